@@ -0,0 +1,226 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek/Arena.h"
+
+#include <memory>
+#include <new>
+
+#include "zeek/3rdparty/doctest.h"
+
+namespace zeek::detail {
+
+Arena::Arena(size_t max_bytes) : max_chunks(max_bytes / CHUNK_SIZE), owner(std::this_thread::get_id()) {}
+
+Arena::~Arena() {
+    // Anything still alive at this point is only released at shutdown, if
+    // at all, so leave chunks with live objects alone.
+    for ( auto* c : chunks ) {
+        if ( c->live == 0 )
+            delete c;
+        else
+            c->arena = nullptr;
+    }
+}
+
+void* Arena::Allocate(size_t size) {
+    size = (size + sizeof(Header) - 1) / sizeof(Header) * sizeof(Header) + sizeof(Header);
+
+    // The stats belong to the owner thread, so other threads leave them alone.
+    if ( std::this_thread::get_id() != owner )
+        return HeapAllocate(size);
+
+    if ( size > MAX_SIZE || max_chunks == 0 || ((! current || current->pos + size > CHUNK_SIZE) && ! NextChunk()) ) {
+        ++stats.heap_allocations;
+        return HeapAllocate(size);
+    }
+
+    auto* h = reinterpret_cast<Header*>(current->data + current->pos);
+    h->chunk = current;
+    current->pos += size;
+    ++current->live;
+
+    ++stats.arena_allocations;
+    ++stats.live;
+
+    return h + 1;
+}
+
+void* Arena::HeapAllocate(size_t size) {
+    auto* h = static_cast<Header*>(::operator new(size));
+    h->chunk = nullptr;
+    return h + 1;
+}
+
+void Arena::Free(void* p) {
+    if ( ! p )
+        return;
+
+    auto* h = static_cast<Header*>(p) - 1;
+    Chunk* c = h->chunk;
+
+    if ( ! c )
+        ::operator delete(h);
+
+    else if ( c->arena )
+        c->arena->Released(c);
+
+    else if ( --c->live == 0 )
+        // The arena is gone already.
+        delete c;
+}
+
+void Arena::Released(Chunk* c) {
+    --c->live;
+    --stats.live;
+
+    if ( c->live == 0 && c->retired ) {
+        c->retired = false;
+        c->pos = 0;
+        free_chunks.push_back(c);
+    }
+}
+
+bool Arena::NextChunk() {
+    if ( current && current->live == 0 ) {
+        // Everything in it is gone already, start over.
+        current->pos = 0;
+        return true;
+    }
+
+    Chunk* next = nullptr;
+
+    if ( ! free_chunks.empty() ) {
+        next = free_chunks.back();
+        free_chunks.pop_back();
+    }
+
+    else if ( chunks.size() < max_chunks ) {
+        next = new Chunk();
+        next->arena = this;
+        chunks.push_back(next);
+        ++stats.chunks;
+    }
+
+    else
+        return false;
+
+    // The current chunk is reused once the last object in it is released.
+    if ( current )
+        current->retired = true;
+
+    current = next;
+    return true;
+}
+
+void Arena::Reset() {
+    if ( current && current->live == 0 && current->pos > 0 ) {
+        current->pos = 0;
+        ++stats.resets;
+    }
+}
+
+Arena& transient_arena() {
+    // Leaked intentionally, objects in it may be released during shutdown.
+    static Arena* arena = new Arena();
+    return *arena;
+}
+
+TEST_SUITE_BEGIN("Arena");
+
+TEST_CASE("arena reset") {
+    Arena a(4 * Arena::CHUNK_SIZE);
+
+    void* p1 = a.Allocate(100);
+    void* p2 = a.Allocate(1);
+    CHECK(reinterpret_cast<uintptr_t>(p1) % alignof(std::max_align_t) == 0);
+    CHECK(reinterpret_cast<uintptr_t>(p2) % alignof(std::max_align_t) == 0);
+    CHECK(static_cast<char*>(p2) - static_cast<char*>(p1) == 128);
+    CHECK(a.GetStats().arena_allocations == 2);
+    CHECK(a.GetStats().live == 2);
+
+    // Something still alive, so no rewinding.
+    Arena::Free(p1);
+    a.Reset();
+    CHECK(a.GetStats().resets == 0);
+    void* p3 = a.Allocate(100);
+    CHECK(p3 != p1);
+    Arena::Free(p2);
+    Arena::Free(p3);
+
+    Arena a2(Arena::CHUNK_SIZE);
+    void* q1 = a2.Allocate(100);
+    Arena::Free(q1);
+    a2.Reset();
+    CHECK(a2.GetStats().resets == 1);
+    void* q2 = a2.Allocate(100);
+    CHECK(q2 == q1);
+    Arena::Free(q2);
+}
+
+TEST_CASE("arena pinned chunks") {
+    Arena a(2 * Arena::CHUNK_SIZE);
+    std::vector<void*> ptrs;
+
+    // Fill both chunks, keeping one object alive in the first.
+    for ( int i = 0; i < 2 * static_cast<int>(Arena::CHUNK_SIZE / 1024); ++i )
+        ptrs.push_back(a.Allocate(1000));
+
+    CHECK(a.GetStats().chunks == 2);
+    CHECK(a.GetStats().heap_allocations == 0);
+
+    void* heap = a.Allocate(1000);
+    CHECK(a.GetStats().heap_allocations == 1);
+    Arena::Free(heap);
+
+    void* pinned = ptrs[0];
+    for ( size_t i = 1; i < ptrs.size(); ++i )
+        Arena::Free(ptrs[i]);
+
+    // The second chunk is current and empty now, the first one pinned.
+    a.Reset();
+    CHECK(a.GetStats().resets == 1);
+    CHECK(a.GetStats().live == 1);
+
+    Arena::Free(pinned);
+    CHECK(a.GetStats().live == 0);
+
+    // Both chunks can be used again.
+    for ( auto& p : ptrs )
+        p = a.Allocate(1000);
+
+    CHECK(a.GetStats().chunks == 2);
+    CHECK(a.GetStats().heap_allocations == 1);
+
+    for ( auto* p : ptrs )
+        Arena::Free(p);
+
+    // Large requests always go to the heap.
+    Arena::Free(a.Allocate(Arena::MAX_SIZE + 1));
+    CHECK(a.GetStats().heap_allocations == 2);
+}
+
+TEST_CASE("arena other threads") {
+    Arena a(Arena::CHUNK_SIZE);
+    void* p = nullptr;
+
+    // Other threads get heap memory without touching the stats.
+    std::thread([&]() { p = a.Allocate(100); }).join();
+    CHECK(a.GetStats().arena_allocations == 0);
+    CHECK(a.GetStats().heap_allocations == 0);
+    CHECK(a.GetStats().chunks == 0);
+    Arena::Free(p);
+}
+
+TEST_CASE("arena allocator while disabled") {
+    // Nothing enables the transient arena in unit tests.
+    REQUIRE_FALSE(transient_arena().Enabled());
+
+    auto before = transient_arena().GetStats().heap_allocations;
+    auto p = std::allocate_shared<int>(ArenaAllocator<int>(), 42);
+    CHECK(*p == 42);
+    CHECK(transient_arena().GetStats().heap_allocations == before);
+}
+
+TEST_SUITE_END();
+
+} // namespace zeek::detail
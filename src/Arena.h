@@ -0,0 +1,181 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <thread>
+#include <vector>
+
+namespace zeek::detail {
+
+/**
+ * A bump allocator for short-lived objects that are created while
+ * processing a packet and normally gone once the resulting events have
+ * been drained, such as the events themselves and IP headers.
+ *
+ * Memory is handed out sequentially from fixed-size chunks. Each chunk
+ * counts the objects still alive in it, and Reset(), called after every
+ * event queue drain, rewinds the current chunk once all of them have been
+ * released. Objects that do outlive the drain are fine: they just keep
+ * their chunk from being reused until they're freed, and the allocator
+ * moves on to another chunk in the meantime.
+ *
+ * Allocations fall back to the heap once the configured number of chunks
+ * are all pinned by live objects, for large requests, and for requests
+ * from threads other than the one that created the arena. Free() handles
+ * either kind, so callers don't need to track where memory came from.
+ *
+ * Apart from the fallback for other threads the arena is not thread-safe:
+ * memory it hands out must be released on the main thread.
+ */
+class Arena {
+public:
+    static constexpr size_t CHUNK_SIZE = 64 * 1024;
+
+    // Requests above this size always go to the heap.
+    static constexpr size_t MAX_SIZE = CHUNK_SIZE / 8;
+
+    struct Stats {
+        uint64_t arena_allocations = 0; //! Allocations served from a chunk.
+        uint64_t heap_allocations = 0;  //! Allocations passed through to the heap.
+        uint64_t resets = 0;            //! Times the current chunk was rewound.
+        uint64_t chunks = 0;            //! Number of chunks allocated.
+        uint64_t live = 0;              //! Objects currently alive in chunks.
+    };
+
+    /**
+     * Constructor.
+     *
+     * @param max_bytes the most memory to hold in chunks. Zero sends all
+     * requests to the heap.
+     */
+    explicit Arena(size_t max_bytes = 0);
+    ~Arena();
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    /**
+     * Allocates memory aligned suitably for any fundamental type.
+     */
+    void* Allocate(size_t size);
+
+    /**
+     * Releases memory returned by Allocate() of any arena.
+     */
+    static void Free(void* p);
+
+    /**
+     * Starts over at the beginning of the current chunk if nothing
+     * allocated from it is still alive.
+     */
+    void Reset();
+
+    /**
+     * Changes the most memory to hold in chunks. Chunks already allocated
+     * are kept even if beyond a lowered limit.
+     */
+    void SetMaxBytes(size_t max_bytes) { max_chunks = max_bytes / CHUNK_SIZE; }
+
+    /**
+     * Returns true if the arena may hand out memory from chunks at all.
+     */
+    bool Enabled() const { return max_chunks > 0; }
+
+    const Stats& GetStats() const { return stats; }
+
+    /**
+     * Returns the number of bytes held in chunks.
+     */
+    uint64_t ChunkBytes() const { return stats.chunks * CHUNK_SIZE; }
+
+private:
+    struct Chunk;
+
+    // Every allocation is preceded by a header pointing to its chunk, or
+    // null for heap allocations.
+    struct alignas(alignof(std::max_align_t)) Header {
+        Chunk* chunk;
+    };
+
+    struct Chunk {
+        Arena* arena;
+        size_t pos = 0;
+        size_t live = 0;
+        bool retired = false;
+        alignas(alignof(std::max_align_t)) char data[CHUNK_SIZE];
+    };
+
+    static void* HeapAllocate(size_t size);
+
+    // Moves on from the current chunk, returning false if there's no other
+    // one available.
+    bool NextChunk();
+
+    void Released(Chunk* c);
+
+    std::vector<Chunk*> chunks;
+    std::vector<Chunk*> free_chunks;
+    Chunk* current = nullptr;
+    size_t max_chunks;
+    std::thread::id owner;
+    Stats stats;
+};
+
+/**
+ * Returns the arena for per-packet and per-event objects. Until the event
+ * manager sets its size from transient_arena_size after script
+ * initialization, all requests go to the heap.
+ */
+Arena& transient_arena();
+
+/**
+ * An STL-compatible allocator placing objects into transient_arena(), for
+ * use with std::allocate_shared(). While the arena is disabled, it goes
+ * straight to the heap. The allocator remembers which one it used, and
+ * std::allocate_shared() keeps it with the object for releasing it.
+ */
+template<typename T>
+class ArenaAllocator {
+public:
+    using value_type = T;
+
+    ArenaAllocator() noexcept : use_arena(transient_arena().Enabled()) {}
+
+    template<typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) noexcept : use_arena(other.use_arena) {}
+
+    T* allocate(size_t n) {
+        if ( use_arena )
+            return static_cast<T*>(transient_arena().Allocate(n * sizeof(T)));
+
+        return static_cast<T*>(::operator new(n * sizeof(T)));
+    }
+
+    void deallocate(T* p, size_t n) noexcept {
+        if ( use_arena )
+            Arena::Free(p);
+        else
+            ::operator delete(p);
+    }
+
+    template<typename U>
+    bool operator==(const ArenaAllocator<U>& other) const noexcept {
+        return use_arena == other.use_arena;
+    }
+
+    template<typename U>
+    bool operator!=(const ArenaAllocator<U>& other) const noexcept {
+        return use_arena != other.use_arena;
+    }
+
+private:
+    template<typename U>
+    friend class ArenaAllocator;
+
+    bool use_arena;
+};
+
+} // namespace zeek::detail
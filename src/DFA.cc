@@ -2,36 +2,95 @@
 
 #include "zeek/DFA.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "zeek/CCL.h"
 #include "zeek/Desc.h"
 #include "zeek/EquivClass.h"
 #include "zeek/Hash.h"
+#include "zeek/ID.h"
+#include "zeek/Val.h"
+#include "zeek/telemetry/Manager.h"
+
+#include "zeek/3rdparty/doctest.h"
 
 namespace zeek::detail {
 
-DFA_State::DFA_State(int arg_state_num, const EquivClass* ec, NFA_state_list* arg_nfa_states,
-                     AcceptingSet* arg_accept) {
+namespace {
+
+// Saved states start with the magic and version. Changing how states are
+// computed or saved needs a new version, which also changes the digests.
+constexpr uint32_t SAVE_MAGIC = 0x5a444641; // "ZDFA"
+constexpr uint32_t SAVE_VERSION = 1;
+
+// Encodings of transitions other than to a saved state.
+constexpr uint32_t SAVED_UNCOMPUTED = 0xfffffffe;
+constexpr uint32_t SAVED_JAM = 0xffffffff;
+
+// Flags of the states in a machine's state table.
+constexpr uint8_t STATE_USED = 1;   // used since the last eviction
+constexpr uint8_t STATE_PINNED = 2; // never to be evicted
+
+void put_uint32(std::string& s, uint32_t v) { s.append(reinterpret_cast<const char*>(&v), sizeof(v)); }
+
+// Reads values from saved states, failing once it runs out of data.
+class SaveReader {
+public:
+    SaveReader(const char* data, size_t len) : p(data), end(data + len) {}
+
+    bool Get(uint32_t* v) {
+        if ( static_cast<size_t>(end - p) < sizeof(*v) )
+            return false;
+
+        memcpy(v, p, sizeof(*v));
+        p += sizeof(*v);
+        return true;
+    }
+
+    const char* Pos() const { return p; }
+
+    bool Skip(size_t n) {
+        if ( static_cast<size_t>(end - p) < n )
+            return false;
+
+        p += n;
+        return true;
+    }
+
+    bool AtEnd() const { return p == end; }
+
+private:
+    const char* p;
+    const char* end;
+};
+
+} // namespace
+
+DFA_State::DFA_State(int arg_state_num, DFA_Machine* arg_machine, const EquivClass* ec,
+                     NFA_state_list* arg_nfa_states, AcceptingSet* arg_accept) {
     state_num = arg_state_num;
     num_sym = ec->NumClasses();
+    machine = arg_machine;
     nfa_states = arg_nfa_states;
     accept = arg_accept;
     mark = nullptr;
 
     SymPartition(ec);
-
-    xtions = new DFA_State*[num_sym];
-
-    for ( int i = 0; i < num_sym; ++i )
-        xtions[i] = DFA_UNCOMPUTED_STATE_PTR;
 }
 
 DFA_State::~DFA_State() {
-    delete[] xtions;
     delete nfa_states;
     delete accept;
     delete meta_ec;
 }
 
-void DFA_State::AddXtion(int sym, DFA_State* next_state) { xtions[sym] = next_state; }
+void DFA_State::AddXtion(int sym, DFA_State* next_state) {
+    Xtions()[sym] = next_state ? next_state->StateNum() : DFA_JAM_STATE;
+}
 
 void DFA_State::SymPartition(const EquivClass* ec) {
     // Partitioning is done by creating equivalence classes for those
@@ -62,11 +121,17 @@ void DFA_State::SymPartition(const EquivClass* ec) {
     meta_ec->BuildECs();
 }
 
-DFA_State* DFA_State::ComputeXtion(int sym, DFA_Machine* machine) {
+int DFA_State::ComputeXtion(int sym, DFA_Machine* machine) {
     int equiv_sym = meta_ec->EquivRep(sym);
-    if ( xtions[equiv_sym] != DFA_UNCOMPUTED_STATE_PTR ) {
-        AddXtion(sym, xtions[equiv_sym]);
-        return xtions[sym];
+    int next = Xtions()[equiv_sym];
+
+    if ( next != DFA_UNCOMPUTED_STATE ) {
+        Xtions()[sym] = next;
+
+        if ( next >= 0 )
+            machine->state_flags[next] |= STATE_USED;
+
+        return next;
     }
 
     const EquivClass* ec = machine->EC();
@@ -76,7 +141,7 @@ DFA_State* DFA_State::ComputeXtion(int sym, DFA_Machine* machine) {
     NFA_state_list* ns = SymFollowSet(equiv_sym, ec);
     if ( ns->length() > 0 ) {
         NFA_state_list* state_set = epsilon_closure(ns);
-        if ( ! machine->StateSetToDFA_State(state_set, next_d, ec) )
+        if ( ! machine->StateSetToDFA_State(state_set, next_d, ec, state_num) )
             delete state_set;
     }
     else {
@@ -84,11 +149,12 @@ DFA_State* DFA_State::ComputeXtion(int sym, DFA_Machine* machine) {
         next_d = nullptr; // Jam
     }
 
+    // Adding the new state may have moved the transition table.
     AddXtion(equiv_sym, next_d);
     if ( sym != equiv_sym )
         AddXtion(sym, next_d);
 
-    return xtions[sym];
+    return Xtions()[sym];
 }
 
 void DFA_State::AppendIfNew(int sym, int_list* sym_list) {
@@ -158,10 +224,10 @@ void DFA_State::ClearMarks() {
         SetMark(nullptr);
 
         for ( int i = 0; i < num_sym; ++i ) {
-            DFA_State* s = xtions[i];
+            int next = Xtions()[i];
 
-            if ( s && s != DFA_UNCOMPUTED_STATE_PTR )
-                xtions[i]->ClearMarks();
+            if ( next >= 0 )
+                machine->State(next)->ClearMarks();
         }
     }
 }
@@ -183,11 +249,13 @@ void DFA_State::Dump(FILE* f, DFA_Machine* m) {
 
     fprintf(f, "\n");
 
+    const int32_t* xtions = Xtions();
+
     int num_trans = 0;
     for ( int sym = 0; sym < num_sym; ++sym ) {
-        DFA_State* s = xtions[sym];
+        int s = xtions[sym];
 
-        if ( ! s )
+        if ( s == DFA_JAM_STATE )
             continue;
 
         // Look ahead for compression.
@@ -208,10 +276,10 @@ void DFA_State::Dump(FILE* f, DFA_Machine* m) {
         else
             snprintf(xbuf, xbuf_size, "'%c'-'%c'", r, m->Rep(i - 1));
 
-        if ( s == DFA_UNCOMPUTED_STATE_PTR )
+        if ( s == DFA_UNCOMPUTED_STATE )
             fprintf(f, "%stransition on %s to <uncomputed>", ++num_trans == 1 ? "\t" : "\n\t", xbuf);
         else
-            fprintf(f, "%stransition on %s to state %d", ++num_trans == 1 ? "\t" : "\n\t", xbuf, s->StateNum());
+            fprintf(f, "%stransition on %s to state %d", ++num_trans == 1 ? "\t" : "\n\t", xbuf, s);
 
         delete[] xbuf;
 
@@ -224,18 +292,18 @@ void DFA_State::Dump(FILE* f, DFA_Machine* m) {
     SetMark(this);
 
     for ( int sym = 0; sym < num_sym; ++sym ) {
-        DFA_State* s = xtions[sym];
+        int s = xtions[sym];
 
-        if ( s && s != DFA_UNCOMPUTED_STATE_PTR )
-            s->Dump(f, m);
+        if ( s >= 0 )
+            m->State(s)->Dump(f, m);
     }
 }
 
 void DFA_State::Stats(unsigned int* computed, unsigned int* uncomputed) {
-    for ( int sym = 0; sym < num_sym; ++sym ) {
-        DFA_State* s = xtions[sym];
+    const int32_t* xtions = Xtions();
 
-        if ( s == DFA_UNCOMPUTED_STATE_PTR )
+    for ( int sym = 0; sym < num_sym; ++sym ) {
+        if ( xtions[sym] == DFA_UNCOMPUTED_STATE )
             (*uncomputed)++;
         else
             (*computed)++;
@@ -243,13 +311,14 @@ void DFA_State::Stats(unsigned int* computed, unsigned int* uncomputed) {
 }
 
 unsigned int DFA_State::Size() {
-    return sizeof(*this) + util::pad_size(sizeof(DFA_State*) * num_sym) +
+    // The state's share of its machine's tables.
+    return sizeof(*this) + sizeof(int32_t) * num_sym + sizeof(DFA_State*) + sizeof(AcceptingSet*) +
            (accept ? util::pad_size(sizeof(int) * accept->size()) : 0) +
            (nfa_states ? util::pad_size(sizeof(NFA_State*) * nfa_states->length()) : 0) +
            (meta_ec ? meta_ec->Size() : 0);
 }
 
-DFA_State_Cache::DFA_State_Cache() { hits = misses = 0; }
+DFA_State_Cache::DFA_State_Cache() { hits = misses = evictions = 0; }
 
 DFA_State_Cache::~DFA_State_Cache() {
     for ( auto& entry : states ) {
@@ -290,9 +359,11 @@ DFA_State* DFA_State_Cache::Lookup(const NFA_state_list& nfas, DigestStr* digest
     auto entry = states.find(*digest);
     if ( entry == states.end() ) {
         ++misses;
+        ++DFA_Machine::totals.misses;
         return nullptr;
     }
     ++hits;
+    ++DFA_Machine::totals.hits;
 
     digest->clear();
 
@@ -300,10 +371,18 @@ DFA_State* DFA_State_Cache::Lookup(const NFA_state_list& nfas, DigestStr* digest
 }
 
 DFA_State* DFA_State_Cache::Insert(DFA_State* state, DigestStr digest) {
+    state->digest = digest;
     states.emplace(std::move(digest), state);
     return state;
 }
 
+void DFA_State_Cache::Remove(DFA_State* state) {
+    states.erase(state->digest);
+    ++evictions;
+    ++DFA_Machine::totals.evictions;
+    Unref(state);
+}
+
 void DFA_State_Cache::GetStats(Stats* s) {
     s->dfa_states = 0;
     s->nfa_states = 0;
@@ -312,6 +391,7 @@ void DFA_State_Cache::GetStats(Stats* s) {
     s->mem = 0;
     s->hits = hits;
     s->misses = misses;
+    s->evictions = evictions;
 
     for ( const auto& state : states ) {
         DFA_State* e = state.second;
@@ -323,12 +403,11 @@ void DFA_State_Cache::GetStats(Stats* s) {
 }
 
 DFA_Machine::DFA_Machine(NFA_Machine* n, EquivClass* arg_ec) {
-    state_count = 0;
-
     nfa = n;
     Ref(n);
 
     ec = arg_ec;
+    num_classes = ec->NumClasses();
 
     dfa_state_cache = new DFA_State_Cache();
 
@@ -338,6 +417,7 @@ DFA_Machine::DFA_Machine(NFA_Machine* n, EquivClass* arg_ec) {
     if ( ns->length() > 0 ) {
         NFA_state_list* state_set = epsilon_closure(ns);
         StateSetToDFA_State(state_set, start_state, ec);
+        Pin(start_state);
     }
     else {
         start_state = nullptr; // Jam
@@ -346,10 +426,41 @@ DFA_Machine::DFA_Machine(NFA_Machine* n, EquivClass* arg_ec) {
 }
 
 DFA_Machine::~DFA_Machine() {
+    totals.mem -= mem;
     delete dfa_state_cache;
     Unref(nfa);
 }
 
+uint64_t DFA_Machine::max_mem = 0;
+DFA_Totals DFA_Machine::totals;
+
+void DFA_Machine::InitPostScript() {
+    SetMaxMemory(id::find_val("dfa_max_memory")->AsCount());
+
+    telemetry_mgr->CounterInstance("zeek", "dfa_state_cache_hits", {},
+                                   "Number of DFA state computations that found the state existing already", "",
+                                   []() { return static_cast<double>(totals.hits); });
+    telemetry_mgr->CounterInstance("zeek", "dfa_state_cache_misses", {}, "Number of DFA states added", "",
+                                   []() { return static_cast<double>(totals.misses); });
+    telemetry_mgr->CounterInstance("zeek", "dfa_state_cache_evictions", {},
+                                   "Number of DFA states evicted to stay within dfa_max_memory", "",
+                                   []() { return static_cast<double>(totals.evictions); });
+    telemetry_mgr->GaugeInstance("zeek", "dfa_state_cache_memory", {}, "Size of the states of all DFAs", "bytes",
+                                 []() { return static_cast<double>(totals.mem); });
+}
+
+void DFA_Machine::Pin(const DFA_State* s) { state_flags[s->StateNum()] |= STATE_PINNED; }
+
+int DFA_Machine::Revive(const DFA_State* s) {
+    auto* state_set = new NFA_state_list(*s->nfa_states);
+
+    DFA_State* d;
+    if ( ! StateSetToDFA_State(state_set, d, ec) )
+        delete state_set;
+
+    return d->StateNum();
+}
+
 void DFA_Machine::Describe(ODesc* d) const { d->Add("DFA machine"); }
 
 void DFA_Machine::Dump(FILE* f) {
@@ -357,12 +468,17 @@ void DFA_Machine::Dump(FILE* f) {
     start_state->ClearMarks();
 }
 
-bool DFA_Machine::StateSetToDFA_State(NFA_state_list* state_set, DFA_State*& d, const EquivClass* ec) {
+bool DFA_Machine::StateSetToDFA_State(NFA_state_list* state_set, DFA_State*& d, const EquivClass* ec, int keep) {
     DigestStr digest;
     d = dfa_state_cache->Lookup(*state_set, &digest);
 
-    if ( d )
+    if ( d ) {
+        state_flags[d->StateNum()] |= STATE_USED;
         return false;
+    }
+
+    if ( max_mem > 0 && mem > max_mem )
+        Evict(keep);
 
     AcceptingSet* accept = new AcceptingSet;
 
@@ -378,9 +494,301 @@ bool DFA_Machine::StateSetToDFA_State(NFA_state_list* state_set, DFA_State*& d,
         accept = nullptr;
     }
 
-    DFA_State* ds = new DFA_State(state_count++, ec, state_set, accept);
+    int id;
+
+    if ( free_ids.empty() ) {
+        id = state_table.size();
+        xtion_table.resize(xtion_table.size() + num_classes, DFA_UNCOMPUTED_STATE);
+        state_table.push_back(nullptr);
+        accept_table.push_back(nullptr);
+        state_flags.push_back(0);
+    }
+    else {
+        id = free_ids.back();
+        free_ids.pop_back();
+
+        auto row = xtion_table.begin() + static_cast<size_t>(id) * num_classes;
+        std::fill(row, row + num_classes, DFA_UNCOMPUTED_STATE);
+    }
+
+    DFA_State* ds = new DFA_State(id, this, ec, state_set, accept);
     d = dfa_state_cache->Insert(ds, std::move(digest));
 
+    state_table[id] = ds;
+    accept_table[id] = accept;
+    state_flags[id] = STATE_USED;
+
+    auto size = ds->Size();
+    mem += size;
+    totals.mem += size;
+
+    return true;
+}
+
+void DFA_Machine::Evict(int keep) {
+    uint64_t target = max_mem / 4 * 3;
+    std::vector<bool> unlink(state_table.size());
+
+    // Going around twice gives each state a chance to lose its mark first.
+    for ( size_t n = 0; n < 2 * state_table.size() && mem > target; ++n ) {
+        size_t id = clock_hand;
+        clock_hand = (clock_hand + 1) % state_table.size();
+
+        DFA_State* s = state_table[id];
+
+        if ( ! s || static_cast<int>(id) == keep || (state_flags[id] & STATE_PINNED) )
+            continue;
+
+        unlink[id] = true;
+
+        if ( state_flags[id] & STATE_USED ) {
+            state_flags[id] &= ~STATE_USED;
+            continue;
+        }
+
+        auto size = s->Size();
+        mem -= size;
+        totals.mem -= size;
+
+        state_table[id] = nullptr;
+        accept_table[id] = nullptr;
+        free_ids.push_back(id);
+
+        s->state_num = DFA_JAM_STATE;
+        s->machine = nullptr;
+        dfa_state_cache->Remove(s);
+    }
+
+    for ( auto& next : xtion_table ) {
+        if ( next >= 0 && unlink[next] )
+            next = DFA_UNCOMPUTED_STATE;
+    }
+}
+
+bool DFA_Machine::Precompile(int max_states) {
+    if ( ! start_state )
+        return true;
+
+    std::vector<DFA_State*> todo{start_state};
+    std::unordered_set<DFA_State*> seen{start_state};
+    int evictions = dfa_state_cache->NumEvictions();
+
+    while ( ! todo.empty() ) {
+        if ( NumStates() >= max_states )
+            return false;
+
+        DFA_State* s = todo.back();
+        todo.pop_back();
+
+        for ( int sym = 0; sym < ec->NumClasses(); ++sym ) {
+            DFA_State* next = s->Xtion(sym, this);
+
+            // Evicting invalidates the states collected so far.
+            if ( dfa_state_cache->NumEvictions() != evictions )
+                return false;
+
+            if ( next && seen.insert(next).second )
+                todo.push_back(next);
+        }
+    }
+
+    return true;
+}
+
+std::vector<NFA_State*> DFA_Machine::NFAStates() const {
+    std::vector<NFA_State*> states{nfa->FirstState()};
+    std::unordered_set<NFA_State*> seen{nfa->FirstState()};
+
+    for ( size_t i = 0; i < states.size(); ++i ) {
+        for ( auto* next : *states[i]->Transitions() ) {
+            if ( seen.insert(next).second )
+                states.push_back(next);
+        }
+    }
+
+    return states;
+}
+
+std::string DFA_Machine::Digest() const {
+    std::string desc;
+    put_uint32(desc, SAVE_VERSION);
+
+    for ( int sym = 0; sym < ec->NumSyms(); ++sym )
+        put_uint32(desc, ec->SymEquivClass(sym));
+
+    auto states = NFAStates();
+    std::unordered_map<const NFA_State*, uint32_t> index;
+
+    for ( size_t i = 0; i < states.size(); ++i )
+        index[states[i]] = i;
+
+    for ( auto* n : states ) {
+        put_uint32(desc, n->TransSym());
+        put_uint32(desc, n->Accept());
+
+        if ( n->TransSym() == SYM_CCL ) {
+            put_uint32(desc, n->TransCCL()->IsNegated());
+            put_uint32(desc, n->TransCCL()->Syms()->size());
+
+            for ( auto sym : *n->TransCCL()->Syms() )
+                put_uint32(desc, sym);
+        }
+
+        put_uint32(desc, n->Transitions()->length());
+
+        for ( auto* next : *n->Transitions() )
+            put_uint32(desc, index[next]);
+    }
+
+    hash128_t hash;
+    KeyedHash::StaticHash128(desc.data(), desc.size(), &hash);
+
+    std::string digest;
+    const auto* bytes = reinterpret_cast<const unsigned char*>(hash);
+
+    for ( size_t i = 0; i < sizeof(hash); ++i ) {
+        char hex[2];
+        util::bytetohex(bytes[i], hex);
+        digest.append(hex, 2);
+    }
+
+    return digest;
+}
+
+std::string DFA_Machine::Save() const {
+    // Number the states in the order they're reachable from the start
+    // state, so that it comes first.
+    std::vector<DFA_State*> states;
+    std::unordered_map<const DFA_State*, uint32_t> state_index;
+
+    if ( start_state ) {
+        states.push_back(start_state);
+        state_index[start_state] = 0;
+    }
+
+    for ( size_t i = 0; i < states.size(); ++i ) {
+        for ( int sym = 0; sym < num_classes; ++sym ) {
+            DFA_State* next = State(states[i]->Xtions()[sym]);
+
+            if ( next && state_index.emplace(next, states.size()).second )
+                states.push_back(next);
+        }
+    }
+
+    auto nfa_states = NFAStates();
+    std::unordered_map<const NFA_State*, uint32_t> nfa_index;
+
+    for ( size_t i = 0; i < nfa_states.size(); ++i )
+        nfa_index[nfa_states[i]] = i;
+
+    std::string data;
+    put_uint32(data, SAVE_MAGIC);
+    put_uint32(data, SAVE_VERSION);
+    put_uint32(data, ec->NumClasses());
+    put_uint32(data, states.size());
+
+    for ( auto* s : states ) {
+        put_uint32(data, s->nfa_states->length());
+
+        for ( auto* n : *s->nfa_states )
+            put_uint32(data, nfa_index[n]);
+
+        for ( int sym = 0; sym < num_classes; ++sym ) {
+            int next = s->Xtions()[sym];
+
+            if ( next == DFA_UNCOMPUTED_STATE )
+                put_uint32(data, SAVED_UNCOMPUTED);
+            else if ( next == DFA_JAM_STATE )
+                put_uint32(data, SAVED_JAM);
+            else
+                put_uint32(data, state_index[State(next)]);
+        }
+    }
+
+    uint64_t checksum = KeyedHash::StaticHash64(data.data(), data.size());
+    data.append(reinterpret_cast<const char*>(&checksum), sizeof(checksum));
+
+    return data;
+}
+
+bool DFA_Machine::Load(const char* data, size_t len) {
+    uint64_t checksum;
+
+    if ( ! start_state || len < sizeof(checksum) )
+        return false;
+
+    len -= sizeof(checksum);
+    memcpy(&checksum, data + len, sizeof(checksum));
+
+    if ( checksum != KeyedHash::StaticHash64(data, len) )
+        return false;
+
+    SaveReader r(data, len);
+    uint32_t magic, version, num_classes, num_states;
+
+    if ( ! r.Get(&magic) || magic != SAVE_MAGIC || ! r.Get(&version) || version != SAVE_VERSION ||
+         ! r.Get(&num_classes) || num_classes != static_cast<uint32_t>(ec->NumClasses()) || ! r.Get(&num_states) ||
+         num_states == 0 )
+        return false;
+
+    auto nfa_states = NFAStates();
+    std::vector<DFA_State*> states;
+    std::vector<const char*> xtions;
+    int evictions = dfa_state_cache->NumEvictions();
+
+    // Create all the states first, so that transitions can refer to them.
+    while ( states.size() < num_states ) {
+        uint32_t n;
+
+        if ( ! r.Get(&n) || n > nfa_states.size() )
+            return false;
+
+        auto* state_set = new NFA_state_list;
+
+        for ( uint32_t i = 0; i < n; ++i ) {
+            uint32_t idx;
+
+            if ( ! r.Get(&idx) || idx >= nfa_states.size() ) {
+                delete state_set;
+                return false;
+            }
+
+            state_set->push_back(nfa_states[idx]);
+        }
+
+        std::sort(state_set->begin(), state_set->end(), NFA_state_cmp_neg);
+
+        DFA_State* d;
+        if ( ! StateSetToDFA_State(state_set, d, ec) )
+            delete state_set;
+
+        states.push_back(d);
+        xtions.push_back(r.Pos());
+
+        if ( ! r.Skip(num_classes * sizeof(uint32_t)) )
+            return false;
+    }
+
+    // If restoring the states evicted some, they don't fit the memory limit.
+    if ( ! r.AtEnd() || states[0] != start_state || dfa_state_cache->NumEvictions() != evictions )
+        return false;
+
+    for ( size_t i = 0; i < states.size(); ++i ) {
+        SaveReader xr(xtions[i], num_classes * sizeof(uint32_t));
+
+        for ( uint32_t sym = 0; sym < num_classes; ++sym ) {
+            uint32_t next;
+            xr.Get(&next);
+
+            if ( next == SAVED_JAM )
+                states[i]->AddXtion(sym, nullptr);
+            else if ( next < num_states )
+                states[i]->AddXtion(sym, states[next]);
+            else if ( next != SAVED_UNCOMPUTED )
+                return false;
+        }
+    }
+
     return true;
 }
 
@@ -392,4 +800,222 @@ int DFA_Machine::Rep(int sym) {
     return -1;
 }
 
+TEST_SUITE_BEGIN("dfa");
+
+TEST_CASE("jam and uncomputed transitions") {
+    Specific_RE_Matcher m(MATCH_EXACTLY);
+    m.AddPat("ab");
+    REQUIRE(m.Compile());
+
+    DFA_Machine* dfa = m.DFA();
+    const int* ecs = m.EC()->EquivClasses();
+    auto num_classes = static_cast<unsigned int>(m.EC()->NumClasses());
+
+    // Compiling lazily computes no transitions.
+    unsigned int computed = 0;
+    unsigned int uncomputed = 0;
+    dfa->StartState()->Stats(&computed, &uncomputed);
+    CHECK_EQ(computed, 0);
+    CHECK_EQ(uncomputed, num_classes);
+
+    int bol = dfa->Xtion(dfa->StartStateID(), ecs[SYM_BOL]);
+    REQUIRE(bol >= 0);
+
+    // A character the pattern can't start with jams, and the jam is then
+    // stored as computed rather than computed again.
+    int num_states = dfa->NumStates();
+    CHECK_EQ(dfa->Xtion(bol, ecs['x']), DFA_JAM_STATE);
+    CHECK_EQ(dfa->Xtion(bol, ecs['x']), DFA_JAM_STATE);
+    CHECK_EQ(dfa->NumStates(), num_states);
+    CHECK_FALSE(dfa->State(bol)->Xtion(ecs['x'], dfa));
+
+    computed = uncomputed = 0;
+    dfa->State(bol)->Stats(&computed, &uncomputed);
+    CHECK(computed > 0);
+    CHECK_EQ(computed + uncomputed, num_classes);
+
+    // The characters of the pattern lead to proper states.
+    int a = dfa->Xtion(bol, ecs['a']);
+    REQUIRE(a >= 0);
+    CHECK_FALSE(dfa->Accept(a));
+
+    int b = dfa->Xtion(a, ecs['b']);
+    REQUIRE(b >= 0);
+    int eol = dfa->Xtion(b, ecs[SYM_EOL]);
+    REQUIRE(eol >= 0);
+    CHECK(dfa->Accept(eol));
+    CHECK_EQ(dfa->Xtion(b, ecs['b']), DFA_JAM_STATE);
+
+    CHECK(m.MatchAll("ab"));
+    CHECK_FALSE(m.MatchAll("abb"));
+}
+
+TEST_CASE("transitions survive the table growing") {
+    // Each character leads to a new state, which adds a row to the
+    // transition table while the previous state's transition is being
+    // computed. Growing the table from one row to dozens reallocates it
+    // several times.
+    const char* pat = "abcdefghijklmnopqrstuvwxyz0123456789";
+
+    Specific_RE_Matcher m(MATCH_EXACTLY);
+    m.AddPat(pat);
+    REQUIRE(m.Compile());
+
+    DFA_Machine* dfa = m.DFA();
+    const int* ecs = m.EC()->EquivClasses();
+
+    int d = dfa->Xtion(dfa->StartStateID(), ecs[SYM_BOL]);
+    REQUIRE(d >= 0);
+
+    for ( const char* p = pat; *p; ++p ) {
+        int num_states = dfa->NumStates();
+        int next = dfa->Xtion(d, ecs[static_cast<u_char>(*p)]);
+        REQUIRE(next >= 0);
+        CHECK_EQ(dfa->NumStates(), num_states + 1);
+
+        // The transition went into the state's row of the grown table,
+        // so looking it up again neither computes nor adds anything.
+        CHECK_EQ(dfa->Xtion(d, ecs[static_cast<u_char>(*p)]), next);
+        CHECK_EQ(dfa->NumStates(), num_states + 1);
+        CHECK_EQ(dfa->State(d)->Xtion(ecs[static_cast<u_char>(*p)], dfa), dfa->State(next));
+
+        d = next;
+    }
+
+    CHECK(m.MatchAll(pat));
+}
+
+namespace {
+
+// The layout the transitions had before the table of state IDs: each state
+// with a separately allocated array of pointers to the next states.
+struct PointerState {
+    PointerState** xtions;
+    const AcceptingSet* accept;
+};
+
+// Walks data through the machine like the matchers do, starting over after
+// jams. Returns the number of accepting states passed.
+size_t walk_table(DFA_Machine* dfa, const int* ecs, const std::string& data) {
+    int start = dfa->StartStateID();
+    int d = start;
+    size_t accepts = 0;
+
+    for ( auto c : data ) {
+        d = dfa->Xtion(d, ecs[static_cast<u_char>(c)]);
+
+        if ( d == DFA_JAM_STATE )
+            d = start;
+        else if ( dfa->Accept(d) )
+            ++accepts;
+    }
+
+    return accepts;
+}
+
+size_t walk_pointers(PointerState* start, const int* ecs, const std::string& data) {
+    auto* uncomputed = reinterpret_cast<PointerState*>(DFA_UNCOMPUTED_STATE);
+    PointerState* s = start;
+    size_t accepts = 0;
+
+    for ( auto c : data ) {
+        s = s->xtions[ecs[static_cast<u_char>(c)]];
+
+        // Everything is computed here, but the old loop checked for it.
+        if ( s == uncomputed )
+            return 0;
+
+        if ( ! s )
+            s = start;
+        else if ( s->accept )
+            ++accepts;
+    }
+
+    return accepts;
+}
+
+} // namespace
+
+// Microbenchmark comparing the transition table to the former layout of
+// per-state pointer arrays, for a fully computed machine. Skipped by
+// default, run with:
+// zeek --test -tc="dfa transition table benchmark" --no-skip
+TEST_CASE("dfa transition table benchmark" * doctest::skip(true)) {
+    constexpr size_t data_size = 16 * 1024 * 1024;
+    constexpr int rounds = 10;
+
+    Specific_RE_Matcher m(MATCH_ANYWHERE);
+
+    for ( const char* pat : {"GET /[a-z]+\\.php", "User-Agent: [A-Za-z]+/[0-9]\\.[0-9]", "evil-[0-9a-f]{8}\\.com",
+                             "\\x00\\x01\\x02\\x03", "[Pp][Aa][Ss][Ss]: .+"} )
+        m.AddPat(pat);
+
+    REQUIRE(m.Compile());
+
+    DFA_Machine* dfa = m.DFA();
+    const int* ecs = m.EC()->EquivClasses();
+    int num_classes = m.EC()->NumClasses();
+    REQUIRE(dfa->Precompile(1000000));
+
+    int num_states = dfa->NumStates();
+    std::vector<PointerState> pointer_states(num_states);
+
+    for ( int id = 0; id < num_states; ++id ) {
+        REQUIRE(dfa->State(id));
+        auto& ps = pointer_states[id];
+        ps.xtions = new PointerState*[num_classes];
+        ps.accept = dfa->Accept(id);
+
+        for ( int sym = 0; sym < num_classes; ++sym ) {
+            int next = dfa->Xtion(id, sym);
+            ps.xtions[sym] = next >= 0 ? &pointer_states[next] : nullptr;
+        }
+    }
+
+    // Printable noise with the patterns' prefixes sprinkled in.
+    std::string data;
+    data.reserve(data_size);
+    uint32_t r = 1;
+
+    while ( data.size() < data_size ) {
+        r = r * 1103515245 + 12345;
+
+        if ( (r >> 16) % 512 == 0 )
+            data += "GET /index.php User-Agent: zeek/8.0 evil-0123abcd.com pass: x\n";
+        else
+            data += static_cast<char>(' ' + (r >> 16) % 95);
+    }
+
+    auto rate = [&data](auto&& walk) {
+        size_t accepts = 0;
+        auto start = std::chrono::steady_clock::now();
+
+        for ( int i = 0; i < rounds; ++i )
+            accepts += walk();
+
+        std::chrono::duration<double> t = std::chrono::steady_clock::now() - start;
+        return std::make_pair(rounds * data.size() / t.count() / 1e6, accepts);
+    };
+
+    auto [table_rate, table_accepts] = rate([&]() { return walk_table(dfa, ecs, data); });
+    auto [pointer_rate, pointer_accepts] =
+        rate([&]() { return walk_pointers(&pointer_states[dfa->StartStateID()], ecs, data); });
+    CHECK_EQ(table_accepts, pointer_accepts);
+
+    // Per state, the table holds a row plus the entries of the ID-indexed
+    // state and accepting set tables. The pointer layout held a pointer to
+    // an array of its own, not counting the allocator's overhead for it.
+    size_t table_bytes = num_classes * sizeof(int32_t) + sizeof(DFA_State*) + sizeof(AcceptingSet*);
+    size_t pointer_bytes = num_classes * sizeof(DFA_State*) + sizeof(DFA_State**);
+
+    MESSAGE(util::fmt("%d states, %d equivalence classes", num_states, num_classes));
+    MESSAGE(util::fmt("state ID table:  %4zu bytes/state, %8.1f MB/s", table_bytes, table_rate));
+    MESSAGE(util::fmt("pointer arrays:  %4zu bytes/state, %8.1f MB/s", pointer_bytes, pointer_rate));
+
+    for ( auto& ps : pointer_states )
+        delete[] ps.xtions;
+}
+
+TEST_SUITE_END();
+
 } // namespace zeek::detail
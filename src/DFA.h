@@ -4,8 +4,10 @@
 
 #include <sys/types.h>
 #include <cassert>
+#include <cstdint>
 #include <map>
 #include <string>
+#include <vector>
 
 #include "zeek/NFA.h"
 #include "zeek/Obj.h"
@@ -17,17 +19,29 @@ class DFA_State;
 class DFA_Machine;
 
 // Transitions to the uncomputed state indicate that we haven't yet
-// computed the state to go to.
+// computed the state to go to. Transitions to the jam state indicate
+// that no match is possible anymore.
 #define DFA_UNCOMPUTED_STATE (-2)
-#define DFA_UNCOMPUTED_STATE_PTR ((DFA_State*)DFA_UNCOMPUTED_STATE)
+#define DFA_JAM_STATE (-1)
 
+using DigestStr = std::string;
+
+// The transitions of a state live in its machine's transition table, see
+// DFA_Machine::Xtion().
 class DFA_State : public Obj {
 public:
-    DFA_State(int state_num, const EquivClass* ec, NFA_state_list* nfa_states, AcceptingSet* accept);
+    DFA_State(int state_num, DFA_Machine* machine, const EquivClass* ec, NFA_state_list* nfa_states,
+              AcceptingSet* accept);
     ~DFA_State() override;
 
     int StateNum() const { return state_num; }
     int NFAStateNum() const { return nfa_states->length(); }
+
+    // Returns true if the machine has evicted the state to make room for
+    // others. Only references held elsewhere keep it alive then, see
+    // DFA_Machine::Revive().
+    bool Evicted() const { return state_num == DFA_JAM_STATE; }
+
     void AddXtion(int sym, DFA_State* next_state);
 
     inline DFA_State* Xtion(int sym, DFA_Machine* machine);
@@ -52,14 +66,21 @@ public:
 
 protected:
     friend class DFA_State_Cache;
+    friend class DFA_Machine; // for computing transitions and saving and loading states
 
-    DFA_State* ComputeXtion(int sym, DFA_Machine* machine);
+    // Returns the ID of the state to go to.
+    int ComputeXtion(int sym, DFA_Machine* machine);
     void AppendIfNew(int sym, int_list* sym_list);
 
+    // Returns the state's row of the transition table. Adding states
+    // invalidates it.
+    inline int32_t* Xtions() const;
+
     int state_num;
     int num_sym;
 
-    DFA_State** xtions;
+    DFA_Machine* machine;
+    DigestStr digest; // the state's key in the cache
 
     AcceptingSet* accept;
     NFA_state_list* nfa_states;
@@ -67,8 +88,6 @@ protected:
     DFA_State* mark;
 };
 
-using DigestStr = std::string;
-
 struct DFA_State_Cache_Stats {
     // Sum of all NFA states
     unsigned int nfa_states;
@@ -78,6 +97,15 @@ struct DFA_State_Cache_Stats {
     unsigned int mem;
     unsigned int hits;
     unsigned int misses;
+    unsigned int evictions;
+};
+
+// Statistics summed up over all machines.
+struct DFA_Totals {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+    uint64_t mem = 0; // size of the states the machines currently have
 };
 
 class DFA_State_Cache {
@@ -91,7 +119,11 @@ public:
     // Takes ownership of state; digest is the one returned by Lookup().
     DFA_State* Insert(DFA_State* state, DigestStr digest);
 
+    // Releases a state that Insert() took ownership of.
+    void Remove(DFA_State* state);
+
     int NumEntries() const { return states.size(); }
+    int NumEvictions() const { return evictions; }
 
     using Stats = DFA_State_Cache_Stats;
     void GetStats(Stats* s);
@@ -99,6 +131,7 @@ public:
 private:
     int hits; // Statistics
     int misses;
+    int evictions;
 
     // Hash indexed by NFA states (MD5s of them, actually).
     std::map<DigestStr, DFA_State*> states;
@@ -110,13 +143,65 @@ public:
     ~DFA_Machine() override;
 
     DFA_State* StartState() const { return start_state; }
+    int StartStateID() const { return start_state ? start_state->StateNum() : DFA_JAM_STATE; }
+
+    // Returns the state with the given ID, or null for DFA_JAM_STATE.
+    DFA_State* State(int id) const { return id >= 0 ? state_table[id] : nullptr; }
+
+    // Returns the ID of the state that the state with the given ID goes to
+    // on the equivalence class sym, computing it if necessary, or
+    // DFA_JAM_STATE if there's none.
+    inline int Xtion(int state, int sym);
+
+    // Returns what the state with the given ID accepts, or null if it
+    // isn't an accepting state.
+    const AcceptingSet* Accept(int state) const { return accept_table[state]; }
 
     int NumStates() const { return dfa_state_cache->NumEntries(); }
 
     DFA_State_Cache* Cache() { return dfa_state_cache; }
 
+    // Keeps the machine from ever evicting a state, so that callers may
+    // hold on to it without a reference and compare it to others.
+    void Pin(const DFA_State* s);
+
+    // Returns the ID of the machine's state for the same NFA states as one
+    // it has evicted, adding that state anew if needed.
+    int Revive(const DFA_State* s);
+
+    // Limits the size of each machine's states. Once a machine exceeds
+    // the limit, it evicts states it hasn't used recently, down to three
+    // quarters of the limit, and computes them again if needed. Zero means
+    // no limit.
+    static void SetMaxMemory(uint64_t bytes) { max_mem = bytes; }
+
+    static const DFA_Totals& Totals() { return totals; }
+
+    // Applies the script-level settings and registers the telemetry
+    // metrics, once the scripts are parsed.
+    static void InitPostScript();
+
     int Rep(int sym);
 
+    // Computes all states reachable from the start state, rather than
+    // leaving that to the first matches needing them. Stops once the
+    // machine has at least max_states states. Returns true if the machine
+    // is complete.
+    bool Precompile(int max_states);
+
+    // Returns a hex digest identifying the NFA and equivalence classes,
+    // which together determine the DFA. It remains the same across runs.
+    std::string Digest() const;
+
+    // Returns the states computed so far in a form that Load() restores,
+    // in this run or a later one.
+    std::string Save() const;
+
+    // Restores states returned by Save() for a machine with the same
+    // digest. Returns false if the data doesn't fit the machine, in which
+    // case some of the states may have been restored.
+    bool Load(const char* data, size_t len);
+
     void Describe(ODesc* d) const override;
     void Dump(FILE* f);
 
@@ -124,24 +209,63 @@ protected:
     friend class DFA_State; // for DFA_State::ComputeXtion
     friend class DFA_State_Cache;
 
-    int state_count;
-
-    // The state list has to be sorted according to IDs.
-    bool StateSetToDFA_State(NFA_state_list* state_set, DFA_State*& d, const EquivClass* ec);
+    // The state list has to be sorted according to IDs. Adding a state
+    // may evict others, except for the one with the ID keep.
+    bool StateSetToDFA_State(NFA_state_list* state_set, DFA_State*& d, const EquivClass* ec,
+                             int keep = DFA_JAM_STATE);
     const EquivClass* EC() const { return ec; }
 
+    // Evicts states not used since the last eviction until the states fit
+    // into three quarters of the limit. Transitions to states it spares
+    // become uncomputed as well, so that their next use marks them again.
+    void Evict(int keep);
+
+    // Returns the NFA's states in an order that doesn't depend on their
+    // IDs, which differ between runs.
+    std::vector<NFA_State*> NFAStates() const;
+
     EquivClass* ec; // equivalence classes corresponding to NFAs
+    int num_classes;
     DFA_State* start_state;
+
+    // The transition table, with one row of num_classes state IDs for each
+    // state, in the order of the IDs. Matching walks this rather than the
+    // states themselves, which keeps the transitions of a machine together
+    // and halves their size compared to pointers.
+    std::vector<int32_t> xtion_table;
+
+    // The states and what they accept, indexed by ID. The IDs of evicted
+    // states get reused.
+    std::vector<DFA_State*> state_table;
+    std::vector<const AcceptingSet*> accept_table;
+    std::vector<uint8_t> state_flags;
+    std::vector<int> free_ids;
     DFA_State_Cache* dfa_state_cache;
 
+    uint64_t mem = 0; // size of the states
+    size_t clock_hand = 0;
+
+    static uint64_t max_mem;
+    static DFA_Totals totals;
+
     NFA_Machine* nfa;
 };
 
+inline int32_t* DFA_State::Xtions() const {
+    return machine->xtion_table.data() + static_cast<size_t>(state_num) * num_sym;
+}
+
 inline DFA_State* DFA_State::Xtion(int sym, DFA_Machine* machine) {
-    if ( xtions[sym] == DFA_UNCOMPUTED_STATE_PTR )
-        return ComputeXtion(sym, machine);
-    else
-        return xtions[sym];
+    return machine->State(machine->Xtion(state_num, sym));
+}
+
+inline int DFA_Machine::Xtion(int state, int sym) {
+    int next = xtion_table[static_cast<size_t>(state) * num_classes + sym];
+
+    if ( next == DFA_UNCOMPUTED_STATE )
+        return state_table[state]->ComputeXtion(sym, this);
+
+    return next;
 }
 
 } // namespace zeek::detail
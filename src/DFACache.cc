@@ -0,0 +1,146 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek/DFACache.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+
+#include "zeek/DFA.h"
+#include "zeek/DebugLogger.h"
+#include "zeek/ID.h"
+#include "zeek/Reporter.h"
+#include "zeek/RuleMatcher.h"
+#include "zeek/Scope.h"
+#include "zeek/Val.h"
+#include "zeek/telemetry/Manager.h"
+#include "zeek/util.h"
+
+namespace zeek::detail {
+
+bool DFACache::Precompile(DFA_Machine* dfa) {
+    std::string path;
+
+    if ( ! dir.empty() ) {
+        path = util::fmt("%s/%s.dfa", dir.c_str(), dfa->Digest().c_str());
+
+        if ( Load(dfa, path) )
+            ++loaded;
+    }
+
+    DFA_State_Cache::Stats before;
+    dfa->Cache()->GetStats(&before);
+
+    bool complete = dfa->Precompile(max_states);
+
+    if ( ! complete )
+        ++incomplete;
+
+    // Only write the file if loading it didn't provide everything.
+    DFA_State_Cache::Stats after;
+    dfa->Cache()->GetStats(&after);
+
+    if ( ! path.empty() && after.computed != before.computed && Save(dfa, path) )
+        ++saved;
+
+    return complete;
+}
+
+bool DFACache::Load(DFA_Machine* dfa, const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+    if ( fd < 0 )
+        return false;
+
+    struct stat sb;
+    void* data = MAP_FAILED;
+
+    if ( fstat(fd, &sb) == 0 && sb.st_size > 0 )
+        data = mmap(nullptr, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    close(fd);
+
+    if ( data == MAP_FAILED )
+        return false;
+
+    bool ok = dfa->Load(static_cast<const char*>(data), sb.st_size);
+    munmap(data, sb.st_size);
+
+    if ( ! ok )
+        reporter->Warning("ignoring invalid DFA cache file %s", path.c_str());
+
+    return ok;
+}
+
+bool DFACache::Save(DFA_Machine* dfa, const std::string& path) {
+    auto data = dfa->Save();
+    std::string tmp = util::fmt("%s.%d.tmp", path.c_str(), getpid());
+
+    int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+
+    if ( fd < 0 ) {
+        reporter->Warning("cannot create DFA cache file %s: %s", tmp.c_str(), strerror(errno));
+        return false;
+    }
+
+    bool ok = util::safe_write(fd, data.data(), data.size());
+
+    if ( close(fd) != 0 )
+        ok = false;
+
+    if ( ok && rename(tmp.c_str(), path.c_str()) == 0 )
+        return true;
+
+    reporter->Warning("cannot write DFA cache file %s: %s", path.c_str(), strerror(errno));
+    unlink(tmp.c_str());
+    return false;
+}
+
+void precompile_dfas() {
+    auto dir = id::find_val("dfa_cache_dir")->AsStringVal()->ToStdString();
+    auto max_states = std::min(id::find_val("dfa_precompile_max_states")->AsCount(), zeek_uint_t(INT_MAX));
+
+    if ( ! dir.empty() && ! util::detail::ensure_intermediate_dirs(dir.c_str()) ) {
+        reporter->Warning("cannot create DFA cache directory %s", dir.c_str());
+        dir.clear();
+    }
+
+    DFACache cache(std::move(dir), static_cast<int>(max_states));
+
+    // Only constants keep their patterns for good.
+    for ( const auto& [name, id] : global_scope()->Vars() ) {
+        if ( id->GetType()->Tag() != TYPE_PATTERN || ! id->IsConst() || ! id->HasVal() )
+            continue;
+
+        const RE_Matcher* re = id->GetVal()->AsPattern();
+
+        for ( auto* m : {re->ExactMatcher(), re->AnywhereMatcher()} ) {
+            if ( m->DFA() )
+                cache.Precompile(m->DFA());
+        }
+    }
+
+    if ( rule_matcher )
+        rule_matcher->PrecompileDFAs(&cache);
+
+    DBG_LOG(DBG_RULES, "precompiled DFAs: %d loaded from cache, %d saved to cache, %d incomplete", cache.Loaded(),
+            cache.Saved(), cache.Incomplete());
+
+    telemetry_mgr
+        ->CounterInstance("zeek", "dfa_cache_loaded", {}, "Number of DFAs loaded from dfa_cache_dir at startup")
+        ->Inc(cache.Loaded());
+    telemetry_mgr->CounterInstance("zeek", "dfa_cache_saved", {}, "Number of DFAs saved to dfa_cache_dir at startup")
+        ->Inc(cache.Saved());
+
+    if ( cache.Incomplete() > 0 )
+        reporter->Warning("%d DFAs reached dfa_precompile_max_states or dfa_max_memory and remain partially computed",
+                          cache.Incomplete());
+}
+
+} // namespace zeek::detail
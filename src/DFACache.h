@@ -0,0 +1,79 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+//
+// Computing DFAs ahead of time and keeping them across runs.
+
+#pragma once
+
+#include <string>
+#include <utility>
+
+namespace zeek::detail {
+
+class DFA_Machine;
+
+/**
+ * Computes DFAs completely ahead of time, so that matching doesn't need to
+ * build their states on the fly.
+ *
+ * With a directory set, the cache saves each DFA there in a file named
+ * after the machine's digest, and later runs load the states from that file
+ * instead of computing them again. Files get written under a temporary name
+ * and then renamed, so that processes starting up concurrently never see
+ * partial ones.
+ */
+class DFACache {
+public:
+    /**
+     * Constructor.
+     *
+     * @param dir The directory for the files, or empty to not keep DFAs
+     * across runs.
+     *
+     * @param max_states The number of states at which precompiling a DFA
+     * gives up, leaving the rest to be computed while matching.
+     */
+    DFACache(std::string dir, int max_states) : dir(std::move(dir)), max_states(max_states) {}
+
+    /**
+     * Computes all states of a DFA, loading what's in the cache first.
+     *
+     * @return False if the DFA reached the maximum number of states and
+     * thus remains incomplete.
+     */
+    bool Precompile(DFA_Machine* dfa);
+
+    /**
+     * Returns the number of DFAs loaded from the cache.
+     */
+    int Loaded() const { return loaded; }
+
+    /**
+     * Returns the number of DFAs that were saved to the cache.
+     */
+    int Saved() const { return saved; }
+
+    /**
+     * Returns the number of DFAs that remained incomplete.
+     */
+    int Incomplete() const { return incomplete; }
+
+private:
+    bool Load(DFA_Machine* dfa, const std::string& path);
+    bool Save(DFA_Machine* dfa, const std::string& path);
+
+    std::string dir;
+    int max_states;
+
+    int loaded = 0;
+    int saved = 0;
+    int incomplete = 0;
+};
+
+/**
+ * Precompiles the DFAs of all signatures and global pattern constants, as
+ * configured by :zeek:see:`dfa_precompile_max_states` and
+ * :zeek:see:`dfa_cache_dir`.
+ */
+extern void precompile_dfas();
+
+} // namespace zeek::detail
@@ -2,13 +2,112 @@
 
 #include "zeek/Dict.h"
 
+#include "zeek/zeek-config.h"
+
+#ifndef _MSC_VER
+#include <sys/mman.h>
+#endif
+#include <chrono>
+#include <cstring>
+
 #include "zeek/Hash.h"
 
 #include "zeek/3rdparty/doctest.h"
 
 namespace zeek {
 
-// namespace detail
+namespace detail {
+
+thread_local DictResizeStats dict_resize_stats;
+
+#ifndef _MSC_VER
+static bool use_mmap(size_t bytes) { return bytes >= DICT_MMAP_THRESHOLD; }
+
+static void* map_table(size_t bytes) {
+    void* p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if ( p == MAP_FAILED )
+        throw std::bad_alloc();
+
+    return p;
+}
+#else
+static bool use_mmap(size_t bytes) { return false; }
+#endif
+
+void* dict_table_alloc(size_t bytes) {
+#ifndef _MSC_VER
+    if ( use_mmap(bytes) )
+        // Fresh anonymous pages are zero already, and only materialize once touched.
+        return map_table(bytes);
+#endif
+
+    void* p = calloc(1, bytes);
+    if ( ! p )
+        throw std::bad_alloc();
+
+    return p;
+}
+
+void* dict_table_grow(void* table, size_t old_bytes, size_t new_bytes) {
+    auto start = std::chrono::steady_clock::now();
+    void* p = nullptr;
+
+    if ( use_mmap(new_bytes) ) {
+#ifndef _MSC_VER
+        if ( ! use_mmap(old_bytes) ) {
+            p = map_table(new_bytes);
+            memcpy(p, table, old_bytes);
+            free(table);
+        }
+        else {
+#ifdef MREMAP_MAYMOVE
+            // Moves the page mappings rather than the data, the added pages are zero-filled.
+            p = mremap(table, old_bytes, new_bytes, MREMAP_MAYMOVE);
+            if ( p == MAP_FAILED )
+                throw std::bad_alloc();
+#else
+            p = map_table(new_bytes);
+            memcpy(p, table, old_bytes);
+            munmap(table, old_bytes);
+#endif
+        }
+#endif
+    }
+
+    else {
+        p = realloc(table, new_bytes);
+        if ( ! p )
+            throw std::bad_alloc();
+
+        if ( new_bytes > old_bytes )
+            memset(static_cast<char*>(p) + old_bytes, 0, new_bytes - old_bytes);
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    ++dict_resize_stats.resizes;
+
+    if ( elapsed.count() > dict_resize_stats.max_resize_time )
+        dict_resize_stats.max_resize_time = elapsed.count();
+
+    if ( new_bytes > dict_resize_stats.max_resize_bytes )
+        dict_resize_stats.max_resize_bytes = new_bytes;
+
+    return p;
+}
+
+void dict_table_free(void* table, size_t bytes) {
+#ifndef _MSC_VER
+    if ( use_mmap(bytes) ) {
+        munmap(table, bytes);
+        return;
+    }
+#endif
+
+    free(table);
+}
+
+} // namespace detail
 
 TEST_SUITE_BEGIN("Dict");
 
@@ -434,6 +533,62 @@ TEST_CASE("dict iterator invalidation") {
     delete key3;
 }
 
+TEST_CASE("dict large resize") {
+    PDict<uint32_t> dict;
+    std::vector<uint32_t> vals(200000);
+    auto resizes = detail::dict_resize_stats.resizes;
+
+    for ( uint32_t i = 0; i < vals.size(); ++i ) {
+        vals[i] = i;
+        detail::HashKey key(i);
+        dict.Insert(&key, &vals[i]);
+
+        // Entries inserted before the last resize must remain reachable while remapping.
+        if ( i % 1000 == 0 ) {
+            for ( uint32_t j = 0; j <= i; j += 97 ) {
+                detail::HashKey k(j);
+                auto* v = dict.Lookup(&k);
+                REQUIRE(v);
+                CHECK(*v == j);
+            }
+        }
+    }
+
+    CHECK(dict.Length() == static_cast<int>(vals.size()));
+    CHECK(detail::dict_resize_stats.resizes > resizes);
+    CHECK(detail::dict_resize_stats.max_resize_bytes >= detail::DICT_MMAP_THRESHOLD);
+    CHECK(detail::dict_resize_stats.max_remap_scanned <= 4 * detail::DICT_REMAP_ENTRIES + detail::DICT_REMAP_ENTRIES);
+
+    size_t count = 0;
+    for ( auto it = dict.begin_robust(); it != dict.end_robust(); ++it ) {
+        ++count;
+
+        // Keep growing during the iteration.
+        if ( count <= 1000 ) {
+            detail::HashKey key(static_cast<uint32_t>(vals.size() + count));
+            dict.Insert(&key, &vals[0]);
+        }
+    }
+
+    CHECK(count >= vals.size());
+    CHECK(dict.Length() == static_cast<int>(vals.size() + 1000));
+
+    for ( uint32_t i = 0; i < vals.size(); ++i ) {
+        detail::HashKey k(i);
+        CHECK(dict.Remove(&k) == &vals[i]);
+    }
+
+    CHECK(dict.Length() == 1000);
+    dict.Clear();
+    CHECK(dict.Length() == 0);
+
+    // Reusable after clearing.
+    detail::HashKey k1(static_cast<uint32_t>(1));
+    dict.Insert(&k1, &vals[1]);
+    CHECK(dict.Lookup(&k1) == &vals[1]);
+    dict.Clear();
+}
+
 // private
 void generic_delete_func(void* v) { free(v); }
 
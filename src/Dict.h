@@ -74,6 +74,53 @@ constexpr uint8_t DICT_THRESHOLD_BITS = 3;
 // bucket at which to start looking for the next value to return.
 constexpr uint16_t TOO_FAR_TO_REACH = 0xFFFF;
 
+// Tables taking up at least this many bytes are allocated directly from the OS, so that the
+// part added when growing them doesn't need to be initialized up front.
+constexpr size_t DICT_MMAP_THRESHOLD = 1024 * 1024;
+
+/**
+ * Statistics about resizing dictionaries. Dictionaries are used by other
+ * threads as well, so each thread keeps its own.
+ */
+struct DictResizeStats {
+    uint64_t resizes = 0;           //! Number of times a table was grown.
+    double max_resize_time = 0.0;   //! Longest time spent growing a table, in seconds.
+    uint64_t max_resize_bytes = 0;  //! Size of the largest table grown.
+    uint64_t remap_rounds = 0;      //! Number of incremental remapping steps.
+    uint64_t remapped = 0;          //! Entries moved by remapping.
+    uint64_t max_remap_scanned = 0; //! Most positions examined in one remapping step.
+};
+
+extern thread_local DictResizeStats dict_resize_stats;
+
+/**
+ * Allocates a dictionary table. The memory is zero-filled, which makes all entries empty.
+ */
+void* dict_table_alloc(size_t bytes);
+
+/**
+ * Grows a dictionary table allocated by dict_table_alloc(), zero-filling the added part.
+ * Large tables are extended in place or by remapping their pages where the OS supports that,
+ * so that neither the existing entries nor the new part need to be touched.
+ */
+void* dict_table_grow(void* table, size_t old_bytes, size_t new_bytes);
+
+/**
+ * Releases a table allocated by dict_table_alloc() or dict_table_grow().
+ */
+void dict_table_free(void* table, size_t bytes);
+
+/**
+ * Records a step of incremental remapping in the current thread's dict_resize_stats.
+ */
+inline void dict_remap_step(uint64_t moved, uint64_t scanned) {
+    ++dict_resize_stats.remap_rounds;
+    dict_resize_stats.remapped += moved;
+
+    if ( scanned > dict_resize_stats.max_remap_scanned )
+        dict_resize_stats.max_remap_scanned = scanned;
+}
+
 /**
  * An entry stored in the dictionary.
  */
@@ -84,8 +131,29 @@ public:
     int bucket = 0;
 #endif
 
-    // Distance from the expected position in the table. 0xFFFF means that the entry is empty.
-    uint16_t distance = TOO_FAR_TO_REACH;
+    // Distance from the expected position in the table. It's stored offset by one, so that a
+    // zero-filled entry has distance TOO_FAR_TO_REACH and reads as empty.
+    class Distance {
+    public:
+        Distance(uint16_t d = TOO_FAR_TO_REACH) : stored(static_cast<uint16_t>(d + 1)) {}
+        operator uint16_t() const { return static_cast<uint16_t>(stored - 1); }
+
+        Distance& operator+=(int d) {
+            stored += d;
+            return *this;
+        }
+
+        Distance& operator-=(int d) {
+            stored -= d;
+            return *this;
+        }
+
+    private:
+        uint16_t stored;
+    };
+
+    // TOO_FAR_TO_REACH means that the entry is empty.
+    Distance distance;
 
     // The size of the key. Less than 8 bytes we'll store directly in the entry, otherwise we'll
     // store it as a pointer. This avoids extra allocations if we can help it.
@@ -760,7 +828,7 @@ public:
                     delete_func(table[i].value);
                 table[i].Clear();
             }
-            free(table);
+            detail::dict_table_free(table, Capacity() * sizeof(detail::DictEntry<T>));
             table = nullptr;
         }
 
@@ -776,7 +844,7 @@ public:
             delete iterators;
             iterators = nullptr;
         }
-        log2_buckets = 0;
+        SetLog2Buckets(0);
         num_iterators = 0;
         remaps = 0;
         remap_end = -1;
@@ -1117,9 +1185,8 @@ private:
 
     void Init() {
         ASSERT(! table);
-        table = (detail::DictEntry<T>*)malloc(sizeof(detail::DictEntry<T>) * ExpectedCapacity());
-        for ( int i = Capacity() - 1; i >= 0; i-- )
-            table[i].SetEmpty();
+        // Zero-filled entries are empty.
+        table = (detail::DictEntry<T>*)detail::dict_table_alloc(sizeof(detail::DictEntry<T>) * ExpectedCapacity());
     }
 
     // Lookup
@@ -1361,16 +1428,28 @@ private:
             return;
 
         int left = detail::DICT_REMAP_ENTRIES;
-        while ( remap_end >= 0 && left > 0 ) {
-            if ( ! table[remap_end].Empty() && Remap(remap_end) )
+
+        // Positions that don't need to move count against their own, larger budget, so that a
+        // round stays bounded for sparse tables.
+        int scan_left = 4 * detail::DICT_REMAP_ENTRIES;
+        int moved = 0, scanned = 0;
+        while ( remap_end >= 0 && left > 0 && scan_left > 0 ) {
+            ++scanned;
+            if ( ! table[remap_end].Empty() && Remap(remap_end) ) {
                 left--;
-            else //< successful Remap may increase remap_end in the case of SizeUp due to insert. if
-                 // so,
-                 // remap_end need to be worked on again.
+                moved++;
+            }
+            else {
+                //< successful Remap may increase remap_end in the case of SizeUp due to insert. if
+                // so, remap_end need to be worked on again.
                 remap_end--;
+                scan_left--;
+            }
         }
         if ( remap_end < 0 )
             remaps = 0; // done remapping.
+
+        detail::dict_remap_step(moved, scanned);
     }
 
     // Remap an item in position to a new position. Returns true if the relocation was
@@ -1409,10 +1488,12 @@ private:
         int prev_capacity = Capacity();
         SetLog2Buckets(log2_buckets + 1);
 
+        // The added part comes back zero-filled, i.e. empty. For large tables this doesn't touch
+        // it or copy the existing entries, so the cost of growing stays small and the remapping
+        // below happens incrementally.
         int capacity = Capacity();
-        table = (detail::DictEntry<T>*)realloc(table, capacity * sizeof(detail::DictEntry<T>));
-        for ( int i = prev_capacity; i < capacity; i++ )
-            table[i].SetEmpty();
+        table = (detail::DictEntry<T>*)detail::dict_table_grow(table, prev_capacity * sizeof(detail::DictEntry<T>),
+                                                               capacity * sizeof(detail::DictEntry<T>));
 
         // REmap from last to first in reverse order. SizeUp can be triggered by 2 conditions, one
         // of which is that the last space in the table is occupied and there's nowhere to put new
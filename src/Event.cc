@@ -4,6 +4,7 @@
 
 #include "zeek/zeek-config.h"
 
+#include "zeek/Arena.h"
 #include "zeek/Desc.h"
 #include "zeek/Func.h"
 #include "zeek/NetVar.h"
@@ -30,6 +31,32 @@ Event::Event(const EventHandlerPtr& arg_handler, zeek::Args arg_args, util::deta
         Ref(obj);
 }
 
+// Events come from the transient arena only once it's enabled and all
+// events allocated from the heap before are gone, so that each one gets
+// released the way it was allocated.
+static bool events_in_arena = false;
+static uint64_t heap_events = 0;
+
+void* Event::operator new(size_t size) {
+    if ( events_in_arena )
+        return detail::transient_arena().Allocate(size);
+
+    ++heap_events;
+    return ::operator new(size);
+}
+
+void Event::operator delete(void* p) {
+    if ( ! p )
+        return;
+
+    if ( events_in_arena )
+        detail::Arena::Free(p);
+    else {
+        --heap_events;
+        ::operator delete(p);
+    }
+}
+
 void Event::Describe(ODesc* d) const {
     if ( d->IsReadable() )
         d->AddSP("event");
@@ -157,6 +184,16 @@ void EventMgr::Drain() {
     // Make sure all of the triggers get processed every time the events
     // drain.
     detail::trigger_mgr->Process();
+
+    auto& arena = detail::transient_arena();
+
+    if ( ! arena.Enabled() )
+        return;
+
+    arena.Reset();
+
+    if ( ! events_in_arena && heap_events == 0 )
+        events_in_arena = true;
 }
 
 void EventMgr::Describe(ODesc* d) const {
@@ -180,6 +217,9 @@ void EventMgr::Process() {
     // and had the opportunity to spawn new events.
 }
 
-void EventMgr::InitPostScript() { iosource_mgr->Register(this, true, false); }
+void EventMgr::InitPostScript() {
+    iosource_mgr->Register(this, true, false);
+    detail::transient_arena().SetMaxBytes(detail::transient_arena_size);
+}
 
 } // namespace zeek
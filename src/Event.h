@@ -36,6 +36,11 @@ public:
 
     void Describe(ODesc* d) const override;
 
+    // Events are usually gone once the queue has been drained, so they
+    // come from the transient arena if that's enabled.
+    static void* operator new(size_t size);
+    static void operator delete(void* p);
+
 protected:
     friend class EventMgr;
 
@@ -0,0 +1,290 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek/LiteralMatcher.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cctype>
+#include <cstring>
+#include <string_view>
+
+#include "zeek/3rdparty/doctest.h"
+#include "zeek/util.h"
+
+namespace zeek::detail {
+
+namespace {
+
+// Characters with a special meaning in patterns, outside of character
+// classes and quotes.
+constexpr const char* PATTERN_META = "|*+?.(){}[]^$\"\\\n";
+
+// Appends the character of the escape sequence p points to, just past the
+// backslash, and advances p beyond the sequence. Returns false for anything
+// the pattern scanner wouldn't turn into exactly that character.
+bool append_escape(const char*& p, std::string& s) {
+    if ( ! *p || *p == '\n' )
+        return false;
+
+    if ( *p == 'x' && ! (isxdigit(p[1]) && isxdigit(p[2])) )
+        return false;
+
+    if ( *p >= '0' && *p <= '7' ) {
+        // The scanner drops octal digits beyond the third.
+        size_t digits = strspn(p, "01234567");
+
+        if ( digits > 3 )
+            return false;
+    }
+
+    int c = util::detail::expand_escape(p);
+
+    if ( c < 0 || c > 255 )
+        return false;
+
+    s += static_cast<char>(c);
+    return true;
+}
+
+// Skip a quoted string or a character class, with p pointing at the
+// opening delimiter. They return a pointer beyond the closing delimiter, or
+// null if there isn't one.
+const char* skip_quoted(const char* p) {
+    for ( ++p; *p && *p != '"'; ++p ) {
+        if ( *p == '\\' && p[1] )
+            ++p;
+    }
+
+    return *p ? p + 1 : nullptr;
+}
+
+const char* skip_ccl(const char* p) {
+    ++p;
+
+    if ( *p == '^' )
+        ++p;
+
+    // A leading ']' is part of the class.
+    if ( *p == ']' )
+        ++p;
+
+    while ( *p && *p != ']' ) {
+        if ( *p == '\\' && p[1] )
+            p += 2;
+
+        else if ( p[0] == '[' && p[1] == ':' ) {
+            const char* end = strstr(p + 2, ":]");
+
+            if ( ! end )
+                return nullptr;
+
+            p = end + 2;
+        }
+
+        else
+            ++p;
+    }
+
+    return *p ? p + 1 : nullptr;
+}
+
+// Returns true if the pattern has alternatives outside of any parentheses,
+// or if it can't tell.
+bool has_top_level_alternative(const char* p) {
+    int depth = 0;
+
+    while ( *p ) {
+        switch ( *p ) {
+            case '\\': p += p[1] ? 2 : 1; continue;
+
+            case '"':
+                if ( ! (p = skip_quoted(p)) )
+                    return true;
+                continue;
+
+            case '[':
+                if ( ! (p = skip_ccl(p)) )
+                    return true;
+                continue;
+
+            case '(': ++depth; break;
+            case ')': --depth; break;
+
+            case '|':
+                if ( depth <= 0 )
+                    return true;
+                break;
+
+            default: break;
+        }
+
+        ++p;
+    }
+
+    return false;
+}
+
+} // namespace
+
+LiteralMatcher::LiteralMatcher() : prefixes(65536 / 64) {}
+
+void LiteralMatcher::Add(std::string literal, int id) {
+    assert(literal.size() >= MIN_LENGTH && id >= 0);
+
+    auto prefix = Prefix(reinterpret_cast<const u_char*>(literal.data()));
+    prefixes[prefix / 64] |= uint64_t(1) << (prefix % 64);
+    buckets[prefix].push_back(literals.size());
+
+    literals.emplace_back(std::move(literal), id);
+    num_ids = std::max(num_ids, id + 1);
+}
+
+int LiteralMatcher::Find(const u_char* data, int len, std::vector<bool>& hits) const {
+    hits.assign(num_ids, false);
+
+    int found = 0;
+
+    for ( int i = 0; i < len - 1; ++i ) {
+        auto prefix = Prefix(data + i);
+
+        if ( ! (prefixes[prefix / 64] & (uint64_t(1) << (prefix % 64))) )
+            continue;
+
+        for ( auto idx : buckets.find(prefix)->second ) {
+            const auto& [literal, id] = literals[idx];
+
+            if ( hits[id] || literal.size() > static_cast<size_t>(len - i) ||
+                 memcmp(data + i, literal.data(), literal.size()) != 0 )
+                continue;
+
+            hits[id] = true;
+
+            if ( ++found == num_ids )
+                return found;
+        }
+    }
+
+    return found;
+}
+
+std::string LiteralMatcher::LeadingLiteral(const char* pattern) {
+    // Without the leading ".*", the literal would have to be at a specific
+    // offset. With alternatives, it might not be needed at all.
+    if ( strncmp(pattern, ".*", 2) != 0 || has_top_level_alternative(pattern) )
+        return "";
+
+    std::string literal;
+    const char* p = pattern + 2;
+
+    while ( true ) {
+        std::string atom;
+
+        if ( *p == '\\' ) {
+            ++p;
+
+            if ( ! append_escape(p, atom) )
+                break;
+        }
+
+        else if ( *p == '"' ) {
+            for ( ++p; *p && *p != '"' && *p != '\n'; ) {
+                if ( *p != '\\' )
+                    atom += *p++;
+
+                else if ( ! append_escape(++p, atom) )
+                    return literal;
+            }
+
+            if ( *p++ != '"' )
+                break;
+        }
+
+        else if ( *p && ! strchr(PATTERN_META, *p) )
+            atom = *p++;
+
+        else
+            break;
+
+        // The atom is optional if repeated, or required just once if
+        // repeated at least once.
+        if ( *p == '*' || *p == '?' || *p == '{' )
+            break;
+
+        literal += atom;
+
+        if ( *p == '+' )
+            break;
+    }
+
+    return literal;
+}
+
+TEST_SUITE_BEGIN("LiteralMatcher");
+
+TEST_CASE("leading literal") {
+    CHECK(LiteralMatcher::LeadingLiteral(".*GET /") == "GET /");
+    CHECK(LiteralMatcher::LeadingLiteral(".*SSH-[12]\\.") == "SSH-");
+    CHECK(LiteralMatcher::LeadingLiteral(".*\\x00\\x01abc\\.def") == std::string("\x00\x01" "abc.def", 9));
+    CHECK(LiteralMatcher::LeadingLiteral(".*\"a.b\"c") == "a.bc");
+    CHECK(LiteralMatcher::LeadingLiteral(".*(foo|bar)baz") == "");
+    CHECK(LiteralMatcher::LeadingLiteral(".*abcd*") == "abc");
+    CHECK(LiteralMatcher::LeadingLiteral(".*abcd?") == "abc");
+    CHECK(LiteralMatcher::LeadingLiteral(".*abcd{2}") == "abc");
+    CHECK(LiteralMatcher::LeadingLiteral(".*abcd+e") == "abcd");
+    CHECK(LiteralMatcher::LeadingLiteral(".*\\1234") == "");
+
+    // Patterns that don't require a literal right after a leading ".*".
+    CHECK(LiteralMatcher::LeadingLiteral("GET /") == "");
+    CHECK(LiteralMatcher::LeadingLiteral("^.*GET /") == "");
+    CHECK(LiteralMatcher::LeadingLiteral("(?i:.*GET /)") == "");
+    CHECK(LiteralMatcher::LeadingLiteral(".*GET /|POST /") == "");
+    CHECK(LiteralMatcher::LeadingLiteral(".*[|]GET|x") == "");
+    CHECK(LiteralMatcher::LeadingLiteral(".*(GET)|x") == "");
+    CHECK(LiteralMatcher::LeadingLiteral(".*?GET") == "");
+
+    // Alternatives that are enclosed don't matter.
+    CHECK(LiteralMatcher::LeadingLiteral(".*USER (a|b)") == "USER ");
+    CHECK(LiteralMatcher::LeadingLiteral(".*USER [|]") == "USER ");
+    CHECK(LiteralMatcher::LeadingLiteral(".*USER \"|\"") == "USER |");
+}
+
+TEST_CASE("find") {
+    LiteralMatcher m;
+    CHECK(m.Empty());
+
+    m.Add("GET /", 0);
+    m.Add("POST /", 0);
+    m.Add("SSH-", 1);
+    m.Add("SSH-2.0", 2);
+    m.Add(std::string("\x00\x00\x01", 3), 3);
+    CHECK_FALSE(m.Empty());
+    CHECK(m.NumIds() == 4);
+
+    std::vector<bool> hits;
+    auto find = [&](std::string_view s) {
+        return m.Find(reinterpret_cast<const u_char*>(s.data()), s.size(), hits);
+    };
+
+    CHECK(find("") == 0);
+    CHECK(hits == std::vector<bool>({false, false, false, false}));
+
+    CHECK(find("xxPOST /index.html") == 1);
+    CHECK(hits == std::vector<bool>({true, false, false, false}));
+
+    CHECK(find("SSH-2.") == 1);
+    CHECK(hits == std::vector<bool>({false, true, false, false}));
+
+    CHECK(find("SSH-2.0-OpenSSH GET /") == 3);
+    CHECK(hits == std::vector<bool>({true, true, true, false}));
+
+    CHECK(find(std::string_view("ab\x00\x00\x01", 5)) == 1);
+    CHECK(hits == std::vector<bool>({false, false, false, true}));
+
+    // Literals cut off at the end don't count.
+    CHECK(find("GET") == 0);
+    CHECK(find(std::string_view("\x00\x00", 2)) == 0);
+}
+
+TEST_SUITE_END();
+
+} // namespace zeek::detail
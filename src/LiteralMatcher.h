@@ -0,0 +1,86 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+//
+// Searching data for many literal strings at once.
+
+#pragma once
+
+#include <sys/types.h> // for u_char
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace zeek::detail {
+
+/**
+ * Finds which of a set of literal strings occur in a chunk of data.
+ *
+ * Each literal belongs to a group identified by a small integer, and a
+ * search reports the groups with at least one literal in the data. The
+ * search takes a single pass over the data: a bitmap of the literals'
+ * first two bytes rules out most positions with one lookup, and only the
+ * remaining candidates are compared against the literals.
+ */
+class LiteralMatcher {
+public:
+    // Literals shorter than this aren't selective enough to be worth
+    // looking for.
+    static constexpr size_t MIN_LENGTH = 3;
+
+    LiteralMatcher();
+
+    /**
+     * Adds a literal to search for.
+     *
+     * @param literal The literal, at least MIN_LENGTH bytes long.
+     *
+     * @param id The group the literal belongs to, counting from 0.
+     */
+    void Add(std::string literal, int id);
+
+    /**
+     * Returns true if no literals have been added.
+     */
+    bool Empty() const { return literals.empty(); }
+
+    /**
+     * Returns the number of groups, one more than the largest ID added.
+     */
+    int NumIds() const { return num_ids; }
+
+    /**
+     * Searches data for the literals.
+     *
+     * @param hits Resized to NumIds(), with an element set to true for each
+     * group with a literal occurring in the data.
+     *
+     * @return The number of groups found.
+     */
+    int Find(const u_char* data, int len, std::vector<bool>& hits) const;
+
+    /**
+     * Returns the literal that any match of a signature pattern must
+     * contain right after a leading ".*", or an empty string if the
+     * pattern doesn't have that form. The literal is the longest such
+     * prefix this can determine without fully parsing the pattern, and may
+     * be shorter than MIN_LENGTH.
+     */
+    static std::string LeadingLiteral(const char* pattern);
+
+private:
+    static uint16_t Prefix(const u_char* p) { return p[0] | (p[1] << 8); }
+
+    // Literals and their IDs.
+    std::vector<std::pair<std::string, int>> literals;
+
+    // One bit per two-byte prefix, set if a literal starts with it.
+    std::vector<uint64_t> prefixes;
+
+    // Indices into literals by their first two bytes.
+    std::unordered_map<uint16_t, std::vector<size_t>> buckets;
+
+    int num_ids = 0;
+};
+
+} // namespace zeek::detail
@@ -107,6 +107,8 @@ namespace zeek::detail {
 int watchdog_interval;
 
 int max_timer_expires;
+double timer_wheel_resolution;
+zeek_uint_t transient_arena_size;
 
 int ignore_checksums;
 int partial_connection_ok;
@@ -127,6 +129,7 @@ int tcp_max_initial_window;
 int tcp_max_above_hole_without_any_acks;
 int tcp_excessive_data_without_further_acks;
 int tcp_max_old_segments;
+bool reassembly_slab_allocator;
 
 double non_analyzed_lifetime;
 double tcp_inactivity_timeout;
@@ -172,6 +175,7 @@ double pkt_profile_freq;
 int packet_filter_default;
 
 int sig_max_group_size;
+int sig_prefilter;
 
 int dpd_reassemble_first_packets;
 int dpd_buffer_size;
@@ -229,6 +233,7 @@ void init_general_global_var() {
     table_incremental_step = id::find_val("table_incremental_step")->AsCount();
     packet_filter_default = id::find_val("packet_filter_default")->AsBool();
     sig_max_group_size = id::find_val("sig_max_group_size")->AsCount();
+    sig_prefilter = id::find_val("sig_prefilter")->AsBool();
     record_all_packets = id::find_val("record_all_packets")->AsBool();
     bits_per_uid = id::find_val("bits_per_uid")->AsCount();
 }
@@ -260,6 +265,7 @@ void init_net_var() {
     tcp_max_above_hole_without_any_acks = id::find_val("tcp_max_above_hole_without_any_acks")->AsCount();
     tcp_excessive_data_without_further_acks = id::find_val("tcp_excessive_data_without_further_acks")->AsCount();
     tcp_max_old_segments = id::find_val("tcp_max_old_segments")->AsCount();
+    reassembly_slab_allocator = id::find_val("reassembly_slab_allocator")->AsBool();
 
     non_analyzed_lifetime = id::find_val("non_analyzed_lifetime")->AsInterval();
     tcp_inactivity_timeout = id::find_val("tcp_inactivity_timeout")->AsInterval();
@@ -283,6 +289,8 @@ void init_net_var() {
     watchdog_interval = int(id::find_val("watchdog_interval")->AsInterval());
 
     max_timer_expires = id::find_val("max_timer_expires")->AsCount();
+    timer_wheel_resolution = id::find_val("timer_wheel_resolution")->AsInterval();
+    transient_arena_size = id::find_val("transient_arena_size")->AsCount();
 
     mime_segment_length = id::find_val("mime_segment_length")->AsCount();
     mime_segment_overlap_length = id::find_val("mime_segment_overlap_length")->AsCount();
@@ -11,6 +11,8 @@ namespace zeek::detail {
 extern int watchdog_interval;
 
 extern int max_timer_expires;
+extern double timer_wheel_resolution;
+extern zeek_uint_t transient_arena_size;
 
 extern int ignore_checksums;
 extern int partial_connection_ok;
@@ -31,6 +33,7 @@ extern int tcp_max_initial_window;
 extern int tcp_max_above_hole_without_any_acks;
 extern int tcp_excessive_data_without_further_acks;
 extern int tcp_max_old_segments;
+extern bool reassembly_slab_allocator;
 
 extern double non_analyzed_lifetime;
 extern double tcp_inactivity_timeout;
@@ -78,6 +81,7 @@ extern double pkt_profile_freq;
 extern int packet_filter_default;
 
 extern int sig_max_group_size;
+extern int sig_prefilter;
 
 extern int dpd_reassemble_first_packets;
 extern int dpd_buffer_size;
@@ -216,26 +216,26 @@ bool Specific_RE_Matcher::MatchAll(const u_char* bv, int n, std::vector<AcceptId
         // matched is empty.
         return n == 0;
 
-    DFA_State* d = dfa->StartState();
-    d = d->Xtion(ecs[SYM_BOL], dfa);
+    int d = dfa->Xtion(dfa->StartStateID(), ecs[SYM_BOL]);
 
-    while ( d ) {
+    while ( d != DFA_JAM_STATE ) {
         if ( --n < 0 )
             break;
 
         int ec = ecs[*(bv++)];
-        d = d->Xtion(ec, dfa);
+        d = dfa->Xtion(d, ec);
     }
 
-    if ( d )
-        d = d->Xtion(ecs[SYM_EOL], dfa);
+    if ( d != DFA_JAM_STATE )
+        d = dfa->Xtion(d, ecs[SYM_EOL]);
 
-    if ( d && matches )
-        if ( const auto* a_set = d->Accept() )
-            for ( auto a : *a_set )
-                matches->push_back(a);
+    const AcceptingSet* a_set = d != DFA_JAM_STATE ? dfa->Accept(d) : nullptr;
 
-    return d && d->Accept() != nullptr;
+    if ( a_set && matches )
+        for ( auto a : *a_set )
+            matches->push_back(a);
+
+    return a_set != nullptr;
 }
 
 int Specific_RE_Matcher::Match(const u_char* bv, int n) {
@@ -243,25 +243,23 @@ int Specific_RE_Matcher::Match(const u_char* bv, int n) {
         // An empty pattern matches anything.
         return 1;
 
-    DFA_State* d = dfa->StartState();
-
-    d = d->Xtion(ecs[SYM_BOL], dfa);
-    if ( ! d )
+    int d = dfa->Xtion(dfa->StartStateID(), ecs[SYM_BOL]);
+    if ( d == DFA_JAM_STATE )
         return 0;
 
     for ( int i = 0; i < n; ++i ) {
         int ec = ecs[bv[i]];
-        d = d->Xtion(ec, dfa);
-        if ( ! d )
+        d = dfa->Xtion(d, ec);
+        if ( d == DFA_JAM_STATE )
             break;
 
-        if ( d->Accept() )
+        if ( dfa->Accept(d) )
             return i + 1;
     }
 
-    if ( d ) {
-        d = d->Xtion(ecs[SYM_EOL], dfa);
-        if ( d && d->Accept() )
+    if ( d != DFA_JAM_STATE ) {
+        d = dfa->Xtion(d, ecs[SYM_EOL]);
+        if ( d != DFA_JAM_STATE && dfa->Accept(d) )
             return n > 0 ? n : 1; // we can't return 0 here for match...
     }
 
@@ -270,6 +268,42 @@ int Specific_RE_Matcher::Match(const u_char* bv, int n) {
 
 void Specific_RE_Matcher::Dump(FILE* f) { dfa->Dump(f); }
 
+RE_Match_State::RE_Match_State(Specific_RE_Matcher* matcher) {
+    dfa = matcher->DFA() ? matcher->DFA() : nullptr;
+    ecs = matcher->EC()->EquivClasses();
+    current_pos = -1;
+    current_state = nullptr;
+}
+
+RE_Match_State::~RE_Match_State() { Unref(current_state); }
+
+void RE_Match_State::Clear() {
+    current_pos = -1;
+    SetState(DFA_JAM_STATE);
+    accepted_matches.clear();
+}
+
+void RE_Match_State::SetState(int state) {
+    DFA_State* s = state != DFA_JAM_STATE ? dfa->State(state) : nullptr;
+
+    if ( s == current_state )
+        return;
+
+    if ( s )
+        Ref(s);
+
+    Unref(current_state);
+    current_state = s;
+}
+
+int RE_Match_State::Resume() {
+    // The machine may have evicted the state since the last call.
+    if ( current_state && current_state->Evicted() )
+        SetState(dfa->Revive(current_state));
+
+    return current_state ? current_state->StateNum() : DFA_JAM_STATE;
+}
+
 inline void RE_Match_State::AddMatches(const AcceptingSet& as, MatchPos position) {
     using am_idx = std::pair<AcceptIdx, MatchPos>;
 
@@ -278,6 +312,8 @@ inline void RE_Match_State::AddMatches(const AcceptingSet& as, MatchPos position
 }
 
 bool RE_Match_State::Match(const u_char* bv, int n, bool bol, bool eol, bool clear) {
+    int state;
+
     if ( current_pos == -1 ) {
         // First call to Match().
         if ( ! dfa )
@@ -286,9 +322,9 @@ bool RE_Match_State::Match(const u_char* bv, int n, bool bol, bool eol, bool cle
         // Initialize state and copy the accepting states of the start
         // state into the acceptance set.
         current_pos = 0;
-        current_state = dfa->StartState();
+        state = dfa->StartStateID();
 
-        const AcceptingSet* ac = current_state->Accept();
+        const AcceptingSet* ac = state != DFA_JAM_STATE ? dfa->Accept(state) : nullptr;
 
         if ( ac )
             AddMatches(*ac, 0);
@@ -296,12 +332,16 @@ bool RE_Match_State::Match(const u_char* bv, int n, bool bol, bool eol, bool cle
 
     else if ( clear ) {
         current_pos = 0;
-        current_state = dfa->StartState();
+        state = dfa->StartStateID();
     }
 
-    if ( ! current_state )
-        return false;
+    else
+        state = Resume();
 
+    if ( state == DFA_JAM_STATE ) {
+        SetState(state);
+        return false;
+    }
 
     size_t old_matches = accepted_matches.size();
 
@@ -317,26 +357,38 @@ bool RE_Match_State::Match(const u_char* bv, int n, bool bol, bool eol, bool cle
         else
             ec = ecs[*(bv++)];
 
-        DFA_State* next_state = current_state->Xtion(ec, dfa);
+        int next_state = dfa->Xtion(state, ec);
 
-        if ( ! next_state ) {
-            current_state = nullptr;
+        if ( next_state == DFA_JAM_STATE ) {
+            state = DFA_JAM_STATE;
             break;
         }
 
-        const AcceptingSet* ac = next_state->Accept();
+        const AcceptingSet* ac = dfa->Accept(next_state);
 
         if ( ac )
             AddMatches(*ac, current_pos);
 
         ++current_pos;
 
-        current_state = next_state;
+        state = next_state;
     }
 
+    SetState(state);
+
     return accepted_matches.size() != old_matches;
 }
 
+void RE_Match_State::Skip(const u_char* bv, int n, int keep) {
+    if ( keep < n ) {
+        current_pos += n - keep;
+        bv += n - keep;
+        n = keep;
+    }
+
+    Match(bv, n, false, false, false);
+}
+
 int Specific_RE_Matcher::LongestMatch(const u_char* bv, int n, bool bol, bool eol) {
     if ( ! dfa )
         // An empty pattern matches anything.
@@ -344,31 +396,31 @@ int Specific_RE_Matcher::LongestMatch(const u_char* bv, int n, bool bol, bool eo
 
     // Use -1 to indicate no match.
     int last_accept = -1;
-    DFA_State* d = dfa->StartState();
+    int d = dfa->StartStateID();
 
     if ( bol ) {
-        d = d->Xtion(ecs[SYM_BOL], dfa);
-        if ( ! d )
+        d = dfa->Xtion(d, ecs[SYM_BOL]);
+        if ( d == DFA_JAM_STATE )
             return -1;
     }
 
-    if ( d->Accept() ) // initial state or bol match (e.g, / */ or /^ ?/)
+    if ( dfa->Accept(d) ) // initial state or bol match (e.g, / */ or /^ ?/)
         last_accept = 0;
 
     for ( int i = 0; i < n; ++i ) {
         int ec = ecs[bv[i]];
-        d = d->Xtion(ec, dfa);
+        d = dfa->Xtion(d, ec);
 
-        if ( ! d )
+        if ( d == DFA_JAM_STATE )
             break;
 
-        if ( d->Accept() )
+        if ( dfa->Accept(d) )
             last_accept = i + 1;
     }
 
-    if ( d && eol ) {
-        d = d->Xtion(ecs[SYM_EOL], dfa);
-        if ( d && d->Accept() )
+    if ( d != DFA_JAM_STATE && eol ) {
+        d = dfa->Xtion(d, ecs[SYM_EOL]);
+        if ( d != DFA_JAM_STATE && dfa->Accept(d) )
             return n;
     }
 
@@ -155,12 +155,11 @@ protected:
 
 class RE_Match_State {
 public:
-    explicit RE_Match_State(Specific_RE_Matcher* matcher) {
-        dfa = matcher->DFA() ? matcher->DFA() : nullptr;
-        ecs = matcher->EC()->EquivClasses();
-        current_pos = -1;
-        current_state = nullptr;
-    }
+    explicit RE_Match_State(Specific_RE_Matcher* matcher);
+    ~RE_Match_State();
+
+    RE_Match_State(const RE_Match_State&) = delete;
+    RE_Match_State& operator=(const RE_Match_State&) = delete;
 
     const AcceptingMatchSet& AcceptedMatches() const { return accepted_matches; }
 
@@ -171,15 +170,30 @@ public:
     // If clear is true, starts matching over.
     bool Match(const u_char* bv, int n, bool bol, bool eol, bool clear);
 
-    void Clear() {
-        current_pos = -1;
-        current_state = nullptr;
-        accepted_matches.clear();
-    }
+    // Returns the DFA state the matcher is in, or null before the first
+    // call to Match() and once no further match is possible. The state
+    // may be one the machine has evicted since.
+    const DFA_State* CurrentState() const { return current_state; }
+
+    // Advances over data the caller knows can't lead to a match from the
+    // current state, feeding only its last keep bytes into the DFA. Must
+    // only be called once Match() has been.
+    void Skip(const u_char* bv, int n, int keep);
+
+    void Clear();
 
     void AddMatches(const AcceptingSet& as, MatchPos position);
 
 protected:
+    // Makes the state with the given ID the current one. Between calls to
+    // Match(), the matcher holds a reference to it, so that it remains
+    // available even if the machine evicts it.
+    void SetState(int state);
+
+    // Returns the ID of the current state, adding it back to the machine
+    // if evicted.
+    int Resume();
+
     DFA_Machine* dfa;
     int* ecs;
 
@@ -238,6 +252,10 @@ public:
     const char* PatternText() const { return re_exact->PatternText(); }
     const char* AnywherePatternText() const { return re_anywhere->PatternText(); }
 
+    // The underlying matchers, e.g. for precompiling their DFAs.
+    detail::Specific_RE_Matcher* ExactMatcher() const { return re_exact; }
+    detail::Specific_RE_Matcher* AnywhereMatcher() const { return re_anywhere; }
+
     // Original text used to construct this matcher.  Empty unless
     // the main ("explicit") constructor was used.
     const char* OrigText() const { return orig_text.c_str(); }
@@ -8,19 +8,49 @@
 #include <limits>
 
 #include "zeek/Desc.h"
+#include "zeek/NetVar.h"
 #include "zeek/Reporter.h"
+#include "zeek/SlabAllocator.h"
 
 using std::min;
 
 namespace zeek {
 
+namespace detail {
+
+SlabAllocator* reassembly_allocator() {
+    // Blocks must be released to wherever they came from, so the choice
+    // can't change once the first one has been handed out.
+    static SlabAllocator* allocator = reassembly_slab_allocator ? new SlabAllocator() : nullptr;
+    return allocator;
+}
+
+void* reassembly_allocate(size_t size) {
+    if ( auto* a = reassembly_allocator() )
+        return a->Allocate(size);
+
+    return ::operator new(size);
+}
+
+void reassembly_free(void* p, size_t size) {
+    if ( ! p )
+        return;
+
+    if ( auto* a = reassembly_allocator() )
+        a->Free(p, size);
+    else
+        ::operator delete(p);
+}
+
+} // namespace detail
+
 uint64_t Reassembler::total_size = 0;
 uint64_t Reassembler::sizes[REASSEM_NUM];
 
 DataBlock::DataBlock(const u_char* data, uint64_t size, uint64_t arg_seq) {
     seq = arg_seq;
     upper = seq + size;
-    block = new u_char[size];
+    block = AllocBlock(size);
     memcpy(block, data, size);
 }
 
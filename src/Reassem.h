@@ -4,6 +4,7 @@
 
 #include <sys/types.h> // for u_char
 #include <cassert>
+#include <cstddef>
 #include <cstdint>
 #include <cstring>
 #include <map>
@@ -26,6 +27,50 @@ enum ReassemblerType {
 
 class Reassembler;
 
+namespace detail {
+
+class SlabAllocator;
+
+/**
+ * Returns the allocator backing reassembly buffers, or nullptr if they
+ * come from the heap. Which one is used is decided on first use according
+ * to reassembly_slab_allocator and stays fixed for the rest of the run.
+ */
+SlabAllocator* reassembly_allocator();
+
+void* reassembly_allocate(size_t size);
+void reassembly_free(void* p, size_t size);
+
+/**
+ * STL allocator that places the nodes of the reassemblers' block maps
+ * into reassembly_allocator().
+ */
+template<typename T>
+class ReassemblyAllocator {
+public:
+    using value_type = T;
+
+    ReassemblyAllocator() noexcept = default;
+
+    template<typename U>
+    ReassemblyAllocator(const ReassemblyAllocator<U>&) noexcept {}
+
+    T* allocate(size_t n) { return static_cast<T*>(reassembly_allocate(n * sizeof(T))); }
+    void deallocate(T* p, size_t n) noexcept { reassembly_free(p, n * sizeof(T)); }
+
+    template<typename U>
+    bool operator==(const ReassemblyAllocator<U>&) const noexcept {
+        return true;
+    }
+
+    template<typename U>
+    bool operator!=(const ReassemblyAllocator<U>&) const noexcept {
+        return false;
+    }
+};
+
+} // namespace detail
+
 /**
  * A block/segment of data for use in the reassembly process.
  */
@@ -40,7 +85,7 @@ public:
         seq = other.seq;
         upper = other.upper;
         auto size = other.Size();
-        block = new u_char[size];
+        block = AllocBlock(size);
         memcpy(block, other.block, size);
     }
 
@@ -55,11 +100,11 @@ public:
         if ( this == &other )
             return *this;
 
+        FreeBlock(block, Size());
         seq = other.seq;
         upper = other.upper;
         auto size = other.Size();
-        delete[] block;
-        block = new u_char[size];
+        block = AllocBlock(size);
         memcpy(block, other.block, size);
         return *this;
     }
@@ -68,15 +113,15 @@ public:
         if ( this == &other )
             return *this;
 
+        FreeBlock(block, Size());
         seq = other.seq;
         upper = other.upper;
-        delete[] block;
         block = other.block;
         other.block = nullptr;
         return *this;
     }
 
-    ~DataBlock() { delete[] block; }
+    ~DataBlock() { FreeBlock(block, Size()); }
 
     /**
      * @return length of the data block
@@ -86,9 +131,14 @@ public:
     uint64_t seq;
     uint64_t upper;
     u_char* block;
+
+private:
+    static u_char* AllocBlock(uint64_t size) { return static_cast<u_char*>(detail::reassembly_allocate(size)); }
+    static void FreeBlock(u_char* b, uint64_t size) { detail::reassembly_free(b, size); }
 };
 
-using DataBlockMap = std::map<uint64_t, DataBlock>;
+using DataBlockMap = std::map<uint64_t, DataBlock, std::less<uint64_t>,
+                              detail::ReassemblyAllocator<std::pair<const uint64_t, DataBlock>>>;
 
 /**
  * The data structure used for reassembling arbitrary sequences of data
@@ -3,9 +3,11 @@
 #include "zeek/RuleMatcher.h"
 
 #include <algorithm>
+#include <cinttypes>
 #include <functional>
 
 #include "zeek/DFA.h"
+#include "zeek/DFACache.h"
 #include "zeek/DebugLogger.h"
 #include "zeek/File.h"
 #include "zeek/ID.h"
@@ -24,6 +26,7 @@
 #include "zeek/analyzer/Analyzer.h"
 #include "zeek/module_util.h"
 #include "zeek/plugin/Manager.h"
+#include "zeek/telemetry/Manager.h"
 
 using namespace std;
 
@@ -219,6 +222,16 @@ RuleMatcher::RuleMatcher(int arg_RE_level) {
     RE_level = arg_RE_level;
     parse_error = false;
     has_non_file_magic_rule = false;
+
+    telemetry_mgr->CounterInstance("zeek", "signature_prefilter_checks", {},
+                                   "Number of times the signature prefilter checked whether a matcher needs data",
+                                   "", []() { return rule_matcher ? rule_matcher->prefilter_checks : 0; });
+    telemetry_mgr->CounterInstance("zeek", "signature_prefilter_hits", {},
+                                   "Number of times the signature prefilter found one of a matcher's literals", "",
+                                   []() { return rule_matcher ? rule_matcher->prefilter_hit_count : 0; });
+    telemetry_mgr->CounterInstance("zeek", "signature_prefilter_skipped", {},
+                                   "Number of bytes matchers skipped thanks to the signature prefilter", "bytes",
+                                   []() { return rule_matcher ? rule_matcher->prefilter_bytes_skipped : 0; });
 }
 
 RuleMatcher::~RuleMatcher() {
@@ -428,7 +441,7 @@ void RuleMatcher::BuildRegEx(RuleHdrTest* hdr_test, string_list* exprs, int_list
     if ( hdr_test->level < RE_level ) {
         for ( int i = 0; i < Rule::TYPES; ++i )
             if ( exprs[i].length() )
-                BuildPatternSets(&hdr_test->psets[i], exprs[i], ids[i]);
+                BuildPatternSets(&hdr_test->psets[i], (Rule::PatternType)i, exprs[i], ids[i]);
     }
 
     // Get the patterns on all of our children.
@@ -451,13 +464,14 @@ void RuleMatcher::BuildRegEx(RuleHdrTest* hdr_test, string_list* exprs, int_list
     if ( hdr_test->level == RE_level ) {
         for ( int i = 0; i < Rule::TYPES; ++i )
             if ( exprs[i].length() )
-                BuildPatternSets(&hdr_test->psets[i], exprs[i], ids[i]);
+                BuildPatternSets(&hdr_test->psets[i], (Rule::PatternType)i, exprs[i], ids[i]);
     }
 
     // If we're below the RE_level, the regexprs remains empty.
 }
 
-void RuleMatcher::BuildPatternSets(RuleHdrTest::pattern_set_list* dst, const string_list& exprs, const int_list& ids) {
+void RuleMatcher::BuildPatternSets(RuleHdrTest::pattern_set_list* dst, Rule::PatternType type, const string_list& exprs,
+                                   const int_list& ids) {
     assert(static_cast<size_t>(exprs.length()) == ids.size());
 
     // We build groups of at most sig_max_group_size regexps.
@@ -477,6 +491,7 @@ void RuleMatcher::BuildPatternSets(RuleHdrTest::pattern_set_list* dst, const str
             set->re->CompileSet(group_exprs, group_ids);
             set->patterns = group_exprs;
             set->ids = group_ids;
+            BuildPrefilter(set, type);
             dst->push_back(set);
 
             group_exprs.clear();
@@ -485,6 +500,82 @@ void RuleMatcher::BuildPatternSets(RuleHdrTest::pattern_set_list* dst, const str
     }
 }
 
+// Feeds a symbol into a DFA state until the state doesn't change anymore.
+// Returns null if that doesn't happen right away.
+static const DFA_State* settle(DFA_State* s, DFA_Machine* dfa, int ec) {
+    for ( int i = 0; s && i < 4; ++i ) {
+        DFA_State* next = s->Xtion(ec, dfa);
+
+        if ( next == s )
+            return s;
+
+        s = next;
+    }
+
+    return nullptr;
+}
+
+void RuleMatcher::BuildPrefilter(RuleHdrTest::PatternSet* set, Rule::PatternType type) {
+    // File magic isn't matched per endpoint.
+    if ( ! sig_prefilter || type == Rule::FILE_MAGIC || ! set->re->DFA() )
+        return;
+
+    std::vector<std::string> literals;
+    size_t max_len = 0;
+
+    for ( const auto& p : set->patterns ) {
+        auto literal = LiteralMatcher::LeadingLiteral(p);
+
+        if ( literal.size() < LiteralMatcher::MIN_LENGTH )
+            return;
+
+        max_len = std::max(max_len, literal.size());
+        literals.emplace_back(std::move(literal));
+    }
+
+    DFA_Machine* dfa = set->re->DFA();
+    const int* ecs = set->re->EC()->EquivClasses();
+
+    // Find a byte that can't start any of the literals. The matcher is idle
+    // in the state it stays in when fed that byte, which every byte other
+    // than a literal's first leads back to.
+    int filler = -1;
+
+    for ( int c = 0; c < 256 && filler < 0; ++c ) {
+        if ( std::none_of(literals.begin(), literals.end(),
+                          [&](const auto& l) { return ecs[c] == ecs[static_cast<u_char>(l[0])]; }) )
+            filler = c;
+    }
+
+    if ( filler < 0 )
+        return;
+
+    PrefilterGroup group;
+    group.keep = max_len - 1;
+
+    // Data starting at the beginning of a line may lead to a different
+    // idle state.
+    for ( DFA_State* s : {dfa->StartState()->Xtion(ecs[SYM_BOL], dfa), dfa->StartState()} ) {
+        const DFA_State* idle = settle(s, dfa, ecs[filler]);
+
+        if ( ! idle )
+            return;
+
+        // Matching compares states against the idle ones, which thus must
+        // remain the same objects.
+        dfa->Pin(idle);
+
+        if ( std::find(group.idle_states.begin(), group.idle_states.end(), idle) == group.idle_states.end() )
+            group.idle_states.push_back(idle);
+    }
+
+    set->prefilter_id = prefilter_groups[type].size();
+    prefilter_groups[type].push_back(std::move(group));
+
+    for ( auto& l : literals )
+        prefilters[type].Add(std::move(l), set->prefilter_id);
+}
+
 // Get a 8/16/32-bit value from the given position in the packet header
 static inline uint32_t getval(const u_char* data, int size) {
     switch ( size ) {
@@ -720,6 +811,7 @@ RuleEndpointState* RuleMatcher::InitEndpoint(analyzer::Analyzer* analyzer, const
                     auto* m = new RuleEndpointState::Matcher;
                     m->state = new RE_Match_State(set->re);
                     m->type = (Rule::PatternType)i;
+                    m->prefilter_id = set->prefilter_id;
                     state->matchers.push_back(m);
                 }
             }
@@ -816,9 +908,41 @@ void RuleMatcher::Match(RuleEndpointState* state, Rule::PatternType type, const
 
     size_t pre_match_pos = state->current_pos;
 
+    // Matchers that are idle only need to see data containing one of their
+    // literals. The search for the literals happens once for all of them,
+    // when the first one asks.
+    bool prefilter = ! bol && ! eol && ! clear && data_len > 0 && ! prefilters[type].Empty();
+    bool searched = false;
+
     // Feed data into all relevant matchers.
     for ( const auto& m : state->matchers ) {
-        if ( m->type == type && m->state->Match((const u_char*)data, data_len, bol, eol, clear) )
+        if ( m->type != type )
+            continue;
+
+        if ( prefilter && m->prefilter_id >= 0 ) {
+            const auto& group = prefilter_groups[type][m->prefilter_id];
+            const auto& idle = group.idle_states;
+
+            if ( std::find(idle.begin(), idle.end(), m->state->CurrentState()) != idle.end() ) {
+                if ( ! searched ) {
+                    prefilters[type].Find(data, data_len, prefilter_hits);
+                    searched = true;
+                }
+
+                ++prefilter_checks;
+
+                if ( ! prefilter_hits[m->prefilter_id] ) {
+                    int keep = std::min(group.keep, data_len);
+                    m->state->Skip(data, data_len, keep);
+                    prefilter_bytes_skipped += data_len - keep;
+                    continue;
+                }
+
+                ++prefilter_hit_count;
+            }
+        }
+
+        if ( m->state->Match((const u_char*)data, data_len, bol, eol, clear) )
             newmatch = true;
     }
 
@@ -1077,7 +1201,11 @@ void RuleMatcher::GetStats(Stats* stats, RuleHdrTest* hdr_test) const {
         stats->mem = 0;
         stats->hits = 0;
         stats->misses = 0;
+        stats->evictions = 0;
         stats->nfa_states = 0;
+        stats->prefilter_checks = prefilter_checks;
+        stats->prefilter_hits = prefilter_hit_count;
+        stats->prefilter_bytes_skipped = prefilter_bytes_skipped;
         hdr_test = root;
     }
 
@@ -1095,6 +1223,7 @@ void RuleMatcher::GetStats(Stats* stats, RuleHdrTest* hdr_test) const {
             stats->mem += cstats.mem;
             stats->hits += cstats.hits;
             stats->misses += cstats.misses;
+            stats->evictions += cstats.evictions;
             stats->nfa_states += cstats.nfa_states;
         }
     }
@@ -1103,6 +1232,21 @@ void RuleMatcher::GetStats(Stats* stats, RuleHdrTest* hdr_test) const {
         GetStats(stats, h);
 }
 
+void RuleMatcher::PrecompileDFAs(DFACache* cache, RuleHdrTest* hdr_test) const {
+    if ( ! hdr_test )
+        hdr_test = root;
+
+    for ( int i = 0; i < Rule::TYPES; ++i ) {
+        for ( const auto& set : hdr_test->psets[i] ) {
+            if ( set->re->DFA() )
+                cache->Precompile(set->re->DFA());
+        }
+    }
+
+    for ( RuleHdrTest* h = hdr_test->child; h; h = h->sibling )
+        PrecompileDFAs(cache, h);
+}
+
 void RuleMatcher::DumpStats(File* f) const {
     Stats stats;
     GetStats(&stats);
@@ -1111,7 +1255,11 @@ void RuleMatcher::DumpStats(File* f) const {
         util::fmt("%.6f computed dfa states = %d; classes = ??; "
                   "computed trans. = %d; matchers = %d; mem = %d\n",
                   run_state::network_time, stats.dfa_states, stats.computed, stats.matchers, stats.mem));
-    f->Write(util::fmt("%.6f DFA cache hits = %d; misses = %d\n", run_state::network_time, stats.hits, stats.misses));
+    f->Write(util::fmt("%.6f DFA cache hits = %d; misses = %d; evictions = %d\n", run_state::network_time, stats.hits,
+                       stats.misses, stats.evictions));
+    f->Write(util::fmt("%.6f prefilter checks = %" PRIu64 "; hits = %" PRIu64 "; skipped bytes = %" PRIu64 "\n",
+                       run_state::network_time, stats.prefilter_checks, stats.prefilter_hits,
+                       stats.prefilter_bytes_skipped));
 
     DumpStateStats(f, root);
 }
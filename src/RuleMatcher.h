@@ -11,6 +11,7 @@
 #include <vector>
 
 #include "zeek/CCL.h"
+#include "zeek/LiteralMatcher.h"
 #include "zeek/RE.h"
 #include "zeek/Rule.h"
 #include "zeek/ScannedFile.h"
@@ -45,6 +46,7 @@ class PIA;
 
 namespace detail {
 
+class DFACache;
 class RE_Match_State;
 class Specific_RE_Matcher;
 class RuleMatcher;
@@ -112,7 +114,7 @@ private:
     friend class RuleMatcher;
 
     struct PatternSet {
-        PatternSet() : re() {}
+        PatternSet() : re(), prefilter_id(-1) {}
 
         // If we're above the 'RE_level' (see RuleMatcher), this
         // expr contains all patterns on this node. If we're on
@@ -123,6 +125,10 @@ private:
         // All the patterns and their rule indices.
         string_list patterns;
         int_list ids; // (only needed for debugging)
+
+        // Index into the RuleMatcher's prefilter groups of the
+        // pattern type, or -1 if the set isn't prefiltered.
+        int prefilter_id;
     };
 
     using pattern_set_list = PList<PatternSet>;
@@ -198,6 +204,7 @@ private:
     struct Matcher {
         RE_Match_State* state;
         Rule::PatternType type;
+        int prefilter_id; // As in the PatternSet the matcher is for.
     };
 
     using matcher_list = PList<Matcher>;
@@ -332,7 +339,15 @@ public:
 
         // # cache hits (sampled, multiply by MOVE_TO_FRONT_SAMPLE_SIZE)
         unsigned int hits;
-        unsigned int misses; // # cache misses
+        unsigned int misses;    // # cache misses
+        unsigned int evictions; // # states evicted from the cache
+
+        // # times the prefilter decided whether a matcher needs to see
+        // data, # times it found one of the matcher's literals, and
+        // # bytes matchers skipped otherwise.
+        uint64_t prefilter_checks;
+        uint64_t prefilter_hits;
+        uint64_t prefilter_bytes_skipped;
     };
 
     Val* BuildRuleStateValue(const Rule* rule, const RuleEndpointState* state) const;
@@ -340,6 +355,9 @@ public:
     void GetStats(Stats* stats, RuleHdrTest* hdr_test = nullptr) const;
     void DumpStats(File* f) const;
 
+    // Computes the DFAs of all pattern sets ahead of time.
+    void PrecompileDFAs(DFACache* cache, RuleHdrTest* hdr_test = nullptr) const;
+
 private:
     // Delete node and all children.
     void Delete(RuleHdrTest* node);
@@ -354,7 +372,12 @@ private:
     void BuildRegEx(RuleHdrTest* hdr_test, string_list* exprs, int_list* ids);
 
     // Build groups of regular expressions.
-    void BuildPatternSets(RuleHdrTest::pattern_set_list* dst, const string_list& exprs, const int_list& ids);
+    void BuildPatternSets(RuleHdrTest::pattern_set_list* dst, Rule::PatternType type, const string_list& exprs,
+                          const int_list& ids);
+
+    // Set up prefiltering for a group of regular expressions if all of
+    // them start with ".*" and a literal.
+    void BuildPrefilter(RuleHdrTest::PatternSet* set, Rule::PatternType type);
 
     // Check an arbitrary rule if it's satisfied right now.
     // eos signals end of stream
@@ -380,6 +403,23 @@ private:
 
     static bool AllRulePatternsMatched(const Rule* r, MatchPos matchpos, const AcceptingMatchSet& ams);
 
+    // A prefiltered group of regular expressions. While its matcher is in
+    // one of the idle states, only data containing one of the group's
+    // literals can lead towards a match, and any other data just needs to
+    // be fed in for its last bytes, which might start a literal.
+    struct PrefilterGroup {
+        std::vector<const DFA_State*> idle_states;
+        int keep; // One less than the length of the longest literal.
+    };
+
+    LiteralMatcher prefilters[Rule::TYPES];
+    std::vector<PrefilterGroup> prefilter_groups[Rule::TYPES];
+    std::vector<bool> prefilter_hits; // Result of the current search.
+
+    uint64_t prefilter_checks = 0;
+    uint64_t prefilter_hit_count = 0;
+    uint64_t prefilter_bytes_skipped = 0;
+
     int RE_level;
     bool has_non_file_magic_rule;
     bool parse_error;
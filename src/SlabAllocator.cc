@@ -0,0 +1,147 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek/SlabAllocator.h"
+
+#include "zeek/3rdparty/doctest.h"
+
+namespace zeek::detail {
+
+static_assert(SlabAllocator::MAX_SIZE == (size_t(1) << 16), "size classes are computed for 64 KB max");
+
+SlabAllocator::SlabAllocator(size_t arg_slab_size) : slab_size(arg_slab_size) {
+    if ( slab_size < MAX_SIZE )
+        slab_size = MAX_SIZE;
+}
+
+SlabAllocator::~SlabAllocator() {
+    for ( auto* slab : slabs )
+        delete[] slab;
+}
+
+int SlabAllocator::SizeClass(size_t size) {
+    if ( size <= 64 )
+        return size == 0 ? 0 : static_cast<int>((size + 15) / 16) - 1;
+
+    // size lies in (2^b, 2^(b+1)], split into four steps of 2^(b-2).
+    int b = 63 - __builtin_clzll(size - 1);
+    size_t base = size_t(1) << b;
+    size_t step = base >> 2;
+    int sub = static_cast<int>((size - 1 - base) / step);
+    return 4 + (b - 6) * 4 + sub;
+}
+
+size_t SlabAllocator::ClassSizeOf(int size_class) {
+    if ( size_class < 4 )
+        return (size_class + 1) * 16;
+
+    int b = (size_class - 4) / 4 + 6;
+    int sub = (size_class - 4) % 4;
+    size_t base = size_t(1) << b;
+    return base + (sub + 1) * (base >> 2);
+}
+
+void* SlabAllocator::Allocate(size_t size) {
+    ++stats.allocations;
+
+    if ( size > MAX_SIZE ) {
+        ++stats.large_allocations;
+        stats.large_bytes_in_use += size;
+        return new char[size];
+    }
+
+    int c = SizeClass(size);
+    size_t n = ClassSizeOf(c);
+    stats.bytes_in_use += n;
+
+    if ( FreeChunk* chunk = free_lists[c] ) {
+        free_lists[c] = chunk->next;
+        ++stats.reused;
+        return chunk;
+    }
+
+    if ( n > slab_left ) {
+        // The remainder of the current slab is abandoned. As chunks are
+        // at most MAX_SIZE, that's a small fraction of a slab.
+        slab_pos = new char[slab_size];
+        slab_left = slab_size;
+        slabs.push_back(slab_pos);
+        ++stats.slabs;
+    }
+
+    void* p = slab_pos;
+    slab_pos += n;
+    slab_left -= n;
+    return p;
+}
+
+void SlabAllocator::Free(void* p, size_t size) {
+    if ( ! p )
+        return;
+
+    if ( size > MAX_SIZE ) {
+        stats.large_bytes_in_use -= size;
+        delete[] static_cast<char*>(p);
+        return;
+    }
+
+    int c = SizeClass(size);
+    stats.bytes_in_use -= ClassSizeOf(c);
+
+    auto* chunk = static_cast<FreeChunk*>(p);
+    chunk->next = free_lists[c];
+    free_lists[c] = chunk;
+}
+
+} // namespace zeek::detail
+
+TEST_SUITE_BEGIN("SlabAllocator");
+
+TEST_CASE("slab allocator size classes") {
+    using zeek::detail::SlabAllocator;
+
+    CHECK(SlabAllocator::ClassSize(0) == 16);
+    CHECK(SlabAllocator::ClassSize(1) == 16);
+    CHECK(SlabAllocator::ClassSize(17) == 32);
+    CHECK(SlabAllocator::ClassSize(64) == 64);
+    CHECK(SlabAllocator::ClassSize(65) == 80);
+    CHECK(SlabAllocator::ClassSize(128) == 128);
+    CHECK(SlabAllocator::ClassSize(129) == 160);
+    CHECK(SlabAllocator::ClassSize(1448) == 1536);
+    CHECK(SlabAllocator::ClassSize(SlabAllocator::MAX_SIZE) == SlabAllocator::MAX_SIZE);
+
+    // Rounding never wastes more than a quarter of the request.
+    for ( size_t i = 65; i <= SlabAllocator::MAX_SIZE; i += 7 ) {
+        size_t c = SlabAllocator::ClassSize(i);
+        CHECK(c >= i);
+        CHECK((c - i) * 4 <= i);
+        CHECK(c % 16 == 0);
+    }
+}
+
+TEST_CASE("slab allocator reuse") {
+    zeek::detail::SlabAllocator a;
+
+    void* p1 = a.Allocate(1448);
+    void* p2 = a.Allocate(1500);
+    CHECK(p1 != p2);
+    CHECK(a.GetStats().slabs == 1);
+    CHECK(a.GetStats().bytes_in_use == 3072);
+
+    // Same size class, so the chunk gets recycled.
+    a.Free(p1, 1448);
+    void* p3 = a.Allocate(1400);
+    CHECK(p3 == p1);
+    CHECK(a.GetStats().reused == 1);
+
+    void* large = a.Allocate(zeek::detail::SlabAllocator::MAX_SIZE + 1);
+    CHECK(a.GetStats().large_allocations == 1);
+    a.Free(large, zeek::detail::SlabAllocator::MAX_SIZE + 1);
+
+    a.Free(p2, 1500);
+    a.Free(p3, 1400);
+    CHECK(a.GetStats().bytes_in_use == 0);
+    CHECK(a.GetStats().large_bytes_in_use == 0);
+    CHECK(a.GetStats().allocations == 4);
+}
+
+TEST_SUITE_END();
@@ -0,0 +1,101 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace zeek::detail {
+
+/**
+ * A size-class slab allocator for many small, short-lived buffers of
+ * varying size, such as the segments held by reassemblers.
+ *
+ * Requests are rounded up to one of a set of size classes spaced at
+ * quarter powers of two, so that the waste per allocation stays below
+ * 25%. Chunks are carved from large slabs and recycled through per-class
+ * free lists, so in steady state neither allocation nor release touch the
+ * global heap, and buffers allocated around the same time end up next to
+ * each other in memory. Requests larger than MAX_SIZE go to the heap.
+ *
+ * Slabs are only returned to the system when the allocator is destroyed,
+ * so the memory held is bounded by the peak usage.
+ *
+ * The allocator is not thread-safe.
+ */
+class SlabAllocator {
+public:
+    static constexpr size_t MAX_SIZE = 64 * 1024;
+    static constexpr size_t DEFAULT_SLAB_SIZE = 1024 * 1024;
+
+    struct Stats {
+        uint64_t allocations = 0;         //! Allocations served by the allocator in total.
+        uint64_t reused = 0;              //! Allocations served from a free list.
+        uint64_t large_allocations = 0;   //! Allocations passed through to the heap.
+        uint64_t slabs = 0;               //! Number of slabs allocated.
+        uint64_t bytes_in_use = 0;        //! Bytes currently handed out, including rounding.
+        uint64_t large_bytes_in_use = 0;  //! Bytes currently passed through to the heap.
+    };
+
+    /**
+     * Constructor.
+     *
+     * @param slab_size the size of the slabs to carve chunks from. Must
+     * be at least MAX_SIZE.
+     */
+    explicit SlabAllocator(size_t slab_size = DEFAULT_SLAB_SIZE);
+    ~SlabAllocator();
+
+    SlabAllocator(const SlabAllocator&) = delete;
+    SlabAllocator& operator=(const SlabAllocator&) = delete;
+
+    /**
+     * Allocates a buffer of at least the given size, aligned suitably for
+     * any fundamental type.
+     */
+    void* Allocate(size_t size);
+
+    /**
+     * Releases a buffer. The size must be the one passed to Allocate().
+     */
+    void Free(void* p, size_t size);
+
+    const Stats& GetStats() const { return stats; }
+
+    /**
+     * Returns the number of bytes held in slabs.
+     */
+    uint64_t SlabBytes() const { return stats.slabs * slab_size; }
+
+    /**
+     * Returns the size of the class a request of the given size is
+     * rounded up to. Exposed for testing.
+     */
+    static size_t ClassSize(size_t size) { return ClassSizeOf(SizeClass(size)); }
+
+private:
+    struct FreeChunk {
+        FreeChunk* next;
+    };
+
+    // 16-byte steps up to 64 bytes, then four classes per power of two
+    // up to MAX_SIZE.
+    static constexpr int NUM_CLASSES = 4 + 4 * 10;
+
+    static int SizeClass(size_t size);
+    static size_t ClassSizeOf(int size_class);
+
+    size_t slab_size;
+    std::vector<char*> slabs;
+
+    // Unused remainder of the current slab.
+    char* slab_pos = nullptr;
+    size_t slab_left = 0;
+
+    FreeChunk* free_lists[NUM_CLASSES] = {};
+
+    Stats stats;
+};
+
+} // namespace zeek::detail
@@ -6,19 +6,25 @@
 #include <sys/time.h>
 #include <sys/types.h>
 
+#include "zeek/Arena.h"
 #include "zeek/Conn.h"
 #include "zeek/DNS_Mgr.h"
+#include "zeek/Dict.h"
 #include "zeek/Event.h"
 #include "zeek/File.h"
 #include "zeek/Func.h"
 #include "zeek/ID.h"
 #include "zeek/NetVar.h"
+#include "zeek/Reassem.h"
 #include "zeek/RuleMatcher.h"
 #include "zeek/RunState.h"
 #include "zeek/Scope.h"
+#include "zeek/SlabAllocator.h"
 #include "zeek/Trigger.h"
 #include "zeek/broker/Manager.h"
 #include "zeek/input.h"
+#include "zeek/iosource/Manager.h"
+#include "zeek/iosource/PktSrc.h"
 #include "zeek/packet_analysis/protocol/tcp/TCP.h"
 #include "zeek/session/Manager.h"
 #include "zeek/threading/Manager.h"
@@ -154,6 +160,15 @@ void ProfileLogger::Log() {
     file->Write(util::fmt("%.06f Connections expired due to inactivity: %" PRIu64 "\n", run_state::network_time,
                           killed_by_inactivity));
 
+    if ( auto* ps = iosource_mgr->GetPktSrc() ) {
+        const auto& bstats = ps->GetBatchStats();
+
+        if ( bstats.batches > 0 )
+            file->Write(util::fmt("%.06f PktSrc: batches=%" PRIu64 " avg_batch=%.1f max_batch=%" PRIu64 "\n",
+                                  run_state::network_time, bstats.batches,
+                                  static_cast<double>(bstats.packets) / bstats.batches, bstats.max_size));
+    }
+
     // Signature engine.
     if ( expensive && rule_matcher ) {
         RuleMatcher::Stats stats;
@@ -168,6 +183,30 @@ void ProfileLogger::Log() {
     file->Write(util::fmt("%.06f Timers: current=%zu max=%zu lag=%.2fs\n", run_state::network_time, timer_mgr->Size(),
                           timer_mgr->PeakSize(), run_state::network_time - timer_mgr->LastTimestamp()));
 
+    // This covers the dictionaries of the main thread, which hold all script state.
+    const auto& dict_stats = detail::dict_resize_stats;
+    file->Write(util::fmt("%.06f Dicts: resizes=%" PRIu64 " max_resize=%.3fs max_table=%" PRIu64
+                          "K remap_steps=%" PRIu64 " remapped=%" PRIu64 " max_remap_scan=%" PRIu64 "\n",
+                          run_state::network_time, dict_stats.resizes, dict_stats.max_resize_time,
+                          dict_stats.max_resize_bytes / 1024, dict_stats.remap_rounds, dict_stats.remapped,
+                          dict_stats.max_remap_scanned));
+
+    if ( auto* ra = detail::reassembly_allocator() ) {
+        const auto& rstats = ra->GetStats();
+        file->Write(util::fmt("%.06f Reassembly slabs: slabs=%" PRIu64 "K in_use=%" PRIu64 "K large=%" PRIu64
+                              "K allocs=%" PRIu64 " reused=%" PRIu64 "\n",
+                              run_state::network_time, ra->SlabBytes() / 1024, rstats.bytes_in_use / 1024,
+                              rstats.large_bytes_in_use / 1024, rstats.allocations, rstats.reused));
+    }
+
+    if ( transient_arena_size > 0 ) {
+        const auto& astats = transient_arena().GetStats();
+        file->Write(util::fmt("%.06f Transient arena: chunks=%" PRIu64 "K live=%" PRIu64 " arena_allocs=%" PRIu64
+                              " heap_allocs=%" PRIu64 " resets=%" PRIu64 "\n",
+                              run_state::network_time, transient_arena().ChunkBytes() / 1024, astats.live,
+                              astats.arena_allocations, astats.heap_allocations, astats.resets));
+    }
+
     DNS_Mgr::Stats dstats;
     dns_mgr->GetStats(&dstats);
 
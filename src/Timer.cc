@@ -7,6 +7,7 @@
 #include "zeek/Desc.h"
 #include "zeek/NetVar.h"
 #include "zeek/RunState.h"
+#include "zeek/TimerWheel.h"
 #include "zeek/broker/Manager.h"
 #include "zeek/iosource/Manager.h"
 #include "zeek/telemetry/Manager.h"
@@ -74,6 +75,15 @@ TimerMgr::TimerMgr() {
         iosource_mgr->Register(this, true);
 }
 
+TimerMgr::~TimerMgr() = default;
+
+void TimerMgr::UseTimerWheel(double resolution) {
+    DBG_LOG(DBG_TM, "using timer wheel with resolution %.6f", resolution);
+    wheel = std::make_unique<TimerWheel>(resolution);
+}
+
+size_t TimerMgr::Size() const { return q->Size() + (wheel ? wheel->Size() : 0); }
+
 int TimerMgr::Advance(double arg_t, int max_expire) {
     DBG_LOG(DBG_TM, "advancing timer mgr to %.6f", arg_t);
 
@@ -99,6 +109,9 @@ void TimerMgr::InitPostScript() {
 
     dispatch_all_expired = zeek::detail::max_timer_expires == 0;
 
+    if ( zeek::detail::timer_wheel_resolution > 0.0 && ! wheel )
+        UseTimerWheel(zeek::detail::timer_wheel_resolution);
+
     cumulative_num_metric =
         telemetry_mgr->CounterInstance("zeek", "timers", {}, "Cumulative number of timers", "",
                                        []() { return static_cast<double>(timer_mgr->CumulativeNum()); });
@@ -121,24 +134,41 @@ void TimerMgr::Add(Timer* timer) {
 
     // Add the timer even if it's already expired - that way, if
     // multiple already-added timers are added, they'll still
-    // execute in sorted order.
-    if ( ! q->Add(timer) )
+    // execute in sorted order. The wheel rejects those, so they
+    // always end up in the heap.
+    if ( ! (wheel && wheel->Add(timer)) && ! q->Add(timer) )
         reporter->InternalError("out of memory");
 
     ++current_timers[timer->Type()];
+    ++cumulative_num;
+
+    if ( size_t size = Size(); size > peak_size )
+        peak_size = size;
 }
 
 void TimerMgr::Expire() {
-    Timer* timer;
-    while ( (timer = Remove()) ) {
-        DBG_LOG(DBG_TM, "Dispatching timer %s (%p)", timer_type_to_string(timer->Type()), timer);
-        timer->Dispatch(t, true);
-        --current_timers[timer->Type()];
-        delete timer;
-    }
+    // Dispatching may add new timers to the wheel, so keep going until
+    // both are empty.
+    do {
+        if ( wheel )
+            wheel->Flush(q.get());
+
+        Timer* timer;
+        while ( (timer = Remove()) ) {
+            DBG_LOG(DBG_TM, "Dispatching timer %s (%p)", timer_type_to_string(timer->Type()), timer);
+            timer->Dispatch(t, true);
+            --current_timers[timer->Type()];
+            delete timer;
+        }
+    } while ( wheel && wheel->Size() > 0 );
 }
 
 int TimerMgr::DoAdvance(double new_t, int max_expire) {
+    // Move everything that's due out of the wheel, the heap then
+    // determines the order of dispatching.
+    if ( wheel )
+        wheel->Advance(new_t, q.get());
+
     Timer* timer = Top();
     for ( num_expired = 0; (num_expired < max_expire || dispatch_all_expired) && timer && timer->Time() <= new_t;
           ++num_expired ) {
@@ -161,7 +191,9 @@ int TimerMgr::DoAdvance(double new_t, int max_expire) {
 }
 
 void TimerMgr::Remove(Timer* timer) {
-    if ( ! q->Remove(timer) )
+    if ( TimerWheel::Contains(timer) )
+        wheel->Remove(timer);
+    else if ( ! q->Remove(timer) )
         reporter->InternalError("asked to remove a missing timer");
 
     --current_timers[timer->Type()];
@@ -169,9 +201,20 @@ void TimerMgr::Remove(Timer* timer) {
 }
 
 double TimerMgr::GetNextTimeout() {
-    Timer* top = Top();
-    if ( top )
-        return std::max(0.0, top->Time() - run_state::network_time);
+    double next = -1;
+
+    if ( Timer* top = Top() )
+        next = top->Time();
+
+    // The wheel only provides a lower bound. Waking up early is harmless
+    // as the next Advance() will move its due timers into the heap.
+    if ( wheel ) {
+        if ( double wheel_next = wheel->NextExpiration(); wheel_next >= 0 && (next < 0 || wheel_next < next) )
+            next = wheel_next;
+    }
+
+    if ( next >= 0 )
+        return std::max(0.0, next - run_state::network_time);
 
     return -1;
 }
@@ -79,11 +79,24 @@ public:
 
 protected:
     TimerType type{};
+
+private:
+    friend class TimerWheel;
+
+    // Position in the TimerMgr's timer wheel, if it's in use. A level
+    // of -1 means the timer isn't in the wheel.
+    int8_t wheel_level = -1;
+    uint8_t wheel_slot = 0;
+    Timer* wheel_prev = nullptr;
+    Timer* wheel_next = nullptr;
 };
 
+class TimerWheel;
+
 class TimerMgr final : public iosource::IOSource {
 public:
     TimerMgr();
+    ~TimerMgr() override;
 
     void Add(Timer* timer);
 
@@ -121,9 +134,9 @@ public:
 
     double Time() const { return t ? t : 1; } // 1 > 0
 
-    size_t Size() const { return q->Size(); }
-    size_t PeakSize() const { return q->PeakSize(); }
-    size_t CumulativeNum() const { return q->CumulativeNum(); }
+    size_t Size() const;
+    size_t PeakSize() const { return peak_size; }
+    size_t CumulativeNum() const { return cumulative_num; }
 
     double LastTimestamp() const { return last_timestamp; }
 
@@ -145,6 +158,17 @@ public:
      */
     void InitPostScript();
 
+    /**
+     * Switches the manager to a hierarchical timing wheel for timers that
+     * expire beyond the current tick, with O(1) insertion and
+     * cancellation. Due timers are still dispatched through the heap in
+     * exact timestamp order. Timers that are already pending stay in the
+     * heap.
+     *
+     * @param resolution the length of a wheel tick in seconds.
+     */
+    void UseTimerWheel(double resolution);
+
 private:
     int DoAdvance(double t, int max_expire);
     void Remove(Timer* timer);
@@ -168,6 +192,10 @@ private:
     telemetry::GaugePtr current_timer_metrics[NUM_TIMER_TYPES];
 
     std::unique_ptr<PriorityQueue> q;
+    std::unique_ptr<TimerWheel> wheel;
+
+    size_t peak_size = 0;
+    uint64_t cumulative_num = 0;
 };
 
 extern TimerMgr* timer_mgr;
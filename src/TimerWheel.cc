@@ -0,0 +1,288 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek/TimerWheel.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "zeek/3rdparty/doctest.h"
+#include "zeek/PriorityQueue.h"
+#include "zeek/Reporter.h"
+
+namespace zeek::detail {
+
+static_assert(TimerWheel::SLOTS == 64, "occupancy bitmaps are 64 bits");
+
+TimerWheel::TimerWheel(double arg_resolution) : resolution(arg_resolution) {
+    if ( resolution <= 0.0 )
+        reporter->InternalError("invalid timer wheel resolution %f", resolution);
+}
+
+TimerWheel::~TimerWheel() {
+    for ( int l = 0; l < LEVELS; ++l )
+        for ( int s = 0; s < SLOTS; ++s ) {
+            Timer* t = Take(l, s);
+            while ( t ) {
+                Timer* next = t->wheel_next;
+                delete t;
+                t = next;
+            }
+        }
+}
+
+uint64_t TimerWheel::ToTick(double t) const {
+    double ticks = std::floor(t / resolution);
+
+    // Keep clear of the top bits so that the per-level arithmetic can't
+    // overflow. Anything that far out goes into the heap anyway.
+    if ( ! (ticks >= 0.0 && ticks < 4.0e18) )
+        return UINT64_MAX;
+
+    return static_cast<uint64_t>(ticks);
+}
+
+bool TimerWheel::Add(Timer* timer) {
+    uint64_t tick = ToTick(timer->Time());
+
+    if ( tick == UINT64_MAX || tick <= current_tick )
+        return false;
+
+    // Use the lowest level whose window still reaches the timer. A timer
+    // on level l always sits in a slot strictly ahead of the current one.
+    for ( int l = 0; l < LEVELS; ++l ) {
+        int shift = l * SLOT_BITS;
+        if ( (tick >> shift) - (current_tick >> shift) < SLOTS ) {
+            Insert(timer, l, static_cast<int>((tick >> shift) & (SLOTS - 1)));
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void TimerWheel::Insert(Timer* timer, int level, int slot) {
+    Timer*& head = slots[level][slot];
+
+    timer->wheel_prev = nullptr;
+    timer->wheel_next = head;
+
+    if ( head )
+        head->wheel_prev = timer;
+
+    head = timer;
+    timer->wheel_level = static_cast<int8_t>(level);
+    timer->wheel_slot = static_cast<uint8_t>(slot);
+    occupied[level] |= (uint64_t(1) << slot);
+    ++size;
+}
+
+void TimerWheel::Remove(Timer* timer) {
+    int level = timer->wheel_level;
+    int slot = timer->wheel_slot;
+
+    if ( timer->wheel_prev )
+        timer->wheel_prev->wheel_next = timer->wheel_next;
+    else
+        slots[level][slot] = timer->wheel_next;
+
+    if ( timer->wheel_next )
+        timer->wheel_next->wheel_prev = timer->wheel_prev;
+
+    if ( ! slots[level][slot] )
+        occupied[level] &= ~(uint64_t(1) << slot);
+
+    timer->wheel_prev = timer->wheel_next = nullptr;
+    timer->wheel_level = -1;
+    --size;
+}
+
+Timer* TimerWheel::Take(int level, int slot) {
+    Timer* head = slots[level][slot];
+    slots[level][slot] = nullptr;
+    occupied[level] &= ~(uint64_t(1) << slot);
+
+    for ( Timer* t = head; t; t = t->wheel_next ) {
+        t->wheel_level = -1;
+        --size;
+    }
+
+    return head;
+}
+
+void TimerWheel::Advance(double t, PriorityQueue* heap) {
+    uint64_t tick = ToTick(t);
+
+    if ( tick == UINT64_MAX || tick <= current_tick )
+        return;
+
+    uint64_t old_tick = current_tick;
+    current_tick = tick;
+
+    // Visit every slot that has been reached since the last advance, top
+    // level first. Timers either land in the heap or get re-added relative
+    // to the new current tick, which always places them into a slot that
+    // lies ahead.
+    for ( int l = LEVELS - 1; l >= 0; --l ) {
+        int shift = l * SLOT_BITS;
+        uint64_t first = (old_tick >> shift) + 1;
+        uint64_t last = tick >> shift;
+
+        if ( last < first || ! occupied[l] )
+            continue;
+
+        uint64_t n = std::min(last - first + 1, uint64_t(SLOTS));
+
+        for ( uint64_t i = 0; i < n; ++i ) {
+            int slot = static_cast<int>((first + i) & (SLOTS - 1));
+
+            if ( ! (occupied[l] & (uint64_t(1) << slot)) )
+                continue;
+
+            Timer* timer = Take(l, slot);
+
+            while ( timer ) {
+                Timer* next = timer->wheel_next;
+                timer->wheel_next = timer->wheel_prev = nullptr;
+
+                if ( ! Add(timer) )
+                    heap->Add(timer);
+
+                timer = next;
+            }
+        }
+    }
+}
+
+void TimerWheel::Flush(PriorityQueue* heap) {
+    for ( int l = 0; l < LEVELS; ++l ) {
+        while ( occupied[l] ) {
+            Timer* timer = Take(l, __builtin_ctzll(occupied[l]));
+
+            while ( timer ) {
+                Timer* next = timer->wheel_next;
+                timer->wheel_next = timer->wheel_prev = nullptr;
+                heap->Add(timer);
+                timer = next;
+            }
+        }
+    }
+}
+
+double TimerWheel::NextExpiration() const {
+    if ( size == 0 )
+        return -1;
+
+    uint64_t min_tick = UINT64_MAX;
+
+    for ( int l = 0; l < LEVELS; ++l ) {
+        if ( ! occupied[l] )
+            continue;
+
+        // Slots of level l hold ticks from the window following the
+        // current slot, find the first occupied one in that order.
+        int shift = l * SLOT_BITS;
+        uint64_t first = (current_tick >> shift) + 1;
+        int rot = static_cast<int>(first & (SLOTS - 1));
+        uint64_t rotated = rot ? (occupied[l] >> rot) | (occupied[l] << (SLOTS - rot)) : occupied[l];
+        uint64_t start = (first + __builtin_ctzll(rotated)) << shift;
+
+        min_tick = std::min(min_tick, start);
+    }
+
+    return static_cast<double>(min_tick) * resolution;
+}
+
+} // namespace zeek::detail
+
+TEST_SUITE_BEGIN("TimerWheel");
+
+namespace {
+
+class TestTimer final : public zeek::detail::Timer {
+public:
+    TestTimer(double t) : Timer(t, zeek::detail::TIMER_SCHEDULE) {}
+    void Dispatch(double t, bool is_expire) override {}
+};
+
+} // namespace
+
+TEST_CASE("timer wheel placement and advance") {
+    zeek::detail::TimerWheel wheel(1.0);
+    zeek::detail::PriorityQueue heap;
+
+    auto* now = new TestTimer(0.5);
+    auto* soon = new TestTimer(10.0);
+    auto* later = new TestTimer(1000.0);
+    auto* far = new TestTimer(1.0e9);
+
+    // Timers within the current tick and beyond the wheel's range are
+    // rejected.
+    CHECK_FALSE(wheel.Add(now));
+    CHECK(wheel.Add(soon));
+    CHECK(wheel.Add(later));
+    CHECK_FALSE(wheel.Add(far));
+    CHECK(wheel.Size() == 2);
+    CHECK(zeek::detail::TimerWheel::Contains(soon));
+    CHECK_FALSE(zeek::detail::TimerWheel::Contains(now));
+    CHECK(wheel.NextExpiration() == 10.0);
+
+    wheel.Advance(9.9, &heap);
+    CHECK(heap.Size() == 0);
+
+    wheel.Advance(10.0, &heap);
+    CHECK(heap.Size() == 1);
+    CHECK(heap.Top() == soon);
+    CHECK_FALSE(zeek::detail::TimerWheel::Contains(soon));
+
+    // The later timer started out on level 1 and must have been cascaded
+    // down without being released early.
+    wheel.Advance(999.0, &heap);
+    CHECK(heap.Size() == 1);
+    CHECK(wheel.Size() == 1);
+    CHECK(wheel.NextExpiration() > 999.0);
+    CHECK(wheel.NextExpiration() <= 1000.0);
+
+    wheel.Advance(5000.0, &heap);
+    CHECK(heap.Size() == 2);
+    CHECK(wheel.Size() == 0);
+    CHECK(wheel.NextExpiration() == -1);
+
+    delete now;
+    delete far;
+}
+
+TEST_CASE("timer wheel remove and flush") {
+    zeek::detail::TimerWheel wheel(0.01);
+    zeek::detail::PriorityQueue heap;
+
+    TestTimer* timers[100];
+    for ( int i = 0; i < 100; ++i ) {
+        timers[i] = new TestTimer(1.0 + i * 7.3);
+        CHECK(wheel.Add(timers[i]));
+    }
+
+    for ( int i = 0; i < 100; i += 2 ) {
+        wheel.Remove(timers[i]);
+        delete timers[i];
+    }
+
+    CHECK(wheel.Size() == 50);
+
+    // Advancing in big jumps must release exactly the due timers.
+    wheel.Advance(200.0, &heap);
+    for ( int i = 1; i < 100; i += 2 )
+        CHECK(zeek::detail::TimerWheel::Contains(timers[i]) == (timers[i]->Time() > 200.0));
+
+    wheel.Flush(&heap);
+    CHECK(wheel.Size() == 0);
+    CHECK(heap.Size() == 50);
+
+    double last = 0.0;
+    while ( auto* t = heap.Remove() ) {
+        CHECK(t->Time() >= last);
+        last = t->Time();
+        delete t;
+    }
+}
+
+TEST_SUITE_END();
@@ -0,0 +1,103 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "zeek/Timer.h"
+
+namespace zeek::detail {
+
+class PriorityQueue;
+
+/**
+ * A hierarchical timing wheel that the TimerMgr can place timers into
+ * instead of its binary heap.
+ *
+ * The wheel has LEVELS levels of SLOTS slots each. A slot on level l
+ * covers SLOTS^l ticks of the configured resolution. Timers are kept in
+ * intrusive lists per slot, making both insertion and cancellation O(1).
+ *
+ * The wheel doesn't dispatch timers itself: when advancing, all timers of
+ * slots that have been reached are either cascaded down to a lower level
+ * or, if they are due, moved into the TimerMgr's heap in one batch. As
+ * the heap then only holds timers about to expire, it stays small, and
+ * the TimerMgr still dispatches in exact timestamp order.
+ */
+class TimerWheel {
+public:
+    static constexpr int LEVELS = 4;
+    static constexpr int SLOT_BITS = 6;
+    static constexpr int SLOTS = 1 << SLOT_BITS;
+
+    /**
+     * Constructor.
+     *
+     * @param resolution The length of a tick in seconds. Timers expiring
+     * within the current tick, as well as timers that are more than
+     * SLOTS^LEVELS ticks in the future, are not accepted by the wheel.
+     */
+    explicit TimerWheel(double resolution);
+
+    /**
+     * Destructor. Deletes all timers still in the wheel.
+     */
+    ~TimerWheel();
+
+    /**
+     * Adds a timer to the wheel.
+     *
+     * @return false if the timer is not suitable for the wheel, in which
+     * case the caller needs to place it into the heap.
+     */
+    bool Add(Timer* timer);
+
+    /**
+     * Removes a timer from the wheel. The timer must be in the wheel.
+     */
+    void Remove(Timer* timer);
+
+    /**
+     * Returns true if the given timer currently resides in a wheel.
+     */
+    static bool Contains(const Timer* timer) { return timer->wheel_level >= 0; }
+
+    /**
+     * Advances the wheel to time t, moving all timers expiring at or
+     * before t into the given heap.
+     */
+    void Advance(double t, PriorityQueue* heap);
+
+    /**
+     * Moves all timers in the wheel into the given heap.
+     */
+    void Flush(PriorityQueue* heap);
+
+    /**
+     * Returns a lower bound for the expiration time of the timers in the
+     * wheel, or -1 if the wheel is empty. The value is always in the
+     * future relative to the last Advance().
+     */
+    double NextExpiration() const;
+
+    size_t Size() const { return size; }
+
+private:
+    void Insert(Timer* timer, int level, int slot);
+    uint64_t ToTick(double t) const;
+
+    // Detaches the list of the given slot, removing its timers from the
+    // wheel. Returns the head of the list.
+    Timer* Take(int level, int slot);
+
+    double resolution;
+    uint64_t current_tick = 0;
+    size_t size = 0;
+
+    // Bitmap of non-empty slots per level.
+    uint64_t occupied[LEVELS] = {};
+    Timer* slots[LEVELS][SLOTS] = {};
+};
+
+} // namespace zeek::detail
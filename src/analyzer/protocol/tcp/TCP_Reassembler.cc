@@ -40,6 +40,8 @@ TCP_Reassembler::TCP_Reassembler(analyzer::Analyzer* arg_dst_analyzer,
     if ( zeek::detail::tcp_max_old_segments )
         SetMaxOldBlocks(zeek::detail::tcp_max_old_segments);
 
+    retain_delivered = rexmit_inconsistency || max_old_blocks > 0;
+
     if ( ::tcp_contents ) {
         static auto tcp_content_delivery_ports_orig = id::find_val<TableVal>("tcp_content_delivery_ports_orig");
         static auto tcp_content_delivery_ports_resp = id::find_val<TableVal>("tcp_content_delivery_ports_resp");
@@ -73,6 +75,20 @@ void TCP_Reassembler::SizeBufferedData(uint64_t& waiting_on_hole, uint64_t& wait
     block_list.DataSize(last_reassem_seq, &waiting_on_ack, &waiting_on_hole);
 }
 
+uint64_t TCP_Reassembler::UnackedBytes() const {
+    if ( retain_delivered )
+        return block_list.DataSize();
+
+    uint64_t delivered = 0;
+    uint64_t undelivered = 0;
+    block_list.DataSize(last_reassem_seq, &delivered, &undelivered);
+
+    if ( last_reassem_seq > trim_seq )
+        undelivered += last_reassem_seq - trim_seq;
+
+    return undelivered;
+}
+
 uint64_t TCP_Reassembler::NumUndeliveredBytes() const {
     if ( block_list.Empty() )
         return 0;
@@ -370,6 +386,22 @@ void TCP_Reassembler::BlockInserted(DataBlockMap::const_iterator it) {
         ++it;
     }
 
+    TrimDelivered();
+
+    // Note: don't make an EOF check here, because then we'd miss it
+    // for FIN packets that don't carry any payload (and thus
+    // endpoint->DataSent is not called).  Instead, do the check in
+    // TCP_Connection::NextPacket.
+}
+
+void TCP_Reassembler::DeliverUnbuffered(uint64_t seq, int len, const u_char* data) {
+    assert(seq == last_reassem_seq && block_list.Empty());
+    last_reassem_seq += len;
+    DeliverBlock(seq, len, data);
+    TrimDelivered();
+}
+
+void TCP_Reassembler::TrimDelivered() {
     TCP_Endpoint* e = endp;
 
     if ( ! e->peer->HasContents() )
@@ -386,11 +418,6 @@ void TCP_Reassembler::BlockInserted(DataBlockMap::const_iterator it) {
         // don't hang onto the data further, as we may wind up
         // carrying it all the way until this connection ends.
         TrimToSeq(last_reassem_seq);
-
-    // Note: don't make an EOF check here, because then we'd miss it
-    // for FIN packets that don't carry any payload (and thus
-    // endpoint->DataSent is not called).  Instead, do the check in
-    // TCP_Connection::NextPacket.
 }
 
 void TCP_Reassembler::Overlap(const u_char* b1, const u_char* b2, uint64_t n) {
@@ -445,8 +472,27 @@ bool TCP_Reassembler::DataSent(double t, uint64_t seq, int len, const u_char* da
         len -= amount_acked;
     }
 
+    if ( ! retain_delivered && seq < last_reassem_seq ) {
+        // We've already delivered this and have nothing to compare it
+        // against, so just keep the new part.
+        if ( upper_seq <= last_reassem_seq )
+            return true;
+
+        uint64_t amount_delivered = last_reassem_seq - seq;
+        seq += amount_delivered;
+        data += amount_delivered;
+        len -= amount_delivered;
+    }
+
     flags = arg_flags;
-    NewBlock(t, seq, len, data);
+
+    if ( ! retain_delivered && len > 0 && seq == last_reassem_seq && block_list.Empty() && ! record_contents_file )
+        // The common case of in-order data: no need to copy it into a
+        // block just to deliver it right away and then throw it out.
+        DeliverUnbuffered(seq, len, data);
+    else
+        NewBlock(t, seq, len, data);
+
     flags = TCP_Flags();
 
     if ( Endpoint()->NoDataAcked() && zeek::detail::tcp_max_above_hole_without_any_acks &&
@@ -457,7 +503,7 @@ bool TCP_Reassembler::DataSent(double t, uint64_t seq, int len, const u_char* da
     }
 
     if ( zeek::detail::tcp_excessive_data_without_further_acks &&
-         block_list.DataSize() > static_cast<uint64_t>(zeek::detail::tcp_excessive_data_without_further_acks) ) {
+         UnackedBytes() > static_cast<uint64_t>(zeek::detail::tcp_excessive_data_without_further_acks) ) {
         tcp_analyzer->Weird("excessive_data_without_further_acks");
         ClearBlocks();
         skip_deliveries = true;
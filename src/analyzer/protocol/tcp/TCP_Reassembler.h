@@ -72,7 +72,11 @@ public:
     // when so.
     void CheckEOF();
 
-    bool HasUndeliveredData() const { return HasBlocks(); }
+    // Data delivered without buffering still counts as undelivered until
+    // it's been acked, just as if we held a block for it.
+    bool HasUndeliveredData() const {
+        return HasBlocks() || (! retain_delivered && ! skip_deliveries && trim_seq < last_reassem_seq);
+    }
     bool HadGap() const { return had_gap; }
     bool DataPending() const;
     uint64_t DataSeq() const { return LastReassemSeq(); }
@@ -95,6 +99,18 @@ private:
     void RecordBlock(const DataBlock& b, const FilePtr& f);
     void RecordGap(uint64_t start_seq, uint64_t upper_seq, const FilePtr& f);
 
+    // Delivers in-order data straight from the packet, without copying
+    // it into a block first. Only valid if nothing is buffered and
+    // delivered data doesn't need to be retained.
+    void DeliverUnbuffered(uint64_t seq, int len, const u_char* data);
+
+    // Drops delivered data that we won't see acks for.
+    void TrimDelivered();
+
+    // Returns the amount of data that's either buffered or delivered but
+    // not yet acked.
+    uint64_t UnackedBytes() const;
+
     void BlockInserted(DataBlockMap::const_iterator it) override;
     void Overlap(const u_char* b1, const u_char* b2, uint64_t n) override;
 
@@ -105,6 +121,11 @@ private:
     bool did_EOF;
     bool skip_deliveries;
 
+    // Whether delivered data is kept until acked. That's only needed to
+    // compare retransmissions against it; otherwise in-order data is
+    // passed on without buffering.
+    bool retain_delivered;
+
     analyzer::tcp::TCP_Flags flags;
     bool in_delivery;
 
@@ -0,0 +1,192 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek/cluster/backend/zeromq/ZeroMQ-Batch.h"
+
+#include <cstring>
+#include <zlib.h>
+
+#include "zeek/3rdparty/doctest.h"
+
+namespace zeek::cluster::zeromq {
+
+namespace {
+
+constexpr size_t HEADER_SIZE = 5;
+
+// Deflate can't shrink data by more than this factor.
+constexpr size_t MAX_ZLIB_RATIO = 1032;
+
+void PutUint32(std::byte* p, uint32_t v) {
+    p[0] = static_cast<std::byte>(v >> 24);
+    p[1] = static_cast<std::byte>(v >> 16);
+    p[2] = static_cast<std::byte>(v >> 8);
+    p[3] = static_cast<std::byte>(v);
+}
+
+uint32_t GetUint32(const std::byte* p) {
+    return (std::to_integer<uint32_t>(p[0]) << 24) | (std::to_integer<uint32_t>(p[1]) << 16) |
+           (std::to_integer<uint32_t>(p[2]) << 8) | std::to_integer<uint32_t>(p[3]);
+}
+
+} // namespace
+
+void EventBatch::Add(const std::byte* data, size_t size) {
+    size_t pos = body.size();
+    body.resize(pos + 4 + size);
+    PutUint32(body.data() + pos, static_cast<uint32_t>(size));
+    memcpy(body.data() + pos + 4, data, size);
+    ++events;
+}
+
+cluster::detail::byte_buffer EventBatch::Encode(int compression_level) const {
+    cluster::detail::byte_buffer payload;
+
+    if ( compression_level > 0 && body.size() >= MIN_COMPRESS_SIZE ) {
+        uLongf len = compressBound(body.size());
+        payload.resize(HEADER_SIZE + len);
+
+        int r = compress2(reinterpret_cast<Bytef*>(&payload[HEADER_SIZE]), &len,
+                          reinterpret_cast<const Bytef*>(body.data()), body.size(), compression_level);
+
+        if ( r == Z_OK && len < body.size() ) {
+            payload.resize(HEADER_SIZE + len);
+            payload[0] = static_cast<std::byte>(ZLIB);
+            PutUint32(&payload[1], static_cast<uint32_t>(body.size()));
+            return payload;
+        }
+    }
+
+    payload.resize(HEADER_SIZE + body.size());
+    payload[0] = static_cast<std::byte>(NONE);
+    PutUint32(&payload[1], static_cast<uint32_t>(body.size()));
+    memcpy(&payload[HEADER_SIZE], body.data(), body.size());
+    return payload;
+}
+
+bool DecodeEventBatch(cluster::detail::byte_buffer_span payload, std::vector<cluster::detail::byte_buffer>& events) {
+    if ( payload.size() < HEADER_SIZE )
+        return false;
+
+    auto compression = std::to_integer<uint8_t>(payload[0]);
+    size_t size = GetUint32(&payload[1]);
+    const std::byte* body = payload.data() + HEADER_SIZE;
+    cluster::detail::byte_buffer uncompressed;
+
+    if ( size > MAX_BATCH_SIZE )
+        return false;
+
+    if ( compression == EventBatch::ZLIB ) {
+        if ( size > (payload.size() - HEADER_SIZE) * MAX_ZLIB_RATIO )
+            return false;
+
+        uncompressed.resize(size);
+        uLongf len = size;
+        int r = uncompress(reinterpret_cast<Bytef*>(uncompressed.data()), &len, reinterpret_cast<const Bytef*>(body),
+                           payload.size() - HEADER_SIZE);
+
+        if ( r != Z_OK || len != size )
+            return false;
+
+        body = uncompressed.data();
+    }
+    else if ( compression != EventBatch::NONE || size != payload.size() - HEADER_SIZE )
+        return false;
+
+    for ( size_t pos = 0; pos < size; ) {
+        if ( size - pos < 4 )
+            return false;
+
+        size_t len = GetUint32(body + pos);
+        pos += 4;
+
+        if ( size - pos < len )
+            return false;
+
+        events.emplace_back(body + pos, body + pos + len);
+        pos += len;
+    }
+
+    return true;
+}
+
+TEST_SUITE_BEGIN("cluster zeromq batch");
+
+TEST_CASE("event batch round trip") {
+    EventBatch batch("binary-serialization-format-v1", std::chrono::steady_clock::now());
+    std::vector<std::string> in = {"one", "", std::string(1000, 'x'), "four"};
+
+    for ( const auto& s : in )
+        batch.Add(reinterpret_cast<const std::byte*>(s.data()), s.size());
+
+    CHECK(batch.Events() == 4);
+    CHECK(batch.Bytes() == 4 * 4 + 3 + 1000 + 4);
+    CHECK(batch.Format() == "batch/binary-serialization-format-v1");
+
+    for ( int level : {0, 1, 9} ) {
+        auto payload = batch.Encode(level);
+
+        if ( level == 0 )
+            CHECK(payload.size() == HEADER_SIZE + batch.Bytes());
+        else
+            CHECK(payload.size() < batch.Bytes());
+
+        std::vector<cluster::detail::byte_buffer> out;
+        REQUIRE(DecodeEventBatch({payload.data(), payload.size()}, out));
+        REQUIRE(out.size() == in.size());
+
+        for ( size_t i = 0; i < in.size(); i++ )
+            CHECK(std::string(reinterpret_cast<const char*>(out[i].data()), out[i].size()) == in[i]);
+    }
+}
+
+TEST_CASE("event batch malformed") {
+    EventBatch batch("f", std::chrono::steady_clock::now());
+    std::string s(1000, 'y');
+    batch.Add(reinterpret_cast<const std::byte*>(s.data()), s.size());
+
+    std::vector<cluster::detail::byte_buffer> out;
+
+    auto payload = batch.Encode(0);
+    payload.pop_back();
+    CHECK_FALSE(DecodeEventBatch({payload.data(), payload.size()}, out));
+    CHECK_FALSE(DecodeEventBatch({payload.data(), 3}, out));
+
+    payload = batch.Encode(6);
+    payload[HEADER_SIZE + 2] ^= std::byte{0xff};
+    CHECK_FALSE(DecodeEventBatch({payload.data(), payload.size()}, out));
+
+    payload = batch.Encode(0);
+    payload[0] = std::byte{42};
+    CHECK_FALSE(DecodeEventBatch({payload.data(), payload.size()}, out));
+
+    CHECK(out.empty());
+}
+
+TEST_CASE("event batch forged size") {
+    std::vector<cluster::detail::byte_buffer> out;
+
+    // A tiny compressed payload claiming a 4 GB body.
+    cluster::detail::byte_buffer forged = {std::byte{EventBatch::ZLIB}, std::byte{0xff}, std::byte{0xff},
+                                           std::byte{0xff}, std::byte{0xff}, std::byte{0x78}, std::byte{0x9c}};
+    CHECK_FALSE(DecodeEventBatch({forged.data(), forged.size()}, out));
+
+    // A size within MAX_BATCH_SIZE, but more than the payload could expand to.
+    forged[1] = std::byte{0};
+    forged[2] = std::byte{0x10};
+    forged[3] = std::byte{0};
+    forged[4] = std::byte{0};
+    CHECK_FALSE(DecodeEventBatch({forged.data(), forged.size()}, out));
+
+    // A well-formed batch over the limit.
+    EventBatch batch("f", std::chrono::steady_clock::now());
+    std::string s(MAX_BATCH_SIZE, 'z');
+    batch.Add(reinterpret_cast<const std::byte*>(s.data()), s.size());
+    auto payload = batch.Encode(0);
+    CHECK_FALSE(DecodeEventBatch({payload.data(), payload.size()}, out));
+
+    CHECK(out.empty());
+}
+
+TEST_SUITE_END();
+
+} // namespace zeek::cluster::zeromq
@@ -0,0 +1,93 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "zeek/cluster/Serializer.h"
+
+// Batching of serialized events.
+//
+// A batch is published like a single event, but with BATCH_FORMAT_PREFIX
+// prepended to the format part of the message. Its payload starts with a
+// one byte compression marker and the size of the uncompressed body as a
+// 32 bit big endian value. The body is a sequence of serialized events,
+// each preceded by its size as a 32 bit big endian value.
+namespace zeek::cluster::zeromq {
+
+constexpr std::string_view BATCH_FORMAT_PREFIX = "batch/";
+
+// The largest uncompressed body receivers accept. The size in the header
+// comes from the peer, so it's checked before allocating anything.
+constexpr size_t MAX_BATCH_SIZE = 64 * 1024 * 1024;
+
+// Senders keep their batches well below MAX_BATCH_SIZE, sending larger
+// events on their own.
+constexpr size_t MAX_BATCH_FILL = MAX_BATCH_SIZE / 4;
+
+class EventBatch {
+public:
+    enum Compression : uint8_t {
+        NONE = 0,
+        ZLIB = 1,
+    };
+
+    /**
+     * Constructor.
+     *
+     * @param format the format of the serialized events in the batch.
+     * @param started the time the first event was added.
+     */
+    EventBatch(std::string format, std::chrono::steady_clock::time_point started)
+        : format(std::move(format)), started(started) {}
+
+    /**
+     * Appends a serialized event.
+     */
+    void Add(const std::byte* data, size_t size);
+
+    /**
+     * @return The format part of the message publishing this batch.
+     */
+    std::string Format() const { return std::string(BATCH_FORMAT_PREFIX) + format; }
+
+    /**
+     * @return The payload for publishing this batch.
+     *
+     * @param compression_level the zlib compression level to use, or 0 to
+     * leave the body uncompressed. Compression is skipped for small batches
+     * and when it doesn't save anything.
+     */
+    cluster::detail::byte_buffer Encode(int compression_level) const;
+
+    size_t Events() const { return events; }
+    size_t Bytes() const { return body.size(); }
+    std::chrono::steady_clock::time_point Started() const { return started; }
+
+    // Bodies smaller than this are never compressed.
+    static constexpr size_t MIN_COMPRESS_SIZE = 256;
+
+private:
+    std::string format;
+    std::chrono::steady_clock::time_point started;
+    cluster::detail::byte_buffer body;
+    size_t events = 0;
+};
+
+/**
+ * Splits the payload of a batch into the serialized events it contains.
+ *
+ * @param payload the payload of a message published by EventBatch.
+ * @param events the vector to append the events to.
+ *
+ * @return False if the payload is malformed, or if its body would exceed
+ * MAX_BATCH_SIZE.
+ */
+bool DecodeEventBatch(cluster::detail::byte_buffer_span payload, std::vector<cluster::detail::byte_buffer>& events);
+
+} // namespace zeek::cluster::zeromq
@@ -8,6 +8,7 @@
 #include <cstddef>
 #include <cstdio>
 #include <functional>
+#include <map>
 #include <memory>
 #include <string>
 #include <thread>
@@ -22,7 +23,9 @@
 #include "zeek/cluster/Backend.h"
 #include "zeek/cluster/Serializer.h"
 #include "zeek/cluster/backend/zeromq/Plugin.h"
+#include "zeek/cluster/backend/zeromq/ZeroMQ-Batch.h"
 #include "zeek/cluster/backend/zeromq/ZeroMQ-Proxy.h"
+#include "zeek/telemetry/Manager.h"
 #include "zeek/util.h"
 
 namespace zeek {
@@ -94,12 +97,49 @@ void ZeroMQBackend::DoInitPostScript() {
     poll_max_messages = zeek::id::find_val<zeek::CountVal>("Cluster::Backend::ZeroMQ::poll_max_messages")->Get();
     debug_flags = zeek::id::find_val<zeek::CountVal>("Cluster::Backend::ZeroMQ::debug_flags")->Get();
 
+    event_batch_max_bytes = std::min<zeek_uint_t>(
+        zeek::id::find_val<zeek::CountVal>("Cluster::Backend::ZeroMQ::event_batch_max_bytes")->Get(), MAX_BATCH_FILL);
+    event_batch_max_delay = std::chrono::microseconds(static_cast<int64_t>(
+        zeek::id::find_val<zeek::IntervalVal>("Cluster::Backend::ZeroMQ::event_batch_max_delay")->Get() * 1e6));
+    event_batch_compression_level = static_cast<int>(std::min<zeek_uint_t>(
+        zeek::id::find_val<zeek::CountVal>("Cluster::Backend::ZeroMQ::event_batch_compression_level")->Get(), 9));
+
+    batches_size_metric =
+        telemetry_mgr->CounterInstance("zeek", "cluster_zeromq_event_batches", {{"reason", "size"}},
+                                       "Number of event batches published, by what triggered publishing them");
+    batches_time_metric =
+        telemetry_mgr->CounterInstance("zeek", "cluster_zeromq_event_batches", {{"reason", "time"}},
+                                       "Number of event batches published, by what triggered publishing them");
+    batched_events_metric = telemetry_mgr->CounterInstance("zeek", "cluster_zeromq_batched_events", {},
+                                                           "Number of events published in batches");
+    batch_bytes_metric = telemetry_mgr->CounterInstance("zeek", "cluster_zeromq_event_batch_bytes", {},
+                                                        "Serialized event bytes published in batches");
+    batch_payload_bytes_metric =
+        telemetry_mgr->CounterInstance("zeek", "cluster_zeromq_event_batch_payload_bytes", {},
+                                       "Bytes of event batch payloads published, after compression");
+
     event_unsubscription = zeek::event_registry->Register("Cluster::Backend::ZeroMQ::unsubscription");
     event_subscription = zeek::event_registry->Register("Cluster::Backend::ZeroMQ::subscription");
 }
 
 
 void ZeroMQBackend::DoTerminate() {
+    // Have the thread publish events still waiting in batches. Once the
+    // context is shut down, its sockets can't send anymore.
+    if ( event_batch_max_bytes > 0 && self_thread.joinable() ) {
+        ZEROMQ_DEBUG("Flushing event batches");
+        auto flushed = batches_flushed.get_future();
+
+        try {
+            // Like subscription messages, but with a 0x02 byte.
+            const char flush = '\x02';
+            main_inproc.send(zmq::const_buffer(&flush, 1));
+            flushed.wait();
+        } catch ( zmq::error_t& err ) {
+            zeek::reporter->Error("ZeroMQ: Failed to flush event batches: %s", err.what());
+        }
+    }
+
     ZEROMQ_DEBUG("Shutting down ctx");
     ctx.shutdown();
     ZEROMQ_DEBUG("Joining self_thread");
@@ -386,52 +426,160 @@ void ZeroMQBackend::Run() {
         QueueForProcessing(std::move(qmsgs));
     };
 
-    auto HandleInprocMessages = [this](std::vector<MultipartMessage>& msgs) {
+    // Forwards a multipart message to XPUB. Returns false on shutdown.
+    auto SendToXPub = [this](MultipartMessage& msg) {
+        for ( size_t i = 0; i < msg.size(); i++ ) {
+            zmq::send_flags flags = zmq::send_flags::dontwait;
+            if ( i < msg.size() - 1 )
+                flags = flags | zmq::send_flags::sndmore;
+
+            zmq::send_result_t result;
+            int tries = 0;
+            do {
+                try {
+                    result = xpub.send(msg[i], flags);
+                } catch ( zmq::error_t& err ) {
+                    if ( err.num() == ETERM )
+                        return false;
+
+                    // XXX: What other error can happen here? How should we react?
+                    ZEROMQ_THREAD_PRINTF("xpub: Failed to publish with error %s (%d)\n", err.what(), err.num());
+                    break;
+                }
+
+                // Empty result means xpub.send() returned EAGAIN. The
+                // socket reached its high water mark and we should
+                // relax / backoff a bit. Otherwise we'll be spinning
+                // unproductively very fast here. Note that this is going
+                // to build up backpressure and eventually inproc.send()
+                // will block from the main thread.
+                if ( ! result ) {
+                    ++tries;
+                    auto sleep_for = std::min(tries * 10, 500);
+                    ZEROMQ_THREAD_PRINTF("xpub: Failed forward inproc to xpub! Overloaded? (tries=%d sleeping %d ms)\n",
+                                         tries, sleep_for);
+
+                    std::this_thread::sleep_for(std::chrono::milliseconds(sleep_for));
+                }
+            } while ( ! result );
+        }
+
+        return true;
+    };
+
+    // Events collected per topic when batching is enabled. A topic's batch
+    // is published once it reaches event_batch_max_bytes, or once its first
+    // event has waited for event_batch_max_delay. Events of a topic stay in
+    // order, but events of different topics may be reordered.
+    std::map<std::string, EventBatch> batches;
+
+    auto PublishBatch = [this, &SendToXPub](const std::string& topic, const EventBatch& batch, bool full) {
+        auto payload = batch.Encode(event_batch_compression_level);
+        auto format = batch.Format();
+
+        MultipartMessage msg;
+        msg.emplace_back(topic.data(), topic.size());
+        msg.emplace_back(NodeId().data(), NodeId().size());
+        msg.emplace_back(format.data(), format.size());
+        msg.emplace_back(payload.data(), payload.size());
+
+        (full ? batches_size_metric : batches_time_metric)->Inc();
+        batched_events_metric->Inc(static_cast<double>(batch.Events()));
+        batch_bytes_metric->Inc(static_cast<double>(batch.Bytes()));
+        batch_payload_bytes_metric->Inc(static_cast<double>(payload.size()));
+
+        return SendToXPub(msg);
+    };
+
+    // Publishes the batches that are due. Returns how long until the next
+    // one is, or -1 if there are none left.
+    auto PublishDueBatches = [this, &batches, &PublishBatch]() {
+        auto now = std::chrono::steady_clock::now();
+        std::chrono::milliseconds timeout{-1};
+
+        for ( auto it = batches.begin(); it != batches.end(); ) {
+            auto due = it->second.Started() + event_batch_max_delay;
+
+            if ( due <= now ) {
+                bool ok = PublishBatch(it->first, it->second, false);
+                it = batches.erase(it);
+                if ( ! ok )
+                    return std::chrono::milliseconds{-1};
+
+                continue;
+            }
+
+            auto left = std::chrono::ceil<std::chrono::milliseconds>(due - now);
+            if ( timeout.count() < 0 || left < timeout )
+                timeout = left;
+
+            ++it;
+        }
+
+        return timeout;
+    };
+
+    // Publishes all batches, on shutdown.
+    auto PublishAllBatches = [&batches, &PublishBatch]() {
+        for ( auto it = batches.begin(); it != batches.end(); it = batches.erase(it) ) {
+            if ( ! PublishBatch(it->first, it->second, false) ) {
+                batches.clear();
+                return;
+            }
+        }
+    };
+
+    auto HandleInprocMessages = [this, &SendToXPub, &batches, &PublishBatch,
+                                 &PublishAllBatches](std::vector<MultipartMessage>& msgs) {
         // Forward messages from the inprocess bridge to XSUB for subscription
         // subscription handling (1 part) or XPUB for publishing (4 parts).
+        // DoTerminate() sends a single 0x02 byte to flush the batches.
         for ( auto& msg : msgs ) {
             assert(msg.size() == 1 || msg.size() == 4);
-            if ( msg.size() == 1 ) {
+            if ( msg.size() == 1 && msg[0].size() == 1 && *msg[0].data<char>() == '\x02' ) {
+                PublishAllBatches();
+                batches_flushed.set_value();
+            }
+            else if ( msg.size() == 1 ) {
                 xsub.send(msg[0], zmq::send_flags::none);
             }
-            else {
-                for ( auto& part : msg ) {
-                    zmq::send_flags flags = zmq::send_flags::dontwait;
-                    if ( part.more() )
-                        flags = flags | zmq::send_flags::sndmore;
-
-                    zmq::send_result_t result;
-                    int tries = 0;
-                    do {
-                        try {
-                            result = xpub.send(part, flags);
-                        } catch ( zmq::error_t& err ) {
-                            if ( err.num() == ETERM )
-                                return;
-
-                            // XXX: What other error can happen here? How should we react?
-                            ZEROMQ_THREAD_PRINTF("xpub: Failed to publish with error %s (%d)\n", err.what(), err.num());
-                            break;
-                        }
+            else if ( event_batch_max_bytes > 0 ) {
+                std::string topic(msg[0].data<const char>(), msg[0].size());
+                auto it = batches.find(topic);
+
+                // Events that would fill a batch on their own go out
+                // directly, after what's pending for their topic.
+                if ( msg[3].size() >= event_batch_max_bytes ) {
+                    if ( it != batches.end() ) {
+                        bool ok = PublishBatch(it->first, it->second, true);
+                        batches.erase(it);
+                        if ( ! ok )
+                            return;
+                    }
 
-                        // Empty result means xpub.send() returned EAGAIN. The
-                        // socket reached its high water mark and we should
-                        // relax / backoff a bit. Otherwise we'll be spinning
-                        // unproductively very fast here. Note that this is going
-                        // to build up backpressure and eventually inproc.send()
-                        // will block from the main thread.
-                        if ( ! result ) {
-                            ++tries;
-                            auto sleep_for = std::min(tries * 10, 500);
-                            ZEROMQ_THREAD_PRINTF(
-                                "xpub: Failed forward inproc to xpub! Overloaded? (tries=%d sleeping %d ms)\n", tries,
-                                sleep_for);
-
-                            std::this_thread::sleep_for(std::chrono::milliseconds(sleep_for));
-                        }
-                    } while ( ! result );
+                    if ( ! SendToXPub(msg) )
+                        return;
+
+                    continue;
+                }
+
+                if ( it == batches.end() ) {
+                    auto batch = EventBatch(std::string(msg[2].data<const char>(), msg[2].size()),
+                                            std::chrono::steady_clock::now());
+                    it = batches.emplace(std::move(topic), std::move(batch)).first;
+                }
+
+                it->second.Add(msg[3].data<std::byte>(), msg[3].size());
+
+                if ( it->second.Bytes() >= event_batch_max_bytes ) {
+                    bool ok = PublishBatch(it->first, it->second, true);
+                    batches.erase(it);
+                    if ( ! ok )
+                        return;
                 }
             }
+            else if ( ! SendToXPub(msg) )
+                return;
         }
     };
 
@@ -486,9 +634,26 @@ void ZeroMQBackend::Run() {
             if ( sender == NodeId() )
                 continue;
 
+            std::string format(msg[2].data<const char>(), msg[2].size());
+            if ( format.starts_with(BATCH_FORMAT_PREFIX) ) {
+                std::vector<detail::byte_buffer> payloads;
+                if ( ! DecodeEventBatch({msg[3].data<std::byte>(), msg[3].size()}, payloads) ) {
+                    ZEROMQ_THREAD_PRINTF("xsub: error: malformed event batch from %s\n", sender.c_str());
+                    continue;
+                }
+
+                std::string topic(msg[0].data<const char>(), msg[0].size());
+                format.erase(0, BATCH_FORMAT_PREFIX.size());
+
+                for ( auto& payload : payloads )
+                    qmsgs.emplace_back(EventMessage{.topic = topic, .format = format, .payload = std::move(payload)});
+
+                continue;
+            }
+
             detail::byte_buffer payload{msg[3].data<std::byte>(), msg[3].data<std::byte>() + msg[3].size()};
             qmsgs.emplace_back(EventMessage{.topic = std::string(msg[0].data<const char>(), msg[0].size()),
-                                            .format = std::string(msg[2].data<const char>(), msg[2].size()),
+                                            .format = std::move(format),
                                             .payload = std::move(payload)});
         }
 
@@ -528,6 +693,7 @@ void ZeroMQBackend::Run() {
     });
 
     std::vector<zmq::pollitem_t> poll_items(sockets.size());
+    std::chrono::milliseconds poll_timeout{-1};
 
     while ( true ) {
         for ( size_t i = 0; i < sockets.size(); i++ )
@@ -536,7 +702,7 @@ void ZeroMQBackend::Run() {
         // Awkward.
         std::vector<std::vector<MultipartMessage>> rcv_messages(sockets.size());
         try {
-            int r = zmq::poll(poll_items, std::chrono::seconds(-1));
+            int r = zmq::poll(poll_items, poll_timeout);
             ZEROMQ_DEBUG_THREAD_PRINTF(DebugFlag::POLL, "poll: r=%d", r);
 
             for ( size_t i = 0; i < poll_items.size(); i++ ) {
@@ -611,6 +777,8 @@ void ZeroMQBackend::Run() {
 
             sockets[i].handler(rcv_messages[i]);
         }
+
+        poll_timeout = PublishDueBatches();
     }
 }
 
@@ -2,6 +2,8 @@
 
 #pragma once
 
+#include <chrono>
+#include <future>
 #include <memory>
 #include <thread>
 #include <zmq.hpp>
@@ -9,6 +11,7 @@
 #include "zeek/cluster/Backend.h"
 #include "zeek/cluster/Serializer.h"
 #include "zeek/cluster/backend/zeromq/ZeroMQ-Proxy.h"
+#include "zeek/telemetry/Counter.h"
 
 namespace zeek::cluster::zeromq {
 
@@ -77,6 +80,23 @@ private:
     zeek_uint_t poll_max_messages = 0;
     zeek_uint_t debug_flags = 0;
 
+    // Event batching, disabled if event_batch_max_bytes is 0.
+    zeek_uint_t event_batch_max_bytes = 0;
+    std::chrono::microseconds event_batch_max_delay{0};
+    int event_batch_compression_level = 0;
+
+    // Set by the background thread once it has published the pending
+    // batches on DoTerminate()'s request.
+    std::promise<void> batches_flushed;
+
+    // Batching metrics. These are only incremented by the background
+    // thread, which is safe as the underlying counters are atomic.
+    telemetry::CounterPtr batches_size_metric;
+    telemetry::CounterPtr batches_time_metric;
+    telemetry::CounterPtr batched_events_metric;
+    telemetry::CounterPtr batch_bytes_metric;
+    telemetry::CounterPtr batch_payload_bytes_metric;
+
     EventHandlerPtr event_subscription;
     EventHandlerPtr event_unsubscription;
 
@@ -0,0 +1,27 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek/cluster/serializer/flat/Plugin.h"
+
+#include <memory>
+
+#include "zeek/cluster/Component.h"
+#include "zeek/cluster/serializer/flat/Serializer.h"
+
+using namespace zeek::cluster;
+
+namespace zeek::plugin::Flat_Serializer {
+
+Plugin plugin;
+
+zeek::plugin::Configuration Plugin::Configure() {
+    AddComponent(new EventSerializerComponent("ZEEK_FLAT_V1", []() -> std::unique_ptr<EventSerializer> {
+        return std::make_unique<cluster::detail::FlatV1_Serializer>();
+    }));
+
+    zeek::plugin::Configuration config;
+    config.name = "Zeek::Flat_Serializer";
+    config.description = "Event serialization using a flat binary layout";
+    return config;
+}
+
+} // namespace zeek::plugin::Flat_Serializer
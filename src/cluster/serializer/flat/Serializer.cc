@@ -0,0 +1,795 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek/cluster/serializer/flat/Serializer.h"
+
+#include <bit>
+#include <chrono>
+#include <cstring>
+#include <optional>
+
+#include "zeek/Desc.h"
+#include "zeek/EventRegistry.h"
+#include "zeek/Func.h"
+#include "zeek/ID.h"
+#include "zeek/IPAddr.h"
+#include "zeek/RE.h"
+#include "zeek/Reporter.h"
+#include "zeek/Type.h"
+#include "zeek/Val.h"
+#include "zeek/cluster/Backend.h"
+#include "zeek/cluster/serializer/broker/Serializer.h"
+#include "zeek/util.h"
+
+#include "zeek/3rdparty/doctest.h"
+
+using namespace zeek::cluster;
+
+namespace {
+
+constexpr uint8_t FORMAT_VERSION = 1;
+
+// Version, flags, name length, timestamp and fingerprint.
+constexpr size_t HEADER_SIZE = 1 + 1 + 2 + 8 + 8;
+
+// Records nested deeper than this only contribute their name to a
+// fingerprint, so that recursive types terminate.
+constexpr int MAX_FINGERPRINT_DEPTH = 16;
+
+// Integers are stored little endian.
+void PutUint(std::byte* p, uint64_t v, size_t n) {
+    for ( size_t i = 0; i < n; i++ )
+        p[i] = static_cast<std::byte>(v >> (8 * i));
+}
+
+uint64_t GetUint(const std::byte* p, size_t n) {
+    uint64_t v = 0;
+    for ( size_t i = 0; i < n; i++ )
+        v |= std::to_integer<uint64_t>(p[i]) << (8 * i);
+    return v;
+}
+
+bool IsVariable(const zeek::Type* t) {
+    switch ( t->Tag() ) {
+        case zeek::TYPE_ENUM:
+        case zeek::TYPE_STRING:
+        case zeek::TYPE_PATTERN:
+        case zeek::TYPE_FUNC:
+        case zeek::TYPE_RECORD:
+        case zeek::TYPE_VECTOR:
+        case zeek::TYPE_TABLE: return true;
+        default: return false;
+    }
+}
+
+// Returns the size of a slot for the given type, or 0 if the type isn't
+// supported.
+size_t SlotSize(const zeek::Type* t) {
+    switch ( t->Tag() ) {
+        case zeek::TYPE_BOOL:
+        case zeek::TYPE_INT:
+        case zeek::TYPE_COUNT:
+        case zeek::TYPE_DOUBLE:
+        case zeek::TYPE_TIME:
+        case zeek::TYPE_INTERVAL:
+        case zeek::TYPE_PORT:
+        case zeek::TYPE_ENUM:
+        case zeek::TYPE_STRING:
+        case zeek::TYPE_PATTERN:
+        case zeek::TYPE_FUNC:
+        case zeek::TYPE_RECORD:
+        case zeek::TYPE_VECTOR:
+        case zeek::TYPE_TABLE: return 8;
+        case zeek::TYPE_ADDR: return 16;
+        case zeek::TYPE_SUBNET: return 17;
+        default: return 0;
+    }
+}
+
+// FNV-1a over the structure of a type. Returns false for types that
+// can't be serialized.
+bool Fingerprint(const zeek::Type* t, uint64_t& h, int depth = 0) {
+    auto mix = [&h](const void* data, size_t n) {
+        for ( size_t i = 0; i < n; i++ ) {
+            h ^= static_cast<const uint8_t*>(data)[i];
+            h *= 0x100000001b3ULL;
+        }
+    };
+
+    auto tag = static_cast<uint8_t>(t->Tag());
+    mix(&tag, 1);
+
+    if ( SlotSize(t) == 0 )
+        return false;
+
+    switch ( t->Tag() ) {
+        case zeek::TYPE_ENUM: {
+            const auto& name = t->GetName();
+            mix(name.data(), name.size());
+            break;
+        }
+
+        case zeek::TYPE_RECORD: {
+            auto rt = t->AsRecordType();
+            const auto& name = t->GetName();
+            mix(name.data(), name.size());
+
+            if ( depth >= MAX_FINGERPRINT_DEPTH )
+                break;
+
+            for ( int i = 0; i < rt->NumFields(); i++ ) {
+                const char* field = rt->FieldName(i);
+                mix(field, strlen(field) + 1);
+
+                if ( ! Fingerprint(rt->GetFieldType(i).get(), h, depth + 1) )
+                    return false;
+            }
+            break;
+        }
+
+        case zeek::TYPE_VECTOR: return Fingerprint(t->Yield().get(), h, depth + 1);
+
+        case zeek::TYPE_TABLE: {
+            const auto& indices = t->AsTableType()->GetIndexTypes();
+            auto n = static_cast<uint8_t>(indices.size());
+            mix(&n, 1);
+
+            for ( const auto& it : indices )
+                if ( ! Fingerprint(it.get(), h, depth + 1) )
+                    return false;
+
+            if ( const auto& yield = t->Yield() )
+                return Fingerprint(yield.get(), h, depth + 1);
+
+            break;
+        }
+
+        default: break;
+    }
+
+    return true;
+}
+
+class Writer {
+public:
+    explicit Writer(detail::byte_buffer& buf) : buf(buf) {}
+
+    // Appends a block of n values. type_at(i) returns the type of the i-th
+    // value and val_at(i) the value itself, or nullptr if it's absent.
+    template<typename TypeAt, typename ValAt>
+    bool WriteBlock(size_t n, TypeAt type_at, ValAt val_at) {
+        size_t start = buf.size();
+        size_t slot = start + (n + 7) / 8;
+        size_t end = slot;
+
+        for ( size_t i = 0; i < n; i++ )
+            end += SlotSize(type_at(i));
+
+        buf.resize(end);
+
+        for ( size_t i = 0; i < n; i++ ) {
+            const zeek::Type* t = type_at(i);
+
+            if ( zeek::ValPtr v = val_at(i) ) {
+                buf[start + i / 8] |= static_cast<std::byte>(1 << (i % 8));
+
+                if ( IsVariable(t) ) {
+                    size_t begin = buf.size();
+
+                    if ( ! WriteVariable(t, v.get()) )
+                        return false;
+
+                    PutUint(&buf[slot], begin - start, 4);
+                    PutUint(&buf[slot + 4], buf.size() - begin, 4);
+                }
+                else
+                    WriteFixed(&buf[slot], t, v.get());
+            }
+
+            slot += SlotSize(t);
+        }
+
+        return true;
+    }
+
+private:
+    void Append(const void* data, size_t n) {
+        auto p = static_cast<const std::byte*>(data);
+        buf.insert(buf.end(), p, p + n);
+    }
+
+    void AppendUint32(uint32_t v) {
+        buf.resize(buf.size() + 4);
+        PutUint(&buf[buf.size() - 4], v, 4);
+    }
+
+    void WriteFixed(std::byte* p, const zeek::Type* t, const zeek::Val* v) {
+        switch ( t->Tag() ) {
+            case zeek::TYPE_BOOL: PutUint(p, v->AsBool(), 8); break;
+            case zeek::TYPE_INT: PutUint(p, static_cast<uint64_t>(v->AsInt()), 8); break;
+            case zeek::TYPE_COUNT: PutUint(p, v->AsCount(), 8); break;
+            case zeek::TYPE_DOUBLE:
+            case zeek::TYPE_TIME:
+            case zeek::TYPE_INTERVAL: PutUint(p, std::bit_cast<uint64_t>(v->AsDouble()), 8); break;
+            case zeek::TYPE_PORT:
+                PutUint(p, v->AsPortVal()->Port(), 4);
+                PutUint(p + 4, v->AsPortVal()->PortType(), 4);
+                break;
+            case zeek::TYPE_ADDR: v->AsAddr().CopyIPv6(reinterpret_cast<in6_addr*>(p)); break;
+            case zeek::TYPE_SUBNET:
+                v->AsSubNet().Prefix().CopyIPv6(reinterpret_cast<in6_addr*>(p));
+                p[16] = static_cast<std::byte>(v->AsSubNet().LengthIPv6());
+                break;
+            default: break;
+        }
+    }
+
+    bool WriteVariable(const zeek::Type* t, const zeek::Val* v) {
+        switch ( t->Tag() ) {
+            case zeek::TYPE_STRING: Append(v->AsString()->Bytes(), v->AsString()->Len()); return true;
+
+            case zeek::TYPE_ENUM: {
+                const char* name = t->AsEnumType()->Lookup(v->AsEnum());
+                if ( ! name )
+                    return false;
+
+                Append(name, strlen(name));
+                return true;
+            }
+
+            case zeek::TYPE_PATTERN: {
+                const char* exact = v->AsPattern()->PatternText();
+                const char* anywhere = v->AsPattern()->AnywherePatternText();
+                AppendUint32(strlen(exact));
+                Append(exact, strlen(exact));
+                Append(anywhere, strlen(anywhere));
+                return true;
+            }
+
+            case zeek::TYPE_FUNC: {
+                // Functions are sent by name, which doesn't work for lambdas.
+                const auto& name = v->AsFunc()->GetName();
+                if ( name.starts_with("lambda_<") )
+                    return false;
+
+                Append(name.data(), name.size());
+                return true;
+            }
+
+            case zeek::TYPE_RECORD: {
+                auto rt = t->AsRecordType();
+                auto rv = v->AsRecordVal();
+                return WriteBlock(
+                    rt->NumFields(), [rt](size_t i) { return rt->GetFieldType(i).get(); },
+                    [rv](size_t i) { return rv->GetFieldOrDefault(i); });
+            }
+
+            case zeek::TYPE_VECTOR: {
+                const zeek::Type* yield = t->Yield().get();
+                auto vv = v->AsVectorVal();
+                AppendUint32(vv->Size());
+                return WriteBlock(
+                    vv->Size(), [yield](size_t) { return yield; }, [vv](size_t i) { return vv->ValAt(i); });
+            }
+
+            case zeek::TYPE_TABLE: {
+                const auto& indices = t->AsTableType()->GetIndexTypes();
+                const zeek::Type* yield = t->Yield().get();
+                size_t stride = indices.size() + (yield ? 1 : 0);
+                auto tv = v->AsTableVal();
+
+                std::vector<zeek::ValPtr> vals;
+                vals.reserve(tv->Size() * stride);
+
+                for ( const auto& te : *tv->AsTable() ) {
+                    auto hk = te.GetHashKey();
+                    auto vl = tv->RecreateIndex(*hk);
+
+                    for ( int i = 0; i < vl->Length(); i++ )
+                        vals.emplace_back(vl->Idx(i));
+
+                    if ( yield )
+                        vals.emplace_back(te.value->GetVal());
+                }
+
+                AppendUint32(vals.size() / stride);
+                return WriteBlock(
+                    vals.size(),
+                    [&indices, yield, stride](size_t i) {
+                        return i % stride < indices.size() ? indices[i % stride].get() : yield;
+                    },
+                    [&vals](size_t i) { return vals[i]; });
+            }
+
+            default: return false;
+        }
+    }
+
+    detail::byte_buffer& buf;
+};
+
+zeek::ValPtr ReadVariable(zeek::Type* t, const std::byte* p, size_t len);
+
+// Reads a block of n values. type_at(i) returns the type of the i-th
+// value, and assign(i, v) stores it, with v being nullptr if the value
+// is absent. Returns false if the block is malformed or assign() fails.
+template<typename TypeAt, typename Assign>
+bool ReadBlock(const std::byte* p, size_t len, size_t n, TypeAt type_at, Assign assign) {
+    size_t slot = (n + 7) / 8;
+
+    for ( size_t i = 0; i < n; i++ ) {
+        zeek::Type* t = type_at(i);
+        size_t size = SlotSize(t);
+
+        if ( slot > len || size > len - slot )
+            return false;
+
+        zeek::ValPtr v;
+
+        if ( (std::to_integer<uint8_t>(p[i / 8]) & (1 << (i % 8))) != 0 ) {
+            const std::byte* s = p + slot;
+
+            if ( IsVariable(t) ) {
+                size_t off = GetUint(s, 4);
+                size_t vlen = GetUint(s + 4, 4);
+
+                if ( off > len || vlen > len - off )
+                    return false;
+
+                v = ReadVariable(t, p + off, vlen);
+            }
+            else {
+                switch ( t->Tag() ) {
+                    case zeek::TYPE_BOOL: v = zeek::val_mgr->Bool(GetUint(s, 8) != 0); break;
+                    case zeek::TYPE_INT: v = zeek::val_mgr->Int(static_cast<zeek_int_t>(GetUint(s, 8))); break;
+                    case zeek::TYPE_COUNT: v = zeek::val_mgr->Count(GetUint(s, 8)); break;
+                    case zeek::TYPE_DOUBLE:
+                        v = zeek::make_intrusive<zeek::DoubleVal>(std::bit_cast<double>(GetUint(s, 8)));
+                        break;
+                    case zeek::TYPE_TIME:
+                        v = zeek::make_intrusive<zeek::TimeVal>(std::bit_cast<double>(GetUint(s, 8)));
+                        break;
+                    case zeek::TYPE_INTERVAL:
+                        v = zeek::make_intrusive<zeek::IntervalVal>(std::bit_cast<double>(GetUint(s, 8)));
+                        break;
+                    case zeek::TYPE_PORT: {
+                        auto proto = GetUint(s + 4, 4);
+                        if ( proto > TRANSPORT_ICMP )
+                            return false;
+
+                        v = zeek::val_mgr->Port(GetUint(s, 4), static_cast<TransportProto>(proto));
+                        break;
+                    }
+                    case zeek::TYPE_ADDR: {
+                        in6_addr a;
+                        memcpy(&a, s, sizeof(a));
+                        v = zeek::make_intrusive<zeek::AddrVal>(zeek::IPAddr(a));
+                        break;
+                    }
+                    case zeek::TYPE_SUBNET: {
+                        in6_addr a;
+                        memcpy(&a, s, sizeof(a));
+                        auto width = std::to_integer<uint8_t>(s[16]);
+                        if ( width > 128 )
+                            return false;
+
+                        v = zeek::make_intrusive<zeek::SubNetVal>(zeek::IPPrefix(zeek::IPAddr(a), width, true));
+                        break;
+                    }
+                    default: return false;
+                }
+            }
+
+            if ( ! v )
+                return false;
+        }
+
+        if ( ! assign(i, std::move(v)) )
+            return false;
+
+        slot += size;
+    }
+
+    return true;
+}
+
+zeek::ValPtr ReadVariable(zeek::Type* t, const std::byte* p, size_t len) {
+    switch ( t->Tag() ) {
+        case zeek::TYPE_STRING: return zeek::make_intrusive<zeek::StringVal>(len, reinterpret_cast<const char*>(p));
+
+        case zeek::TYPE_ENUM: {
+            auto et = t->AsEnumType();
+            auto i = et->Lookup(std::string(reinterpret_cast<const char*>(p), len));
+            if ( i < 0 )
+                return nullptr;
+
+            return et->GetEnumVal(i);
+        }
+
+        case zeek::TYPE_PATTERN: {
+            if ( len < 4 || GetUint(p, 4) > len - 4 )
+                return nullptr;
+
+            size_t exact_len = GetUint(p, 4);
+            std::string exact(reinterpret_cast<const char*>(p + 4), exact_len);
+            std::string anywhere(reinterpret_cast<const char*>(p + 4 + exact_len), len - 4 - exact_len);
+
+            auto* re = new zeek::RE_Matcher(exact.c_str(), anywhere.c_str());
+            if ( ! re->Compile() ) {
+                delete re;
+                return nullptr;
+            }
+
+            return zeek::make_intrusive<zeek::PatternVal>(re);
+        }
+
+        case zeek::TYPE_FUNC: {
+            const auto& id = zeek::id::find(std::string_view(reinterpret_cast<const char*>(p), len));
+            if ( ! id || ! id->GetVal() || id->GetVal()->GetType()->Tag() != zeek::TYPE_FUNC )
+                return nullptr;
+
+            return id->GetVal();
+        }
+
+        case zeek::TYPE_RECORD: {
+            auto rt = t->AsRecordType();
+            auto rv = zeek::make_intrusive<zeek::RecordVal>(zeek::IntrusivePtr{zeek::NewRef{}, rt});
+            auto ok = ReadBlock(
+                p, len, rt->NumFields(), [rt](size_t i) { return rt->GetFieldType(i).get(); },
+                [&rv](size_t i, zeek::ValPtr v) {
+                    if ( v )
+                        rv->Assign(i, std::move(v));
+                    else
+                        rv->Remove(i);
+                    return true;
+                });
+
+            return ok ? rv : nullptr;
+        }
+
+        case zeek::TYPE_VECTOR: {
+            // Every element takes at least a slot, so anything larger is
+            // bogus and mustn't be allocated for.
+            if ( len < 4 || GetUint(p, 4) > (len - 4) / 8 )
+                return nullptr;
+
+            auto n = static_cast<unsigned int>(GetUint(p, 4));
+            auto vt = t->AsVectorType();
+            auto yield = vt->Yield().get();
+            auto vv = zeek::make_intrusive<zeek::VectorVal>(zeek::IntrusivePtr{zeek::NewRef{}, vt});
+            vv->Resize(n);
+
+            auto ok = ReadBlock(
+                p + 4, len - 4, n, [yield](size_t) { return yield; },
+                [&vv](size_t i, zeek::ValPtr v) { return ! v || vv->Assign(i, std::move(v)); });
+
+            return ok ? vv : nullptr;
+        }
+
+        case zeek::TYPE_TABLE: {
+            auto tt = t->AsTableType();
+            const auto& indices = tt->GetIndexTypes();
+            auto yield = tt->Yield().get();
+            size_t stride = indices.size() + (yield ? 1 : 0);
+
+            if ( len < 4 || GetUint(p, 4) > (len - 4) / 8 / stride )
+                return nullptr;
+
+            auto tv = zeek::make_intrusive<zeek::TableVal>(zeek::IntrusivePtr{zeek::NewRef{}, tt});
+            zeek::ListValPtr index;
+
+            auto ok = ReadBlock(
+                p + 4, len - 4, GetUint(p, 4) * stride,
+                [&indices, yield, stride](size_t i) {
+                    return i % stride < indices.size() ? indices[i % stride].get() : yield;
+                },
+                [&](size_t i, zeek::ValPtr v) {
+                    if ( ! v )
+                        return false;
+
+                    if ( i % stride == 0 )
+                        index = zeek::make_intrusive<zeek::ListVal>(zeek::TYPE_ANY);
+
+                    if ( i % stride < indices.size() )
+                        index->Append(std::move(v));
+
+                    if ( i % stride == stride - 1 )
+                        tv->Assign(std::move(index), yield ? std::move(v) : nullptr);
+
+                    return true;
+                });
+
+            return ok ? tv : nullptr;
+        }
+
+        default: return nullptr;
+    }
+}
+
+} // namespace
+
+const detail::FlatV1_Serializer::Schema& detail::FlatV1_Serializer::GetSchema(EventHandlerPtr handler) {
+    if ( auto it = schemas.find(handler.Ptr()); it != schemas.end() )
+        return it->second;
+
+    Schema schema;
+    schema.fingerprint = 0xcbf29ce484222325ULL;
+    schema.supported = true;
+
+    if ( const auto& ft = handler->GetType(false) ) {
+        for ( const auto& pt : ft->ParamList()->GetTypes() )
+            schema.supported = schema.supported && Fingerprint(pt.get(), schema.fingerprint);
+    }
+    else
+        schema.supported = false;
+
+    return schemas.emplace(handler.Ptr(), schema).first->second;
+}
+
+bool detail::FlatV1_Serializer::SerializeEvent(detail::byte_buffer& buf, const detail::Event& event) {
+    const auto& schema = GetSchema(event.Handler());
+    std::string_view name = event.HandlerName();
+
+    if ( ! schema.supported ) {
+        zeek::reporter->Error("Event '%s' has parameter types unsupported by %s", std::string(name).c_str(),
+                              Name().c_str());
+        return false;
+    }
+
+    EventHandlerPtr handler = event.Handler();
+    const auto& params = handler->GetType(false)->ParamList()->GetTypes();
+
+    if ( params.size() != event.args.size() || name.size() > UINT16_MAX )
+        return false;
+
+    size_t start = buf.size();
+    buf.resize(start + HEADER_SIZE + name.size());
+
+    auto* p = &buf[start];
+    p[0] = static_cast<std::byte>(FORMAT_VERSION);
+    p[1] = std::byte{0};
+    PutUint(p + 2, name.size(), 2);
+    memcpy(p + 4, name.data(), name.size());
+    PutUint(p + 4 + name.size(), std::bit_cast<uint64_t>(event.timestamp), 8);
+    PutUint(p + 12 + name.size(), schema.fingerprint, 8);
+
+    Writer writer(buf);
+    return writer.WriteBlock(
+        params.size(), [&params](size_t i) { return params[i].get(); }, [&event](size_t i) { return event.args[i]; });
+}
+
+std::optional<detail::Event> detail::FlatV1_Serializer::UnserializeEvent(detail::byte_buffer_span buf) {
+    const std::byte* p = buf.data();
+
+    if ( buf.size() < HEADER_SIZE || std::to_integer<uint8_t>(p[0]) != FORMAT_VERSION )
+        return std::nullopt;
+
+    size_t name_len = GetUint(p + 2, 2);
+    if ( buf.size() < HEADER_SIZE + name_len )
+        return std::nullopt;
+
+    std::string_view name(reinterpret_cast<const char*>(p + 4), name_len);
+    double ts = std::bit_cast<double>(GetUint(p + 4 + name_len, 8));
+    uint64_t fingerprint = GetUint(p + 12 + name_len, 8);
+
+    zeek::EventHandlerPtr handler = zeek::event_registry->Lookup(name);
+    if ( handler == nullptr ) {
+        zeek::reporter->Error("Failed to lookup handler for '%s'", std::string(name).c_str());
+        return std::nullopt;
+    }
+
+    const auto& schema = GetSchema(handler);
+    if ( ! schema.supported || schema.fingerprint != fingerprint ) {
+        zeek::reporter->Error("Unserialize error for event '%s': parameter types differ from sender's",
+                              std::string(name).c_str());
+        return std::nullopt;
+    }
+
+    const auto& params = handler->GetType(false)->ParamList()->GetTypes();
+    zeek::Args args(params.size());
+
+    size_t offset = HEADER_SIZE + name_len;
+    auto ok = ReadBlock(
+        p + offset, buf.size() - offset, params.size(), [&params](size_t i) { return params[i].get(); },
+        [&args](size_t i, zeek::ValPtr v) {
+            args[i] = std::move(v);
+            return args[i] != nullptr;
+        });
+
+    if ( ! ok ) {
+        zeek::reporter->Error("Unserialize error for event '%s': malformed arguments", std::string(name).c_str());
+        return std::nullopt;
+    }
+
+    return detail::Event{handler, std::move(args), ts};
+}
+
+TEST_SUITE_BEGIN("cluster serializer flat");
+
+namespace {
+
+// Returns a value of the given type with all record fields set, for tests
+// and the benchmark below.
+zeek::ValPtr sample_val(zeek::Type* t, int depth = 0) {
+    switch ( t->Tag() ) {
+        case zeek::TYPE_BOOL: return zeek::val_mgr->True();
+        case zeek::TYPE_INT: return zeek::val_mgr->Int(-42);
+        case zeek::TYPE_COUNT: return zeek::val_mgr->Count(42);
+        case zeek::TYPE_DOUBLE: return zeek::make_intrusive<zeek::DoubleVal>(0.5);
+        case zeek::TYPE_TIME: return zeek::make_intrusive<zeek::TimeVal>(1700000000.123456);
+        case zeek::TYPE_INTERVAL: return zeek::make_intrusive<zeek::IntervalVal>(3.25);
+        case zeek::TYPE_PORT: return zeek::val_mgr->Port(443, TRANSPORT_TCP);
+        case zeek::TYPE_ADDR: return zeek::make_intrusive<zeek::AddrVal>("192.168.1.100");
+        case zeek::TYPE_SUBNET: return zeek::make_intrusive<zeek::SubNetVal>("2001:db8::/32");
+        case zeek::TYPE_STRING: return zeek::make_intrusive<zeek::StringVal>("CHhAvVGS1DHFjwGM9");
+        case zeek::TYPE_ENUM: {
+            auto et = t->AsEnumType();
+            auto names = et->Names();
+            return names.empty() ? nullptr : et->GetEnumVal(names.front().second);
+        }
+        case zeek::TYPE_RECORD: {
+            if ( depth > 4 )
+                return nullptr;
+
+            auto rt = t->AsRecordType();
+            auto rv = zeek::make_intrusive<zeek::RecordVal>(zeek::IntrusivePtr{zeek::NewRef{}, rt});
+            for ( int i = 0; i < rt->NumFields(); i++ ) {
+                if ( auto v = sample_val(rt->GetFieldType(i).get(), depth + 1) )
+                    rv->Assign(i, std::move(v));
+            }
+            return rv;
+        }
+        case zeek::TYPE_VECTOR: {
+            auto vv = zeek::make_intrusive<zeek::VectorVal>(zeek::IntrusivePtr{zeek::NewRef{}, t->AsVectorType()});
+            if ( auto v = sample_val(t->Yield().get(), depth + 1) )
+                vv->Assign(0, std::move(v));
+            return vv;
+        }
+        case zeek::TYPE_TABLE: {
+            auto tt = t->AsTableType();
+            auto tv = zeek::make_intrusive<zeek::TableVal>(zeek::IntrusivePtr{zeek::NewRef{}, tt});
+            auto index = zeek::make_intrusive<zeek::ListVal>(zeek::TYPE_ANY);
+            for ( const auto& it : tt->GetIndexTypes() ) {
+                auto v = sample_val(it.get(), depth + 1);
+                if ( ! v )
+                    return tv;
+
+                index->Append(std::move(v));
+            }
+
+            zeek::ValPtr yield;
+            if ( tt->Yield() && ! (yield = sample_val(tt->Yield().get(), depth + 1)) )
+                return tv;
+
+            tv->Assign(std::move(index), std::move(yield));
+            return tv;
+        }
+        default: return nullptr;
+    }
+}
+
+std::optional<detail::Event> sample_event(const char* name) {
+    zeek::EventHandlerPtr handler = zeek::event_registry->Lookup(name);
+    if ( ! handler )
+        return std::nullopt;
+
+    zeek::Args args;
+    for ( const auto& t : handler->GetType(false)->ParamList()->GetTypes() )
+        args.emplace_back(sample_val(t.get()));
+
+    return detail::Event{handler, std::move(args), 1700000000.5};
+}
+
+} // namespace
+
+TEST_CASE("roundtrip") {
+    auto* handler = zeek::event_registry->Lookup("Supervisor::node_status");
+    detail::Event e{handler, zeek::Args{zeek::make_intrusive<zeek::StringVal>("TEST"), zeek::val_mgr->Count(42)}};
+    detail::FlatV1_Serializer serializer;
+    detail::byte_buffer buf;
+
+    unsigned char expected_bytes[] = {0x01, 0x00, 0x17, 0x00, 0x53, 0x75, 0x70, 0x65, 0x72, 0x76, 0x69, 0x73, 0x6f,
+                                      0x72, 0x3a, 0x3a, 0x6e, 0x6f, 0x64, 0x65, 0x5f, 0x73, 0x74, 0x61, 0x74, 0x75,
+                                      0x73, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
+
+    REQUIRE(serializer.SerializeEvent(buf, e));
+
+    // Header up to the fingerprint, followed by the bitmap, the offset and
+    // length of the string, the count and the string.
+    REQUIRE_EQ(buf.size(), sizeof(expected_bytes) + 8 + 1 + 8 + 8 + 4);
+    CHECK(memcmp(buf.data(), expected_bytes, sizeof(expected_bytes)) == 0);
+    CHECK_EQ(std::to_integer<int>(buf[43]), 0x03);
+    CHECK_EQ(GetUint(&buf[44], 4), 17);
+    CHECK_EQ(GetUint(&buf[48], 4), 4);
+    CHECK_EQ(GetUint(&buf[52], 8), 42);
+    CHECK_EQ(std::string(reinterpret_cast<const char*>(&buf[60]), 4), "TEST");
+
+    auto result = serializer.UnserializeEvent(buf);
+    REQUIRE(result);
+    CHECK_EQ(result->Handler(), handler);
+    CHECK_EQ(result->HandlerName(), "Supervisor::node_status");
+    REQUIRE_EQ(result->args.size(), 2);
+    CHECK_EQ(result->args[0]->AsString()->CheckString(), std::string("TEST"));
+    CHECK_EQ(result->args[1]->AsCount(), 42);
+
+    // A different parameter signature on the receiving side is rejected.
+    buf[38] ^= std::byte{0xff};
+    CHECK_FALSE(serializer.UnserializeEvent(buf));
+    buf[38] ^= std::byte{0xff};
+
+    // As is anything truncated.
+    CHECK_FALSE(serializer.UnserializeEvent({buf.data(), 20}));
+    CHECK_FALSE(serializer.UnserializeEvent({buf.data(), buf.size() - 1}));
+}
+
+TEST_CASE("roundtrip connection") {
+    auto e = sample_event("connection_state_remove");
+    REQUIRE(e);
+
+    detail::FlatV1_Serializer serializer;
+    detail::byte_buffer buf;
+    REQUIRE(serializer.SerializeEvent(buf, *e));
+
+    auto result = serializer.UnserializeEvent(buf);
+    REQUIRE(result);
+    REQUIRE_EQ(result->args.size(), 1);
+    CHECK_EQ(result->timestamp, e->timestamp);
+    CHECK_EQ(zeek::obj_desc(result->args[0].get()), zeek::obj_desc(e->args[0].get()));
+
+    detail::byte_buffer buf2;
+    REQUIRE(serializer.SerializeEvent(buf2, *result));
+    CHECK_EQ(buf, buf2);
+}
+
+namespace {
+
+// Encodes and decodes an event n times each, returning the rates
+// achieved in events per second.
+std::pair<double, double> serializer_throughput(EventSerializer& serializer, const detail::Event& e, size_t n) {
+    detail::byte_buffer buf;
+    auto start = std::chrono::steady_clock::now();
+
+    for ( size_t i = 0; i < n; i++ ) {
+        buf.clear();
+        serializer.SerializeEvent(buf, e);
+    }
+
+    auto encoded = std::chrono::steady_clock::now();
+
+    for ( size_t i = 0; i < n; i++ )
+        serializer.UnserializeEvent(buf);
+
+    auto decoded = std::chrono::steady_clock::now();
+
+    std::chrono::duration<double> encode_time = encoded - start;
+    std::chrono::duration<double> decode_time = decoded - encoded;
+    return {n / encode_time.count(), n / decode_time.count()};
+}
+
+} // namespace
+
+// Microbenchmark comparing the event serializers for typical event
+// shapes. Skipped by default, run with:
+// zeek --test -tc="event serializer benchmark" --no-skip
+TEST_CASE("event serializer benchmark" * doctest::skip(true)) {
+    constexpr size_t n = 100000;
+
+    detail::FlatV1_Serializer flat;
+    detail::BrokerBinV1_Serializer broker_bin;
+    detail::BrokerJsonV1_Serializer broker_json;
+
+    for ( const char* name : {"connection_state_remove", "dns_request"} ) {
+        auto e = sample_event(name);
+        REQUIRE(e);
+
+        for ( EventSerializer* s : std::initializer_list<EventSerializer*>{&flat, &broker_bin, &broker_json} ) {
+            detail::byte_buffer buf;
+            s->SerializeEvent(buf, *e);
+
+            auto [encode_rate, decode_rate] = serializer_throughput(*s, *e, n);
+            MESSAGE(zeek::util::fmt("%-24s %-15s %6zu bytes, encode %9.0f events/s, decode %9.0f events/s", name,
+                                    s->Name().c_str(), buf.size(), encode_rate, decode_rate));
+        }
+    }
+}
+
+TEST_SUITE_END();
@@ -0,0 +1,57 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+
+#include "zeek/EventHandler.h"
+#include "zeek/cluster/Serializer.h"
+
+namespace zeek::cluster::detail {
+
+/**
+ * Event serializer writing values directly into a flat binary layout,
+ * without converting them to an intermediate representation first.
+ *
+ * A message starts with a header holding the format version, the event
+ * name, the timestamp and a fingerprint of the event's parameter types.
+ * The arguments follow as a block.
+ *
+ * A block holds a fixed number of values with types known to both sides:
+ * a bitmap of the values present, then one fixed-size slot per value,
+ * then a variable-sized area. Slots of scalar types hold the value itself.
+ * Slots of strings, enums and functions (by name), patterns and container
+ * types hold the offset and length of their data in the variable-sized
+ * area. As slot sizes only depend on the types, a record field's slot is
+ * at the same offset in every message. Records are encoded as a block of
+ * their fields.
+ * Vectors and tables are encoded as their number of elements, followed by
+ * a block of all elements, or of all index and yield values respectively.
+ *
+ * Type information isn't transferred. Instead, sender and receiver derive
+ * the layout from the event's declared parameter types, and the receiver
+ * rejects messages whose fingerprint doesn't match its own declaration.
+ * Fingerprints are computed once per event handler. Values of type any,
+ * opaque or file, as well as lambdas, aren't supported.
+ */
+class FlatV1_Serializer : public EventSerializer {
+public:
+    FlatV1_Serializer() : EventSerializer("zeek-flat-v1") {}
+
+    bool SerializeEvent(detail::byte_buffer& buf, const detail::Event& event) override;
+
+    std::optional<detail::Event> UnserializeEvent(detail::byte_buffer_span buf) override;
+
+private:
+    struct Schema {
+        uint64_t fingerprint = 0;
+        bool supported = false;
+    };
+
+    const Schema& GetSchema(EventHandlerPtr handler);
+
+    std::unordered_map<const EventHandler*, Schema> schemas;
+};
+
+} // namespace zeek::cluster::detail
@@ -2,6 +2,8 @@
 
 #include "zeek/input/Manager.h"
 
+#include <algorithm>
+#include <chrono>
 #include <string>
 #include <utility>
 
@@ -18,6 +20,7 @@
 #include "zeek/input/ReaderFrontend.h"
 #include "zeek/input/input.bif.h"
 #include "zeek/module_util.h"
+#include "zeek/telemetry/Manager.h"
 #include "zeek/threading/SerialTypes.h"
 
 using namespace std;
@@ -96,6 +99,28 @@ public:
 
     EventHandlerPtr event;
 
+    // With Input::bulk_table_loads, the changes of a (re)load are held
+    // back here until the reader has sent all entries.
+    struct StagedEntry {
+        ValPtr idx;
+        std::unique_ptr<zeek::detail::HashKey> key;
+        ValPtr val;
+        zeek::Args event_args; // Empty if there's no event to raise.
+    };
+
+    bool bulk;
+    std::vector<StagedEntry> staged;
+
+    // State of the current (re)load for telemetry.
+    double load_start = 0.0;       // Wall time when the load started, 0 if none is ongoing.
+    double load_main_thread = 0.0; // Main-thread time spent on the load so far.
+    double load_max_stall = 0.0;   // Longest single main-thread step of the load.
+
+    std::shared_ptr<telemetry::Counter> loads;
+    std::shared_ptr<telemetry::Counter> load_seconds;
+    std::shared_ptr<telemetry::Counter> load_main_thread_seconds;
+    std::shared_ptr<telemetry::Histogram> load_stall;
+
     TableStream();
     ~TableStream() override;
 };
@@ -131,7 +156,8 @@ Manager::TableStream::TableStream()
       currDict(),
       lastDict(),
       pred(),
-      event() {}
+      event(),
+      bulk() {}
 
 Manager::EventStream::EventStream()
     : Manager::Stream::Stream(EVENT_STREAM), event(), fields(), num_fields(), want_record() {}
@@ -167,6 +193,23 @@ Manager::AnalysisStream::AnalysisStream() : Manager::Stream::Stream(ANALYSIS_STR
 
 Manager::Manager() : plugin::ComponentManager<input::Component>("Input", "Reader") {
     end_of_data = event_registry->Register("Input::end_of_data");
+
+    static const double stall_bounds[] = {0.001, 0.01, 0.1, 1.0, 10.0};
+
+    table_loads_family =
+        telemetry_mgr->CounterFamily("zeek", "input-table-loads", {"stream"}, "Number of completed table (re)loads.");
+    table_load_time_family =
+        telemetry_mgr->CounterFamily("zeek", "input-table-load", {"stream"},
+                                     "Time from the first entry of a table (re)load reaching the main thread until "
+                                     "the table was up to date.",
+                                     "seconds");
+    table_load_main_thread_family =
+        telemetry_mgr->CounterFamily("zeek", "input-table-load-main-thread", {"stream"},
+                                     "Time the main thread spent on bulk table (re)loads.", "seconds");
+    table_load_stall_family =
+        telemetry_mgr->HistogramFamily("zeek", "input-table-load-stall", {"stream"}, stall_bounds,
+                                       "Longest uninterrupted step of the main thread for each bulk table (re)load.",
+                                       "seconds");
 }
 
 Manager::~Manager() {
@@ -230,6 +273,15 @@ bool Manager::CreateStream(Stream* info, RecordVal* description) {
         default: reporter->InternalWarning("unknown input reader mode"); return false;
     }
 
+    if ( info->stream_type == TABLE_STREAM ) {
+        rinfo.num_idx_fields = ((TableStream*)info)->num_idx_fields;
+
+        // Only tables are loaded in bulk. Other streams process their
+        // entries one by one anyway.
+        if ( BifConst::Input::bulk_table_loads )
+            rinfo.entry_batch_size = std::max(BifConst::Input::bulk_batch_size, static_cast<zeek_uint_t>(1));
+    }
+
     auto config = description->GetFieldOrDefault("config");
     info->config = config.release()->AsTableVal();
 
@@ -659,6 +711,8 @@ bool Manager::CreateTableStream(RecordVal* fval) {
     }
 
     TableStream* stream = new TableStream();
+    stream->num_idx_fields = idxfields;
+
     {
         bool res = CreateStream(stream, fval);
         if ( ! res ) {
@@ -674,7 +728,6 @@ bool Manager::CreateTableStream(RecordVal* fval) {
         fields[i] = fieldsV[i];
 
     stream->pred = pred ? pred->AsFunc() : nullptr;
-    stream->num_idx_fields = idxfields;
     stream->num_val_fields = valfields;
     stream->tab = dst.release()->AsTableVal();
     stream->rtype = val.release();
@@ -686,6 +739,12 @@ bool Manager::CreateTableStream(RecordVal* fval) {
     stream->lastDict = new PDict<InputHash>;
     stream->lastDict->SetDeleteFunc(input_hash_delete_func);
     stream->want_record = (want_record->InternalInt() == 1);
+    stream->bulk = BifConst::Input::bulk_table_loads;
+
+    stream->loads = table_loads_family->GetOrAdd({{"stream", stream->name}});
+    stream->load_seconds = table_load_time_family->GetOrAdd({{"stream", stream->name}});
+    stream->load_main_thread_seconds = table_load_main_thread_family->GetOrAdd({{"stream", stream->name}});
+    stream->load_stall = table_load_stall_family->GetOrAdd({{"stream", stream->name}});
 
     assert(stream->reader);
     stream->reader->Init(fieldsV.size(), fields);
@@ -1054,9 +1113,21 @@ void Manager::SendEntry(ReaderFrontend* reader, Value** vals) {
 
     int readFields = 0;
 
-    if ( i->stream_type == TABLE_STREAM )
+    if ( i->stream_type == TABLE_STREAM ) {
+        // Reading the clock would cost about as much as the entry itself,
+        // so only bulk loads account for their main-thread time.
+        auto* stream = static_cast<TableStream*>(i);
+        std::chrono::steady_clock::time_point start;
+
+        if ( stream->bulk )
+            start = std::chrono::steady_clock::now();
+
         readFields = SendEntryTable(i, vals);
 
+        if ( stream->bulk )
+            AddLoadTime(stream, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+
     else if ( i->stream_type == EVENT_STREAM ) {
         auto type = BifType::Enum::Input::Event->GetEnumVal(BifEnum::Input::EVENT_NEW);
         readFields = SendEventStreamEvent(i, type.release(), vals);
@@ -1075,6 +1146,33 @@ void Manager::SendEntry(ReaderFrontend* reader, Value** vals) {
     Value::delete_value_ptr_array(vals, readFields);
 }
 
+void Manager::SendEntries(ReaderFrontend* reader, const vector<Value**>& entries) {
+    Stream* i = FindStream(reader);
+
+    if ( i == nullptr || i->stream_type != TABLE_STREAM ) {
+        for ( auto* vals : entries )
+            SendEntry(reader, vals);
+
+        return;
+    }
+
+    // The whole batch is one step of the main thread.
+    auto start = std::chrono::steady_clock::now();
+
+    for ( auto* vals : entries ) {
+        int readFields = SendEntryTable(i, vals);
+        Value::delete_value_ptr_array(vals, readFields);
+    }
+
+    AddLoadTime(static_cast<TableStream*>(i),
+                std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+}
+
+void Manager::AddLoadTime(TableStream* stream, double seconds) {
+    stream->load_main_thread += seconds;
+    stream->load_max_stall = std::max(stream->load_max_stall, seconds);
+}
+
 int Manager::SendEntryTable(Stream* i, const Value* const* vals) {
     bool updated = false;
 
@@ -1083,6 +1181,9 @@ int Manager::SendEntryTable(Stream* i, const Value* const* vals) {
     assert(i->stream_type == TABLE_STREAM);
     TableStream* stream = (TableStream*)i;
 
+    if ( stream->load_start == 0.0 )
+        stream->load_start = util::current_time();
+
     zeek::detail::HashKey* idxhash = HashValues(stream->num_idx_fields, vals);
 
     if ( idxhash == nullptr ) {
@@ -1220,7 +1321,10 @@ int Manager::SendEntryTable(Stream* i, const Value* const* vals) {
     ih->idxkey = new zeek::detail::HashKey(k->Key(), k->Size(), k->Hash());
     ih->valhash = valhash;
 
-    stream->tab->Assign({AdoptRef{}, idxval}, std::move(k), {AdoptRef{}, valval});
+    if ( stream->bulk )
+        stream->staged.push_back({{AdoptRef{}, idxval}, std::move(k), {AdoptRef{}, valval}, {}});
+    else
+        stream->tab->Assign({AdoptRef{}, idxval}, std::move(k), {AdoptRef{}, valval});
 
     if ( predidx != nullptr )
         Unref(predidx);
@@ -1238,18 +1342,26 @@ int Manager::SendEntryTable(Stream* i, const Value* const* vals) {
             // already be ok again
             Unref(predidx);
         }
-        else if ( updated ) { // in case of update send back the old value.
-            assert(stream->num_val_fields > 0);
-            auto ev = BifType::Enum::Input::Event->GetEnumVal(BifEnum::Input::EVENT_CHANGED);
-            assert(oldval != nullptr);
-            SendEvent(stream->event, 4, stream->description->Ref(), ev.release(), predidx, oldval.release());
-        }
         else {
-            auto ev = BifType::Enum::Input::Event->GetEnumVal(BifEnum::Input::EVENT_NEW);
-            if ( stream->num_val_fields == 0 )
-                SendEvent(stream->event, 3, stream->description->Ref(), ev.release(), predidx);
+            zeek::Args args{{NewRef{}, stream->description}, nullptr, {AdoptRef{}, predidx}};
+
+            if ( updated ) { // in case of update send back the old value.
+                assert(stream->num_val_fields > 0);
+                args[1] = BifType::Enum::Input::Event->GetEnumVal(BifEnum::Input::EVENT_CHANGED);
+                assert(oldval != nullptr);
+                args.emplace_back(std::move(oldval));
+            }
+            else {
+                args[1] = BifType::Enum::Input::Event->GetEnumVal(BifEnum::Input::EVENT_NEW);
+                if ( stream->num_val_fields > 0 )
+                    args.emplace_back(NewRef{}, valval);
+            }
+
+            // A bulk load raises its events once the table reflects them.
+            if ( stream->bulk )
+                stream->staged.back().event_args = std::move(args);
             else
-                SendEvent(stream->event, 4, stream->description->Ref(), ev.release(), predidx, valval->Ref());
+                event_mgr.Enqueue(stream->event, std::move(args), util::detail::SOURCE_LOCAL);
         }
     }
 
@@ -1280,6 +1392,13 @@ void Manager::EndCurrentSend(ReaderFrontend* reader) {
     assert(i->stream_type == TABLE_STREAM);
     auto* stream = static_cast<TableStream*>(i);
 
+    auto start = std::chrono::steady_clock::now();
+
+    if ( stream->load_start == 0.0 )
+        stream->load_start = util::current_time();
+
+    ApplyStagedEntries(stream);
+
     // lastdict contains all deleted entries and should be empty apart from that
     for ( auto it = stream->lastDict->begin_robust(); it != stream->lastDict->end_robust(); ++it ) {
         auto lastDictIdxKey = it->GetHashKey();
@@ -1331,6 +1450,20 @@ void Manager::EndCurrentSend(ReaderFrontend* reader) {
     stream->currDict = new PDict<InputHash>;
     stream->currDict->SetDeleteFunc(input_hash_delete_func);
 
+    AddLoadTime(stream, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+
+    stream->loads->Inc();
+    stream->load_seconds->Inc(util::current_time() - stream->load_start);
+
+    if ( stream->bulk ) {
+        stream->load_main_thread_seconds->Inc(stream->load_main_thread);
+        stream->load_stall->Observe(stream->load_max_stall);
+    }
+
+    stream->load_start = 0.0;
+    stream->load_main_thread = 0.0;
+    stream->load_max_stall = 0.0;
+
 #ifdef DEBUG
     DBG_LOG(DBG_INPUT, "EndCurrentSend complete for stream %s", i->name.c_str());
 #endif
@@ -1338,6 +1471,17 @@ void Manager::EndCurrentSend(ReaderFrontend* reader) {
     SendEndOfData(i);
 }
 
+void Manager::ApplyStagedEntries(TableStream* stream) {
+    for ( auto& e : stream->staged ) {
+        stream->tab->Assign(std::move(e.idx), std::move(e.key), std::move(e.val));
+
+        if ( ! e.event_args.empty() )
+            event_mgr.Enqueue(stream->event, std::move(e.event_args), util::detail::SOURCE_LOCAL);
+    }
+
+    stream->staged.clear();
+}
+
 void Manager::SendEndOfData(ReaderFrontend* reader) {
     Stream* i = FindStream(reader);
 
@@ -1604,6 +1748,14 @@ bool Manager::Delete(ReaderFrontend* reader, Value** vals) {
 
         assert(idxval != nullptr);
 
+        if ( ! stream->tab->Find({NewRef{}, idxval}) ) {
+            // Nothing to delete, for example because a predicate refused
+            // to add the entry in the first place.
+            Unref(idxval);
+            Value::delete_value_ptr_array(vals, readVals);
+            return true;
+        }
+
         if ( stream->pred || stream->event ) {
             auto val = stream->tab->FindOrDefault({NewRef{}, idxval});
 
@@ -1643,7 +1795,11 @@ bool Manager::Delete(ReaderFrontend* reader, Value** vals) {
         if ( streamresult ) {
             if ( ! stream->tab->Remove(*idxval) )
                 Warning(i, "Internal error while deleting values from input table");
+
+            Unref(idxval);
         }
+
+        success = true;
     }
 
     else if ( i->stream_type == EVENT_STREAM ) {
@@ -5,6 +5,8 @@
 #pragma once
 
 #include <map>
+#include <memory>
+#include <vector>
 
 #include "zeek/EventHandler.h"
 #include "zeek/Tag.h"
@@ -16,6 +18,11 @@ namespace zeek {
 
 class RecordVal;
 
+namespace telemetry {
+class CounterFamily;
+class HistogramFamily;
+} // namespace telemetry
+
 namespace input {
 
 class ReaderFrontend;
@@ -121,6 +128,7 @@ protected:
     friend class DeleteMessage;
     friend class ClearMessage;
     friend class SendEntryMessage;
+    friend class SendEntriesMessage;
     friend class EndCurrentSendMessage;
     friend class ReaderClosedMessage;
     friend class DisableMessage;
@@ -141,6 +149,7 @@ protected:
     // monitoring new/deleted values) Functions take ownership of
     // threading::Value fields.
     void SendEntry(ReaderFrontend* reader, threading::Value** vals);
+    void SendEntries(ReaderFrontend* reader, const std::vector<threading::Value**>& entries);
     void EndCurrentSend(ReaderFrontend* reader);
 
     // Instantiates a new ReaderBackend of the given type (note that
@@ -192,6 +201,13 @@ private:
     // SendEntry implementation for Table stream.
     int SendEntryTable(Stream* i, const threading::Value* const* vals);
 
+    // Applies the entries of a bulk table load that were held back until
+    // the reader sent all of them.
+    void ApplyStagedEntries(TableStream* stream);
+
+    // Accounts main-thread time spent on the current load of a table.
+    void AddLoadTime(TableStream* stream, double seconds);
+
     // Put implementation for Table stream.
     int PutTable(Stream* i, const threading::Value* const* vals);
 
@@ -261,6 +277,11 @@ private:
     std::map<ReaderFrontend*, Stream*> readers;
 
     EventHandlerPtr end_of_data;
+
+    std::shared_ptr<telemetry::CounterFamily> table_loads_family;
+    std::shared_ptr<telemetry::CounterFamily> table_load_time_family;
+    std::shared_ptr<telemetry::CounterFamily> table_load_main_thread_family;
+    std::shared_ptr<telemetry::HistogramFamily> table_load_stall_family;
 };
 
 } // namespace input
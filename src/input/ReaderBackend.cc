@@ -81,6 +81,20 @@ private:
     Value** val;
 };
 
+class SendEntriesMessage final : public threading::OutputMessage<ReaderFrontend> {
+public:
+    SendEntriesMessage(ReaderFrontend* reader, std::vector<Value**> entries)
+        : threading::OutputMessage<ReaderFrontend>("SendEntries", reader), entries(std::move(entries)) {}
+
+    bool Process() override {
+        input_mgr->SendEntries(Object(), entries);
+        return true;
+    }
+
+private:
+    std::vector<Value**> entries;
+};
+
 class EndCurrentSendMessage final : public threading::OutputMessage<ReaderFrontend> {
 public:
     EndCurrentSendMessage(ReaderFrontend* reader)
@@ -154,23 +168,66 @@ ReaderBackend::ReaderBackend(ReaderFrontend* arg_frontend) : MsgThread() {
     info = new ReaderInfo(frontend->Info());
     num_fields = 0;
     fields = nullptr;
+    entry_batch_size = info->entry_batch_size;
 
     SetName(frontend->Name());
 }
 
-ReaderBackend::~ReaderBackend() { delete info; }
+ReaderBackend::~ReaderBackend() {
+    for ( auto* vals : entry_batch )
+        Value::delete_value_ptr_array(vals, num_fields);
+
+    delete info;
+}
+
+// Entries batched up so far go out first, so that the main thread sees
+// everything in the order the reader sent it.
+
+void ReaderBackend::Put(Value** val) {
+    FlushEntries();
+    SendOut(new PutMessage(frontend, val));
+}
+
+void ReaderBackend::Delete(Value** val) {
+    FlushEntries();
+    SendOut(new DeleteMessage(frontend, val));
+}
+
+void ReaderBackend::Clear() {
+    FlushEntries();
+    SendOut(new ClearMessage(frontend));
+}
 
-void ReaderBackend::Put(Value** val) { SendOut(new PutMessage(frontend, val)); }
+void ReaderBackend::EndCurrentSend() {
+    FlushEntries();
+    SendOut(new EndCurrentSendMessage(frontend));
+}
+
+void ReaderBackend::EndOfData() {
+    FlushEntries();
+    SendOut(new EndOfDataMessage(frontend));
+}
 
-void ReaderBackend::Delete(Value** val) { SendOut(new DeleteMessage(frontend, val)); }
+void ReaderBackend::SendEntry(Value** vals) {
+    if ( entry_batch_size <= 1 ) {
+        SendOut(new SendEntryMessage(frontend, vals));
+        return;
+    }
 
-void ReaderBackend::Clear() { SendOut(new ClearMessage(frontend)); }
+    entry_batch.push_back(vals);
 
-void ReaderBackend::EndCurrentSend() { SendOut(new EndCurrentSendMessage(frontend)); }
+    if ( entry_batch.size() >= entry_batch_size )
+        FlushEntries();
+}
 
-void ReaderBackend::EndOfData() { SendOut(new EndOfDataMessage(frontend)); }
+void ReaderBackend::FlushEntries() {
+    if ( entry_batch.empty() )
+        return;
 
-void ReaderBackend::SendEntry(Value** vals) { SendOut(new SendEntryMessage(frontend, vals)); }
+    SendOut(new SendEntriesMessage(frontend, std::move(entry_batch)));
+    entry_batch.clear();
+    entry_batch.reserve(entry_batch_size);
+}
 
 bool ReaderBackend::Init(const int arg_num_fields, const threading::Field* const* arg_fields) {
     if ( Failed() )
@@ -198,6 +255,8 @@ bool ReaderBackend::OnFinish(double network_time) {
     if ( ! Failed() )
         DoClose();
 
+    FlushEntries();
+
     disabled = true; // frontend disables itself when it gets the Close-message.
     SendOut(new ReaderClosedMessage(frontend));
 
@@ -232,6 +291,8 @@ void ReaderBackend::DisableFrontend() {
     if ( disabled )
         return;
 
+    FlushEntries();
+
     // We also set disabled here, because there still may be other
     // messages queued and we will dutifully ignore these from now.
     disabled = true;
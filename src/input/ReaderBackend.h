@@ -2,6 +2,8 @@
 
 #pragma once
 
+#include <vector>
+
 #include "zeek/ZeekString.h"
 #include "zeek/input/Component.h"
 #include "zeek/threading/MsgThread.h"
@@ -109,16 +111,33 @@ public:
          */
         ReaderMode mode;
 
+        /**
+         * The number of entries that SendEntry() collects into a single
+         * message to the main thread. This is larger than one only for
+         * table streams with Input::bulk_table_loads set.
+         */
+        size_t entry_batch_size;
+
+        /**
+         * For table streams, the number of leading fields that make up
+         * the table's index. Zero for other streams.
+         */
+        int num_idx_fields;
+
         ReaderInfo() {
             source = nullptr;
             name = nullptr;
             mode = MODE_NONE;
+            entry_batch_size = 1;
+            num_idx_fields = 0;
         }
 
         ReaderInfo(const ReaderInfo& other) {
             source = other.source ? util::copy_string(other.source) : nullptr;
             name = other.name ? util::copy_string(other.name) : nullptr;
             mode = other.mode;
+            entry_batch_size = other.entry_batch_size;
+            num_idx_fields = other.num_idx_fields;
 
             for ( config_map::const_iterator i = other.config.begin(); i != other.config.end(); i++ )
                 config.insert(std::make_pair(util::copy_string(i->first), util::copy_string(i->second)));
@@ -353,6 +372,10 @@ protected:
     void EndCurrentSend();
 
 private:
+    // Sends the entries batched up by SendEntry() with
+    // Input::bulk_table_loads.
+    void FlushEntries();
+
     // Frontend that instantiated us. This object must not be accessed
     // from this class, it's running in a different thread!
     ReaderFrontend* frontend;
@@ -366,6 +389,9 @@ private:
     // it's used to suppress duplicate error messages.
     bool suppress_warnings = false;
     size_t warnings_suppressed = 0;
+
+    std::vector<threading::Value**> entry_batch;
+    size_t entry_batch_size = 1;
 };
 
 } // namespace zeek::input
@@ -2,10 +2,16 @@
 
 #include "zeek/input/readers/ascii/Ascii.h"
 
+#include <fcntl.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
+#include <algorithm>
 #include <cerrno>
+#include <cstring>
+#include <numeric>
+#include <unordered_set>
 
 #include "zeek/input/readers/ascii/ascii.bif.h"
 #include "zeek/threading/SerialTypes.h"
@@ -16,6 +22,32 @@ using zeek::threading::Value;
 
 namespace zeek::input::reader::detail {
 
+namespace {
+
+// Splits a line at each separator into the strings of fields, reusing
+// their storage, and returns the number of fields. Like util::split(), a
+// trailing separator results in an empty last field.
+size_t split_line(string_view line, char separator, vector<string>& fields) {
+    size_t n = 0;
+
+    while ( true ) {
+        const auto* p = static_cast<const char*>(memchr(line.data(), separator, line.size()));
+        size_t len = p ? p - line.data() : line.size();
+
+        if ( n == fields.size() )
+            fields.emplace_back();
+
+        fields[n++].assign(line.data(), len);
+
+        if ( ! p )
+            return n;
+
+        line.remove_prefix(len + 1);
+    }
+}
+
+} // namespace
+
 FieldMapping::FieldMapping(const string& arg_name, const TypeTag& arg_type, int arg_position)
     : name(arg_name), type(arg_type), subtype(TYPE_ERROR) {
     position = arg_position;
@@ -37,6 +69,11 @@ FieldMapping::FieldMapping(const FieldMapping& arg)
     secondary_position = arg.secondary_position;
 }
 
+bool FieldMapping::operator==(const FieldMapping& arg) const {
+    return name == arg.name && type == arg.type && subtype == arg.subtype && present == arg.present &&
+           position == arg.position && secondary_position == arg.secondary_position;
+}
+
 FieldMapping FieldMapping::subType() { return {name, subtype, position}; }
 
 FieldMapping& FieldMapping::operator=(const FieldMapping& arg) {
@@ -58,9 +95,16 @@ Ascii::Ascii(ReaderFrontend* frontend) : ReaderBackend(frontend) {
     ino = 0;
     fail_on_file_problem = false;
     fail_on_invalid_lines = false;
+    use_mmap = false;
+    diff_on_reread = false;
 }
 
-void Ascii::DoClose() { read_location.reset(); }
+Ascii::~Ascii() { CloseFile(); }
+
+void Ascii::DoClose() {
+    CloseFile();
+    read_location.reset();
+}
 
 bool Ascii::DoInit(const ReaderInfo& info, int num_fields, const Field* const* fields) {
     StopWarningSuppression();
@@ -82,6 +126,9 @@ bool Ascii::DoInit(const ReaderInfo& info, int num_fields, const Field* const* f
     path_prefix.assign((const char*)BifConst::InputAscii::path_prefix->Bytes(),
                        BifConst::InputAscii::path_prefix->Len());
 
+    use_mmap = BifConst::InputAscii::use_mmap;
+    diff_on_reread = BifConst::InputAscii::diff_on_reread;
+
     // Set per-filter configuration options.
     for ( const auto& [k, v] : info.config ) {
         if ( strcmp(k, "separator") == 0 )
@@ -101,8 +148,18 @@ bool Ascii::DoInit(const ReaderInfo& info, int num_fields, const Field* const* f
 
         else if ( strcmp(k, "fail_on_file_problem") == 0 )
             fail_on_file_problem = (strncmp(v, "T", 1) == 0);
+
+        else if ( strcmp(k, "use_mmap") == 0 )
+            use_mmap = (strncmp(v, "T", 1) == 0);
+
+        else if ( strcmp(k, "diff_on_reread") == 0 )
+            diff_on_reread = (strncmp(v, "T", 1) == 0);
     }
 
+    // Streamed files are read incrementally anyway.
+    if ( info.mode == MODE_STREAM )
+        diff_on_reread = false;
+
     if ( separator.size() != 1 )
         Error("separator length has to be 1. Separator will be truncated.");
 
@@ -116,7 +173,7 @@ bool Ascii::DoInit(const ReaderInfo& info, int num_fields, const Field* const* f
 }
 
 bool Ascii::OpenFile() {
-    if ( file.is_open() )
+    if ( IsOpen() )
         return true;
 
     // Handle path-prefixing. See similar logic in Binary::DoInit().
@@ -134,18 +191,26 @@ bool Ascii::OpenFile() {
         fname = path + "/" + fname;
     }
 
-    file.open(fname);
+    bool opened;
+
+    if ( use_mmap )
+        opened = MapFile();
+    else {
+        file.open(fname);
+        opened = file.is_open();
+    }
 
-    if ( ! file.is_open() ) {
+    if ( ! opened ) {
         FailWarn(fail_on_file_problem, Fmt("Init: cannot open %s", fname.c_str()), true);
 
+        CloseFile();
         return false;
     }
 
     if ( ReadHeader(false) == false ) {
         FailWarn(fail_on_file_problem, Fmt("Init: cannot open %s; problem reading file header", fname.c_str()), true);
 
-        file.close();
+        CloseFile();
         return false;
     }
 
@@ -158,6 +223,68 @@ bool Ascii::OpenFile() {
     return true;
 }
 
+// Opens the file if needed and maps all of it. For streamed files, this
+// also picks up data appended since the last call.
+bool Ascii::MapFile() {
+    if ( fd < 0 ) {
+        fd = open(fname.c_str(), O_RDONLY | O_CLOEXEC);
+
+        if ( fd < 0 )
+            return false;
+
+        map_pos = 0;
+    }
+
+    struct stat sb;
+    if ( fstat(fd, &sb) != 0 )
+        return false;
+
+    auto size = static_cast<size_t>(sb.st_size);
+
+    if ( map_data && size == map_size )
+        return true;
+
+    if ( map_data )
+        munmap(const_cast<char*>(map_data), map_size);
+
+    map_data = nullptr;
+    map_size = 0;
+
+    // A truncated file starts over.
+    if ( size < map_pos )
+        map_pos = 0;
+
+    if ( size == 0 )
+        return true;
+
+    void* p = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    if ( p == MAP_FAILED )
+        return false;
+
+    madvise(p, size, MADV_SEQUENTIAL);
+
+    map_data = static_cast<const char*>(p);
+    map_size = size;
+    return true;
+}
+
+void Ascii::CloseFile() {
+    if ( file.is_open() )
+        file.close();
+
+    if ( map_data )
+        munmap(const_cast<char*>(map_data), map_size);
+
+    if ( fd >= 0 )
+        close(fd);
+
+    fd = -1;
+    map_data = nullptr;
+    map_size = 0;
+    map_pos = 0;
+}
+
 bool Ascii::ReadHeader(bool useCached) {
     // try to read the header line...
     string line;
@@ -227,8 +354,36 @@ bool Ascii::ReadHeader(bool useCached) {
     return true;
 }
 
+// Returns the next line of the file, without the newline.
+bool Ascii::NextLine(string& str) {
+    if ( fd < 0 )
+        return static_cast<bool>(getline(file, str));
+
+    if ( map_pos >= map_size )
+        return false;
+
+    const char* start = map_data + map_pos;
+    size_t left = map_size - map_pos;
+    const auto* nl = static_cast<const char*>(memchr(start, '\n', left));
+
+    if ( nl ) {
+        str.assign(start, nl - start);
+        map_pos += nl - start + 1;
+        return true;
+    }
+
+    // Leave an unterminated last line of a streamed file until it's
+    // complete.
+    if ( Info().mode == MODE_STREAM )
+        return false;
+
+    str.assign(start, left);
+    map_pos = map_size;
+    return true;
+}
+
 bool Ascii::GetLine(string& str) {
-    while ( getline(file, str) ) {
+    while ( NextLine(str) ) {
         if ( read_location ) {
             read_location->first_line++;
             read_location->last_line++;
@@ -269,7 +424,7 @@ bool Ascii::DoUpdate() {
             if ( stat(fname.c_str(), &sb) == -1 ) {
                 FailWarn(fail_on_file_problem, Fmt("Could not get stat for %s", fname.c_str()), true);
 
-                file.close();
+                CloseFile();
                 return ! fail_on_file_problem;
             }
 
@@ -292,9 +447,13 @@ bool Ascii::DoUpdate() {
         case MODE_STREAM: {
             // dirty, fix me. (well, apparently after trying seeking, etc
             // - this is not that bad)
-            if ( file.is_open() ) {
+            if ( IsOpen() ) {
                 if ( Info().mode == MODE_STREAM ) {
-                    file.clear(); // remove end of file evil bits
+                    if ( fd >= 0 )
+                        MapFile(); // pick up appended data
+                    else
+                        file.clear(); // remove end of file evil bits
+
                     if ( ! ReadHeader(true) ) {
                         return ! fail_on_file_problem; // header reading failed
                     }
@@ -302,7 +461,7 @@ bool Ascii::DoUpdate() {
                     break;
                 }
 
-                file.close();
+                CloseFile();
             }
 
             OpenFile();
@@ -315,100 +474,299 @@ bool Ascii::DoUpdate() {
 
     string line;
 
-    file.sync();
+    if ( file.is_open() )
+        file.sync();
+
+    Snapshot current;
+    bool diff = diff_on_reread && Info().mode != MODE_STREAM;
 
     while ( GetLine(line) ) {
-        // split on tabs
-        bool error = false;
-        auto stringfields = util::split(line, separator[0]);
-
-        // This needs to be a signed value or the comparisons below will fail.
-        int pos = static_cast<int>(stringfields.size() - 1);
-
-        Value** fields = new Value*[NumFields()];
-
-        int fpos = 0;
-        for ( const auto& fit : columnMap ) {
-            if ( ! fit.present ) {
-                // add non-present field
-                fields[fpos] = new Value(fit.type, false);
-                if ( read_location )
-                    fields[fpos]->SetFileLineNumber(read_location->first_line);
-                fpos++;
-                continue;
-            }
+        if ( diff ) {
+            // Only record the line here. Parsing is left to SendChanges(),
+            // for the lines that changed.
+            int line_number = read_location ? read_location->first_line : 0;
+            current.lines.push_back(
+                {std::hash<string_view>{}(line), current.data.size(), line.size(), line_number, true});
+            current.data.append(line);
+            continue;
+        }
 
-            assert(fit.position >= 0);
+        bool fatal = false;
+        Value** fields = ParseLine(line, columnMap, fatal);
 
-            if ( fit.position > pos || fit.secondary_position > pos ) {
-                FailWarn(fail_on_invalid_lines,
-                         Fmt("Not enough fields in line '%s' of %s. Found "
-                             "%d fields, want positions %d and %d",
-                             line.c_str(), fname.c_str(), pos, fit.position, fit.secondary_position),
-                         ! fail_on_invalid_lines);
+        if ( ! fields ) {
+            if ( fatal )
+                return false;
 
-                if ( fail_on_invalid_lines ) {
-                    for ( int i = 0; i < fpos; i++ )
-                        delete fields[i];
+            continue;
+        }
 
-                    delete[] fields;
+        // If there's no error, then it makes sense to report the next error.
+        StopWarningSuppression();
 
-                    return false;
-                }
-                else {
-                    error = true;
-                    break;
-                }
-            }
+        if ( Info().mode == MODE_STREAM )
+            Put(fields);
+        else
+            SendEntry(fields);
+    }
 
-            Value* val = formatter->ParseValue(stringfields[fit.position], fit.name, fit.type, fit.subtype);
-            if ( ! val ) {
-                Warning(Fmt("Could not convert line '%s' of %s to Val. Ignoring line.", line.c_str(), fname.c_str()));
-                error = true;
-                break;
-            }
+    if ( diff ) {
+        current.columns = columnMap;
 
-            if ( read_location )
-                val->SetFileLineNumber(read_location->first_line);
+        if ( ! SendChanges(std::move(current)) )
+            return false;
+    }
 
-            if ( fit.secondary_position != -1 ) {
-                // we have a port definition :)
-                assert(val->type == TYPE_PORT);
-                val->val.port_val.proto = formatter->ParseProto(stringfields[fit.secondary_position]);
-            }
+    else if ( Info().mode != MODE_STREAM )
+        EndCurrentSend();
 
-            fields[fpos] = val;
+    StopWarningSuppression();
+    return true;
+}
+
+Value** Ascii::ParseLine(const string& line, const vector<FieldMapping>& columns, bool& fatal) {
+    // split on tabs
+    size_t num_stringfields = split_line(line, separator[0], split_fields);
+    const auto& stringfields = split_fields;
 
+    // This needs to be a signed value or the comparisons below will fail.
+    int pos = static_cast<int>(num_stringfields - 1);
+
+    Value** fields = new Value*[NumFields()];
+
+    int fpos = 0;
+    for ( const auto& fit : columns ) {
+        if ( ! fit.present ) {
+            // add non-present field
+            fields[fpos] = new Value(fit.type, false);
+            if ( read_location )
+                fields[fpos]->SetFileLineNumber(read_location->first_line);
             fpos++;
+            continue;
         }
 
-        if ( error ) {
-            // Encountered non-fatal error, ignoring line. But
-            // first, delete all successfully read fields and the
-            // array structure.
+        assert(fit.position >= 0);
+
+        if ( fit.position > pos || fit.secondary_position > pos ) {
+            FailWarn(fail_on_invalid_lines,
+                     Fmt("Not enough fields in line '%s' of %s. Found "
+                         "%d fields, want positions %d and %d",
+                         line.c_str(), fname.c_str(), pos, fit.position, fit.secondary_position),
+                     ! fail_on_invalid_lines);
 
-            for ( int i = 0; i < fpos; i++ )
-                delete fields[i];
+            fatal = fail_on_invalid_lines;
+            break;
+        }
 
-            delete[] fields;
+        Value* val = formatter->ParseValue(stringfields[fit.position], fit.name, fit.type, fit.subtype);
+        if ( ! val ) {
+            Warning(Fmt("Could not convert line '%s' of %s to Val. Ignoring line.", line.c_str(), fname.c_str()));
+            break;
+        }
+
+        if ( read_location )
+            val->SetFileLineNumber(read_location->first_line);
+
+        if ( fit.secondary_position != -1 ) {
+            // we have a port definition :)
+            assert(val->type == TYPE_PORT);
+            val->val.port_val.proto = formatter->ParseProto(stringfields[fit.secondary_position]);
+        }
+
+        fields[fpos] = val;
+
+        fpos++;
+    }
+
+    if ( fpos < NumFields() ) {
+        // Encountered an error, ignoring line. But first, delete all
+        // successfully read fields and the array structure.
+        for ( int i = 0; i < fpos; i++ )
+            delete fields[i];
+
+        delete[] fields;
+        return nullptr;
+    }
+
+    assert(fpos == NumFields());
+    return fields;
+}
+
+// Returns the text of a table stream's index fields in the line that
+// ParseLine() just parsed. Empty for other streams.
+string Ascii::IndexKey(const vector<FieldMapping>& columns) const {
+    string key;
+
+    for ( int i = 0; i < Info().num_idx_fields; ++i ) {
+        const auto& fit = columns[i];
+
+        if ( ! fit.present )
             continue;
+
+        key += split_fields[fit.position];
+        key += separator[0];
+
+        if ( fit.secondary_position != -1 ) {
+            key += split_fields[fit.secondary_position];
+            key += separator[0];
         }
-        // If there's no error, then it makes sense to report the next error.
-        else
-            StopWarningSuppression();
+    }
 
-        assert(fpos == NumFields());
+    return key;
+}
 
-        if ( Info().mode == MODE_STREAM )
+// Compares the lines read with those of the previous read. New lines are
+// put, which the manager reports as changes for indices it already has.
+// Entries are only deleted if no line provides their index anymore. Lines
+// present in both reads aren't parsed at all.
+bool Ascii::SendChanges(Snapshot&& current) {
+    if ( previous.columns != current.columns )
+        // The header changed, so unchanged lines may now map to different
+        // fields. Send everything like a read without diff_on_reread.
+        return SendAll(std::move(current));
+
+    auto sorted = [](const Snapshot& s) {
+        vector<size_t> order(s.lines.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [&s](size_t a, size_t b) {
+            const auto& la = s.lines[a];
+            const auto& lb = s.lines[b];
+            if ( la.hash != lb.hash )
+                return la.hash < lb.hash;
+
+            return s.Text(la) < s.Text(lb);
+        });
+
+        return order;
+    };
+
+    auto prev_order = sorted(previous);
+    auto cur_order = sorted(current);
+
+    vector<size_t> removed;
+    vector<size_t> added;
+    size_t i = 0;
+    size_t j = 0;
+
+    while ( i < prev_order.size() || j < cur_order.size() ) {
+        if ( j == cur_order.size() ) {
+            removed.push_back(prev_order[i++]);
+            continue;
+        }
+
+        if ( i == prev_order.size() ) {
+            added.push_back(cur_order[j++]);
+            continue;
+        }
+
+        auto& p = previous.lines[prev_order[i]];
+        auto& c = current.lines[cur_order[j]];
+
+        if ( p.hash < c.hash || (p.hash == c.hash && previous.Text(p) < current.Text(c)) )
+            removed.push_back(prev_order[i++]);
+
+        else if ( c.hash < p.hash || previous.Text(p) != current.Text(c) )
+            added.push_back(cur_order[j++]);
+
+        else {
+            // Unchanged.
+            c.valid = p.valid;
+            c.key = std::move(p.key);
+            ++i;
+            ++j;
+        }
+    }
+
+    // Send changes in file order.
+    std::sort(removed.begin(), removed.end());
+    std::sort(added.begin(), added.end());
+
+    string line;
+
+    for ( auto idx : added ) {
+        auto& l = current.lines[idx];
+
+        if ( read_location )
+            read_location->first_line = read_location->last_line = l.line_number;
+
+        line = current.Text(l);
+        bool fatal = false;
+
+        if ( auto* fields = ParseLine(line, current.columns, fatal) ) {
+            l.key = IndexKey(current.columns);
+            StopWarningSuppression();
             Put(fields);
-        else
-            SendEntry(fields);
+            continue;
+        }
+
+        if ( fatal )
+            return false;
+
+        l.valid = false;
     }
 
-    if ( Info().mode != MODE_STREAM )
-        EndCurrentSend();
+    // The indices that the new read still provides. Event streams don't
+    // have any, each of their removed lines is deleted.
+    bool is_table = Info().num_idx_fields > 0;
+    std::unordered_set<string_view> keys;
 
-    StopWarningSuppression();
+    if ( is_table )
+        for ( const auto& l : current.lines )
+            if ( l.valid )
+                keys.insert(l.key);
+
+    for ( auto idx : removed ) {
+        const auto& l = previous.lines[idx];
+
+        if ( ! l.valid )
+            continue;
+
+        // Inserting the key also keeps us from deleting it twice.
+        if ( is_table && ! keys.insert(l.key).second )
+            continue;
+
+        if ( read_location )
+            read_location->first_line = read_location->last_line = l.line_number;
+
+        line = previous.Text(l);
+        bool fatal = false;
+
+        if ( auto* fields = ParseLine(line, previous.columns, fatal) )
+            Delete(fields);
+        else if ( fatal )
+            return false;
+    }
+
+    previous = std::move(current);
+    EndOfData();
+    return true;
+}
+
+bool Ascii::SendAll(Snapshot&& current) {
+    string line;
+
+    for ( auto& l : current.lines ) {
+        if ( read_location )
+            read_location->first_line = read_location->last_line = l.line_number;
+
+        line = current.Text(l);
+        bool fatal = false;
+
+        if ( auto* fields = ParseLine(line, current.columns, fatal) ) {
+            l.key = IndexKey(current.columns);
+            StopWarningSuppression();
+            SendEntry(fields);
+            continue;
+        }
+
+        if ( fatal )
+            return false;
+
+        l.valid = false;
+    }
+
+    previous = std::move(current);
+    EndCurrentSend();
     return true;
 }
 
@@ -6,6 +6,7 @@
 #include <fstream>
 #include <iostream>
 #include <memory>
+#include <string_view>
 #include <vector>
 
 #include "zeek/Obj.h"
@@ -30,6 +31,8 @@ struct FieldMapping {
     FieldMapping() = default;
 
     FieldMapping& operator=(const FieldMapping& arg);
+    bool operator==(const FieldMapping& arg) const;
+    bool operator!=(const FieldMapping& arg) const { return ! (*this == arg); }
 
     FieldMapping subType();
 };
@@ -40,7 +43,7 @@ struct FieldMapping {
 class Ascii : public ReaderBackend {
 public:
     explicit Ascii(ReaderFrontend* frontend);
-    ~Ascii() override = default;
+    ~Ascii() override;
 
     // prohibit copying and moving
     Ascii(const Ascii&) = delete;
@@ -59,14 +62,51 @@ protected:
     const zeek::detail::Location* GetLocationInfo() const override { return read_location.get(); }
 
 private:
+    // The data lines of the last read, for diff_on_reread.
+    struct Snapshot {
+        struct Line {
+            size_t hash;
+            size_t offset; // Into data.
+            size_t len;
+            int line_number;
+            bool valid;      // False if the line failed to parse.
+            std::string key; // Text of the index fields, for valid lines.
+        };
+
+        std::string data;
+        std::vector<Line> lines; // In file order.
+        std::vector<FieldMapping> columns;
+
+        std::string_view Text(const Line& l) const { return {data.data() + l.offset, l.len}; }
+    };
+
     bool ReadHeader(bool useCached);
     bool GetLine(std::string& str);
+    bool NextLine(std::string& str);
     bool OpenFile();
+    bool MapFile();
+    void CloseFile();
+    bool IsOpen() const { return file.is_open() || fd >= 0; }
+    threading::Value** ParseLine(const std::string& line, const std::vector<FieldMapping>& columns, bool& fatal);
+    std::string IndexKey(const std::vector<FieldMapping>& columns) const;
+    bool SendChanges(Snapshot&& current);
+    bool SendAll(Snapshot&& current);
 
     std::ifstream file;
     time_t mtime;
     ino_t ino;
 
+    // With use_mmap, the file is read through a mapping instead of file.
+    int fd = -1;
+    const char* map_data = nullptr;
+    size_t map_size = 0;
+    size_t map_pos = 0;
+
+    // Reused for splitting lines into fields.
+    std::vector<std::string> split_fields;
+
+    Snapshot previous;
+
     // The name using which we actually load the file -- compared
     // to the input source name, this one may have a path_prefix
     // attached to it.
@@ -86,6 +126,8 @@ private:
     bool fail_on_invalid_lines;
     bool fail_on_file_problem;
     std::string path_prefix;
+    bool use_mmap;
+    bool diff_on_reread;
 
     std::unique_ptr<threading::Formatter> formatter;
 
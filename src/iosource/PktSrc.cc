@@ -3,6 +3,7 @@
 #include "zeek/iosource/PktSrc.h"
 
 #include <sys/stat.h>
+#include <algorithm>
 
 #include "zeek/DebugLogger.h"
 #include "zeek/RunState.h"
@@ -110,6 +111,14 @@ void PktSrc::Process() {
     if ( ! IsOpen() )
         return;
 
+    // Pseudo-realtime mode needs to look at the next packet ahead of
+    // processing it, see GetNextTimeout(), so it sticks to single packets.
+    if ( batch_pos < batch_len || (BifConst::Pcap::packet_batch_size > 1 && SupportsBatches() && ! have_packet &&
+                                   run_state::pseudo_realtime == 0.0) ) {
+        ProcessBatch();
+        return;
+    }
+
     if ( ! ExtractNextPacketInternal() )
         return;
 
@@ -119,6 +128,78 @@ void PktSrc::Process() {
     DoneWithPacket();
 }
 
+static inline void prefetch(const void* p) {
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_prefetch(p);
+#endif
+}
+
+void PktSrc::ProcessBatch() {
+    if ( batch_pos == batch_len ) {
+        if ( run_state::is_processing_suspended() )
+            return;
+
+        if ( ! batch ) {
+            batch_capacity = BifConst::Pcap::packet_batch_size;
+            batch = std::make_unique<Packet[]>(batch_capacity);
+        }
+
+        batch_len = ExtractNextPackets(batch.get(), batch_capacity);
+        batch_pos = 0;
+
+        if ( batch_len == 0 ) {
+            MarkIdle();
+            return;
+        }
+
+        had_packet = true;
+        ++batch_stats.batches;
+        batch_stats.packets += batch_len;
+        batch_stats.max_size = std::max(batch_stats.max_size, static_cast<uint64_t>(batch_len));
+    }
+
+    while ( batch_pos < batch_len ) {
+        // If a packet's events suspended processing, the rest of the
+        // batch waits until it's resumed.
+        if ( run_state::is_processing_suspended() )
+            return;
+
+        // Pull in the headers of the next packet while analyzing this one.
+        if ( batch_pos + 1 < batch_len )
+            prefetch(batch[batch_pos + 1].data);
+
+        Packet* pkt = &batch[batch_pos];
+
+        if ( pkt->time < 0 )
+            Weird("negative_packet_timestamp", pkt);
+        else
+            run_state::detail::dispatch_packet(pkt, this);
+
+        ++batch_pos;
+
+        if ( ! IsOpen() ) {
+            // Closed while processing, there's nothing to hand back anymore.
+            batch_pos = batch_len = 0;
+            return;
+        }
+    }
+
+    DoneWithPackets(batch_len);
+    batch_pos = batch_len = 0;
+}
+
+size_t PktSrc::ExtractNextPackets(Packet* pkts, size_t max) {
+    if ( max == 0 || ! ExtractNextPacket(&pkts[0]) )
+        return 0;
+
+    return 1;
+}
+
+void PktSrc::DoneWithPackets(size_t n) {
+    for ( size_t i = 0; i < n; ++i )
+        DoneWithPacket();
+}
+
 const char* PktSrc::Tag() { return "PktSrc"; }
 
 bool PktSrc::ExtractNextPacketInternal() {
@@ -142,20 +223,8 @@ bool PktSrc::ExtractNextPacketInternal() {
         have_packet = true;
         return true;
     }
-    else {
-        // Update the idle_at timestamp the first time we've failed
-        // to extract a packet. This assumes ExtractNextPacket() is
-        // called regularly which is true for non-selectable PktSrc
-        // instances, but even for selectable ones with an FD the
-        // main-loop will call Process() on the interface regularly
-        // and detect it as idle.
-        if ( had_packet ) {
-            DBG_LOG(DBG_PKTIO, "source %s is idle now", props.path.c_str());
-            idle_at_wallclock = zeek::util::current_time(true);
-        }
-
-        had_packet = false;
-    }
+    else
+        MarkIdle();
 
     return false;
 }
@@ -218,7 +287,27 @@ bool PktSrc::ApplyBPFFilter(int index, const struct pcap_pkthdr* hdr, const u_ch
     return pcap_offline_filter(code->GetProgram(), hdr, pkt);
 }
 
+void PktSrc::MarkIdle() {
+    // Update the idle_at timestamp the first time we've failed
+    // to extract a packet. This assumes ExtractNextPacket() is
+    // called regularly which is true for non-selectable PktSrc
+    // instances, but even for selectable ones with an FD the
+    // main-loop will call Process() on the interface regularly
+    // and detect it as idle.
+    if ( had_packet ) {
+        DBG_LOG(DBG_PKTIO, "source %s is idle now", props.path.c_str());
+        idle_at_wallclock = zeek::util::current_time(true);
+    }
+
+    had_packet = false;
+}
+
 bool PktSrc::GetCurrentPacket(const Packet** pkt) {
+    if ( batch_pos < batch_len ) {
+        *pkt = &batch[batch_pos];
+        return true;
+    }
+
     if ( ! have_packet )
         return false;
 
@@ -230,6 +319,10 @@ double PktSrc::GetNextTimeout() {
     if ( run_state::is_processing_suspended() )
         return -1;
 
+    // Rest of a batch left over from before processing got suspended.
+    if ( batch_pos < batch_len )
+        return 0.0;
+
     // If we're in pseudo-realtime mode, find the next time that a packet is ready
     // and have poll block until then.
     if ( run_state::pseudo_realtime ) {
@@ -3,6 +3,7 @@
 #pragma once
 
 #include <sys/types.h> // for u_char
+#include <memory>
 #include <optional>
 #include <vector>
 
@@ -52,6 +53,26 @@ public:
         std::optional<uint64_t> filtered;
     };
 
+    /**
+     * Struct for returning statistics on batched packet extraction.
+     */
+    struct BatchStats {
+        /**
+         * Number of batches extracted.
+         */
+        uint64_t batches = 0;
+
+        /**
+         * Number of packets extracted in batches.
+         */
+        uint64_t packets = 0;
+
+        /**
+         * Size of the largest batch.
+         */
+        uint64_t max_size = 0;
+    };
+
     /**
      * Constructor.
      */
@@ -168,6 +189,12 @@ public:
      */
     bool GetCurrentPacket(const Packet** hdr);
 
+    /**
+     * Returns statistics on the batches of packets extracted from the
+     * source. See \a ExtractNextPackets().
+     */
+    const BatchStats& GetBatchStats() const { return batch_stats; }
+
     // PacketSource interface for derived classes to override.
 
     /**
@@ -350,6 +377,40 @@ protected:
      */
     virtual void DoneWithPacket() = 0;
 
+    /**
+     * Returns true if the source implements \a ExtractNextPackets() to
+     * provide more than one packet at a time. Only then does \a Process()
+     * extract packets in batches.
+     */
+    virtual bool SupportsBatches() const { return false; }
+
+    /**
+     * Provides up to \a max packets from the source at once, so that
+     * sources can amortize the cost of fetching them. Unlike with \a
+     * ExtractNextPacket(), the data of all packets in the batch must
+     * stay available until \a DoneWithPackets() is called. Sources
+     * overriding this must also override \a SupportsBatches().
+     *
+     * The default implementation provides a single packet through \a
+     * ExtractNextPacket(), for sources that can't guarantee that.
+     *
+     * @param pkts An array of at least \a max packet structures to fill in.
+     *
+     * @param max The maximum number of packets to provide.
+     *
+     * @return The number of packets filled in, zero if none is available
+     * or an error occurred (which must be flagged via Error()).
+     */
+    virtual size_t ExtractNextPackets(Packet* pkts, size_t max);
+
+    /**
+     * Signals that the data of all packets of the previously extracted
+     * batch will no longer be needed.
+     *
+     * @param n The number of packets in the batch.
+     */
+    virtual void DoneWithPackets(size_t n);
+
     /**
      * Performs the actual filter compilation. This can be overridden to
      * provide a different implementation of the compilation called by
@@ -366,6 +427,12 @@ private:
     // Internal helper for ExtractNextPacket().
     bool ExtractNextPacketInternal();
 
+    // Internal helper for Process() when extracting batches of packets.
+    void ProcessBatch();
+
+    // Internal helper to track when the source went idle.
+    void MarkIdle();
+
     // IOSource interface implementation.
     void InitSource() override;
     void Done() override;
@@ -381,6 +448,13 @@ private:
 
     double idle_at_wallclock = 0.0;
 
+    // The current batch of packets, and the next one to process from it.
+    std::unique_ptr<Packet[]> batch;
+    size_t batch_capacity = 0;
+    size_t batch_len = 0;
+    size_t batch_pos = 0;
+    BatchStats batch_stats;
+
     // For BPF filtering support.
     std::vector<detail::BPF_Program*> filters;
 
@@ -0,0 +1,23 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek/plugin/Plugin.h"
+
+#include "zeek/iosource/Component.h"
+#include "zeek/iosource/af_packet/Source.h"
+
+namespace zeek::plugin::detail::Zeek_AF_Packet {
+
+class Plugin : public plugin::Plugin {
+public:
+    plugin::Configuration Configure() override {
+        AddComponent(new iosource::PktSrcComponent("AF_PacketReader", "af_packet", iosource::PktSrcComponent::LIVE,
+                                                   iosource::af_packet::AF_PacketSource::Instantiate));
+
+        plugin::Configuration config;
+        config.name = "Zeek::AF_Packet";
+        config.description = "Packet acquisition via AF_Packet";
+        return config;
+    }
+} plugin;
+
+} // namespace zeek::plugin::detail::Zeek_AF_Packet
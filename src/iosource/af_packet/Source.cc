@@ -0,0 +1,453 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek/iosource/af_packet/Source.h"
+
+#include "zeek/zeek-config.h"
+
+#include <arpa/inet.h>
+#include <linux/bpf.h>
+#include <linux/filter.h>
+#include <linux/if_ether.h>
+#include <linux/net_tstamp.h>
+#include <linux/sockios.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include "zeek/ID.h"
+#include "zeek/Reporter.h"
+#include "zeek/Val.h"
+#include "zeek/iosource/BPF_Program.h"
+#include "zeek/iosource/Packet.h"
+
+namespace zeek::iosource::af_packet {
+
+AF_PacketSource::~AF_PacketSource() { Close(); }
+
+AF_PacketSource::AF_PacketSource(const std::string& path, bool is_live) {
+    props.path = path;
+    props.is_live = is_live;
+}
+
+void AF_PacketSource::Open() {
+    if ( ! props.is_live ) {
+        Error("AF_PACKET sources can only capture live");
+        return;
+    }
+
+    static auto checksum_mode_type = id::find_type<EnumType>("AF_Packet::ChecksumMode");
+    auto mode = id::find_val<EnumVal>("AF_Packet::checksum_validation_mode")->AsEnum();
+
+    if ( mode == checksum_mode_type->Lookup("AF_Packet::CHECKSUM_OFF") )
+        checksum_mode = CHECKSUM_OFF;
+    else if ( mode == checksum_mode_type->Lookup("AF_Packet::CHECKSUM_KERNEL") )
+        checksum_mode = CHECKSUM_KERNEL;
+    else
+        checksum_mode = CHECKSUM_ON;
+
+    socket_fd = socket(AF_PACKET, SOCK_RAW, htons(ETH_P_ALL));
+
+    if ( socket_fd < 0 ) {
+        Error(util::fmt("AF_PACKET: cannot open socket: %s", strerror(errno)));
+        return;
+    }
+
+    if ( ! BindInterface() || ! EnablePromiscMode() )
+        return;
+
+    if ( id::find_val("AF_Packet::enable_hw_timestamping")->AsBool() && ! EnableHWTimestamping() )
+        return;
+
+    if ( ! SetupRing() )
+        return;
+
+    if ( id::find_val("AF_Packet::enable_fanout")->AsBool() && ! JoinFanoutGroup() )
+        return;
+
+    props.selectable_fd = socket_fd;
+    props.link_type = id::find_val("AF_Packet::link_type")->AsCount();
+    props.netmask = NETMASK_UNKNOWN;
+    props.is_live = true;
+
+    Opened(props);
+}
+
+bool AF_PacketSource::BindInterface() {
+    if_index = if_nametoindex(props.path.c_str());
+
+    if ( if_index == 0 ) {
+        Error(util::fmt("AF_PACKET: unknown interface %s", props.path.c_str()));
+        Close();
+        return false;
+    }
+
+    struct sockaddr_ll addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sll_family = AF_PACKET;
+    addr.sll_protocol = htons(ETH_P_ALL);
+    addr.sll_ifindex = if_index;
+
+    if ( bind(socket_fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) < 0 ) {
+        SocketError("bind");
+        return false;
+    }
+
+    return true;
+}
+
+bool AF_PacketSource::EnablePromiscMode() {
+    struct packet_mreq mreq;
+    memset(&mreq, 0, sizeof(mreq));
+    mreq.mr_ifindex = if_index;
+    mreq.mr_type = PACKET_MR_PROMISC;
+
+    if ( setsockopt(socket_fd, SOL_PACKET, PACKET_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) < 0 ) {
+        SocketError("PACKET_ADD_MEMBERSHIP");
+        return false;
+    }
+
+    return true;
+}
+
+bool AF_PacketSource::EnableHWTimestamping() {
+    struct hwtstamp_config config;
+    memset(&config, 0, sizeof(config));
+    config.tx_type = HWTSTAMP_TX_OFF;
+    config.rx_filter = HWTSTAMP_FILTER_ALL;
+
+    struct ifreq ifr;
+    memset(&ifr, 0, sizeof(ifr));
+    snprintf(ifr.ifr_name, sizeof(ifr.ifr_name), "%s", props.path.c_str());
+    ifr.ifr_data = reinterpret_cast<char*>(&config);
+
+    if ( ioctl(socket_fd, SIOCSHWTSTAMP, &ifr) < 0 ) {
+        SocketError("SIOCSHWTSTAMP");
+        return false;
+    }
+
+    int opt = SOF_TIMESTAMPING_RAW_HARDWARE;
+
+    if ( setsockopt(socket_fd, SOL_PACKET, PACKET_TIMESTAMP, &opt, sizeof(opt)) < 0 ) {
+        SocketError("PACKET_TIMESTAMP");
+        return false;
+    }
+
+    return true;
+}
+
+bool AF_PacketSource::SetupRing() {
+    int version = TPACKET_V3;
+
+    if ( setsockopt(socket_fd, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) < 0 ) {
+        SocketError("PACKET_VERSION");
+        return false;
+    }
+
+    // Blocks must be a multiple of the page size. The kernel also limits
+    // the number of pages per block, failing the setsockopt() below.
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    block_size = id::find_val("AF_Packet::block_size")->AsCount();
+    block_size = (block_size + page_size - 1) / page_size * page_size;
+
+    auto buffer_size = id::find_val("AF_Packet::buffer_size")->AsCount();
+    num_blocks = buffer_size / block_size;
+
+    if ( num_blocks == 0 )
+        num_blocks = 1;
+
+    // With TPACKET_V3, frames are variable-sized within a block and
+    // tp_frame_size only serves to sanity check the ring geometry.
+    constexpr unsigned int frame_size = TPACKET_ALIGNMENT << 7;
+
+    struct tpacket_req3 req;
+    memset(&req, 0, sizeof(req));
+    req.tp_block_size = block_size;
+    req.tp_block_nr = num_blocks;
+    req.tp_frame_size = frame_size;
+    req.tp_frame_nr = (block_size / frame_size) * num_blocks;
+    req.tp_retire_blk_tov = static_cast<unsigned int>(id::find_val("AF_Packet::block_timeout")->AsInterval() * 1e3);
+    req.tp_feature_req_word = 0;
+
+    if ( setsockopt(socket_fd, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req)) < 0 ) {
+        SocketError("PACKET_RX_RING");
+        return false;
+    }
+
+    ring_size = block_size * num_blocks;
+    void* mem = mmap(nullptr, ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_LOCKED | MAP_POPULATE, socket_fd, 0);
+
+    if ( mem == MAP_FAILED ) {
+        // Retry without locking the ring into memory, which fails
+        // when beyond RLIMIT_MEMLOCK.
+        mem = mmap(nullptr, ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, socket_fd, 0);
+
+        if ( mem == MAP_FAILED ) {
+            ring_size = 0;
+            SocketError("mmap");
+            return false;
+        }
+    }
+
+    ring = static_cast<uint8_t*>(mem);
+    block_idx = 0;
+    current_block = nullptr;
+    current_packet = nullptr;
+    packets_left = 0;
+    return true;
+}
+
+bool AF_PacketSource::JoinFanoutGroup() {
+    static auto fanout_mode_type = id::find_type<EnumType>("AF_Packet::FanoutMode");
+    auto mode = id::find_val<EnumVal>("AF_Packet::fanout_mode")->AsEnum();
+
+    uint32_t fanout_type = PACKET_FANOUT_HASH;
+
+    if ( mode == fanout_mode_type->Lookup("AF_Packet::FANOUT_LB") )
+        fanout_type = PACKET_FANOUT_LB;
+    else if ( mode == fanout_mode_type->Lookup("AF_Packet::FANOUT_CPU") )
+        fanout_type = PACKET_FANOUT_CPU;
+    else if ( mode == fanout_mode_type->Lookup("AF_Packet::FANOUT_QM") )
+        fanout_type = PACKET_FANOUT_QM;
+    else if ( mode == fanout_mode_type->Lookup("AF_Packet::FANOUT_EBPF") )
+        fanout_type = PACKET_FANOUT_EBPF;
+
+    if ( id::find_val("AF_Packet::enable_defrag")->AsBool() )
+        fanout_type |= PACKET_FANOUT_FLAG_DEFRAG;
+
+    uint32_t fanout_id = id::find_val("AF_Packet::fanout_id")->AsCount();
+    uint32_t fanout_arg = (fanout_id & 0xffff) | (fanout_type << 16);
+
+    if ( setsockopt(socket_fd, SOL_PACKET, PACKET_FANOUT, &fanout_arg, sizeof(fanout_arg)) < 0 ) {
+        SocketError("PACKET_FANOUT");
+        return false;
+    }
+
+    if ( (fanout_type & 0xff) != PACKET_FANOUT_EBPF )
+        return true;
+
+    // The steering program is expected to be loaded and pinned by
+    // whatever sets up the cluster, e.g. with bpftool.
+    auto path = id::find_val("AF_Packet::fanout_ebpf_program")->AsStringVal()->ToStdString();
+
+    union bpf_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.pathname = reinterpret_cast<uint64_t>(path.c_str());
+
+    int prog_fd = syscall(__NR_bpf, BPF_OBJ_GET, &attr, sizeof(attr));
+
+    if ( prog_fd < 0 ) {
+        Error(util::fmt("AF_PACKET: cannot get eBPF fanout program '%s': %s", path.c_str(), strerror(errno)));
+        Close();
+        return false;
+    }
+
+    int rc = setsockopt(socket_fd, SOL_PACKET, PACKET_FANOUT_DATA, &prog_fd, sizeof(prog_fd));
+    close(prog_fd);
+
+    if ( rc < 0 ) {
+        SocketError("PACKET_FANOUT_DATA");
+        return false;
+    }
+
+    return true;
+}
+
+void AF_PacketSource::Close() {
+    if ( socket_fd < 0 )
+        return;
+
+    if ( ring ) {
+        munmap(ring, ring_size);
+        ring = nullptr;
+        ring_size = 0;
+    }
+
+    current_block = nullptr;
+    current_packet = nullptr;
+    packets_left = 0;
+
+    close(socket_fd);
+    socket_fd = -1;
+
+    // Open() may have failed before it got to call Opened().
+    if ( IsOpen() )
+        Closed();
+}
+
+bool AF_PacketSource::AcquireBlock() {
+    if ( current_block )
+        return true;
+
+    auto* block = BlockAt(block_idx);
+
+    if ( (__atomic_load_n(&block->hdr.bh1.block_status, __ATOMIC_ACQUIRE) & TP_STATUS_USER) == 0 )
+        // Nothing retired by the kernel yet.
+        return false;
+
+    current_block = block;
+    packets_left = block->hdr.bh1.num_pkts;
+    current_packet =
+        reinterpret_cast<tpacket3_hdr*>(reinterpret_cast<uint8_t*>(block) + block->hdr.bh1.offset_to_first_pkt);
+
+    if ( packets_left == 0 ) {
+        ReleaseBlock();
+        return false;
+    }
+
+    return true;
+}
+
+void AF_PacketSource::InitPacket(Packet* pkt, const tpacket3_hdr* hdr) {
+    const u_char* data = reinterpret_cast<const u_char*>(hdr) + hdr->tp_mac;
+
+    pkt_timeval ts = {static_cast<time_t>(hdr->tp_sec), static_cast<suseconds_t>(hdr->tp_nsec / 1000)};
+    pkt->Init(props.link_type, &ts, hdr->tp_snaplen, hdr->tp_len, data);
+
+    // The kernel strips the outer VLAN tag, passing it alongside instead.
+    if ( hdr->tp_status & TP_STATUS_VLAN_VALID )
+        pkt->vlan = hdr->hv1.tp_vlan_tci & 0x0fff;
+
+    switch ( checksum_mode ) {
+        case CHECKSUM_ON: break;
+
+        case CHECKSUM_OFF:
+            pkt->l3_checksummed = true;
+            pkt->l4_checksummed = true;
+            break;
+
+        case CHECKSUM_KERNEL:
+            // Either verified by the NIC, or locally generated with the
+            // checksum left for the NIC to fill in.
+            if ( hdr->tp_status & (TP_STATUS_CSUM_VALID | TP_STATUS_CSUMNOTREADY) )
+                pkt->l4_checksummed = true;
+            break;
+    }
+
+    ++stats.received;
+    stats.bytes_received += hdr->tp_len;
+}
+
+bool AF_PacketSource::ExtractNextPacket(Packet* pkt) {
+    if ( ! ring || ! AcquireBlock() )
+        return false;
+
+    InitPacket(pkt, current_packet);
+    return true;
+}
+
+void AF_PacketSource::DoneWithPacket() {
+    if ( ! current_block )
+        return;
+
+    if ( --packets_left == 0 ) {
+        ReleaseBlock();
+        return;
+    }
+
+    current_packet = NextPacket(current_packet);
+}
+
+size_t AF_PacketSource::ExtractNextPackets(Packet* pkts, size_t max) {
+    if ( ! ring || ! AcquireBlock() )
+        return 0;
+
+    // A batch never spans blocks, as the block can only go back to the
+    // kernel once all of its packets are done with.
+    size_t n = std::min(max, static_cast<size_t>(packets_left));
+    auto* hdr = current_packet;
+
+    for ( size_t i = 0; i < n; ++i ) {
+        InitPacket(&pkts[i], hdr);
+        hdr = NextPacket(hdr);
+    }
+
+    return n;
+}
+
+void AF_PacketSource::DoneWithPackets(size_t n) {
+    if ( ! current_block )
+        return;
+
+    if ( n >= packets_left ) {
+        ReleaseBlock();
+        return;
+    }
+
+    packets_left -= n;
+
+    for ( size_t i = 0; i < n; ++i )
+        current_packet = NextPacket(current_packet);
+}
+
+void AF_PacketSource::ReleaseBlock() {
+    __atomic_store_n(&current_block->hdr.bh1.block_status, TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+    current_block = nullptr;
+    current_packet = nullptr;
+    packets_left = 0;
+    block_idx = (block_idx + 1) % num_blocks;
+}
+
+bool AF_PacketSource::SetFilter(int index) {
+    if ( socket_fd < 0 )
+        return true; // Prevent error message
+
+    iosource::detail::BPF_Program* code = GetBPFFilter(index);
+
+    if ( ! code ) {
+        Error(util::fmt("No precompiled pcap filter for index %d", index));
+        return false;
+    }
+
+    auto* program = code->GetProgram();
+
+    if ( ! program )
+        return code->GetState() == FilterState::OK;
+
+    // libpcap's struct bpf_insn has the same layout as the kernel's
+    // struct sock_filter.
+    struct sock_fprog fprog;
+    fprog.len = program->bf_len;
+    fprog.filter = reinterpret_cast<struct sock_filter*>(program->bf_insns);
+
+    if ( setsockopt(socket_fd, SOL_SOCKET, SO_ATTACH_FILTER, &fprog, sizeof(fprog)) < 0 ) {
+        Error(util::fmt("AF_PACKET: cannot attach filter: %s", strerror(errno)));
+        return false;
+    }
+
+    return true;
+}
+
+void AF_PacketSource::Statistics(Stats* s) {
+    if ( socket_fd >= 0 ) {
+        // The kernel resets its counters on every read.
+        struct tpacket_stats_v3 tp_stats;
+        socklen_t len = sizeof(tp_stats);
+
+        if ( getsockopt(socket_fd, SOL_PACKET, PACKET_STATISTICS, &tp_stats, &len) == 0 ) {
+            stats.link += tp_stats.tp_packets;
+            stats.dropped += tp_stats.tp_drops;
+        }
+    }
+
+    s->link = stats.link;
+    s->dropped = stats.dropped;
+    s->received = stats.received;
+    s->bytes_received = stats.bytes_received;
+}
+
+void AF_PacketSource::SocketError(const char* where) {
+    Error(util::fmt("AF_PACKET: %s failed on %s: %s", where, props.path.c_str(), strerror(errno)));
+    Close();
+}
+
+iosource::PktSrc* AF_PacketSource::Instantiate(const std::string& path, bool is_live) {
+    return new AF_PacketSource(path, is_live);
+}
+
+} // namespace zeek::iosource::af_packet
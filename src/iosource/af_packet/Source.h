@@ -0,0 +1,88 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+extern "C" {
+#include <linux/if_packet.h>
+}
+
+#include <cstdint>
+
+#include "zeek/iosource/PktSrc.h"
+
+namespace zeek::iosource::af_packet {
+
+/**
+ * A live packet source reading from a Linux AF_PACKET socket through a
+ * TPACKET_V3 receive ring.
+ *
+ * The kernel fills the ring block by block and hands over a whole block
+ * at a time, so packets are read straight from memory shared with the
+ * kernel, without a system call or copy per packet. Several processes
+ * can share the traffic of an interface through PACKET_FANOUT.
+ */
+class AF_PacketSource : public PktSrc {
+public:
+    AF_PacketSource(const std::string& path, bool is_live);
+    ~AF_PacketSource() override;
+
+    static PktSrc* Instantiate(const std::string& path, bool is_live);
+
+protected:
+    // PktSrc interface.
+    void Open() override;
+    void Close() override;
+    bool ExtractNextPacket(Packet* pkt) override;
+    void DoneWithPacket() override;
+    bool SupportsBatches() const override { return true; }
+    size_t ExtractNextPackets(Packet* pkts, size_t max) override;
+    void DoneWithPackets(size_t n) override;
+    bool SetFilter(int index) override;
+    void Statistics(Stats* stats) override;
+
+private:
+    enum ChecksumMode {
+        CHECKSUM_ON,
+        CHECKSUM_OFF,
+        CHECKSUM_KERNEL,
+    };
+
+    bool BindInterface();
+    bool EnablePromiscMode();
+    bool EnableHWTimestamping();
+    bool SetupRing();
+    bool JoinFanoutGroup();
+    bool AcquireBlock();
+    void ReleaseBlock();
+    void InitPacket(Packet* pkt, const tpacket3_hdr* hdr);
+    void SocketError(const char* where);
+
+    tpacket_block_desc* BlockAt(unsigned int idx) const {
+        return reinterpret_cast<tpacket_block_desc*>(ring + idx * block_size);
+    }
+
+    static tpacket3_hdr* NextPacket(tpacket3_hdr* hdr) {
+        return reinterpret_cast<tpacket3_hdr*>(reinterpret_cast<uint8_t*>(hdr) + hdr->tp_next_offset);
+    }
+
+    Properties props;
+    Stats stats;
+
+    int socket_fd = -1;
+    int if_index = -1;
+    ChecksumMode checksum_mode = CHECKSUM_ON;
+
+    // The mmap()ed ring of blocks shared with the kernel.
+    uint8_t* ring = nullptr;
+    size_t ring_size = 0;
+    size_t block_size = 0;
+    unsigned int num_blocks = 0;
+
+    // The block we're reading from, if we own one, and the position in it.
+    unsigned int block_idx = 0;
+    tpacket_block_desc* current_block = nullptr;
+    tpacket3_hdr* current_packet = nullptr;
+    uint32_t packets_left = 0;
+};
+
+} // namespace zeek::iosource::af_packet
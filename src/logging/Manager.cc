@@ -2,9 +2,12 @@
 
 #include "zeek/logging/Manager.h"
 
+#include <algorithm>
 #include <broker/endpoint_info.hh>
+#include <chrono>
 #include <functional>
 #include <optional>
+#include <unordered_map>
 #include <utility>
 
 #include "zeek/Desc.h"
@@ -46,6 +49,7 @@ public:
     explicit LogFlushWriteBufferTimer(double t) : Timer(t, zeek::detail::TIMER_LOG_FLUSH_WRITE_BUFFER) {}
 
     void Dispatch(double t, bool is_expire) override {
+        zeek::log_mgr->ExpireAggregates(t);
         zeek::log_mgr->FlushAllWriteBuffers();
 
         if ( ! is_expire )
@@ -224,6 +228,23 @@ struct Manager::Filter {
     // sub-records.
     vector<list<int>> indices;
 
+    // Records with identical values in the key fields that are collapsed
+    // into one, see Log::Filter$aggregate_by.
+    struct Aggregate {
+        string path;
+        RecordValPtr columns; // The first record seen.
+        zeek_uint_t count = 0;
+    };
+
+    vector<int> aggregate_keys; // Indices of the key fields, empty if not aggregating.
+    int aggregate_count_field = -1;
+    double aggregate_interval = 0.0;
+    double aggregate_start = 0.0; // Start of the current window.
+    size_t aggregate_max_groups = 0; // Zero for no limit.
+    vector<Aggregate> aggregates; // In the order of their first record.
+    std::unordered_map<string, size_t> aggregate_index;
+    detail::PackedLogRecords aggregate_key; // Reused for building keys.
+
     ~Filter();
 
     // Invoke path_func of this filter and sets write_path with the
@@ -264,7 +285,8 @@ struct Manager::Stream {
 
     bool enable_remote = false;
 
-    std::shared_ptr<telemetry::Counter> total_writes; // Initialized on first write.
+    std::shared_ptr<telemetry::Counter> total_writes;       // Initialized on first write.
+    std::shared_ptr<telemetry::Counter> conversion_seconds; // Initialized on first write.
 
     // State about delayed writes for this Stream.
     detail::DelayQueue delay_queue;
@@ -483,7 +505,12 @@ Manager::Manager()
           telemetry_mgr
               ->CounterFamily("zeek", "log-writer-writes", {"writer", "module", "stream", "filter-name", "path"},
                               "Total number of log writes passed to a concrete log writer not vetoed by stream or "
-                              "filter policies.")) {
+                              "filter policies.")),
+      log_stream_conversion_family(
+          telemetry_mgr->CounterFamily("zeek", "log-stream-conversion", {"module", "stream", "thread"},
+                                       "Time spent converting log records of the given stream for writers, on the "
+                                       "main thread or in writer threads.",
+                                       "seconds")) {
     rotations_pending = 0;
 }
 
@@ -678,6 +705,9 @@ bool Manager::RemoveStream(unsigned int idx) {
     if ( ! stream )
         return false;
 
+    for ( auto* filter : stream->filters )
+        FlushAggregates(stream, filter);
+
     for ( Stream::WriterMap::iterator i = stream->writers.begin(); i != stream->writers.end(); i++ ) {
         WriterInfo* winfo = i->second;
 
@@ -848,6 +878,52 @@ bool Manager::TraverseRecord(Stream* stream, Filter* filter, RecordType* rt, Tab
     return true;
 }
 
+bool Manager::SetupAggregation(Filter* filter, TableVal* aggregate_by) {
+    auto* fval = filter->fval->AsRecordVal();
+
+    // Key fields are named like for include and exclude. Extension fields
+    // can't be keys, as their values are only computed when writing.
+    for ( int i = filter->num_ext_fields; i < filter->num_fields; ++i ) {
+        auto name = make_intrusive<StringVal>(filter->fields[i]->name);
+
+        if ( aggregate_by->FindOrDefault(name) )
+            filter->aggregate_keys.push_back(i);
+    }
+
+    if ( filter->aggregate_keys.empty() ||
+         filter->aggregate_keys.size() != static_cast<size_t>(aggregate_by->Size()) ) {
+        reporter->Error("aggregate_by of filter '%s' names fields that the filter doesn't log", filter->name.c_str());
+        return false;
+    }
+
+    auto count_field = fval->GetFieldOrDefault("aggregate_count_field")->AsString()->CheckString();
+
+    for ( int i = 0; i < filter->num_fields; ++i ) {
+        if ( strcmp(filter->fields[i]->name, count_field) == 0 ) {
+            reporter->Error("aggregate_count_field '%s' of filter '%s' conflicts with a logged field", count_field,
+                            filter->name.c_str());
+            return false;
+        }
+    }
+
+    // The count is logged as an additional field after all others.
+    void* tmp = realloc(filter->fields, sizeof(threading::Field*) * (filter->num_fields + 1));
+
+    if ( ! tmp ) {
+        reporter->Error("out of memory in add_filter");
+        return false;
+    }
+
+    filter->fields = (threading::Field**)tmp;
+    filter->fields[filter->num_fields] = new threading::Field(count_field, nullptr, TYPE_COUNT, TYPE_VOID, false);
+    filter->indices.emplace_back();
+    filter->aggregate_count_field = filter->num_fields++;
+    filter->aggregate_interval = fval->GetFieldOrDefault("aggregate_interval")->AsInterval();
+    filter->aggregate_max_groups = fval->GetFieldOrDefault("aggregate_max_groups")->AsCount();
+
+    return true;
+}
+
 bool Manager::AddFilter(EnumVal* id, RecordVal* fval) {
     if ( ! same_type(fval->GetType(), BifType::Record::Log::Filter, false) ) {
         reporter->Error("filter argument not of right type");
@@ -924,6 +1000,13 @@ bool Manager::AddFilter(EnumVal* id, RecordVal* fval) {
         return false;
     }
 
+    if ( const auto& aggregate_by = fval->GetField("aggregate_by") ) {
+        if ( ! SetupAggregation(filter, aggregate_by->AsTableVal()) ) {
+            delete filter;
+            return false;
+        }
+    }
+
     // Get the path for the filter.
     auto path_val = fval->GetField("path");
 
@@ -974,6 +1057,7 @@ bool Manager::RemoveFilter(EnumVal* id, const string& name) {
     for ( list<Filter*>::iterator i = stream->filters.begin(); i != stream->filters.end(); ++i ) {
         if ( (*i)->name == name ) {
             Filter* filter = *i;
+            FlushAggregates(stream, filter);
             stream->filters.erase(i);
             DBG_LOG(DBG_LOGGING, "Removed filter '%s' from stream '%s'", filter->name.c_str(), stream->name.c_str());
             delete filter;
@@ -1010,6 +1094,8 @@ bool Manager::Write(EnumVal* id, RecordVal* columns_arg) {
         std::string module_name = zeek::detail::extract_module_name(stream->name.c_str());
         std::initializer_list<telemetry::LabelView> labels{{"module", module_name}, {"stream", stream->name}};
         stream->total_writes = total_log_stream_writes_family->GetOrAdd(labels);
+        stream->conversion_seconds = log_stream_conversion_family->GetOrAdd(
+            {{"module", module_name}, {"stream", stream->name}, {"thread", "main"}});
     }
 
     stream->total_writes->Inc();
@@ -1087,99 +1173,208 @@ bool Manager::WriteToFilters(const Manager::Stream* stream, zeek::RecordValPtr c
                     stream->name.c_str(), path.c_str());
         }
 
-        Stream::WriterPathPair wpp(filter->writer->AsEnum(), path);
+        if ( ! filter->aggregate_keys.empty() ) {
+            AddToAggregate(stream, filter, path, columns.get());
+            continue;
+        }
 
-        // See if we already have a writer for this path.
-        Stream::WriterMap::const_iterator w = stream->writers.find(wpp);
+        switch ( WriteToFilter(stream, filter, std::move(path), columns.get(), 0) ) {
+            case FilterWriteResult::WRITTEN: break;
+            case FilterWriteResult::VETOED: return true;
+            case FilterWriteResult::FAILED: return false;
+        }
+    }
 
-        if ( w != stream->writers.end() && CheckFilterWriterConflict(w->second, filter) ) {
-            // Auto-correct path due to conflict over the writer/path pairs.
-            string instantiator = w->second->instantiating_filter;
-            string new_path;
-            unsigned int i = 2;
+    return true;
+}
 
-            do {
-                char num[32];
-                snprintf(num, sizeof(num), "-%u", i++);
-                new_path = path + num;
-                wpp.second = new_path;
-                w = stream->writers.find(wpp);
-            } while ( w != stream->writers.end() && CheckFilterWriterConflict(w->second, filter) );
+Manager::FilterWriteResult Manager::WriteToFilter(const Stream* stream, Filter* filter, string path, RecordVal* columns,
+                                                  zeek_uint_t aggregate_count) {
+    Stream::WriterPathPair wpp(filter->writer->AsEnum(), path);
 
-            Unref(filter->path_val);
-            filter->path_val = new StringVal(new_path.c_str());
+    // See if we already have a writer for this path.
+    Stream::WriterMap::const_iterator w = stream->writers.find(wpp);
 
-            reporter->Warning(
-                "Write using filter '%s' on path '%s' changed to"
-                " use new path '%s' to avoid conflict with filter '%s'",
-                filter->name.c_str(), path.c_str(), new_path.c_str(), instantiator.c_str());
+    if ( w != stream->writers.end() && CheckFilterWriterConflict(w->second, filter) ) {
+        // Auto-correct path due to conflict over the writer/path pairs.
+        string instantiator = w->second->instantiating_filter;
+        string new_path;
+        unsigned int i = 2;
 
-            path = filter->path = filter->path_val->AsString()->CheckString();
-        }
+        do {
+            char num[32];
+            snprintf(num, sizeof(num), "-%u", i++);
+            new_path = path + num;
+            wpp.second = new_path;
+            w = stream->writers.find(wpp);
+        } while ( w != stream->writers.end() && CheckFilterWriterConflict(w->second, filter) );
 
-        WriterBackend::WriterInfo* info = nullptr;
-        WriterFrontend* writer = nullptr;
+        Unref(filter->path_val);
+        filter->path_val = new StringVal(new_path.c_str());
 
-        if ( w != stream->writers.end() ) {
-            // We know this writer already.
-            auto* wi = w->second;
-            writer = wi->writer;
-            info = wi->info;
+        reporter->Warning(
+            "Write using filter '%s' on path '%s' changed to"
+            " use new path '%s' to avoid conflict with filter '%s'",
+            filter->name.c_str(), path.c_str(), new_path.c_str(), instantiator.c_str());
 
-            if ( ! wi->hook_initialized ) {
-                wi->hook_initialized = true;
-                PLUGIN_HOOK_VOID(HOOK_LOG_INIT,
-                                 HookLogInit(filter->writer_name, wi->instantiating_filter, filter->local,
-                                             filter->remote, *info, filter->num_fields, filter->fields));
-            }
+        path = filter->path = filter->path_val->AsString()->CheckString();
+    }
+
+    WriterBackend::WriterInfo* info = nullptr;
+    WriterFrontend* writer = nullptr;
+
+    if ( w != stream->writers.end() ) {
+        // We know this writer already.
+        auto* wi = w->second;
+        writer = wi->writer;
+        info = wi->info;
+
+        if ( ! wi->hook_initialized ) {
+            wi->hook_initialized = true;
+            PLUGIN_HOOK_VOID(HOOK_LOG_INIT,
+                             HookLogInit(filter->writer_name, wi->instantiating_filter, filter->local,
+                                         filter->remote, *info, filter->num_fields, filter->fields));
         }
+    }
 
-        else {
-            // No, need to create one.
-            writer = CreateWriterForFilter(filter, path, WriterOrigin::LOCAL);
+    else {
+        // No, need to create one.
+        writer = CreateWriterForFilter(filter, path, WriterOrigin::LOCAL);
 
-            if ( ! writer )
-                return false;
+        if ( ! writer )
+            return FilterWriteResult::FAILED;
 
-            // Find the newly inserted WriterInfo record.
-            w = stream->writers.find(wpp);
-            assert(w != stream->writers.end());
+        // Find the newly inserted WriterInfo record.
+        w = stream->writers.find(wpp);
+        assert(w != stream->writers.end());
 
-            info = w->second->info;
-        }
+        info = w->second->info;
+    }
 
-        assert(writer);
-        assert(info);
+    assert(writer);
+    assert(info);
 
-        // Alright, can do the write now.
-        auto rec = RecordToLogRecord(stream, filter, columns.get());
+    // Alright, can do the write now. Unless a plugin wants to see the
+    // record, leave creating its threading::Values to the writer thread.
+    if ( BifConst::Log::convert_in_writer_threads && writer->AcceptsPacked() &&
+         ! zeek::plugin_mgr->HavePluginForHook(zeek::plugin::HOOK_LOG_WRITE) ) {
+        auto start = std::chrono::steady_clock::now();
+        RecordToPacked(filter, columns, aggregate_count, writer->PackedBuffer());
+        stream->conversion_seconds->Inc(
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
 
-        if ( zeek::plugin_mgr->HavePluginForHook(zeek::plugin::HOOK_LOG_WRITE) ) {
-            // The current HookLogWrite API takes a threading::Value**.
-            // Fabricate the pointer array on the fly. Mutation is allowed.
-            std::vector<threading::Value*> vals;
-            vals.reserve(rec.size());
-            for ( auto& v : rec )
-                vals.emplace_back(&v);
+        w->second->total_writes->Inc();
+        writer->WrotePacked();
+        return FilterWriteResult::WRITTEN;
+    }
 
-            bool res = zeek::plugin_mgr->HookLogWrite(filter->writer_name, filter->name, *info, filter->num_fields,
-                                                      filter->fields, &vals[0]);
-            if ( ! res ) {
-                DBG_LOG(DBG_LOGGING, "Hook prevented writing to filter '%s' on stream '%s'", filter->name.c_str(),
-                        stream->name.c_str());
+    auto start = std::chrono::steady_clock::now();
+    auto rec = RecordToLogRecord(stream, filter, columns, aggregate_count);
+    stream->conversion_seconds->Inc(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
 
-                return true;
-            }
+    if ( zeek::plugin_mgr->HavePluginForHook(zeek::plugin::HOOK_LOG_WRITE) ) {
+        // The current HookLogWrite API takes a threading::Value**.
+        // Fabricate the pointer array on the fly. Mutation is allowed.
+        std::vector<threading::Value*> vals;
+        vals.reserve(rec.size());
+        for ( auto& v : rec )
+            vals.emplace_back(&v);
+
+        bool res = zeek::plugin_mgr->HookLogWrite(filter->writer_name, filter->name, *info, filter->num_fields,
+                                                  filter->fields, &vals[0]);
+        if ( ! res ) {
+            DBG_LOG(DBG_LOGGING, "Hook prevented writing to filter '%s' on stream '%s'", filter->name.c_str(),
+                    stream->name.c_str());
+
+            return FilterWriteResult::VETOED;
         }
+    }
 
-        w->second->total_writes->Inc();
+    w->second->total_writes->Inc();
 
-        // Write takes ownership of vals.
-        writer->Write(std::move(rec));
+    // Write takes ownership of vals.
+    writer->Write(std::move(rec));
 
 #ifdef DEBUG
-        DBG_LOG(DBG_LOGGING, "Wrote record to filter '%s' on stream '%s'", filter->name.c_str(), stream->name.c_str());
+    DBG_LOG(DBG_LOGGING, "Wrote record to filter '%s' on stream '%s'", filter->name.c_str(), stream->name.c_str());
 #endif
+
+    return FilterWriteResult::WRITTEN;
+}
+
+// Follows a log field's indices from the record in val down to the field's
+// value, updating val and its type vt. Leaves val unset if the field, or
+// any of its parents, is not set.
+void Manager::LookupLogField(const list<int>& indices, std::optional<ZVal>& val, Type*& vt) {
+    for ( int idx : indices ) {
+        auto vr = val->AsRecord();
+        val = vr->RawOptField(idx);
+
+        if ( ! val )
+            return;
+
+        vt = cast_intrusive<RecordType>(vr->GetType())->GetFieldType(idx).get();
+    }
+}
+
+void Manager::AddToAggregate(const Stream* stream, Filter* filter, const string& path, RecordVal* columns) {
+    double now = run_state::network_time;
+
+    if ( ! filter->aggregates.empty() && now >= filter->aggregate_start + filter->aggregate_interval )
+        FlushAggregates(stream, filter);
+
+    // The key consists of the path and the packed values of the key
+    // fields. Nothing else of the record gets converted until the
+    // aggregate is written.
+    auto& packed = filter->aggregate_key;
+    packed.Clear();
+
+    for ( int i : filter->aggregate_keys ) {
+        std::optional<ZVal> val = ZVal(columns);
+        Type* vt = columns->GetType().get();
+        LookupLogField(filter->indices[i], val, vt);
+
+        if ( val )
+            KeyValToPacked(val, vt, packed);
+        else
+            packed.AddTag(filter->fields[i]->type, false);
+    }
+
+    string key = path;
+    key.push_back('\0');
+    key.append(packed.Data());
+
+    if ( auto it = filter->aggregate_index.find(key); it != filter->aggregate_index.end() ) {
+        ++filter->aggregates[it->second].count;
+        return;
+    }
+
+    // A new group. If there are already as many as allowed, the window
+    // ends early to bound the memory held per filter.
+    if ( filter->aggregate_max_groups > 0 && filter->aggregates.size() >= filter->aggregate_max_groups )
+        FlushAggregates(stream, filter);
+
+    if ( filter->aggregates.empty() )
+        filter->aggregate_start = now;
+
+    filter->aggregate_index.emplace(std::move(key), filter->aggregates.size());
+
+    // Scripts may modify the record after writing it.
+    auto copy = cast_intrusive<RecordVal>(columns->Clone());
+    filter->aggregates.push_back({path, std::move(copy), 1});
+}
+
+bool Manager::FlushAggregates(const Stream* stream, Filter* filter) {
+    if ( filter->aggregates.empty() )
+        return true;
+
+    auto aggregates = std::move(filter->aggregates);
+    filter->aggregates.clear();
+    filter->aggregate_index.clear();
+
+    for ( auto& a : aggregates ) {
+        if ( WriteToFilter(stream, filter, std::move(a.path), a.columns.get(), a.count) == FilterWriteResult::FAILED )
+            return false;
     }
 
     return true;
@@ -1385,6 +1580,25 @@ bool Manager::SetMaxDelayQueueSize(const EnumValPtr& id, zeek_uint_t queue_size)
     return true;
 }
 
+static threading::Value::port_t to_log_port(zeek_uint_t p) {
+    auto pt = TRANSPORT_UNKNOWN;
+    auto pm = p & PORT_SPACE_MASK;
+    if ( pm == TCP_PORT_MASK )
+        pt = TRANSPORT_TCP;
+    else if ( pm == UDP_PORT_MASK )
+        pt = TRANSPORT_UDP;
+    else if ( pm == ICMP_PORT_MASK )
+        pt = TRANSPORT_ICMP;
+
+    return {p & ~PORT_SPACE_MASK, pt};
+}
+
+static std::string describe_func(const Func* f) {
+    ODesc d;
+    f->Describe(&d);
+    return d.Description();
+}
+
 threading::Value Manager::ValToLogVal(std::optional<ZVal>& val, Type* ty) {
     if ( ! val )
         return {ty->Tag(), false};
@@ -1418,22 +1632,7 @@ threading::Value Manager::ValToLogVal(std::optional<ZVal>& val, Type* ty) {
             break;
         }
 
-        case TYPE_PORT: {
-            auto p = val->AsCount();
-
-            auto pt = TRANSPORT_UNKNOWN;
-            auto pm = p & PORT_SPACE_MASK;
-            if ( pm == TCP_PORT_MASK )
-                pt = TRANSPORT_TCP;
-            else if ( pm == UDP_PORT_MASK )
-                pt = TRANSPORT_UDP;
-            else if ( pm == ICMP_PORT_MASK )
-                pt = TRANSPORT_ICMP;
-
-            lval.val.port_val.port = p & ~PORT_SPACE_MASK;
-            lval.val.port_val.proto = pt;
-            break;
-        }
+        case TYPE_PORT: lval.val.port_val = to_log_port(val->AsCount()); break;
 
         case TYPE_SUBNET: val->AsSubNet()->Get().ConvertToThreadingValue(&lval.val.subnet_val); break;
 
@@ -1463,13 +1662,9 @@ threading::Value Manager::ValToLogVal(std::optional<ZVal>& val, Type* ty) {
         }
 
         case TYPE_FUNC: {
-            ODesc d;
-            const Func* f = val->AsFunc();
-            f->Describe(&d);
-            const char* s = d.Description();
-            auto len = strlen(s);
-            lval.val.string_val.data = util::copy_string(s, len);
-            lval.val.string_val.length = len;
+            auto s = describe_func(val->AsFunc());
+            lval.val.string_val.data = util::copy_string(s.data(), s.size());
+            lval.val.string_val.length = s.size();
             break;
         }
 
@@ -1520,7 +1715,11 @@ threading::Value Manager::ValToLogVal(std::optional<ZVal>& val, Type* ty) {
     return lval;
 }
 
-detail::LogRecord Manager::RecordToLogRecord(const Stream* stream, Filter* filter, RecordVal* columns) {
+// Calls f(i, val, type) for each of the filter's fields, with an unset val
+// and a null type for fields that aren't set. The aggregation count field
+// gets aggregate_count.
+template<typename F>
+void Manager::ForEachLogField(Filter* filter, RecordVal* columns, zeek_uint_t aggregate_count, F f) {
     RecordValPtr ext_rec;
 
     if ( filter->num_ext_fields > 0 ) {
@@ -1530,17 +1729,20 @@ detail::LogRecord Manager::RecordToLogRecord(const Stream* stream, Filter* filte
             ext_rec = {AdoptRef{}, res.release()->AsRecordVal()};
     }
 
-    // Allocate storage for all vals.
-    detail::LogRecord vals;
-    vals.reserve(filter->num_fields);
-
     for ( int i = 0; i < filter->num_fields; ++i ) {
         std::optional<ZVal> val;
         Type* vt;
+
+        if ( i == filter->aggregate_count_field ) {
+            val = ZVal(aggregate_count);
+            f(i, val, base_type(TYPE_COUNT).get());
+            continue;
+        }
+
         if ( i < filter->num_ext_fields ) {
             if ( ! ext_rec ) {
                 // executing function did not return record. Send empty for all vals.
-                vals.emplace_back(filter->fields[i]->type, false);
+                f(i, val, nullptr);
                 continue;
             }
 
@@ -1554,26 +1756,179 @@ detail::LogRecord Manager::RecordToLogRecord(const Stream* stream, Filter* filte
 
         // For each field, first find the right value, which can
         // potentially be nested inside other records.
-        list<int>& indices = filter->indices[i];
+        LookupLogField(filter->indices[i], val, vt);
 
-        for ( list<int>::iterator j = indices.begin(); j != indices.end(); ++j ) {
-            auto vr = val->AsRecord();
-            val = vr->RawOptField(*j);
+        f(i, val, val ? vt : nullptr);
+    }
+}
 
-            if ( ! val ) {
-                // Value, or any of its parents, is not set.
-                vals.emplace_back(filter->fields[i]->type, false);
-                break;
+detail::LogRecord Manager::RecordToLogRecord(const Stream* stream, Filter* filter, RecordVal* columns,
+                                             zeek_uint_t aggregate_count) {
+    // Allocate storage for all vals.
+    detail::LogRecord vals;
+    vals.reserve(filter->num_fields);
+
+    ForEachLogField(filter, columns, aggregate_count, [this, filter, &vals](int i, std::optional<ZVal>& val, Type* vt) {
+        if ( val )
+            vals.emplace_back(ValToLogVal(val, vt));
+        else
+            vals.emplace_back(filter->fields[i]->type, false);
+    });
+
+    return vals;
+}
+
+void Manager::RecordToPacked(Filter* filter, RecordVal* columns, zeek_uint_t aggregate_count,
+                             detail::PackedLogRecords& packed) {
+    ForEachLogField(filter, columns, aggregate_count,
+                    [this, filter, &packed](int i, std::optional<ZVal>& val, Type* vt) {
+                        if ( val )
+                            ValToPacked(val, vt, packed);
+                        else
+                            packed.AddTag(filter->fields[i]->type, false);
+                    });
+}
+
+void Manager::ValToPacked(std::optional<ZVal>& val, Type* ty, detail::PackedLogRecords& packed) {
+    if ( ! val ) {
+        packed.AddTag(ty->Tag(), false);
+        return;
+    }
+
+    packed.AddTag(ty->Tag(), true);
+
+    switch ( ty->Tag() ) {
+        case TYPE_BOOL:
+        case TYPE_INT: packed.Add(val->AsInt()); break;
+
+        case TYPE_ENUM: {
+            const char* s = ty->AsEnumType()->Lookup(val->AsInt());
+
+            if ( s )
+                packed.AddString(s, strlen(s));
+
+            else {
+                auto err_msg = "enum type does not contain value:" + std::to_string(val->AsInt());
+                ty->Error(err_msg.c_str());
+                packed.AddString("", 0);
             }
+            break;
+        }
 
-            vt = cast_intrusive<RecordType>(vr->GetType())->GetFieldType(*j).get();
+        case TYPE_COUNT: packed.Add(val->AsCount()); break;
+
+        case TYPE_PORT: packed.Add(to_log_port(val->AsCount())); break;
+
+        case TYPE_SUBNET: {
+            threading::Value::subnet_t sn;
+            val->AsSubNet()->Get().ConvertToThreadingValue(&sn);
+            packed.Add(sn);
+            break;
         }
 
-        if ( val )
-            vals.emplace_back(ValToLogVal(val, vt));
+        case TYPE_ADDR: {
+            threading::Value::addr_t a;
+            val->AsAddr()->Get().ConvertToThreadingValue(&a);
+            packed.Add(a);
+            break;
+        }
+
+        case TYPE_DOUBLE:
+        case TYPE_TIME:
+        case TYPE_INTERVAL: packed.Add(val->AsDouble()); break;
+
+        case TYPE_STRING: {
+            const String* s = val->AsString()->AsString();
+            packed.AddString(reinterpret_cast<const char*>(s->Bytes()), s->Len());
+            break;
+        }
+
+        case TYPE_FILE: {
+            const char* s = val->AsFile()->Name();
+            packed.AddString(s, strlen(s));
+            break;
+        }
+
+        case TYPE_FUNC: {
+            auto s = describe_func(val->AsFunc());
+            packed.AddString(s.data(), s.size());
+            break;
+        }
+
+        case TYPE_TABLE: {
+            auto tbl = val->AsTable();
+            auto set = tbl->ToPureListVal();
+
+            if ( ! set )
+                set = make_intrusive<ListVal>(TYPE_INT);
+
+            auto tbl_t = cast_intrusive<TableType>(tbl->GetType());
+            auto& set_t = tbl_t->GetIndexTypes()[0];
+            bool is_managed = ZVal::IsManagedType(set_t);
+
+            packed.Add(static_cast<zeek_int_t>(set->Length()));
+
+            for ( int i = 0; i < set->Length(); i++ ) {
+                std::optional<ZVal> s_i = ZVal(set->Idx(i), set_t);
+                ValToPacked(s_i, set_t.get(), packed);
+                if ( is_managed )
+                    ZVal::DeleteManagedType(*s_i);
+            }
+
+            break;
+        }
+
+        case TYPE_VECTOR: {
+            VectorVal* vec = val->AsVector();
+            auto& vv = vec->RawVec();
+            auto& vt = vec->GetType()->Yield();
+
+            packed.Add(static_cast<zeek_int_t>(vec->Size()));
+
+            for ( auto& v : vv )
+                ValToPacked(v, vt.get(), packed);
+
+            break;
+        }
+
+        default: reporter->InternalError("unsupported type %s for log_write", type_name(ty->Tag()));
     }
+}
 
-    return vals;
+void Manager::KeyValToPacked(std::optional<ZVal>& val, Type* ty, detail::PackedLogRecords& packed) {
+    if ( ty->Tag() != TYPE_TABLE ) {
+        ValToPacked(val, ty, packed);
+        return;
+    }
+
+    // Sets iterate in the order of their hash table, which depends on
+    // their history. Pack the elements individually and sort them.
+    auto set = val->AsTable()->ToPureListVal();
+    auto& set_t = ty->AsTableType()->GetIndexTypes()[0];
+    bool is_managed = ZVal::IsManagedType(set_t);
+    int n = set ? set->Length() : 0;
+
+    std::vector<string> elems;
+    elems.reserve(n);
+
+    detail::PackedLogRecords elem;
+
+    for ( int i = 0; i < n; i++ ) {
+        std::optional<ZVal> s_i = ZVal(set->Idx(i), set_t);
+        elem.Clear();
+        ValToPacked(s_i, set_t.get(), elem);
+        elems.emplace_back(elem.Data());
+        if ( is_managed )
+            ZVal::DeleteManagedType(*s_i);
+    }
+
+    std::sort(elems.begin(), elems.end());
+
+    packed.AddTag(TYPE_TABLE, true);
+    packed.Add(static_cast<zeek_int_t>(n));
+
+    for ( const auto& e : elems )
+        packed.AddString(e.data(), e.size());
 }
 
 bool Manager::CreateWriterForRemoteLog(EnumVal* id, EnumVal* writer, WriterBackend::WriterInfo* info, int num_fields,
@@ -1679,6 +2034,8 @@ WriterFrontend* Manager::CreateWriter(EnumVal* id, EnumVal* writer, WriterBacken
     winfo->info->rotation_base = util::detail::parse_rotate_base_time(base_time);
 
     winfo->writer = new WriterFrontend(*winfo->info, id, writer, local, remote);
+    winfo->writer->unpack_seconds = log_stream_conversion_family->GetOrAdd(
+        {{"module", stream_module_name}, {"stream", stream->name}, {"thread", "writer"}});
     winfo->writer->Init(num_fields, fields);
 
     if ( ! from_remote ) {
@@ -1916,6 +2273,9 @@ void Manager::Terminate() {
         if ( ! *s )
             continue;
 
+        for ( auto* filter : (*s)->filters )
+            FlushAggregates(*s, filter);
+
         for ( Stream::WriterMap::iterator i = (*s)->writers.begin(); i != (*s)->writers.end(); i++ )
             i->second->writer->Stop();
     }
@@ -2161,6 +2521,18 @@ bool Manager::FinishedRotation(WriterFrontend* writer, const char* new_name, con
     return result;
 }
 
+void Manager::ExpireAggregates(double t) {
+    for ( auto* s : streams ) {
+        if ( ! s )
+            continue;
+
+        for ( auto* filter : s->filters ) {
+            if ( ! filter->aggregates.empty() && t >= filter->aggregate_start + filter->aggregate_interval )
+                FlushAggregates(s, filter);
+        }
+    }
+}
+
 void Manager::FlushAllWriteBuffers() {
     for ( const auto* s : zeek::log_mgr->streams ) {
         if ( ! s ) // may store nullptr
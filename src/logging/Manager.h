@@ -37,6 +37,8 @@ class LogFlushWriteBufferTimer;
 
 class DelayInfo;
 
+class PackedLogRecords;
+
 using WriteIdx = uint64_t;
 
 /**
@@ -394,6 +396,9 @@ protected:
     // Flush write buffers of all writers.
     void FlushAllWriteBuffers();
 
+    // Writes out aggregated records of filters whose window has ended.
+    void ExpireAggregates(double t);
+
     // Start the regular log flushing timer.
     void StartLogFlushTimer();
 
@@ -422,9 +427,29 @@ private:
     bool TraverseRecord(Stream* stream, Filter* filter, RecordType* rt, TableVal* include, TableVal* exclude,
                         const std::string& path, const std::list<int>& indices);
 
-    detail::LogRecord RecordToLogRecord(const Stream* stream, Filter* filter, RecordVal* columns);
+    bool SetupAggregation(Filter* filter, TableVal* aggregate_by);
+
+    static void LookupLogField(const std::list<int>& indices, std::optional<ZVal>& val, Type*& vt);
+
+    template<typename F>
+    void ForEachLogField(Filter* filter, RecordVal* columns, zeek_uint_t aggregate_count, F f);
+
+    // The aggregate_count is the value of the filter's aggregation count
+    // field, if it has one.
+    detail::LogRecord RecordToLogRecord(const Stream* stream, Filter* filter, RecordVal* columns,
+                                        zeek_uint_t aggregate_count);
     threading::Value ValToLogVal(std::optional<ZVal>& val, Type* ty);
 
+    // Like RecordToLogRecord(), but leaves the creation of the
+    // threading::Values to the writer thread.
+    void RecordToPacked(Filter* filter, RecordVal* columns, zeek_uint_t aggregate_count,
+                        detail::PackedLogRecords& packed);
+    void ValToPacked(std::optional<ZVal>& val, Type* ty, detail::PackedLogRecords& packed);
+
+    // Like ValToPacked(), but packs the elements of sets in sorted order so
+    // that equal sets give equal aggregation keys.
+    void KeyValToPacked(std::optional<ZVal>& val, Type* ty, detail::PackedLogRecords& packed);
+
     Stream* FindStream(EnumVal* id);
     void RemoveDisabledWriters(Stream* stream);
     void InstallRotationTimer(WriterInfo* winfo);
@@ -440,6 +465,20 @@ private:
     };
     bool WriteToFilters(const Manager::Stream* stream, zeek::RecordValPtr columns, PolicyVerdict stream_verdict);
 
+    // Outcome of writing a record through a single filter.
+    enum class FilterWriteResult {
+        WRITTEN,
+        VETOED, // By a plugin's log write hook.
+        FAILED,
+    };
+    FilterWriteResult WriteToFilter(const Stream* stream, Filter* filter, std::string path, RecordVal* columns,
+                                    zeek_uint_t aggregate_count);
+
+    // Collapses the record into its filter's aggregate with the same key
+    // fields, writing the aggregates out first if their window has ended.
+    void AddToAggregate(const Stream* stream, Filter* filter, const std::string& path, RecordVal* columns);
+    bool FlushAggregates(const Stream* stream, Filter* filter);
+
     bool RemoveStream(unsigned int idx);
 
     bool DelayCompleted(Manager::Stream* stream, detail::DelayInfo& delay_info);
@@ -451,6 +490,7 @@ private:
 
     std::shared_ptr<telemetry::CounterFamily> total_log_stream_writes_family;
     std::shared_ptr<telemetry::CounterFamily> total_log_writer_writes_family;
+    std::shared_ptr<telemetry::CounterFamily> log_stream_conversion_family;
 
     zeek_uint_t last_delay_token = 0;
     std::vector<detail::WriteContext> active_writes;
@@ -210,20 +210,21 @@ bool WriterBackend::Write(int arg_num_fields, zeek::Span<detail::LogRecord> reco
         // itself manages strings, sets and vectors using raw pointers,
         // so this is more consistent than mixing.
         std::vector<Value*> valps;
-        valps.reserve(num_fields);
+        valps.reserve(records.size() * num_fields);
 
-        for ( size_t j = 0; j < records.size(); j++ ) {
-            auto& write_vals = records[j];
+        for ( auto& write_vals : records ) {
             for ( int f = 0; f < num_fields; f++ )
                 valps.emplace_back(&write_vals[f]);
+        }
 
-            success = DoWrite(num_fields, fields, &valps[0]);
+        std::vector<Value**> rows;
+        rows.reserve(records.size());
 
-            valps.clear();
+        // Not &valps[...], which would index an empty vector without fields.
+        for ( size_t j = 0; j < records.size(); j++ )
+            rows.emplace_back(valps.data() + j * num_fields);
 
-            if ( ! success )
-                break;
-        }
+        success = DoWriteBatch(num_fields, fields, static_cast<int>(rows.size()), rows.data());
     }
 
     if ( ! success )
@@ -232,6 +233,15 @@ bool WriterBackend::Write(int arg_num_fields, zeek::Span<detail::LogRecord> reco
     return success;
 }
 
+bool WriterBackend::DoWriteBatch(int num_fields, const Field* const* fields, int num_writes, Value** const* vals) {
+    for ( int j = 0; j < num_writes; j++ ) {
+        if ( ! DoWrite(num_fields, fields, vals[j]) )
+            return false;
+    }
+
+    return true;
+}
+
 bool WriterBackend::SetBuf(bool enabled) {
     if ( enabled == buffering )
         // No change.
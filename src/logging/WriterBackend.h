@@ -285,6 +285,28 @@ protected:
      */
     virtual bool DoWrite(int num_fields, const threading::Field* const* fields, threading::Value** vals) = 0;
 
+    /**
+     * Writer-specific output method for a batch of log entries, as passed
+     * into Write().
+     *
+     * The default implementation calls DoWrite() for each entry. Writers
+     * that can record several entries at once more efficiently than one
+     * at a time, for example inside a single database transaction, may
+     * override it. The same rules as for DoWrite() apply to the return
+     * value.
+     *
+     * @param num_fields The number of fields of each entry.
+     *
+     * @param fields The fields of the log stream.
+     *
+     * @param num_writes The number of entries in the batch.
+     *
+     * @param vals The values of each entry, in the same format as passed
+     * to DoWrite().
+     */
+    virtual bool DoWriteBatch(int num_fields, const threading::Field* const* fields, int num_writes,
+                              threading::Value** const* vals);
+
     /**
      * Writer-specific method implementing a change of the buffering
      * state.  If buffering is disabled, the writer should attempt to
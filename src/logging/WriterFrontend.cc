@@ -2,12 +2,16 @@
 
 #include "zeek/logging/WriterFrontend.h"
 
+#include <chrono>
+
+#include "zeek/3rdparty/doctest.h"
 #include "zeek/RunState.h"
 #include "zeek/Span.h"
 #include "zeek/broker/Manager.h"
 #include "zeek/cluster/Backend.h"
 #include "zeek/logging/Manager.h"
 #include "zeek/logging/WriterBackend.h"
+#include "zeek/telemetry/Counter.h"
 #include "zeek/threading/SerialTypes.h"
 
 using zeek::threading::Field;
@@ -59,11 +63,30 @@ public:
           num_fields(num_fields),
           records(std::move(records)) {}
 
-    bool Process() override { return Object()->Write(num_fields, zeek::Span{records}); }
+    WriteMessage(WriterBackend* backend, int num_fields, detail::PackedLogRecords&& packed,
+                 std::shared_ptr<telemetry::Counter> unpack_seconds)
+        : threading::InputMessage<WriterBackend>("Write", backend),
+          num_fields(num_fields),
+          packed(std::move(packed)),
+          unpack_seconds(std::move(unpack_seconds)) {}
+
+    bool Process() override {
+        if ( packed.Size() > 0 ) {
+            auto start = std::chrono::steady_clock::now();
+            records = packed.Unpack(num_fields);
+
+            if ( unpack_seconds )
+                unpack_seconds->Inc(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        }
+
+        return Object()->Write(num_fields, zeek::Span{records});
+    }
 
 private:
     int num_fields;
     std::vector<detail::LogRecord> records;
+    detail::PackedLogRecords packed;
+    std::shared_ptr<telemetry::Counter> unpack_seconds;
 };
 
 class SetBufMessage final : public threading::InputMessage<WriterBackend> {
@@ -213,6 +236,10 @@ void WriterFrontend::Write(detail::LogRecord&& arg_vals) {
     // Either non-broker remote or local logging.
     assert(backend || (remote && ! broker_is_cluster_backend));
 
+    // Keep the order with packed records written before.
+    if ( write_buffer.Packed().Size() > 0 )
+        FlushWriteBuffer();
+
     write_buffer.WriteRecord(std::move(vals));
 
     if ( write_buffer.Full() || ! buf || run_state::terminating )
@@ -220,6 +247,23 @@ void WriterFrontend::Write(detail::LogRecord&& arg_vals) {
         FlushWriteBuffer();
 }
 
+detail::PackedLogRecords& WriterFrontend::PackedBuffer() {
+    assert(AcceptsPacked());
+
+    // Keep the order with records written before.
+    if ( write_buffer.Size() > write_buffer.Packed().Size() )
+        FlushWriteBuffer();
+
+    return write_buffer.Packed();
+}
+
+void WriterFrontend::WrotePacked() {
+    write_buffer.Packed().EndRecord();
+
+    if ( write_buffer.Full() || ! buf || run_state::terminating )
+        FlushWriteBuffer();
+}
+
 void WriterFrontend::FlushWriteBuffer() {
     if ( disabled )
         return;
@@ -228,6 +272,13 @@ void WriterFrontend::FlushWriteBuffer() {
         // Nothing to do.
         return;
 
+    if ( write_buffer.Packed().Size() > 0 ) {
+        // Packed records only go to the local backend, see AcceptsPacked().
+        assert(backend && ! remote);
+        backend->SendIn(new WriteMessage(backend, num_fields, std::move(write_buffer).TakePacked(), unpack_seconds));
+        return;
+    }
+
     auto records = std::move(write_buffer).TakeRecords();
 
     // We've already pushed to broker during Write(). If another backend
@@ -277,4 +328,150 @@ void WriterFrontend::Rotate(const char* rotated_path, double open, double close,
         log_mgr->FinishedRotation(this, nullptr, nullptr, 0, 0, false, terminating);
 }
 
+namespace detail {
+
+void PackedLogRecords::AddString(const char* s, size_t len) {
+    Add(static_cast<uint32_t>(len));
+    data.insert(data.end(), s, s + len);
+}
+
+std::vector<LogRecord> PackedLogRecords::Unpack(int num_fields) const {
+    std::vector<LogRecord> result;
+    result.reserve(records);
+
+    size_t pos = 0;
+
+    for ( size_t i = 0; i < records; i++ ) {
+        LogRecord& rec = result.emplace_back();
+        rec.reserve(num_fields);
+
+        for ( int j = 0; j < num_fields; j++ )
+            rec.emplace_back(UnpackValue(pos));
+    }
+
+    assert(pos == data.size());
+    return result;
+}
+
+threading::Value PackedLogRecords::UnpackValue(size_t& pos) const {
+    auto type = static_cast<TypeTag>(Get<uint8_t>(pos));
+    bool present = Get<uint8_t>(pos);
+
+    Value v{type, present};
+
+    if ( ! present )
+        return v;
+
+    switch ( type ) {
+        case TYPE_BOOL:
+        case TYPE_INT: v.val.int_val = Get<zeek_int_t>(pos); break;
+
+        case TYPE_COUNT: v.val.uint_val = Get<zeek_uint_t>(pos); break;
+
+        case TYPE_PORT: v.val.port_val = Get<Value::port_t>(pos); break;
+
+        case TYPE_ADDR: v.val.addr_val = Get<Value::addr_t>(pos); break;
+
+        case TYPE_SUBNET: v.val.subnet_val = Get<Value::subnet_t>(pos); break;
+
+        case TYPE_DOUBLE:
+        case TYPE_TIME:
+        case TYPE_INTERVAL: v.val.double_val = Get<double>(pos); break;
+
+        case TYPE_ENUM:
+        case TYPE_STRING:
+        case TYPE_FILE:
+        case TYPE_FUNC: {
+            auto len = Get<uint32_t>(pos);
+            v.val.string_val.data = util::copy_string(&data[pos], len);
+            v.val.string_val.length = len;
+            pos += len;
+            break;
+        }
+
+        case TYPE_TABLE: {
+            v.val.set_val.size = Get<zeek_int_t>(pos);
+            v.val.set_val.vals = new Value*[v.val.set_val.size];
+
+            for ( zeek_int_t i = 0; i < v.val.set_val.size; i++ )
+                v.val.set_val.vals[i] = new Value(UnpackValue(pos));
+
+            break;
+        }
+
+        case TYPE_VECTOR: {
+            v.val.vector_val.size = Get<zeek_int_t>(pos);
+            v.val.vector_val.vals = new Value*[v.val.vector_val.size];
+
+            for ( zeek_int_t i = 0; i < v.val.vector_val.size; i++ )
+                v.val.vector_val.vals[i] = new Value(UnpackValue(pos));
+
+            break;
+        }
+
+        default:
+            // Can't be reached, the packing side only adds these types.
+            abort();
+    }
+
+    return v;
+}
+
+TEST_SUITE_BEGIN("logging packed records");
+
+TEST_CASE("packed records round trip") {
+    PackedLogRecords packed;
+
+    for ( int i = 0; i < 2; i++ ) {
+        packed.AddTag(TYPE_COUNT, true);
+        packed.Add(static_cast<zeek_uint_t>(42 + i));
+
+        packed.AddTag(TYPE_STRING, true);
+        packed.AddString("a\0b", 3);
+
+        packed.AddTag(TYPE_ENUM, false);
+
+        packed.AddTag(TYPE_PORT, true);
+        packed.Add(Value::port_t{80, TRANSPORT_TCP});
+
+        packed.AddTag(TYPE_VECTOR, true);
+        packed.Add(static_cast<zeek_int_t>(2));
+        packed.AddTag(TYPE_DOUBLE, true);
+        packed.Add(1.5);
+        packed.AddTag(TYPE_DOUBLE, false);
+
+        packed.EndRecord();
+    }
+
+    CHECK(packed.Size() == 2);
+
+    auto records = packed.Unpack(5);
+    REQUIRE(records.size() == 2);
+
+    for ( int i = 0; i < 2; i++ ) {
+        const auto& rec = records[i];
+        REQUIRE(rec.size() == 5);
+
+        CHECK(rec[0].type == TYPE_COUNT);
+        CHECK(rec[0].val.uint_val == static_cast<zeek_uint_t>(42 + i));
+
+        CHECK(rec[1].type == TYPE_STRING);
+        CHECK(std::string(rec[1].val.string_val.data, rec[1].val.string_val.length) == std::string("a\0b", 3));
+
+        CHECK(rec[2].type == TYPE_ENUM);
+        CHECK_FALSE(rec[2].present);
+
+        CHECK(rec[3].val.port_val.port == 80);
+        CHECK(rec[3].val.port_val.proto == TRANSPORT_TCP);
+
+        REQUIRE(rec[4].val.vector_val.size == 2);
+        CHECK(rec[4].val.vector_val.vals[0]->val.double_val == 1.5);
+        CHECK_FALSE(rec[4].val.vector_val.vals[1]->present);
+    }
+}
+
+TEST_SUITE_END();
+
+} // namespace detail
+
 } // namespace zeek::logging
@@ -2,16 +2,119 @@
 
 #pragma once
 
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
 #include "zeek/logging/Types.h"
 #include "zeek/logging/WriterBackend.h"
 
-namespace zeek::logging {
+namespace zeek {
+
+namespace telemetry {
+class Counter;
+}
+
+namespace logging {
 
 class Manager;
 
 
 namespace detail {
 
+/**
+ * Log records in a compact form that's cheap to produce on the main thread:
+ * the values of all records are packed back to back into a single buffer,
+ * without allocating anything per value. Writer threads turn them into
+ * LogRecords with Unpack().
+ *
+ * Each value starts with its type tag and whether it's present, followed
+ * by its data in host byte order. Strings are preceded by their length,
+ * sets and vectors by their number of elements.
+ */
+class PackedLogRecords {
+public:
+    /**
+     * Starts a new value.
+     *
+     * @param type The type of the value.
+     * @param present False if the value is unset, in which case no data
+     * follows.
+     */
+    void AddTag(TypeTag type, bool present) {
+        Add(static_cast<uint8_t>(type));
+        Add(static_cast<uint8_t>(present));
+    }
+
+    /**
+     * Appends the data of a value of fixed size.
+     */
+    template<typename T>
+    void Add(const T& v) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        auto n = data.size();
+        data.resize(n + sizeof(T));
+        memcpy(&data[n], &v, sizeof(T));
+    }
+
+    /**
+     * Appends the data of a string value.
+     */
+    void AddString(const char* s, size_t len);
+
+    /**
+     * Completes a record. Each record must consist of the same number of
+     * values.
+     */
+    void EndRecord() { ++records; }
+
+    /**
+     * Converts the packed records into LogRecords.
+     *
+     * @param num_fields The number of values per record.
+     */
+    std::vector<LogRecord> Unpack(int num_fields) const;
+
+    /**
+     * @return The number of complete records.
+     */
+    size_t Size() const { return records; }
+
+    /**
+     * @return The number of bytes in the buffer.
+     */
+    size_t Bytes() const { return data.size(); }
+
+    /**
+     * @return The packed data.
+     */
+    std::string_view Data() const { return {data.data(), data.size()}; }
+
+    /**
+     * Removes all records.
+     */
+    void Clear() {
+        data.clear();
+        records = 0;
+    }
+
+private:
+    template<typename T>
+    T Get(size_t& pos) const {
+        T v;
+        memcpy(&v, &data[pos], sizeof(T));
+        pos += sizeof(T);
+        return v;
+    }
+
+    threading::Value UnpackValue(size_t& pos) const;
+
+    std::vector<char> data;
+    size_t records = 0;
+};
+
 /**
  * Implements a buffer accumulating log records in \a WriterFrontend instance
  * before passing them to \a WriterBackend instances.
@@ -32,6 +135,13 @@ public:
      */
     void WriteRecord(LogRecord&& record) { records.emplace_back(std::move(record)); }
 
+    /**
+     * @return The buffer for records packed by the caller. The buffer
+     * should only hold one kind of records at a time, so that their order
+     * is kept.
+     */
+    PackedLogRecords& Packed() { return packed; }
+
     /**
      * Moves the records out of the buffer and resets it.
      *
@@ -47,24 +157,32 @@ public:
         return tmp;
     }
 
+    /**
+     * Moves the packed records out of the buffer and resets it.
+     *
+     * @return The currently buffered packed records.
+     */
+    PackedLogRecords TakePacked() && { return std::exchange(packed, {}); }
+
     /**
      * @return The size of the buffer.
      */
-    size_t Size() const { return records.size(); }
+    size_t Size() const { return records.size() + packed.Size(); }
 
     /**
      * @return True if buffer is empty.
      */
-    size_t Empty() const { return records.empty(); }
+    size_t Empty() const { return Size() == 0; }
 
     /**
      * @return True if size equals or exceeds configured buffer size.
      */
-    bool Full() const { return records.size() >= buffer_size; }
+    bool Full() const { return Size() >= buffer_size; }
 
 private:
     size_t buffer_size;
     std::vector<LogRecord> records;
+    PackedLogRecords packed;
 };
 
 } // namespace detail
@@ -154,6 +272,28 @@ public:
      */
     void Write(detail::LogRecord&& rec);
 
+    /**
+     * Returns true if records can be written through PackedBuffer(),
+     * which is the case if they only go to a local writer thread.
+     */
+    bool AcceptsPacked() const { return backend && ! remote && ! disabled; }
+
+    /**
+     * Returns the buffer to pack the next record into, which the writer
+     * thread unpacks. Records written through Write() that are still
+     * buffered are flushed first. Call WrotePacked() once the record is
+     * complete.
+     *
+     * This method must only be called from the main thread, and only if
+     * AcceptsPacked() returns true.
+     */
+    detail::PackedLogRecords& PackedBuffer();
+
+    /**
+     * Completes a record added to PackedBuffer().
+     */
+    void WrotePacked();
+
     /**
      * Sets the buffering state.
      *
@@ -277,6 +417,9 @@ protected:
 
     detail::LogWriteHeader header;    // Collected information about the WriterFrontend.
     detail::WriteBuffer write_buffer; // Buffer for bulk writes.
+
+    std::shared_ptr<telemetry::Counter> unpack_seconds; // Time the backend spends unpacking records.
 };
 
-} // namespace zeek::logging
+} // namespace logging
+} // namespace zeek
@@ -120,6 +120,8 @@ static std::optional<LeftoverLog> parse_shadow_log(const std::string& fname) {
     string default_ext = "." + Ascii::LogExt();
     if ( BifConst::LogAscii::gzip_level > 0 )
         default_ext += ".gz";
+    else if ( BifConst::LogAscii::zstd_level != 0 )
+        default_ext += ".zst";
 
     LeftoverLog rval = {};
     rval.filename = fname;
@@ -214,6 +216,9 @@ Ascii::Ascii(WriterFrontend* frontend) : WriterBackend(frontend) {
     formatter = nullptr;
     gzip_level = 0;
     gzfile = nullptr;
+    zstd_level = 0;
+    zstd_workers = 0;
+    zstd_seekable_frame_size = 0;
 
     InitConfigOptions();
     init_options = InitFilterOptions();
@@ -225,6 +230,9 @@ void Ascii::InitConfigOptions() {
     use_json = BifConst::LogAscii::use_json;
     enable_utf_8 = BifConst::LogAscii::enable_utf_8;
     gzip_level = BifConst::LogAscii::gzip_level;
+    zstd_level = BifConst::LogAscii::zstd_level;
+    zstd_workers = BifConst::LogAscii::zstd_workers;
+    zstd_seekable_frame_size = BifConst::LogAscii::zstd_seekable_frame_size;
 
     separator.assign((const char*)BifConst::LogAscii::separator->Bytes(), BifConst::LogAscii::separator->Len());
 
@@ -246,6 +254,9 @@ void Ascii::InitConfigOptions() {
     gzip_file_extension.assign((const char*)BifConst::LogAscii::gzip_file_extension->Bytes(),
                                BifConst::LogAscii::gzip_file_extension->Len());
 
+    zstd_file_extension.assign((const char*)BifConst::LogAscii::zstd_file_extension->Bytes(),
+                               BifConst::LogAscii::zstd_file_extension->Len());
+
     logdir = zeek::id::find_const<StringVal>("Log::default_logdir")->ToStdString();
 }
 
@@ -341,6 +352,29 @@ bool Ascii::InitFilterOptions() {
 
         else if ( strcmp(i->first, "gzip_file_extension") == 0 )
             gzip_file_extension.assign(i->second);
+
+        else if ( strcmp(i->first, "zstd_level") == 0 )
+            zstd_level = atoi(i->second);
+
+        else if ( strcmp(i->first, "zstd_workers") == 0 ) {
+            zstd_workers = atoi(i->second);
+
+            if ( zstd_workers < 0 ) {
+                Error("invalid value for 'zstd_workers', must not be negative.");
+                return false;
+            }
+        }
+
+        else if ( strcmp(i->first, "zstd_seekable_frame_size") == 0 )
+            zstd_seekable_frame_size = strtoull(i->second, nullptr, 10);
+
+        else if ( strcmp(i->first, "zstd_file_extension") == 0 )
+            zstd_file_extension.assign(i->second);
+    }
+
+    if ( gzip_level > 0 && zstd_level != 0 ) {
+        Error("'gzip_level' and 'zstd_level' cannot both enable compression.");
+        return false;
     }
 
     if ( ! InitFormatter() )
@@ -428,12 +462,7 @@ bool Ascii::DoInit(const WriterInfo& info, int num_fields, const threading::Fiel
     fname = path;
 
     if ( ! IsSpecial(fname) ) {
-        std::string ext = "." + LogExt();
-
-        if ( gzip_level > 0 ) {
-            ext += ".";
-            ext += gzip_file_extension.empty() ? "gz" : gzip_file_extension;
-        }
+        std::string ext = "." + LogExt() + CompressionExt();
 
         if ( fname.front() != '/' && ! logdir.empty() )
             fname = (zeek::filesystem::path(logdir) / fname).string();
@@ -502,6 +531,11 @@ bool Ascii::DoInit(const WriterInfo& info, int num_fields, const threading::Fiel
         gzfile = nullptr;
     }
 
+    if ( zstd_level != 0 && ! zstd.Open(fd, zstd_level, zstd_workers, zstd_seekable_frame_size) ) {
+        Error(Fmt("cannot zstd-compress %s: %s", fname.c_str(), zstd.Error().c_str()));
+        return false;
+    }
+
     if ( ! WriteHeader(path) ) {
         Error(Fmt("error writing to %s: %s", fname.c_str(), Strerror(errno)));
         return false;
@@ -555,6 +589,11 @@ bool Ascii::WriteHeader(const string& path) {
 }
 
 bool Ascii::DoFlush(double network_time) {
+    if ( zstd.IsOpen() && ! zstd.Flush() ) {
+        Error(Fmt("error flushing %s: %s", fname.c_str(), zstd.Error().c_str()));
+        return false;
+    }
+
     fsync(fd);
     return true;
 }
@@ -622,12 +661,7 @@ bool Ascii::DoRotate(const char* rotated_path, double open, double close, bool t
 
     CloseFile(close);
 
-    string nname = string(rotated_path) + "." + LogExt();
-
-    if ( gzip_level > 0 ) {
-        nname += ".";
-        nname += gzip_file_extension.empty() ? "gz" : gzip_file_extension;
-    }
+    string nname = string(rotated_path) + "." + LogExt() + CompressionExt();
 
     if ( rename(fname.c_str(), nname.c_str()) != 0 ) {
         char buf[256];
@@ -818,7 +852,25 @@ string Ascii::Timestamp(double t) {
     return tmp;
 }
 
+std::string Ascii::CompressionExt() const {
+    if ( gzip_level > 0 )
+        return "." + (gzip_file_extension.empty() ? "gz" : gzip_file_extension);
+
+    if ( zstd_level != 0 )
+        return "." + (zstd_file_extension.empty() ? "zst" : zstd_file_extension);
+
+    return "";
+}
+
 bool Ascii::InternalWrite(int fd, const char* data, int len) {
+    if ( zstd.IsOpen() ) {
+        if ( zstd.Write(data, len) )
+            return true;
+
+        Error(Fmt("Ascii::InternalWrite error: %s\n", zstd.Error().c_str()));
+        return false;
+    }
+
     if ( ! gzfile )
         return util::safe_write(fd, data, len);
 
@@ -839,6 +891,16 @@ bool Ascii::InternalWrite(int fd, const char* data, int len) {
 }
 
 bool Ascii::InternalClose(int fd) {
+    if ( zstd.IsOpen() ) {
+        bool ok = zstd.Close();
+        util::safe_close(fd);
+
+        if ( ! ok )
+            Error(Fmt("Ascii::InternalClose zstd error: %s\n", zstd.Error().c_str()));
+
+        return ok;
+    }
+
     if ( ! gzfile ) {
         util::safe_close(fd);
         return true;
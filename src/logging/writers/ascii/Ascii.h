@@ -8,6 +8,7 @@
 
 #include "zeek/Desc.h"
 #include "zeek/logging/WriterBackend.h"
+#include "zeek/logging/writers/ascii/Zstd.h"
 #include "zeek/threading/formatters/Ascii.h"
 #include "zeek/threading/formatters/JSON.h"
 
@@ -48,11 +49,13 @@ private:
     void InitConfigOptions();
     bool InitFilterOptions();
     bool InitFormatter();
+    std::string CompressionExt() const;
     bool InternalWrite(int fd, const char* data, int len);
     bool InternalClose(int fd);
 
     int fd;
     gzFile gzfile;
+    ZstdStream zstd;
     std::string fname;
     ODesc desc;
     bool ascii_done;
@@ -70,6 +73,10 @@ private:
 
     int gzip_level; // level > 0 enables gzip compression
     std::string gzip_file_extension;
+    int zstd_level; // level != 0 enables zstd compression
+    int zstd_workers;
+    uint64_t zstd_seekable_frame_size;
+    std::string zstd_file_extension;
     bool use_json;
     bool enable_utf_8;
     std::string json_timestamps;
@@ -0,0 +1,355 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek/logging/writers/ascii/Zstd.h"
+
+#include "zeek/zeek-config.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <unistd.h>
+
+#ifdef USE_ZSTD
+#include <zstd.h>
+#endif
+
+#include "zeek/3rdparty/doctest.h"
+#include "zeek/util.h"
+
+namespace zeek::logging::writer::detail {
+
+#ifdef USE_ZSTD
+
+namespace {
+
+// Constants of the seekable format, see
+// https://github.com/facebook/zstd/blob/dev/contrib/seekable_format/zstd_seekable_compression_format.md
+constexpr uint32_t SKIPPABLE_MAGIC = 0x184D2A5E;
+constexpr uint32_t SEEKABLE_MAGIC = 0x8F92EAB1;
+constexpr size_t SEEK_TABLE_FOOTER_SIZE = 9;
+
+// Keeps the compressed size of a frame within the 32 bits the seek table
+// has for it.
+constexpr uint64_t MAX_FRAME_SIZE = 1 << 30;
+
+void put_uint32_le(std::string& s, uint32_t v) {
+    for ( int i = 0; i < 4; i++ )
+        s.push_back(static_cast<char>(v >> (8 * i)));
+}
+
+} // namespace
+
+ZstdStream::~ZstdStream() { ZSTD_freeCCtx(ctx); }
+
+bool ZstdStream::Open(int arg_fd, int level, int workers, uint64_t arg_frame_size) {
+    if ( level < ZSTD_minCLevel() || level > ZSTD_maxCLevel() ) {
+        error = util::fmt("level must be between %d and %d", ZSTD_minCLevel(), ZSTD_maxCLevel());
+        return false;
+    }
+
+    if ( arg_frame_size > MAX_FRAME_SIZE ) {
+        error = util::fmt("seekable frame size must not exceed %" PRIu64 " bytes", MAX_FRAME_SIZE);
+        return false;
+    }
+
+    ctx = ZSTD_createCCtx();
+
+    if ( ! ctx ) {
+        error = "cannot allocate compression context";
+        return false;
+    }
+
+    size_t r = ZSTD_CCtx_setParameter(ctx, ZSTD_c_compressionLevel, level);
+
+    if ( ! ZSTD_isError(r) )
+        r = ZSTD_CCtx_setParameter(ctx, ZSTD_c_checksumFlag, 1);
+
+    if ( ! ZSTD_isError(r) && workers > 0 ) {
+        r = ZSTD_CCtx_setParameter(ctx, ZSTD_c_nbWorkers, workers);
+
+        if ( ZSTD_isError(r) ) {
+            error = util::fmt("cannot use %d workers, libzstd may lack multithreading support: %s", workers,
+                              ZSTD_getErrorName(r));
+            ZSTD_freeCCtx(ctx);
+            ctx = nullptr;
+            return false;
+        }
+    }
+
+    if ( ZSTD_isError(r) ) {
+        error = ZSTD_getErrorName(r);
+        ZSTD_freeCCtx(ctx);
+        ctx = nullptr;
+        return false;
+    }
+
+    fd = arg_fd;
+    frame_size = arg_frame_size;
+    frame_in = 0;
+    frame_out = 0;
+    seek_table.clear();
+    out.resize(ZSTD_CStreamOutSize());
+
+    return true;
+}
+
+bool ZstdStream::Output(const char* data, size_t len) {
+    if ( ! util::safe_write(fd, data, len) ) {
+        error = util::fmt("write failed: %s", strerror(errno));
+        return false;
+    }
+
+    return true;
+}
+
+bool ZstdStream::Compress(const char* data, size_t len, int mode) {
+    auto directive = static_cast<ZSTD_EndDirective>(mode);
+    ZSTD_inBuffer in = {data, len, 0};
+
+    while ( true ) {
+        ZSTD_outBuffer o = {out.data(), out.size(), 0};
+        size_t remaining = ZSTD_compressStream2(ctx, &o, &in, directive);
+
+        if ( ZSTD_isError(remaining) ) {
+            error = ZSTD_getErrorName(remaining);
+            return false;
+        }
+
+        if ( o.pos > 0 ) {
+            if ( ! Output(out.data(), o.pos) )
+                return false;
+
+            frame_out += o.pos;
+        }
+
+        // Continuing only needs to consume the input, while flushing and
+        // ending a frame need to write out everything.
+        if ( directive == ZSTD_e_continue ? in.pos == in.size : remaining == 0 )
+            return true;
+    }
+}
+
+bool ZstdStream::Write(const char* data, size_t len) {
+    while ( len > 0 ) {
+        size_t n = len;
+
+        if ( frame_size > 0 )
+            n = std::min(n, static_cast<size_t>(frame_size - frame_in));
+
+        if ( ! Compress(data, n, ZSTD_e_continue) )
+            return false;
+
+        frame_in += n;
+        data += n;
+        len -= n;
+
+        if ( frame_size > 0 && frame_in == frame_size && ! EndFrame() )
+            return false;
+    }
+
+    return true;
+}
+
+bool ZstdStream::Flush() { return Compress(nullptr, 0, ZSTD_e_flush); }
+
+bool ZstdStream::EndFrame() {
+    if ( ! Compress(nullptr, 0, ZSTD_e_end) )
+        return false;
+
+    if ( frame_size > 0 )
+        seek_table.emplace_back(static_cast<uint32_t>(frame_out), static_cast<uint32_t>(frame_in));
+
+    frame_in = 0;
+    frame_out = 0;
+    return true;
+}
+
+bool ZstdStream::WriteSeekTable() {
+    std::string table;
+    uint32_t content_size = seek_table.size() * 8 + SEEK_TABLE_FOOTER_SIZE;
+
+    put_uint32_le(table, SKIPPABLE_MAGIC);
+    put_uint32_le(table, content_size);
+
+    for ( const auto& [compressed, decompressed] : seek_table ) {
+        put_uint32_le(table, compressed);
+        put_uint32_le(table, decompressed);
+    }
+
+    put_uint32_le(table, seek_table.size());
+    table.push_back(0); // Descriptor: no per-frame checksums.
+    put_uint32_le(table, SEEKABLE_MAGIC);
+
+    return Output(table.data(), table.size());
+}
+
+bool ZstdStream::Close() {
+    if ( ! ctx )
+        return true;
+
+    // Even an empty stream gets a frame, so that the file is valid.
+    bool ok = true;
+
+    if ( frame_in > 0 || frame_out > 0 || seek_table.empty() )
+        ok = EndFrame();
+
+    if ( ok && frame_size > 0 )
+        ok = WriteSeekTable();
+
+    ZSTD_freeCCtx(ctx);
+    ctx = nullptr;
+    out = {};
+    seek_table = {};
+
+    return ok;
+}
+
+#else
+
+ZstdStream::~ZstdStream() {}
+
+bool ZstdStream::Open(int arg_fd, int level, int workers, uint64_t arg_frame_size) {
+    error = "Zeek was built without zstd support";
+    return false;
+}
+
+bool ZstdStream::Write(const char* data, size_t len) { return false; }
+
+bool ZstdStream::Flush() { return false; }
+
+bool ZstdStream::Close() { return true; }
+
+#endif
+
+#ifdef USE_ZSTD
+
+TEST_SUITE_BEGIN("writers ascii zstd");
+
+namespace {
+
+std::string compress(const std::string& data, int workers, uint64_t frame_size) {
+    FILE* f = tmpfile();
+    REQUIRE(f);
+
+    ZstdStream zstd;
+    REQUIRE(zstd.Open(fileno(f), 3, workers, frame_size));
+
+    // Write in odd-sized pieces to cross frame boundaries.
+    for ( size_t i = 0; i < data.size(); i += 1000 )
+        CHECK(zstd.Write(data.data() + i, std::min(size_t(1000), data.size() - i)));
+
+    CHECK(zstd.Close());
+    CHECK_FALSE(zstd.IsOpen());
+
+    std::string result(lseek(fileno(f), 0, SEEK_END), '\0');
+    CHECK(pread(fileno(f), result.data(), result.size(), 0) == static_cast<ssize_t>(result.size()));
+    fclose(f);
+
+    return result;
+}
+
+std::string decompress(const std::string& data) {
+    std::string result;
+    std::vector<char> buf(ZSTD_DStreamOutSize());
+    ZSTD_DCtx* dctx = ZSTD_createDCtx();
+    ZSTD_inBuffer in = {data.data(), data.size(), 0};
+
+    while ( in.pos < in.size ) {
+        ZSTD_outBuffer o = {buf.data(), buf.size(), 0};
+        size_t r = ZSTD_decompressStream(dctx, &o, &in);
+        REQUIRE_FALSE(ZSTD_isError(r));
+        result.append(buf.data(), o.pos);
+    }
+
+    ZSTD_freeDCtx(dctx);
+    return result;
+}
+
+uint32_t get_uint32_le(const std::string& s, size_t pos) {
+    uint32_t v = 0;
+
+    for ( int i = 0; i < 4; i++ )
+        v |= static_cast<uint32_t>(static_cast<unsigned char>(s[pos + i])) << (8 * i);
+
+    return v;
+}
+
+std::string sample_log(size_t lines) {
+    std::string s;
+
+    for ( size_t i = 0; i < lines; i++ )
+        s += util::fmt("1300475167.%06zu\tC%zu\t141.142.220.118\t%zu\t141.142.2.2\t53\tudp\tdns\n", i, i * 7919,
+                       40000 + i % 1000);
+
+    return s;
+}
+
+} // namespace
+
+TEST_CASE("single frame") {
+    auto data = sample_log(2000);
+    auto compressed = compress(data, 0, 0);
+
+    CHECK(compressed.size() < data.size() / 2);
+    CHECK(ZSTD_findFrameCompressedSize(compressed.data(), compressed.size()) == compressed.size());
+    CHECK(decompress(compressed) == data);
+
+    CHECK(decompress(compress("", 0, 0)).empty());
+}
+
+TEST_CASE("seekable frames") {
+    auto data = sample_log(2000);
+    constexpr uint64_t frame_size = 16384;
+
+    for ( int workers : {0, 2} ) {
+        auto compressed = compress(data, workers, frame_size);
+        CHECK(decompress(compressed) == data);
+
+        // Walk the seek table from the footer.
+        REQUIRE(compressed.size() > SEEK_TABLE_FOOTER_SIZE);
+        size_t footer = compressed.size() - SEEK_TABLE_FOOTER_SIZE;
+        CHECK(get_uint32_le(compressed, footer + 5) == SEEKABLE_MAGIC);
+        CHECK(compressed[footer + 4] == 0);
+
+        uint32_t frames = get_uint32_le(compressed, footer);
+        CHECK(frames == (data.size() + frame_size - 1) / frame_size);
+
+        size_t table = footer - frames * 8 - 8;
+        CHECK(get_uint32_le(compressed, table) == SKIPPABLE_MAGIC);
+        CHECK(get_uint32_le(compressed, table + 4) == frames * 8 + SEEK_TABLE_FOOTER_SIZE);
+
+        // Each frame must decompress on its own into its part of the data.
+        size_t compressed_offset = 0;
+        size_t data_offset = 0;
+
+        for ( uint32_t i = 0; i < frames; i++ ) {
+            uint32_t csize = get_uint32_le(compressed, table + 8 + i * 8);
+            uint32_t dsize = get_uint32_le(compressed, table + 12 + i * 8);
+
+            CHECK(ZSTD_findFrameCompressedSize(compressed.data() + compressed_offset, csize) == csize);
+            CHECK(decompress(compressed.substr(compressed_offset, csize)) == data.substr(data_offset, dsize));
+
+            compressed_offset += csize;
+            data_offset += dsize;
+        }
+
+        CHECK(compressed_offset == table);
+        CHECK(data_offset == data.size());
+    }
+}
+
+TEST_CASE("invalid settings") {
+    ZstdStream zstd;
+    CHECK_FALSE(zstd.Open(1, ZSTD_maxCLevel() + 1, 0, 0));
+    CHECK_FALSE(zstd.Open(1, 3, 0, uint64_t(1) << 32));
+    CHECK_FALSE(zstd.IsOpen());
+    CHECK_FALSE(zstd.Error().empty());
+}
+
+TEST_SUITE_END();
+
+#endif
+
+} // namespace zeek::logging::writer::detail
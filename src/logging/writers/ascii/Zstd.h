@@ -0,0 +1,102 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+//
+// zstd compression for the ASCII writer's output files.
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+struct ZSTD_CCtx_s;
+
+namespace zeek::logging::writer::detail {
+
+/**
+ * Compresses data written to a file descriptor with zstd.
+ *
+ * Compression may run in zstd's own worker threads, so that a single
+ * busy log isn't limited to the throughput of one core.
+ *
+ * With a frame size set, the output uses zstd's seekable format: the
+ * data is split into independent frames of that many uncompressed bytes,
+ * and closing the stream appends a seek table listing the frames. Regular
+ * zstd tools still decompress such files as a whole, while tools aware of
+ * the format can read parts of them without starting from the beginning.
+ */
+class ZstdStream {
+public:
+    ZstdStream() = default;
+    ~ZstdStream();
+
+    ZstdStream(const ZstdStream&) = delete;
+    ZstdStream& operator=(const ZstdStream&) = delete;
+
+    /**
+     * Starts compressing into the given file descriptor.
+     *
+     * @param fd The file descriptor to write to. It remains owned by the
+     * caller.
+     *
+     * @param level The zstd compression level. Negative values select the
+     * faster levels.
+     *
+     * @param workers The number of threads compressing in the background,
+     * or 0 to compress in the calling thread.
+     *
+     * @param frame_size The number of uncompressed bytes per frame of the
+     * seekable format, or 0 to write a single frame.
+     *
+     * @return False if setting up compression failed. Error() then returns
+     * the reason.
+     */
+    bool Open(int fd, int level, int workers, uint64_t frame_size);
+
+    /**
+     * Compresses data. Compressed output is written to the file descriptor
+     * as it becomes available.
+     */
+    bool Write(const char* data, size_t len);
+
+    /**
+     * Writes out everything written so far, waiting for the workers.
+     */
+    bool Flush();
+
+    /**
+     * Ends the current frame and, for the seekable format, writes the seek
+     * table. Doesn't close the file descriptor.
+     */
+    bool Close();
+
+    /**
+     * Returns true between successful calls of Open() and Close().
+     */
+    bool IsOpen() const { return ctx != nullptr; }
+
+    /**
+     * Returns a description of the last error.
+     */
+    const std::string& Error() const { return error; }
+
+private:
+    bool Compress(const char* data, size_t len, int mode);
+    bool EndFrame();
+    bool WriteSeekTable();
+    bool Output(const char* data, size_t len);
+
+    int fd = -1;
+    ZSTD_CCtx_s* ctx = nullptr;
+    std::vector<char> out;
+    std::string error;
+
+    uint64_t frame_size = 0;
+    uint64_t frame_in = 0;  // Uncompressed bytes in the current frame.
+    uint64_t frame_out = 0; // Compressed bytes of the current frame.
+
+    // Compressed and uncompressed sizes of the completed frames.
+    std::vector<std::pair<uint32_t, uint32_t>> seek_table;
+};
+
+} // namespace zeek::logging::writer::detail
@@ -0,0 +1,358 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek/logging/writers/parquet/Parquet.h"
+
+#include <arrow/api.h>
+#include <arrow/io/file.h>
+#include <parquet/arrow/writer.h>
+#include <parquet/properties.h>
+#include <cerrno>
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+
+#include "zeek/ID.h"
+#include "zeek/Val.h"
+#include "zeek/logging/writers/parquet/parquet.bif.h"
+#include "zeek/threading/Formatter.h"
+#include "zeek/threading/SerialTypes.h"
+#include "zeek/util.h"
+
+using namespace std;
+using zeek::threading::Field;
+using zeek::threading::Value;
+
+namespace zeek::logging::writer::detail {
+
+// Returns a builder for values of the given type, or null if the type
+// isn't supported. Enums are dictionary encoded, apart from elements of
+// containers, which are plain strings.
+static shared_ptr<arrow::ArrayBuilder> make_builder(TypeTag type, TypeTag subtype, bool top_level) {
+    auto* pool = arrow::default_memory_pool();
+
+    switch ( type ) {
+        case TYPE_BOOL: return make_shared<arrow::BooleanBuilder>(pool);
+        case TYPE_INT: return make_shared<arrow::Int64Builder>(pool);
+        case TYPE_COUNT: return make_shared<arrow::UInt64Builder>(pool);
+        case TYPE_PORT: return make_shared<arrow::UInt16Builder>(pool);
+
+        case TYPE_DOUBLE:
+        case TYPE_INTERVAL: return make_shared<arrow::DoubleBuilder>(pool);
+
+        case TYPE_TIME:
+            return make_shared<arrow::TimestampBuilder>(arrow::timestamp(arrow::TimeUnit::MICRO, "UTC"), pool);
+
+        case TYPE_ENUM:
+            if ( top_level )
+                return make_shared<arrow::StringDictionary32Builder>(pool);
+
+            [[fallthrough]];
+
+        case TYPE_ADDR:
+        case TYPE_SUBNET:
+        case TYPE_STRING:
+        case TYPE_FILE:
+        case TYPE_FUNC: return make_shared<arrow::StringBuilder>(pool);
+
+        case TYPE_TABLE:
+        case TYPE_VECTOR: {
+            auto values = make_builder(subtype, TYPE_VOID, false);
+            if ( ! values )
+                return nullptr;
+
+            return make_shared<arrow::ListBuilder>(pool, values);
+        }
+
+        default: return nullptr;
+    }
+}
+
+// Parquet strings hold UTF-8. Escape anything else the way the JSON
+// formatter does.
+static arrow::Status append_string(arrow::StringBuilder* builder, const char* data, int len) {
+    for ( int i = 0; i < len; i++ ) {
+        if ( static_cast<unsigned char>(data[i]) >= 0x80 )
+            return builder->Append(util::json_escape_utf8(data, len, false));
+    }
+
+    return builder->Append(data, len);
+}
+
+Parquet::Parquet(WriterFrontend* frontend) : WriterBackend(frontend) {
+    compression = BifConst::LogParquet::compression->AsInt();
+    compression_level = BifConst::LogParquet::compression_level;
+    row_group_size = std::max(BifConst::LogParquet::row_group_size, static_cast<zeek_uint_t>(1));
+    enable_dictionary = BifConst::LogParquet::enable_dictionary;
+
+    logdir = zeek::id::find_const<StringVal>("Log::default_logdir")->ToStdString();
+}
+
+Parquet::~Parquet() = default;
+
+bool Parquet::CheckStatus(const arrow::Status& status, const char* what) {
+    if ( status.ok() )
+        return true;
+
+    Error(Fmt("failed to %s for %s: %s", what, fname.c_str(), status.ToString().c_str()));
+    return false;
+}
+
+bool Parquet::DoInit(const WriterInfo& info, int num_fields, const Field* const* fields) {
+    fname = info.path;
+
+    if ( fname.find("/dev/") == 0 ) {
+        Error(Fmt("cannot write Parquet to %s", fname.c_str()));
+        return false;
+    }
+
+    if ( fname.front() != '/' && ! logdir.empty() )
+        fname = (zeek::filesystem::path(logdir) / fname).string();
+
+    fname += ".parquet";
+
+    arrow::FieldVector arrow_fields;
+
+    for ( int i = 0; i < num_fields; i++ ) {
+        auto builder = make_builder(fields[i]->type, fields[i]->subtype, true);
+
+        if ( ! builder ) {
+            Error(Fmt("unsupported type %s for field %s", type_name(fields[i]->type), fields[i]->name));
+            return false;
+        }
+
+        arrow_fields.emplace_back(arrow::field(fields[i]->name, builder->type()));
+        builders.emplace_back(std::move(builder));
+    }
+
+    schema = arrow::schema(std::move(arrow_fields));
+
+    parquet::WriterProperties::Builder props;
+    props.max_row_group_length(row_group_size);
+
+    if ( enable_dictionary )
+        props.enable_dictionary();
+    else
+        props.disable_dictionary();
+
+    switch ( compression ) {
+        case BifEnum::LogParquet::Compression::COMPRESSION_NONE:
+            props.compression(parquet::Compression::UNCOMPRESSED);
+            break;
+
+        case BifEnum::LogParquet::Compression::COMPRESSION_SNAPPY:
+            props.compression(parquet::Compression::SNAPPY);
+            break;
+
+        case BifEnum::LogParquet::Compression::COMPRESSION_GZIP:
+            props.compression(parquet::Compression::GZIP);
+            break;
+
+        case BifEnum::LogParquet::Compression::COMPRESSION_ZSTD:
+            props.compression(parquet::Compression::ZSTD);
+            break;
+
+        default: Error(Fmt("unknown compression %" PRId64, compression)); return false;
+    }
+
+    if ( compression_level != 0 && (compression == BifEnum::LogParquet::Compression::COMPRESSION_GZIP ||
+                                     compression == BifEnum::LogParquet::Compression::COMPRESSION_ZSTD) )
+        props.compression_level(static_cast<int>(compression_level));
+
+    properties = props.build();
+
+    // The file is created with the first write, so that rotation doesn't
+    // leave empty files behind.
+    return true;
+}
+
+bool Parquet::OpenFile() {
+    auto f = arrow::io::FileOutputStream::Open(fname);
+
+    if ( ! f.ok() )
+        return CheckStatus(f.status(), "open file");
+
+    file = *f;
+
+    auto arrow_props = parquet::ArrowWriterProperties::Builder().store_schema()->build();
+    auto w = parquet::arrow::FileWriter::Open(*schema, arrow::default_memory_pool(), file, properties, arrow_props);
+
+    if ( ! w.ok() )
+        return CheckStatus(w.status(), "create writer");
+
+    writer = std::move(*w);
+    return true;
+}
+
+bool Parquet::WriteRowGroup() {
+    if ( rows == 0 )
+        return true;
+
+    if ( ! writer && ! OpenFile() )
+        return false;
+
+    arrow::ArrayVector arrays;
+    arrays.reserve(builders.size());
+
+    for ( auto& b : builders ) {
+        shared_ptr<arrow::Array> a;
+
+        if ( ! CheckStatus(b->Finish(&a), "finish column") )
+            return false;
+
+        arrays.emplace_back(std::move(a));
+    }
+
+    auto table = arrow::Table::Make(schema, arrays, rows);
+    auto n = rows;
+    rows = 0;
+
+    return CheckStatus(writer->WriteTable(*table, n), "write row group");
+}
+
+bool Parquet::CloseFile() {
+    if ( ! WriteRowGroup() )
+        return false;
+
+    if ( ! writer )
+        return true;
+
+    bool ok = CheckStatus(writer->Close(), "close writer") && CheckStatus(file->Close(), "close file");
+
+    writer.reset();
+    file.reset();
+
+    return ok;
+}
+
+bool Parquet::AppendValue(arrow::ArrayBuilder* builder, const Value* val) {
+    if ( ! val->present )
+        return CheckStatus(builder->AppendNull(), "append value");
+
+    arrow::Status status;
+
+    switch ( val->type ) {
+        case TYPE_BOOL: status = static_cast<arrow::BooleanBuilder*>(builder)->Append(val->val.int_val != 0); break;
+
+        case TYPE_INT: status = static_cast<arrow::Int64Builder*>(builder)->Append(val->val.int_val); break;
+
+        case TYPE_COUNT: status = static_cast<arrow::UInt64Builder*>(builder)->Append(val->val.uint_val); break;
+
+        case TYPE_PORT:
+            status = static_cast<arrow::UInt16Builder*>(builder)->Append(static_cast<uint16_t>(val->val.port_val.port));
+            break;
+
+        case TYPE_DOUBLE:
+        case TYPE_INTERVAL: status = static_cast<arrow::DoubleBuilder*>(builder)->Append(val->val.double_val); break;
+
+        case TYPE_TIME: {
+            auto us = static_cast<int64_t>(std::llround(val->val.double_val * 1e6));
+            status = static_cast<arrow::TimestampBuilder*>(builder)->Append(us);
+            break;
+        }
+
+        case TYPE_ADDR:
+            status =
+                static_cast<arrow::StringBuilder*>(builder)->Append(threading::Formatter::Render(val->val.addr_val));
+            break;
+
+        case TYPE_SUBNET:
+            status =
+                static_cast<arrow::StringBuilder*>(builder)->Append(threading::Formatter::Render(val->val.subnet_val));
+            break;
+
+        case TYPE_ENUM:
+            if ( builder->type()->id() == arrow::Type::DICTIONARY ) {
+                std::string_view s{val->val.string_val.data, static_cast<size_t>(val->val.string_val.length)};
+                status = static_cast<arrow::StringDictionary32Builder*>(builder)->Append(s);
+                break;
+            }
+
+            [[fallthrough]];
+
+        case TYPE_STRING:
+        case TYPE_FILE:
+        case TYPE_FUNC:
+            status = append_string(static_cast<arrow::StringBuilder*>(builder), val->val.string_val.data,
+                                   val->val.string_val.length);
+            break;
+
+        case TYPE_TABLE:
+        case TYPE_VECTOR: {
+            auto* list = static_cast<arrow::ListBuilder*>(builder);
+
+            if ( ! CheckStatus(list->Append(), "append value") )
+                return false;
+
+            bool is_set = val->type == TYPE_TABLE;
+            auto size = is_set ? val->val.set_val.size : val->val.vector_val.size;
+            auto* vals = is_set ? val->val.set_val.vals : val->val.vector_val.vals;
+
+            for ( zeek_int_t i = 0; i < size; i++ ) {
+                if ( ! AppendValue(list->value_builder(), vals[i]) )
+                    return false;
+            }
+
+            return true;
+        }
+
+        default: Error(Fmt("unsupported field type %s", type_name(val->type))); return false;
+    }
+
+    return CheckStatus(status, "append value");
+}
+
+bool Parquet::DoWrite(int num_fields, const Field* const* fields, Value** vals) {
+    for ( int i = 0; i < num_fields; i++ ) {
+        if ( AppendValue(builders[i].get(), vals[i]) )
+            continue;
+
+        // Complete the row with nulls in the columns that didn't receive
+        // it, so that all columns keep the same length and the rows
+        // written before still make it into the file.
+        for ( auto& b : builders ) {
+            if ( b->length() == rows )
+                CheckStatus(b->AppendNull(), "append value");
+        }
+
+        ++rows;
+        return false;
+    }
+
+    if ( static_cast<zeek_uint_t>(++rows) >= row_group_size )
+        return WriteRowGroup();
+
+    return true;
+}
+
+bool Parquet::DoRotate(const char* rotated_path, double open, double close, bool terminating) {
+    bool have_file = writer || rows > 0;
+
+    if ( ! CloseFile() ) {
+        FinishedRotation();
+        return false;
+    }
+
+    if ( ! have_file ) {
+        FinishedRotation();
+        return true;
+    }
+
+    string nname = string(rotated_path) + ".parquet";
+
+    if ( rename(fname.c_str(), nname.c_str()) != 0 ) {
+        Error(Fmt("failed to rename %s to %s: %s", fname.c_str(), nname.c_str(), Strerror(errno)));
+        FinishedRotation();
+        return false;
+    }
+
+    if ( ! FinishedRotation(nname.c_str(), fname.c_str(), open, close, terminating) ) {
+        Error(Fmt("error rotating %s to %s", fname.c_str(), nname.c_str()));
+        return false;
+    }
+
+    return true;
+}
+
+bool Parquet::DoFinish(double network_time) { return CloseFile(); }
+
+} // namespace zeek::logging::writer::detail
@@ -0,0 +1,81 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+//
+// Log writer for Parquet files.
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "zeek/logging/WriterBackend.h"
+
+namespace arrow {
+class ArrayBuilder;
+class DataType;
+class Schema;
+class Status;
+
+namespace io {
+class FileOutputStream;
+}
+} // namespace arrow
+
+namespace parquet {
+class WriterProperties;
+
+namespace arrow {
+class FileWriter;
+}
+} // namespace parquet
+
+namespace zeek::logging::writer::detail {
+
+/**
+ * Writes logs as Parquet files, one column per log field.
+ *
+ * Records are collected in Arrow builders and written out as a row group
+ * once LogParquet::row_group_size of them are buffered, or when the file
+ * is rotated or closed. A file only becomes readable once it's closed, as
+ * Parquet stores its metadata in a footer.
+ */
+class Parquet : public WriterBackend {
+public:
+    explicit Parquet(WriterFrontend* frontend);
+    ~Parquet() override;
+
+    static WriterBackend* Instantiate(WriterFrontend* frontend) { return new Parquet(frontend); }
+
+protected:
+    bool DoInit(const WriterInfo& info, int num_fields, const threading::Field* const* fields) override;
+    bool DoWrite(int num_fields, const threading::Field* const* fields, threading::Value** vals) override;
+    bool DoSetBuf(bool enabled) override { return true; }
+    bool DoRotate(const char* rotated_path, double open, double close, bool terminating) override;
+    bool DoFlush(double network_time) override { return true; }
+    bool DoFinish(double network_time) override;
+    bool DoHeartbeat(double network_time, double current_time) override { return true; }
+
+private:
+    bool OpenFile();
+    bool CloseFile();
+    bool WriteRowGroup();
+    bool AppendValue(::arrow::ArrayBuilder* builder, const threading::Value* val);
+    bool CheckStatus(const ::arrow::Status& status, const char* what);
+
+    std::string fname;
+    std::string logdir;
+    std::shared_ptr<::arrow::Schema> schema;
+    std::vector<std::shared_ptr<::arrow::ArrayBuilder>> builders;
+    int64_t rows = 0; // Records in the builders.
+
+    std::shared_ptr<parquet::WriterProperties> properties;
+    std::shared_ptr<::arrow::io::FileOutputStream> file;
+    std::unique_ptr<parquet::arrow::FileWriter> writer;
+
+    int64_t compression;
+    int64_t compression_level;
+    zeek_uint_t row_group_size;
+    bool enable_dictionary;
+};
+
+} // namespace zeek::logging::writer::detail
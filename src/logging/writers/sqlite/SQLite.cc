@@ -4,7 +4,10 @@
 
 #include "zeek/zeek-config.h"
 
+#include <unistd.h>
+#include <algorithm>
 #include <cerrno>
+#include <climits>
 #include <string>
 #include <vector>
 
@@ -18,7 +21,8 @@ using zeek::threading::Value;
 
 namespace zeek::logging::writer::detail {
 
-SQLite::SQLite(WriterFrontend* frontend) : WriterBackend(frontend), fields(), num_fields(), db(), st() {
+SQLite::SQLite(WriterFrontend* frontend)
+    : WriterBackend(frontend), fields(), num_fields(), db(), st(), multi_st(), multi_rows() {
     set_separator.assign((const char*)BifConst::LogSQLite::set_separator->Bytes(),
                          BifConst::LogSQLite::set_separator->Len());
 
@@ -28,6 +32,9 @@ SQLite::SQLite(WriterFrontend* frontend) : WriterBackend(frontend), fields(), nu
 
     synchronous = BifConst::LogSQLite::synchronous->AsInt();
     journal_mode = BifConst::LogSQLite::journal_mode->AsInt();
+    use_transactions = BifConst::LogSQLite::use_transactions;
+    insert_rows = BifConst::LogSQLite::insert_rows;
+    busy_timeout_ms = static_cast<int>(std::clamp(BifConst::LogSQLite::busy_timeout * 1000.0, 0.0, double(INT_MAX)));
 
     threading::formatter::Ascii::SeparatorInfo sep_info(string(), set_separator, unset_field, empty_field);
     io = new threading::formatter::Ascii(this, sep_info);
@@ -36,6 +43,7 @@ SQLite::SQLite(WriterFrontend* frontend) : WriterBackend(frontend), fields(), nu
 SQLite::~SQLite() {
     if ( db != 0 ) {
         sqlite3_finalize(st);
+        sqlite3_finalize(multi_st);
         if ( ! sqlite3_close(db) )
             Error("Sqlite could not close connection");
 
@@ -131,6 +139,9 @@ bool SQLite::DoInit(const WriterInfo& info, int arg_num_fields, const Field* con
                                     SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_NOMUTEX, NULL)) )
         return false;
 
+    if ( checkError(sqlite3_busy_timeout(db, busy_timeout_ms)) )
+        return false;
+
     char* errorMsg = nullptr;
     int res;
     switch ( synchronous ) {
@@ -229,20 +240,17 @@ bool SQLite::DoInit(const WriterInfo& info, int arg_num_fields, const Field* con
     }
 
     // create the prepared statement that will be re-used forever...
-    string insert = "VALUES (";
+    string insert = "VALUES ";
+    string row = "(";
     string names = "INSERT INTO " + tablename + " ( ";
 
     for ( unsigned int i = 0; i < num_fields; i++ ) {
-        bool ac = true;
-
-        if ( i == 0 )
-            ac = false;
-        else {
+        if ( i != 0 ) {
             names += ", ";
-            insert += ", ";
+            row += ", ";
         }
 
-        insert += "?";
+        row += "?";
 
         char* fieldname = sqlite3_mprintf("%Q", fields[i]->name);
         if ( fieldname == 0 ) {
@@ -254,52 +262,72 @@ bool SQLite::DoInit(const WriterInfo& info, int arg_num_fields, const Field* con
         sqlite3_free(fieldname);
     }
 
-    insert += ");";
+    row += ")";
     names += ") ";
 
-    insert = names + insert;
+    insert = names + insert + row + ";";
 
     if ( checkError(sqlite3_prepare_v2(db, insert.c_str(), insert.size() + 1, &st, NULL)) )
         return false;
 
+    // A second statement inserts several rows at once, which saves most of
+    // the per-statement overhead for larger batches. SQLite limits the
+    // number of parameters a statement can have.
+    if ( num_fields > 0 ) {
+        auto max_rows = sqlite3_limit(db, SQLITE_LIMIT_VARIABLE_NUMBER, -1) / static_cast<int>(num_fields);
+        multi_rows = static_cast<int>(std::min(insert_rows, static_cast<zeek_uint_t>(max_rows)));
+    }
+
+    if ( multi_rows > 1 ) {
+        string multi_insert = names + "VALUES " + row;
+
+        for ( int i = 1; i < multi_rows; i++ )
+            multi_insert += ", " + row;
+
+        multi_insert += ";";
+
+        if ( checkError(sqlite3_prepare_v2(db, multi_insert.c_str(), multi_insert.size() + 1, &multi_st, NULL)) )
+            return false;
+    }
+
     return true;
 }
 
-int SQLite::AddParams(Value* val, int pos) {
+int SQLite::AddParams(sqlite3_stmt* stmt, Value* val, int field, int pos) {
     if ( ! val->present )
-        return sqlite3_bind_null(st, pos);
+        return sqlite3_bind_null(stmt, pos);
 
     switch ( val->type ) {
-        case TYPE_BOOL: return sqlite3_bind_int(st, pos, val->val.int_val != 0 ? 1 : 0);
+        case TYPE_BOOL: return sqlite3_bind_int(stmt, pos, val->val.int_val != 0 ? 1 : 0);
 
-        case TYPE_INT: return sqlite3_bind_int(st, pos, val->val.int_val);
+        case TYPE_INT: return sqlite3_bind_int(stmt, pos, val->val.int_val);
 
-        case TYPE_COUNT: return sqlite3_bind_int(st, pos, val->val.uint_val);
+        case TYPE_COUNT: return sqlite3_bind_int(stmt, pos, val->val.uint_val);
 
-        case TYPE_PORT: return sqlite3_bind_int(st, pos, val->val.port_val.port);
+        case TYPE_PORT: return sqlite3_bind_int(stmt, pos, val->val.port_val.port);
 
         case TYPE_SUBNET: {
             string out = io->Render(val->val.subnet_val);
-            return sqlite3_bind_text(st, pos, out.data(), out.size(), SQLITE_TRANSIENT);
+            return sqlite3_bind_text(stmt, pos, out.data(), out.size(), SQLITE_TRANSIENT);
         }
 
         case TYPE_ADDR: {
             string out = io->Render(val->val.addr_val);
-            return sqlite3_bind_text(st, pos, out.data(), out.size(), SQLITE_TRANSIENT);
+            return sqlite3_bind_text(stmt, pos, out.data(), out.size(), SQLITE_TRANSIENT);
         }
 
         case TYPE_TIME:
         case TYPE_INTERVAL:
-        case TYPE_DOUBLE: return sqlite3_bind_double(st, pos, val->val.double_val);
+        case TYPE_DOUBLE: return sqlite3_bind_double(stmt, pos, val->val.double_val);
 
         case TYPE_ENUM:
         case TYPE_STRING:
         case TYPE_FILE:
         case TYPE_FUNC: {
             if ( ! val->val.string_val.length || val->val.string_val.length == 0 )
-                return sqlite3_bind_null(st, pos);
+                return sqlite3_bind_null(stmt, pos);
 
-            return sqlite3_bind_text(st, pos, val->val.string_val.data, val->val.string_val.length, SQLITE_TRANSIENT);
+            return sqlite3_bind_text(stmt, pos, val->val.string_val.data, val->val.string_val.length, SQLITE_TRANSIENT);
         }
 
         case TYPE_TABLE: {
@@ -315,11 +343,11 @@ int SQLite::AddParams(Value* val, int pos) {
                     if ( j > 0 )
                         desc.AddRaw(set_separator);
 
-                    io->Describe(&desc, val->val.set_val.vals[j], fields[pos - 1]->name);
+                    io->Describe(&desc, val->val.set_val.vals[j], fields[field]->name);
                 }
 
             desc.RemoveEscapeSequence(set_separator);
-            return sqlite3_bind_text(st, pos, (const char*)desc.Bytes(), desc.Len(), SQLITE_TRANSIENT);
+            return sqlite3_bind_text(stmt, pos, (const char*)desc.Bytes(), desc.Len(), SQLITE_TRANSIENT);
         }
 
         case TYPE_VECTOR: {
@@ -335,35 +363,91 @@ int SQLite::AddParams(Value* val, int pos) {
                     if ( j > 0 )
                         desc.AddRaw(set_separator);
 
-                    io->Describe(&desc, val->val.vector_val.vals[j], fields[pos - 1]->name);
+                    io->Describe(&desc, val->val.vector_val.vals[j], fields[field]->name);
                 }
 
             desc.RemoveEscapeSequence(set_separator);
-            return sqlite3_bind_text(st, pos, (const char*)desc.Bytes(), desc.Len(), SQLITE_TRANSIENT);
+            return sqlite3_bind_text(stmt, pos, (const char*)desc.Bytes(), desc.Len(), SQLITE_TRANSIENT);
         }
 
         default: Error(Fmt("unsupported field format %d", val->type)); return 0;
     }
 }
 
-bool SQLite::DoWrite(int num_fields, const Field* const* fields, Value** vals) {
+bool SQLite::Insert(sqlite3_stmt* stmt, int num_fields, int num_rows, Value** const* vals) {
     // bind parameters
-    for ( int i = 0; i < num_fields; i++ ) {
-        if ( checkError(AddParams(vals[i], i + 1)) )
-            return false;
+    for ( int r = 0; r < num_rows; r++ ) {
+        for ( int i = 0; i < num_fields; i++ ) {
+            if ( checkError(AddParams(stmt, vals[r][i], i, r * num_fields + i + 1)) ) {
+                sqlite3_clear_bindings(stmt);
+                return false;
+            }
+        }
     }
 
     // execute query
-    if ( checkError(sqlite3_step(st)) )
+    if ( checkError(sqlite3_step(stmt)) ) {
+        sqlite3_reset(stmt);
         return false;
+    }
 
     // clean up and make ready for next query execution
-    if ( checkError(sqlite3_clear_bindings(st)) )
+    if ( checkError(sqlite3_clear_bindings(stmt)) )
         return false;
 
-    if ( checkError(sqlite3_reset(st)) )
+    if ( checkError(sqlite3_reset(stmt)) )
+        return false;
+
+    return true;
+}
+
+bool SQLite::BeginTransaction() {
+    // SQLite's busy handler waits for other connections holding a write
+    // transaction. Connections sharing the cache, however, get told that
+    // the database is locked right away, so wait for them here, up to the
+    // same timeout.
+    int res = sqlite3_exec(db, "BEGIN IMMEDIATE;", NULL, NULL, NULL);
+
+    for ( int waited = 0; (res & 0xff) == SQLITE_LOCKED && waited < busy_timeout_ms; waited += LOCKED_RETRY_MS ) {
+        usleep(LOCKED_RETRY_MS * 1000);
+        res = sqlite3_exec(db, "BEGIN IMMEDIATE;", NULL, NULL, NULL);
+    }
+
+    return ! checkError(res);
+}
+
+bool SQLite::Rollback() {
+    sqlite3_exec(db, "ROLLBACK;", NULL, NULL, NULL);
+    return false;
+}
+
+bool SQLite::DoWrite(int num_fields, const Field* const* fields, Value** vals) {
+    return DoWriteBatch(num_fields, fields, 1, &vals);
+}
+
+bool SQLite::DoWriteBatch(int num_fields, const Field* const* fields, int num_writes, Value** const* vals) {
+    // Without a transaction around it, SQLite commits, and syncs to disk,
+    // every single insert on its own.
+    if ( use_transactions && ! BeginTransaction() )
         return false;
 
+    int j = 0;
+
+    if ( multi_st ) {
+        for ( ; num_writes - j >= multi_rows; j += multi_rows ) {
+            if ( ! Insert(multi_st, num_fields, multi_rows, vals + j) )
+                return use_transactions ? Rollback() : false;
+        }
+    }
+
+    for ( ; j < num_writes; j++ ) {
+        if ( ! Insert(st, num_fields, 1, vals + j) )
+            return use_transactions ? Rollback() : false;
+    }
+
+    if ( use_transactions && checkError(sqlite3_exec(db, "COMMIT;", NULL, NULL, NULL)) )
+        return Rollback();
+
     return true;
 }
 
@@ -23,6 +23,8 @@ public:
 protected:
     bool DoInit(const WriterInfo& info, int arg_num_fields, const threading::Field* const* arg_fields) override;
     bool DoWrite(int num_fields, const threading::Field* const* fields, threading::Value** vals) override;
+    bool DoWriteBatch(int num_fields, const threading::Field* const* fields, int num_writes,
+                      threading::Value** const* vals) override;
     bool DoSetBuf(bool enabled) override { return true; }
     bool DoRotate(const char* rotated_path, double open, double close, bool terminating) override;
     bool DoFlush(double network_time) override { return true; }
@@ -32,7 +34,10 @@ protected:
 private:
     bool checkError(int code);
 
-    int AddParams(threading::Value* val, int pos);
+    bool BeginTransaction();
+    bool Rollback();
+    bool Insert(sqlite3_stmt* stmt, int num_fields, int num_rows, threading::Value** const* vals);
+    int AddParams(sqlite3_stmt* stmt, threading::Value* val, int field, int pos);
     std::string GetTableType(int, int);
 
     const threading::Field* const* fields; // raw mapping
@@ -40,6 +45,8 @@ private:
 
     sqlite3* db;
     sqlite3_stmt* st;
+    sqlite3_stmt* multi_st; // Inserts multi_rows rows at once, if more than one.
+    int multi_rows;
 
     std::string set_separator;
     std::string unset_field;
@@ -47,6 +54,12 @@ private:
 
     int64_t synchronous;
     int64_t journal_mode;
+    bool use_transactions;
+    zeek_uint_t insert_rows;
+    int busy_timeout_ms;
+
+    // How often to check whether a shared-cache lock went away.
+    static constexpr int LOCKED_RETRY_MS = 1;
 
     threading::formatter::Ascii* io;
 };
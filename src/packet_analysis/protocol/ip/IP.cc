@@ -4,6 +4,7 @@
 
 #include <netinet/in.h>
 
+#include "zeek/Arena.h"
 #include "zeek/Discard.h"
 #include "zeek/Event.h"
 #include "zeek/Frag.h"
@@ -11,13 +12,18 @@
 #include "zeek/IPAddr.h"
 #include "zeek/NetVar.h"
 #include "zeek/PacketFilter.h"
+#include "zeek/Reporter.h"
 #include "zeek/RunState.h"
 #include "zeek/TunnelEncapsulation.h"
 #include "zeek/packet_analysis/protocol/ip/IPBasedAnalyzer.h"
 #include "zeek/session/Manager.h"
+#include "zeek/telemetry/Manager.h"
 
 using namespace zeek::packet_analysis::IP;
 
+// IP headers usually don't outlive their packet.
+using IPHdrAllocator = zeek::detail::ArenaAllocator<zeek::IP_Hdr>;
+
 IPAnalyzer::IPAnalyzer() : zeek::packet_analysis::Analyzer("IP") {
     discarder = new zeek::detail::Discarder();
     if ( ! discarder->IsActive() ) {
@@ -28,6 +34,31 @@ IPAnalyzer::IPAnalyzer() : zeek::packet_analysis::Analyzer("IP") {
 
 IPAnalyzer::~IPAnalyzer() { delete discarder; }
 
+void IPAnalyzer::Initialize() {
+    Analyzer::Initialize();
+
+    num_shards = id::find_val("PacketAnalyzer::IP::num_shards")->AsCount();
+    shard = id::find_val("PacketAnalyzer::IP::shard")->AsCount();
+
+    if ( num_shards == 0 ) {
+        reporter->Error("PacketAnalyzer::IP::num_shards must be at least 1, disabling sharding");
+        num_shards = 1;
+    }
+
+    if ( shard >= num_shards ) {
+        reporter->FatalError("PacketAnalyzer::IP::shard (%" PRIu64 ") must be less than num_shards (%" PRIu64 ")",
+                             shard, num_shards);
+    }
+
+    skipped_shard_packets_metric =
+        telemetry_mgr->CounterInstance("zeek", "ip_shard_skipped_packets", {},
+                                       "Number of packets skipped because their flow belongs to another shard");
+}
+
+bool IPAnalyzer::InLocalShard(const IP_Hdr* ip, size_t len, const uint8_t* payload) const {
+    return SymmetricFlowHash(ip, len, payload) % num_shards == shard;
+}
+
 bool IPAnalyzer::AnalyzePacket(size_t len, const uint8_t* data, Packet* packet) {
     // Check to make sure we have enough data left for an IP header to be here. Note we only
     // check ipv4 here. We'll check ipv6 later once we determine we have an ipv6 header.
@@ -45,7 +76,7 @@ bool IPAnalyzer::AnalyzePacket(size_t len, const uint8_t* data, Packet* packet)
     std::shared_ptr<IP_Hdr> ip_hdr;
 
     if ( protocol == 4 ) {
-        ip_hdr = std::make_shared<IP_Hdr>(ip, false);
+        ip_hdr = std::allocate_shared<IP_Hdr>(IPHdrAllocator(), ip, false);
         packet->l3_proto = L3_IPV4;
     }
     else if ( protocol == 6 ) {
@@ -54,7 +85,8 @@ bool IPAnalyzer::AnalyzePacket(size_t len, const uint8_t* data, Packet* packet)
             return false;
         }
 
-        ip_hdr = std::make_shared<IP_Hdr>((const struct ip6_hdr*)data, false, static_cast<int>(len));
+        ip_hdr =
+            std::allocate_shared<IP_Hdr>(IPHdrAllocator(), (const struct ip6_hdr*)data, false, static_cast<int>(len));
         packet->l3_proto = L3_IPV6;
     }
     else {
@@ -186,6 +218,23 @@ bool IPAnalyzer::AnalyzePacket(size_t len, const uint8_t* data, Packet* packet)
 
     zeek::detail::FragReassemblerTracker frt(f);
 
+    // When splitting a single packet source across several Zeek processes,
+    // only analyze flows hashing to our own shard. Tunneled packets follow
+    // their outermost flow so that all packets of a tunnel end up in the
+    // same process. ESP and mobility header packets have no ports to hash,
+    // so they go by their addresses alone.
+    if ( num_shards > 1 && (! packet->encap || packet->encap->Depth() == 0) &&
+         ! InLocalShard(packet->ip_hdr.get(), len - ip_hdr_len, packet->ip_hdr->Payload()) ) {
+        skipped_shard_packets_metric->Inc();
+        packet->processed = true;
+
+        if ( f )
+            f->DeleteTimer();
+
+        packet->cap_len = orig_cap_len;
+        return true;
+    }
+
     // We stop building the chain when seeing IPPROTO_ESP so if it's
     // there, it's always the last.
     if ( packet->ip_hdr->LastHeader() == IPPROTO_ESP ) {
@@ -273,6 +322,25 @@ bool IPAnalyzer::AnalyzePacket(size_t len, const uint8_t* data, Packet* packet)
     return return_val;
 }
 
+zeek::detail::hash64_t zeek::packet_analysis::IP::SymmetricFlowHash(const IP_Hdr* ip, size_t len,
+                                                                   const uint8_t* payload) {
+    uint16_t proto = ip->NextProto();
+    uint16_t src_port = 0;
+    uint16_t dst_port = 0;
+
+    // TCP, UDP and SCTP all carry source and destination ports in the first
+    // four bytes of their header.
+    if ( (proto == IPPROTO_TCP || proto == IPPROTO_UDP || proto == IPPROTO_SCTP) && len >= 4 ) {
+        src_port = (payload[0] << 8) | payload[1];
+        dst_port = (payload[2] << 8) | payload[3];
+    }
+
+    // ConnKey orders the two endpoints canonically and clears its padding,
+    // which makes hashing its raw bytes symmetric.
+    zeek::detail::ConnKey key(ip->SrcAddr(), ip->DstAddr(), src_port, dst_port, proto, false);
+    return zeek::detail::KeyedHash::StaticHash64(&key, sizeof(key));
+}
+
 ParseResult zeek::packet_analysis::IP::ParsePacket(int caplen, const u_char* const pkt, int proto,
                                                    std::shared_ptr<zeek::IP_Hdr>& inner) {
     if ( proto == IPPROTO_IPV6 ) {
@@ -280,7 +348,7 @@ ParseResult zeek::packet_analysis::IP::ParsePacket(int caplen, const u_char* con
             return ParseResult::CaplenTooSmall;
 
         const struct ip6_hdr* ip6 = (const struct ip6_hdr*)pkt;
-        inner = std::make_shared<zeek::IP_Hdr>(ip6, false, caplen);
+        inner = std::allocate_shared<zeek::IP_Hdr>(IPHdrAllocator(), ip6, false, caplen);
         if ( (ip6->ip6_ctlun.ip6_un2_vfc & 0xF0) != 0x60 )
             return ParseResult::BadProtocol;
     }
@@ -290,7 +358,7 @@ ParseResult zeek::packet_analysis::IP::ParsePacket(int caplen, const u_char* con
             return ParseResult::BadProtocol;
 
         const struct ip* ip4 = (const struct ip*)pkt;
-        inner = std::make_shared<zeek::IP_Hdr>(ip4, false);
+        inner = std::allocate_shared<zeek::IP_Hdr>(IPHdrAllocator(), ip4, false);
         if ( ip4->ip_v != 4 )
             return ParseResult::BadProtocol;
     }
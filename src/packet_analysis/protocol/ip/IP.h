@@ -3,9 +3,15 @@
 #pragma once
 
 #include "zeek/Frag.h"
+#include "zeek/Hash.h"
 #include "zeek/packet_analysis/Analyzer.h"
 #include "zeek/packet_analysis/Component.h"
 
+namespace zeek::telemetry {
+class Counter;
+using CounterPtr = std::shared_ptr<Counter>;
+} // namespace zeek::telemetry
+
 namespace zeek::detail {
 class Discarder;
 }
@@ -17,6 +23,8 @@ public:
     IPAnalyzer();
     ~IPAnalyzer() override;
 
+    void Initialize() override;
+
     bool AnalyzePacket(size_t len, const uint8_t* data, Packet* packet) override;
 
     static zeek::packet_analysis::AnalyzerPtr Instantiate() { return std::make_shared<IPAnalyzer>(); }
@@ -26,9 +34,33 @@ private:
     // some missing fragments.
     zeek::detail::FragReassembler* NextFragment(double t, const IP_Hdr* ip, const u_char* pkt);
 
+    // Returns true if the flow of the given (outermost) IP packet belongs
+    // to the shard configured for this process.
+    bool InLocalShard(const IP_Hdr* ip, size_t len, const uint8_t* payload) const;
+
     zeek::detail::Discarder* discarder = nullptr;
+
+    zeek_uint_t num_shards = 1;
+    zeek_uint_t shard = 0;
+    telemetry::CounterPtr skipped_shard_packets_metric;
 };
 
+/**
+ * Computes a symmetric hash over an IP packet's flow. Both directions of a
+ * flow yield the same value, and the value is stable across Zeek processes
+ * sharing the same :zeek:see:`digest_salt`.
+ *
+ * For TCP, UDP and SCTP the transport-layer ports are included when the
+ * payload is long enough to contain them, for all other protocols only the
+ * addresses and the protocol number are used.
+ *
+ * @param ip The IP header of the packet.
+ * @param len The number of bytes available at \a payload.
+ * @param payload The transport-layer payload following the IP header.
+ * @return A 64-bit hash of the packet's flow.
+ */
+zeek::detail::hash64_t SymmetricFlowHash(const IP_Hdr* ip, size_t len, const uint8_t* payload);
+
 enum class ParseResult { Ok = 0, CaplenTooSmall = -1, BadProtocol = -2, CaplenTooLarge = 1 };
 
 /**
@@ -4,6 +4,7 @@
 
 #include <pcap.h> // For DLT_ constants
 
+#include "zeek/Arena.h"
 #include "zeek/Conn.h"
 #include "zeek/IP.h"
 #include "zeek/RunState.h"
@@ -14,6 +15,11 @@ namespace zeek::packet_analysis::IPTunnel {
 
 IPTunnelAnalyzer* ip_tunnel_analyzer;
 
+// Encapsulation stacks are built per packet, connections keep copies.
+static std::shared_ptr<EncapsulationStack> new_encapsulation_stack() {
+    return std::allocate_shared<EncapsulationStack>(zeek::detail::ArenaAllocator<EncapsulationStack>());
+}
+
 IPTunnelAnalyzer::IPTunnelAnalyzer() : zeek::packet_analysis::Analyzer("IPTunnel") { ip_tunnel_analyzer = this; }
 
 bool IPTunnelAnalyzer::AnalyzePacket(size_t len, const uint8_t* data, Packet* packet) {
@@ -101,7 +107,7 @@ bool IPTunnelAnalyzer::ProcessEncapsulatedPacket(double t, Packet* pkt, const st
     else
         data = (const u_char*)inner->IP6_Hdr();
 
-    auto outer = prev ? prev : std::make_shared<EncapsulationStack>();
+    auto outer = prev ? prev : new_encapsulation_stack();
     outer->Add(ec);
 
     // Construct fake packet containing the inner packet so it can be processed
@@ -137,7 +143,7 @@ bool IPTunnelAnalyzer::ProcessEncapsulatedPacket(double t, Packet* pkt, uint32_t
         ts.tv_usec = (suseconds_t)((run_state::network_time - (double)ts.tv_sec) * 1000000);
     }
 
-    auto outer = prev ? prev : std::make_shared<EncapsulationStack>();
+    auto outer = prev ? prev : new_encapsulation_stack();
     outer->Add(ec);
 
     // Construct fake packet containing the inner packet so it can be processed
@@ -181,7 +187,7 @@ std::unique_ptr<Packet> build_inner_packet(Packet* outer_pkt, int* encap_index,
         EncapsulatingConn inner(static_cast<Connection*>(outer_pkt->session), tunnel_type);
 
         if ( ! outer_pkt->encap )
-            outer_pkt->encap = encap_stack != nullptr ? encap_stack : std::make_shared<EncapsulationStack>();
+            outer_pkt->encap = encap_stack != nullptr ? encap_stack : new_encapsulation_stack();
 
         outer_pkt->encap->Add(inner);
         inner_pkt->encap = outer_pkt->encap;
@@ -108,6 +108,24 @@ void ZAMCompiler::OptimizeInsts() {
             }
         }
 
+        if ( FuseReturns() ) {
+            something_changed = true;
+
+            if ( dump_intermediaries ) {
+                printf("Fused gotos with returns:\n");
+                DumpInsts1(nullptr);
+            }
+        }
+
+        if ( FuseCounterGoTos() ) {
+            something_changed = true;
+
+            if ( dump_intermediaries ) {
+                printf("Fused counter steps with gotos:\n");
+                DumpInsts1(nullptr);
+            }
+        }
+
         ComputeFrameLifetimes();
 
         if ( PruneUnused() ) {
@@ -164,8 +182,8 @@ bool ZAMCompiler::RemoveDeadCode() {
             // This is effectively a branch to the next instruction.
             // We can remove it *unless* the instruction has side effects.
             // Conditionals don't, but loop-iteration-advancement
-            // instructions do.
-            if ( ! i0->IsLoopIterationAdvancement() ) {
+            // instructions and fused counter steps do.
+            if ( ! i0->IsLoopIterationAdvancement() && ! i0->IsCounterBranch() ) {
                 KillInst(i0);
                 did_removal = true;
                 continue;
@@ -223,6 +241,94 @@ bool ZAMCompiler::CollapseGoTos() {
     return did_change;
 }
 
+bool ZAMCompiler::FuseReturns() {
+    if ( analysis_options.no_ZAM_control_flow_opt )
+        return false;
+
+    bool did_change = false;
+
+    for ( auto& i0 : insts1 ) {
+        auto orig_t = i0->target;
+
+        if ( ! i0->live || ! i0->IsUnconditionalBranch() || orig_t == pending_inst )
+            continue;
+
+        // As for CollapseGoTos(), the first live instruction at the
+        // target is the one that carries the goto's label.
+        auto first_branch = FirstLiveInst(orig_t, false);
+        auto t = FirstLiveInst(orig_t, true);
+
+        // We leave returns of variables alone, as copying those would
+        // require extending the lifetimes of the variables.
+        if ( ! t || (t->op != OP_RETURN_X && t->op != OP_RETURN_C) )
+            continue;
+
+        --first_branch->num_labels;
+
+        i0->op = t->op;
+        i0->op_type = t->op_type;
+        i0->v1 = t->v1;
+        i0->v2 = t->v2;
+        i0->v3 = t->v3;
+        i0->v4 = t->v4;
+        i0->c = t->c;
+
+        if ( t->GetType() )
+            i0->SetType(t->GetType());
+
+        i0->target = nullptr;
+        i0->target_slot = 0;
+
+        did_change = true;
+    }
+
+    return did_change;
+}
+
+bool ZAMCompiler::FuseCounterGoTos() {
+    if ( analysis_options.no_ZAM_control_flow_opt )
+        return false;
+
+    bool did_change = false;
+
+    for ( auto& i0 : insts1 ) {
+        if ( ! i0->live )
+            continue;
+
+        ZOp fused_op;
+
+        switch ( i0->op ) {
+            case OP_INCRI_V: fused_op = OP_INCRI_GOTO_Vb; break;
+            case OP_INCRU_V: fused_op = OP_INCRU_GOTO_Vb; break;
+            case OP_DECRI_V: fused_op = OP_DECRI_GOTO_Vb; break;
+            case OP_DECRU_V: fused_op = OP_DECRU_GOTO_Vb; break;
+            default: continue;
+        }
+
+        auto i1 = NextLiveInst(i0);
+
+        if ( ! i1 || ! i1->IsUnconditionalBranch() || i1->target == pending_inst )
+            continue;
+
+        auto t = FirstLiveInst(i1->target, false);
+
+        if ( ! t )
+            continue;
+
+        i0->op = fused_op;
+        i0->op_type = OP_VV_I2;
+        i0->target = t;
+        i0->target_slot = 2;
+        ++t->num_labels;
+
+        // The goto is now unreachable unless other branches lead to it.
+        // RemoveDeadCode() takes care of it.
+        did_change = true;
+    }
+
+    return did_change;
+}
+
 bool ZAMCompiler::PruneUnused() {
     bool did_prune = false;
 
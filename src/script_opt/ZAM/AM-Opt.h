@@ -18,6 +18,15 @@ bool RemoveDeadCode();
 // Collapse chains of gotos.  True if some something changed.
 bool CollapseGoTos();
 
+// Replace gotos that lead to a return with a copy of the return, saving
+// the execution of the goto.  True if something changed.
+bool FuseReturns();
+
+// Replace increments and decrements followed by a goto, as at the end of
+// counting loops, with a single instruction doing both.  True if
+// something changed.
+bool FuseCounterGoTos();
+
 // Prune statements that are unnecessary.  True if something got
 // pruned.
 bool PruneUnused();
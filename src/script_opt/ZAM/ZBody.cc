@@ -120,6 +120,26 @@ static bool profile_all = false;
 
 #endif
 
+#ifdef ENABLE_ZAM_THREADED_DISPATCH
+
+// Ends the instruction cases in ZAM-ThreadedEvalDefs.h.  Instead of going
+// back around the loop in ZBody::Exec(), a case jumps straight to the case
+// of the next instruction, so each case has its own indirect branch for the
+// CPU to predict.  With profiling compiled in we go around the loop after
+// all, as the sampling happens there.
+#ifdef ENABLE_ZAM_PROFILE
+#define ZAM_DISPATCH_NEXT break;
+#else
+#define ZAM_DISPATCH_NEXT                                                                                              \
+    {                                                                                                                  \
+        if ( ++pc >= end_pc || ZAM_error )                                                                             \
+            continue;                                                                                                  \
+        goto* ZAM_dispatch_table[insts[pc].op];                                                                        \
+    }
+#endif
+
+#endif
+
 using std::vector;
 
 // Thrown when a call inside a "when" delays.
@@ -132,6 +152,11 @@ static bool did_init = false;
 int ZOP_count[OP_NOP + 1];
 double ZOP_CPU[OP_NOP + 1];
 
+// Count of how often each pair of ZOPs executed in direct succession,
+// to identify sequences worth fusing into a single ZOP.  Indexed by the
+// first ZOP, then the second.
+static int ZOP_pair_count[OP_NOP + 1][OP_NOP + 1];
+
 void report_ZOP_profile() {
     static bool did_overhead_report = false;
 
@@ -149,6 +174,27 @@ void report_ZOP_profile() {
             auto CPU = std::max(ZOP_CPU[i] - ZOP_count[i] * CPU_prof_overhead, 0.0);
             fprintf(analysis_options.profile_file, "%s\t%d\t%.06f\n", ZOP_name(ZOp(i)), ZOP_count[i], CPU);
         }
+
+    std::vector<std::pair<int, std::pair<ZOp, ZOp>>> pairs;
+
+    for ( int i = 1; i <= OP_NOP; ++i )
+        for ( int j = 1; j <= OP_NOP; ++j )
+            if ( ZOP_pair_count[i][j] > 0 )
+                pairs.push_back({ZOP_pair_count[i][j], {ZOp(i), ZOp(j)}});
+
+    constexpr size_t max_pairs = 50;
+    auto num_pairs = std::min(pairs.size(), max_pairs);
+
+    std::partial_sort(pairs.begin(), pairs.begin() + num_pairs, pairs.end(),
+                      [](const auto& a, const auto& b) { return a.first > b.first; });
+
+    if ( num_pairs > 0 )
+        fprintf(analysis_options.profile_file, "Most frequent ZOP sequences:\n");
+
+    for ( size_t i = 0; i < num_pairs; ++i ) {
+        auto [count, ops] = pairs[i];
+        fprintf(analysis_options.profile_file, "%s %s\t%d\n", ZOP_name(ops.first), ZOP_name(ops.second), count);
+    }
 }
 
 // Sets the given element to a copy of an existing (not newly constructed)
@@ -425,6 +471,19 @@ ValPtr ZBody::Exec(Frame* f, StmtFlowType& flow) {
     // Clear any leftover error state.
     ZAM_error = false;
 
+#ifdef ENABLE_ZAM_THREADED_DISPATCH
+    // Addresses of the instruction cases below, indexed by ZOp.
+    static const void* const ZAM_dispatch_table[] = {
+#include "ZAM-DispatchTable.h"
+    };
+
+    static_assert(sizeof(ZAM_dispatch_table) / sizeof(ZAM_dispatch_table[0]) == OP_NOP + 1);
+#endif
+
+#ifdef ENABLE_ZAM_PROFILE
+    ZOp prev_op = OP_NOP;
+#endif
+
     while ( pc < end_pc && ! ZAM_error ) {
         auto& z = insts[pc];
 
@@ -442,23 +501,43 @@ ValPtr ZBody::Exec(Frame* f, StmtFlowType& flow) {
                 ++ZOP_count[z.op];
                 ++ninst;
 
+                if ( prev_op != OP_NOP )
+                    ++ZOP_pair_count[prev_op][z.op];
+
                 profile_pc = pc;
                 profile_CPU = util::curr_CPU_time();
             }
+
+            prev_op = z.op;
         }
 #endif
 
+#ifdef ENABLE_ZAM_THREADED_DISPATCH
+        goto* ZAM_dispatch_table[z.op];
+#endif
+
         switch ( z.op ) {
             case OP_NOP:
+#ifdef ENABLE_ZAM_THREADED_DISPATCH
+            ZAM_L_OP_NOP:
+#endif
                 break;
 
                 // These must stay in this order or the build fails.
                 // clang-format off
 #include "ZAM-EvalMacros.h"
+#ifdef ENABLE_ZAM_THREADED_DISPATCH
+#include "ZAM-ThreadedEvalDefs.h"
+#else
 #include "ZAM-EvalDefs.h"
+#endif
                 // clang-format on
 
-            default: reporter->InternalError("bad ZAM opcode");
+            default:
+#ifdef ENABLE_ZAM_THREADED_DISPATCH
+            ZAM_bad_op:
+#endif
+                reporter->InternalError("bad ZAM opcode");
         }
 
         DO_ZAM_PROFILE
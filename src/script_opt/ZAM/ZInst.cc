@@ -245,6 +245,17 @@ bool ZInst::IsLoopIterationAdvancement() const {
     }
 }
 
+bool ZInst::IsCounterBranch() const {
+    switch ( op ) {
+        case OP_INCRI_GOTO_Vb:
+        case OP_INCRU_GOTO_Vb:
+        case OP_DECRI_GOTO_Vb:
+        case OP_DECRU_GOTO_Vb: return true;
+
+        default: return false;
+    }
+}
+
 bool ZInst::AssignsToSlot1() const {
     switch ( op_type ) {
         case OP_X:
@@ -438,6 +449,10 @@ string ZInstI::VName(int n, const FrameMap* frame_ids, const FrameReMap* remappi
 bool ZInstI::DoesNotContinue() const {
     switch ( op ) {
         case OP_GOTO_b:
+        case OP_INCRI_GOTO_Vb:
+        case OP_INCRU_GOTO_Vb:
+        case OP_DECRI_GOTO_Vb:
+        case OP_DECRU_GOTO_Vb:
         case OP_HOOK_BREAK_X:
         case OP_WHEN_RETURN_X:
         case OP_RETURN_C:
@@ -59,6 +59,10 @@ public:
     // a loop iteration, false otherwise.
     bool IsLoopIterationAdvancement() const;
 
+    // Returns true if this instruction steps a counter and then branches,
+    // i.e., it's a fused increment/decrement and goto.
+    bool IsCounterBranch() const;
+
     // True if the given instruction assigns to the frame location
     // given by slot 1 (v1).
     bool AssignsToSlot1() const;
@@ -0,0 +1,71 @@
+# Build the ZAM-ThreadedEvalDefs.h and ZAM-DispatchTable.h files from the
+# ZAM-EvalDefs.h and ZAM-OpsDefs.h files that gen-zam generates.
+#
+# ZBody::Exec() uses these instead of ZAM-EvalDefs.h when Zeek is configured
+# with --enable-ZAM-threaded-dispatch. We derive them from gen-zam's output
+# rather than teaching gen-zam about them, so the switch-based build stays
+# exactly as it is.
+#
+# ZAM-ThreadedEvalDefs.h is ZAM-EvalDefs.h with each instruction case given
+# a label (ZAM_L_<op>) and its own block, in which "z" refers to the
+# instruction being executed. The "break" that ends a case becomes
+# ZAM_DISPATCH_NEXT, which moves on to the next instruction through its
+# own indirect branch. Cases that end some other way (branches, returns)
+# are left alone.
+#
+# ZAM-DispatchTable.h holds the initializers for the table of label
+# addresses, one per ZOp in enum order. Ops without a case in
+# ZAM-EvalDefs.h map to ZAM_bad_op.
+#
+# The arguments are the input directory and the output directory.
+
+import os
+import re
+import sys
+
+input_dir = sys.argv[1]
+output_dir = sys.argv[2]
+
+with open(os.path.join(input_dir, "ZAM-EvalDefs.h")) as f:
+    eval_defs = f.read()
+
+with open(os.path.join(input_dir, "ZAM-OpsDefs.h")) as f:
+    ops = re.findall(r"\b(OP_\w+)\s*,", f.read())
+
+header = f"""//
+// This file was automatically generated from {input_dir} by
+// {os.path.basename(sys.argv[0])}
+// DO NOT EDIT.
+//
+"""
+
+case_re = re.compile(r"^([ \t]*)case[ \t]+(OP_\w+)[ \t]*:[ \t]*\n", re.MULTILINE)
+final_break_re = re.compile(r"\bbreak;(\s*)$")
+
+cases = list(case_re.finditer(eval_defs))
+labeled = set()
+out = [header, eval_defs[: cases[0].start()] if cases else eval_defs]
+
+for n, c in enumerate(cases):
+    indent, op = c.group(1), c.group(2)
+    body_end = cases[n + 1].start() if n + 1 < len(cases) else len(eval_defs)
+    body = eval_defs[c.end() : body_end]
+
+    out.append(f"{indent}case {op}:\n{indent}ZAM_L_{op}: {{\n{indent}[[maybe_unused]] auto& z = insts[pc];\n")
+
+    m = final_break_re.search(body)
+    if m:
+        body = body[: m.start()] + "ZAM_DISPATCH_NEXT" + m.group(1)
+
+    # Keep trailing blank lines outside of the block we opened.
+    stripped = body.rstrip()
+    out.append(f"{stripped}\n{indent}}}{body[len(stripped):]}")
+    labeled.add(op)
+
+with open(os.path.join(output_dir, "ZAM-ThreadedEvalDefs.h"), "w") as f:
+    f.write("".join(out))
+
+with open(os.path.join(output_dir, "ZAM-DispatchTable.h"), "w") as f:
+    f.write(header)
+    for op in ops + ["OP_NOP"]:
+        f.write(f"&&ZAM_L_{op},\n" if op in labeled or op == "OP_NOP" else "&&ZAM_bad_op,\n")
@@ -18,6 +18,7 @@ Key::Key(const void* session, size_t size, size_t type, bool copy) : size(size),
 Key::Key(Key&& rhs) {
     data = rhs.data;
     size = rhs.size;
+    type = rhs.type;
     copied = rhs.copied;
 
     rhs.data = nullptr;
@@ -27,8 +28,12 @@ Key::Key(Key&& rhs) {
 
 Key& Key::operator=(Key&& rhs) {
     if ( this != &rhs ) {
+        if ( copied )
+            delete[] data;
+
         data = rhs.data;
         size = rhs.size;
+        type = rhs.type;
         copied = rhs.copied;
 
         rhs.data = nullptr;
@@ -108,11 +108,7 @@ Connection* Manager::FindConnection(Val* v) {
 Connection* Manager::FindConnection(const zeek::detail::ConnKey& conn_key) {
     detail::Key key(&conn_key, sizeof(conn_key), detail::Key::CONNECTION_KEY_TYPE, false);
 
-    auto it = session_map.find(key);
-    if ( it != session_map.end() )
-        return static_cast<Connection*>(it->second);
-
-    return nullptr;
+    return static_cast<Connection*>(session_map.Find(key));
 }
 
 void Manager::Remove(Session* s) {
@@ -123,7 +119,7 @@ void Manager::Remove(Session* s) {
 
         detail::Key key = s->SessionKey(false);
 
-        if ( session_map.erase(key) == 0 )
+        if ( ! session_map.Remove(key) )
             reporter->InternalWarning("connection missing");
         else {
             Connection* c = static_cast<Connection*>(s);
@@ -145,11 +141,8 @@ void Manager::Insert(Session* s, bool remove_existing) {
     detail::Key key = s->SessionKey(true);
 
     if ( remove_existing ) {
-        auto it = session_map.find(key);
-        if ( it != session_map.end() )
-            old = it->second;
-
-        session_map.erase(key);
+        old = session_map.Find(key);
+        session_map.Remove(key);
     }
 
     InsertSession(std::move(key), s);
@@ -164,29 +157,31 @@ void Manager::Insert(Session* s, bool remove_existing) {
 }
 
 void Manager::Drain() {
+    // Done() and RemovalEvent() may insert or remove sessions, which moves
+    // the session table's entries. Work from a snapshot of the sessions
+    // instead, holding a reference to each, and skip those that have left
+    // the table in the meantime.
+    std::vector<std::pair<detail::Key, Session*>> sessions;
+    sessions.reserve(session_map.Size());
+
+    for ( const auto& entry : session_map ) {
+        Ref(entry.second);
+        sessions.emplace_back(entry.second->SessionKey(true), entry.second);
+    }
+
     // If a random seed was passed in, we're most likely in testing mode and need the
     // order of the sessions to be consistent. Sort the keys to force that order
     // every run.
-    if ( zeek::util::detail::have_random_seed() ) {
-        std::vector<const detail::Key*> keys;
-        keys.reserve(session_map.size());
-
-        for ( auto& entry : session_map )
-            keys.push_back(&(entry.first));
-        std::sort(keys.begin(), keys.end(), [](const detail::Key* a, const detail::Key* b) { return *a < *b; });
+    if ( zeek::util::detail::have_random_seed() )
+        std::sort(sessions.begin(), sessions.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
 
-        for ( const auto* k : keys ) {
-            Session* tc = session_map.at(*k);
-            tc->Done();
-            tc->RemovalEvent();
-        }
-    }
-    else {
-        for ( const auto& entry : session_map ) {
-            Session* tc = entry.second;
+    for ( auto& [key, tc] : sessions ) {
+        if ( session_map.Find(key) == tc ) {
             tc->Done();
             tc->RemovalEvent();
         }
+
+        Unref(tc);
     }
 }
 
@@ -194,7 +189,7 @@ void Manager::Clear() {
     for ( const auto& entry : session_map )
         Unref(entry.second);
 
-    session_map.clear();
+    session_map.Clear();
 
     zeek::detail::fragment_mgr->Clear();
 }
@@ -245,7 +240,7 @@ void Manager::Weird(const char* name, const IP_Hdr* ip, const char* addl) {
 void Manager::InsertSession(detail::Key key, Session* session) {
     session->SetInSessionTable(true);
     key.CopyData();
-    session_map.insert_or_assign(std::move(key), session);
+    session_map.Insert(std::move(key), session);
 
     std::string protocol = session->TransportIdentifier();
 
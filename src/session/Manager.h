@@ -3,13 +3,13 @@
 #pragma once
 
 #include <sys/types.h> // for u_char
-#include <unordered_map>
 #include <utility>
 
 #include "zeek/Frag.h"
 #include "zeek/Hash.h"
 #include "zeek/NetVar.h"
 #include "zeek/session/Session.h"
+#include "zeek/session/SessionTable.h"
 
 namespace zeek {
 
@@ -89,11 +89,9 @@ public:
     void Weird(const char* name, const Packet* pkt, const char* addl = "", const char* source = "");
     void Weird(const char* name, const IP_Hdr* ip, const char* addl = "");
 
-    size_t CurrentSessions() { return session_map.size(); }
+    size_t CurrentSessions() { return session_map.Size(); }
 
 private:
-    using SessionMap = std::unordered_map<detail::Key, Session*, detail::KeyHash>;
-
     // Inserts a new connection into the sessions map. If a connection with
     // the same key already exists in the map, it will be overwritten by
     // the new one.  Connection count stats get updated either way (so most
@@ -101,7 +99,7 @@ private:
     // avoid unnecessary incrementing of connecting counts).
     void InsertSession(detail::Key key, Session* session);
 
-    SessionMap session_map;
+    detail::SessionTable session_map;
     detail::ProtocolStats* stats;
     telemetry::CounterFamilyPtr ended_sessions_metric_family;
     telemetry::CounterPtr ended_by_inactivity_metric;
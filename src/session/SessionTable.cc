@@ -0,0 +1,387 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek/session/SessionTable.h"
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include <unordered_map>
+
+#include "zeek/3rdparty/doctest.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace zeek::session::detail {
+
+namespace {
+
+// The control bytes of one group, with bitmasks of the slots matching a
+// condition.
+class Group {
+public:
+#ifdef __SSE2__
+    explicit Group(const int8_t* p) : ctrl(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p))) {}
+
+    uint32_t Match(int8_t tag) const { return _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(tag), ctrl)); }
+
+    // Empty and deleted are the only values below -1.
+    uint32_t MatchFree() const { return _mm_movemask_epi8(_mm_cmpgt_epi8(_mm_set1_epi8(-1), ctrl)); }
+
+private:
+    __m128i ctrl;
+#else
+    explicit Group(const int8_t* p) : ctrl(p) {}
+
+    uint32_t Match(int8_t tag) const {
+        uint32_t mask = 0;
+        for ( size_t i = 0; i < SessionTable::GROUP_SIZE; ++i )
+            if ( ctrl[i] == tag )
+                mask |= 1U << i;
+        return mask;
+    }
+
+    uint32_t MatchFree() const {
+        uint32_t mask = 0;
+        for ( size_t i = 0; i < SessionTable::GROUP_SIZE; ++i )
+            if ( ctrl[i] < -1 )
+                mask |= 1U << i;
+        return mask;
+    }
+
+private:
+    const int8_t* ctrl;
+#endif
+};
+
+int8_t Tag(size_t hash) { return static_cast<int8_t>(hash & 0x7f); }
+
+} // namespace
+
+void SessionTable::Array::Allocate(size_t arg_capacity) {
+    capacity = arg_capacity;
+    used = tombstones = 0;
+
+    ctrl = new int8_t[capacity];
+    memset(ctrl, CTRL_EMPTY, capacity);
+    hashes = new size_t[capacity];
+    slots = static_cast<value_type*>(::operator new(capacity * sizeof(value_type)));
+}
+
+void SessionTable::Array::Release() {
+    for ( size_t i = 0; i < capacity; ++i )
+        if ( Full(i) )
+            slots[i].~value_type();
+
+    delete[] ctrl;
+    delete[] hashes;
+    ::operator delete(slots);
+
+    *this = Array();
+}
+
+size_t SessionTable::Array::Find(const Key& key, size_t hash) const {
+    if ( used == 0 )
+        return capacity;
+
+    // Triangular probing over groups, which visits every group once as
+    // the number of groups is a power of two.
+    size_t mask = capacity / GROUP_SIZE - 1;
+    size_t g = (hash >> 7) & mask;
+    int8_t tag = Tag(hash);
+
+    for ( size_t step = 1; step <= mask + 1; ++step ) {
+        size_t base = g * GROUP_SIZE;
+        Group group(ctrl + base);
+
+        for ( uint32_t m = group.Match(tag); m; m &= m - 1 ) {
+            size_t i = base + __builtin_ctz(m);
+            if ( hashes[i] == hash && slots[i].first == key )
+                return i;
+        }
+
+        // An empty slot ends the probe sequence, since an insertion would
+        // have stopped there.
+        if ( group.Match(CTRL_EMPTY) )
+            break;
+
+        g = (g + step) & mask;
+    }
+
+    return capacity;
+}
+
+void SessionTable::Array::Add(Key&& key, Session* session, size_t hash) {
+    size_t mask = capacity / GROUP_SIZE - 1;
+    size_t g = (hash >> 7) & mask;
+
+    for ( size_t step = 1;; ++step ) {
+        size_t base = g * GROUP_SIZE;
+
+        if ( uint32_t m = Group(ctrl + base).MatchFree() ) {
+            size_t i = base + __builtin_ctz(m);
+
+            if ( ctrl[i] == CTRL_DELETED )
+                --tombstones;
+
+            ctrl[i] = Tag(hash);
+            hashes[i] = hash;
+            new (&slots[i]) value_type(std::move(key), session);
+            ++used;
+            return;
+        }
+
+        g = (g + step) & mask;
+    }
+}
+
+void SessionTable::Array::Erase(size_t i) {
+    slots[i].~value_type();
+    --used;
+
+    // If the group still has an empty slot it has never been full, so no
+    // probe sequence continues past it and the slot can become empty
+    // again. Otherwise it has to remain a tombstone.
+    size_t base = i - i % GROUP_SIZE;
+
+    if ( Group(ctrl + base).Match(CTRL_EMPTY) )
+        ctrl[i] = CTRL_EMPTY;
+    else {
+        ctrl[i] = CTRL_DELETED;
+        ++tombstones;
+    }
+}
+
+SessionTable::~SessionTable() { Clear(); }
+
+Session* SessionTable::Find(const Key& key) const {
+    size_t hash = key.Hash();
+
+    if ( size_t i = cur.Find(key, hash); i != cur.capacity )
+        return cur.slots[i].second;
+
+    if ( Resizing() ) {
+        if ( size_t i = old.Find(key, hash); i != old.capacity )
+            return old.slots[i].second;
+    }
+
+    return nullptr;
+}
+
+void SessionTable::Insert(Key key, Session* session) {
+    if ( Resizing() )
+        Migrate(MIGRATE_SLOTS);
+
+    size_t hash = key.Hash();
+
+    if ( size_t i = cur.Find(key, hash); i != cur.capacity ) {
+        cur.slots[i].second = session;
+        return;
+    }
+
+    if ( Resizing() ) {
+        if ( size_t i = old.Find(key, hash); i != old.capacity ) {
+            old.slots[i].second = session;
+            return;
+        }
+    }
+
+    Reserve();
+    cur.Add(std::move(key), session, hash);
+    ++num_entries;
+}
+
+bool SessionTable::Remove(const Key& key) {
+    if ( Resizing() )
+        Migrate(MIGRATE_SLOTS);
+
+    size_t hash = key.Hash();
+
+    if ( size_t i = cur.Find(key, hash); i != cur.capacity ) {
+        cur.Erase(i);
+        --num_entries;
+        return true;
+    }
+
+    if ( Resizing() ) {
+        if ( size_t i = old.Find(key, hash); i != old.capacity ) {
+            old.Erase(i);
+            --num_entries;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void SessionTable::Clear() {
+    cur.Release();
+    old.Release();
+    migrate_pos = 0;
+    num_entries = 0;
+}
+
+void SessionTable::Reserve() {
+    if ( cur.capacity == 0 ) {
+        cur.Allocate(GROUP_SIZE);
+        return;
+    }
+
+    // Keep at least an eighth of the slots empty so that probe sequences
+    // stay short and always terminate.
+    auto fits = [this]() { return cur.used + cur.tombstones + 1 <= cur.capacity - cur.capacity / 8; };
+
+    if ( fits() )
+        return;
+
+    // Growing while still migrating means the table filled up faster than
+    // we moved entries. Finish the previous migration first, that may
+    // already free up enough tombstones.
+    if ( Resizing() ) {
+        Migrate(old.capacity);
+
+        if ( fits() )
+            return;
+    }
+
+    // Double the size if live entries take up at least half of the usable
+    // slots. Otherwise the table is mostly tombstones, and rehashing into
+    // one of the same size gets rid of them.
+    size_t capacity = cur.capacity;
+
+    if ( cur.used >= capacity / 2 - capacity / 16 )
+        capacity *= 2;
+
+    old = cur;
+    cur = Array();
+    cur.Allocate(capacity);
+    migrate_pos = 0;
+
+    Migrate(MIGRATE_SLOTS);
+}
+
+void SessionTable::Migrate(size_t n) {
+    size_t end = std::min(old.capacity, migrate_pos + n);
+
+    for ( ; migrate_pos < end; ++migrate_pos ) {
+        if ( ! old.Full(migrate_pos) )
+            continue;
+
+        auto& slot = old.slots[migrate_pos];
+        cur.Add(std::move(slot.first), slot.second, old.hashes[migrate_pos]);
+        old.Erase(migrate_pos);
+    }
+
+    if ( migrate_pos == old.capacity ) {
+        old.Release();
+        migrate_pos = 0;
+    }
+}
+
+void SessionTable::iterator::Settle() {
+    while ( which < 2 ) {
+        const auto* a = t->Table(which);
+
+        while ( idx < a->capacity && ! a->Full(idx) )
+            ++idx;
+
+        if ( idx < a->capacity )
+            return;
+
+        ++which;
+        idx = 0;
+    }
+}
+
+TEST_SUITE_BEGIN("SessionTable");
+
+namespace {
+
+Key MakeKey(uint64_t v) { return Key(&v, sizeof(v), Key::CONNECTION_KEY_TYPE, true); }
+
+Session* FakeSession(uint64_t v) { return reinterpret_cast<Session*>(static_cast<uintptr_t>(v + 1) * 8); }
+
+} // namespace
+
+TEST_CASE("session table basics") {
+    SessionTable t;
+    CHECK(t.Size() == 0);
+    CHECK(t.begin() == t.end());
+
+    for ( uint64_t i = 0; i < 1000; ++i )
+        t.Insert(MakeKey(i), FakeSession(i));
+
+    CHECK(t.Size() == 1000);
+
+    for ( uint64_t i = 0; i < 1000; ++i ) {
+        uint64_t v = i;
+        CHECK(t.Find(Key(&v, sizeof(v), Key::CONNECTION_KEY_TYPE)) == FakeSession(i));
+    }
+
+    uint64_t missing = 1000;
+    CHECK(t.Find(Key(&missing, sizeof(missing), Key::CONNECTION_KEY_TYPE)) == nullptr);
+
+    // Same bytes, different key type.
+    uint64_t v = 5;
+    CHECK(t.Find(Key(&v, sizeof(v), 1)) == nullptr);
+
+    t.Insert(MakeKey(5), FakeSession(42));
+    CHECK(t.Size() == 1000);
+    CHECK(t.Find(MakeKey(5)) == FakeSession(42));
+
+    CHECK(t.Remove(MakeKey(5)));
+    CHECK_FALSE(t.Remove(MakeKey(5)));
+    CHECK(t.Find(MakeKey(5)) == nullptr);
+    CHECK(t.Size() == 999);
+
+    size_t n = 0;
+    for ( auto& entry : t ) {
+        CHECK(entry.second != nullptr);
+        ++n;
+    }
+    CHECK(n == 999);
+
+    t.Clear();
+    CHECK(t.Size() == 0);
+    CHECK(t.Capacity() == 0);
+}
+
+TEST_CASE("session table incremental resize") {
+    SessionTable t;
+    std::unordered_map<uint64_t, Session*> ref;
+    bool saw_resize = false;
+    uint64_t x = 1;
+
+    for ( int i = 0; i < 200000; ++i ) {
+        x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+        uint64_t k = (x >> 33) % 20000;
+
+        if ( (x >> 20) % 3 == 0 ) {
+            CHECK(t.Remove(MakeKey(k)) == (ref.erase(k) == 1));
+        }
+        else {
+            t.Insert(MakeKey(k), FakeSession(i));
+            ref[k] = FakeSession(i);
+        }
+
+        saw_resize |= t.Resizing();
+    }
+
+    CHECK(saw_resize);
+    CHECK(t.Size() == ref.size());
+
+    for ( const auto& [k, s] : ref )
+        CHECK(t.Find(MakeKey(k)) == s);
+
+    size_t n = 0;
+    for ( auto& entry : t ) {
+        CHECK(t.Find(entry.first) == entry.second);
+        ++n;
+    }
+    CHECK(n == ref.size());
+}
+
+TEST_SUITE_END();
+
+} // namespace zeek::session::detail
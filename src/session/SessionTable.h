@@ -0,0 +1,160 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+#include "zeek/session/Key.h"
+
+namespace zeek::session {
+
+class Session;
+
+namespace detail {
+
+/**
+ * An open-addressing hash table mapping session keys to sessions.
+ *
+ * Slots are organized into groups of 16, with one control byte per slot
+ * holding 7 bits of the key's hash, or a marker for empty and deleted
+ * slots. A lookup compares all control bytes of a group at once (with
+ * SSE2 where available) and only looks at the keys of the few slots
+ * whose bits match, so that a lookup usually touches just one cache line
+ * of control bytes and one slot.
+ *
+ * When the table grows, it doesn't rehash all entries at once. Instead,
+ * it allocates the larger table and then moves over a fixed number of
+ * slots with each subsequent insertion or removal, looking up keys in
+ * both tables in the meantime. That keeps the cost of individual
+ * insertions bounded even for tables with millions of entries.
+ */
+class SessionTable {
+public:
+    using value_type = std::pair<Key, Session*>;
+
+    SessionTable() = default;
+    ~SessionTable();
+
+    SessionTable(const SessionTable&) = delete;
+    SessionTable& operator=(const SessionTable&) = delete;
+
+    /**
+     * Returns the session for a key, or nullptr if there's none.
+     */
+    Session* Find(const Key& key) const;
+
+    /**
+     * Adds a session, replacing any existing one for the same key. The key
+     * must own its data, see Key::CopyData().
+     */
+    void Insert(Key key, Session* session);
+
+    /**
+     * Removes the session for a key.
+     *
+     * @return True if there was one.
+     */
+    bool Remove(const Key& key);
+
+    /**
+     * Removes all sessions.
+     */
+    void Clear();
+
+    size_t Size() const { return num_entries; }
+
+    /**
+     * Returns the number of slots allocated, including those of a table
+     * still being migrated from.
+     */
+    size_t Capacity() const { return cur.capacity + old.capacity; }
+
+    /**
+     * Returns true while entries are being moved into a grown table.
+     */
+    bool Resizing() const { return old.capacity != 0; }
+
+    class iterator {
+    public:
+        value_type& operator*() const { return t->Table(which)->slots[idx]; }
+        value_type* operator->() const { return &t->Table(which)->slots[idx]; }
+
+        iterator& operator++() {
+            ++idx;
+            Settle();
+            return *this;
+        }
+
+        bool operator==(const iterator& other) const { return which == other.which && idx == other.idx; }
+        bool operator!=(const iterator& other) const { return ! (*this == other); }
+
+    private:
+        friend class SessionTable;
+
+        iterator(const SessionTable* t, int which, size_t idx) : t(t), which(which), idx(idx) { Settle(); }
+
+        // Advances to the next full slot, moving from the current to the
+        // old table and then to the end as needed.
+        void Settle();
+
+        const SessionTable* t;
+        int which;
+        size_t idx;
+    };
+
+    iterator begin() const { return {this, 0, 0}; }
+    iterator end() const { return {this, 2, 0}; }
+
+    // Number of slots per group of control bytes.
+    static constexpr size_t GROUP_SIZE = 16;
+
+    // Number of old slots moved over on every modification while resizing.
+    static constexpr size_t MIGRATE_SLOTS = 64;
+
+private:
+    // Control byte values. Full slots hold the low 7 bits of the hash.
+    static constexpr int8_t CTRL_EMPTY = -128;
+    static constexpr int8_t CTRL_DELETED = -2;
+
+    struct Array {
+        int8_t* ctrl = nullptr;
+        value_type* slots = nullptr; // uninitialized unless ctrl is full
+        size_t* hashes = nullptr;
+        size_t capacity = 0;
+        size_t used = 0;       // full slots
+        size_t tombstones = 0; // deleted slots
+
+        void Allocate(size_t capacity);
+        void Release();
+
+        bool Full(size_t i) const { return ctrl[i] >= 0; }
+
+        // Returns the index of the key's slot, or capacity if not found.
+        size_t Find(const Key& key, size_t hash) const;
+
+        // Inserts an entry known not to be present.
+        void Add(Key&& key, Session* session, size_t hash);
+
+        // Empties a full slot.
+        void Erase(size_t i);
+    };
+
+    const Array* Table(int which) const { return which == 0 ? &cur : &old; }
+
+    // Makes room for one more entry in the current table, starting a
+    // resize if needed.
+    void Reserve();
+
+    // Moves up to n slots of the old table into the current one.
+    void Migrate(size_t n);
+
+    Array cur;
+    Array old; // the table being migrated from, if resizing
+    size_t migrate_pos = 0;
+    size_t num_entries = 0;
+};
+
+} // namespace detail
+} // namespace zeek::session
@@ -4,10 +4,14 @@
 
 #include <fcntl.h>
 #include <unistd.h>
+#include <chrono>
 #include <csignal>
+#include <thread>
 
+#include "zeek/3rdparty/doctest.h"
 #include "zeek/DebugLogger.h"
 #include "zeek/Desc.h"
+#include "zeek/NetVar.h"
 #include "zeek/Obj.h"
 #include "zeek/RunState.h"
 #include "zeek/iosource/Manager.h"
@@ -400,13 +404,15 @@ void MsgThread::SendOut(BasicOutputMessage* msg, bool force) {
         return;
     }
 
-    queue_out.Put(msg);
+    bool was_empty = queue_out.Put(msg);
 
     ++cnt_sent_out;
 
     zeek::thread_mgr->MessageOut();
 
-    if ( io_source )
+    // Process() drains the queue completely, so the main thread only
+    // needs a wakeup once the queue turns non-empty.
+    if ( io_source && was_empty )
         io_source->Fire();
 }
 
@@ -480,6 +486,11 @@ void MsgThread::GetStats(Stats* stats) {
 }
 
 void MsgThread::Process() {
+    double deadline = 0.0;
+
+    if ( BifConst::Threading::max_process_time > 0.0 )
+        deadline = util::current_time() + BifConst::Threading::max_process_time;
+
     while ( HasOut() ) {
         Message* msg = RetrieveOut();
         assert(msg);
@@ -490,7 +501,128 @@ void MsgThread::Process() {
         }
 
         delete msg;
+
+        if ( deadline > 0.0 && HasOut() && util::current_time() > deadline ) {
+            // Leave the rest for the next round. As the queue doesn't turn
+            // non-empty again, wake ourselves up.
+            if ( io_source )
+                io_source->Fire();
+
+            return;
+        }
     }
 }
 
 } // namespace zeek::threading
+
+TEST_SUITE_BEGIN("threading queue");
+
+TEST_CASE("spsc queue fifo and overflow") {
+    zeek::threading::SPSCQueue<int*> q(nullptr, nullptr, 4);
+    int vals[10];
+
+    CHECK(! q.Ready());
+    CHECK(q.TryGet() == nullptr);
+
+    // The first element is an empty to non-empty transition, the next
+    // ones fill the ring and then spill into the overflow queue.
+    CHECK(q.Put(&vals[0]));
+    for ( int i = 1; i < 10; i++ )
+        CHECK(! q.Put(&vals[i]));
+
+    CHECK(q.Ready());
+    CHECK(q.Size() == 10);
+
+    // Interleave reads and writes while the overflow is non-empty to make
+    // sure ordering is preserved across ring and overflow queue.
+    CHECK(q.Get() == &vals[0]);
+    CHECK(q.Get() == &vals[1]);
+    CHECK(! q.Put(&vals[0]));
+
+    for ( int i = 2; i < 10; i++ )
+        CHECK(q.Get() == &vals[i]);
+
+    CHECK(q.Get() == &vals[0]);
+    CHECK(! q.Ready());
+    CHECK(q.Size() == 0);
+
+    zeek::threading::SPSCQueue<int*>::Stats stats;
+    q.GetStats(&stats);
+    CHECK(stats.num_reads == 11);
+    CHECK(stats.num_writes == 11);
+    CHECK(stats.num_overflows == 7);
+
+    // Once drained, the next write is a transition again.
+    CHECK(q.Put(&vals[1]));
+    CHECK(q.TryGet() == &vals[1]);
+}
+
+TEST_CASE("spsc queue concurrent") {
+    zeek::threading::SPSCQueue<uintptr_t*> q(nullptr, nullptr, 64);
+    constexpr uintptr_t n = 100000;
+
+    std::thread producer([&q]() {
+        for ( uintptr_t i = 1; i <= n; i++ )
+            q.Put(reinterpret_cast<uintptr_t*>(i));
+    });
+
+    uintptr_t expected = 1;
+    while ( expected <= n ) {
+        auto* v = q.Get();
+        if ( ! v )
+            continue;
+
+        REQUIRE(reinterpret_cast<uintptr_t>(v) == expected);
+        ++expected;
+    }
+
+    producer.join();
+    CHECK(q.Size() == 0);
+}
+
+namespace {
+
+// Pushes n messages through a queue from a second thread and returns the
+// achieved rate in messages per second.
+template<typename Q>
+double queue_throughput(Q& q, uintptr_t n) {
+    auto start = std::chrono::steady_clock::now();
+
+    std::thread producer([&q, n]() {
+        for ( uintptr_t i = 1; i <= n; i++ )
+            q.Put(reinterpret_cast<uintptr_t*>(i));
+    });
+
+    for ( uintptr_t received = 0; received < n; ) {
+        if ( q.Get() )
+            ++received;
+    }
+
+    producer.join();
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return static_cast<double>(n) / elapsed.count();
+}
+
+} // namespace
+
+// Microbenchmark comparing the two queue implementations. Skipped by
+// default, run with: zeek --test -tc="queue benchmark" --no-skip
+TEST_CASE("queue benchmark" * doctest::skip(true)) {
+    constexpr uintptr_t n = 10000000;
+
+    zeek::threading::Queue<uintptr_t*> mutex_queue(nullptr, nullptr);
+    zeek::threading::SPSCQueue<uintptr_t*> spsc_queue(nullptr, nullptr);
+
+    double mutex_rate = queue_throughput(mutex_queue, n);
+    double spsc_rate = queue_throughput(spsc_queue, n);
+
+    zeek::threading::SPSCQueue<uintptr_t*>::Stats stats;
+    spsc_queue.GetStats(&stats);
+
+    MESSAGE(zeek::util::fmt("Queue<T>:     %.0f msgs/s", mutex_rate));
+    MESSAGE(zeek::util::fmt("SPSCQueue<T>: %.0f msgs/s (%.2fx, %" PRIu64 " overflows)", spsc_rate,
+                            spsc_rate / mutex_rate, stats.num_overflows));
+}
+
+TEST_SUITE_END();
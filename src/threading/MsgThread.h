@@ -197,8 +197,8 @@ public:
                               //! the main thread.
 
         /// Statistics from our queues.
-        Queue<BasicInputMessage*>::Stats queue_in_stats;
-        Queue<BasicOutputMessage*>::Stats queue_out_stats;
+        SPSCQueue<BasicInputMessage*>::Stats queue_in_stats;
+        SPSCQueue<BasicOutputMessage*>::Stats queue_out_stats;
     };
 
     /**
@@ -349,8 +349,11 @@ private:
 
     std::string BuildMsgWithLocation(const char* msg);
 
-    Queue<BasicInputMessage*> queue_in;
-    Queue<BasicOutputMessage*> queue_out;
+    // Messages to the child are only sent by the main thread, and only the
+    // child sends messages back, so both directions are single-producer
+    // single-consumer.
+    SPSCQueue<BasicInputMessage*> queue_in;
+    SPSCQueue<BasicOutputMessage*> queue_out;
 
     std::atomic<uint64_t> cnt_sent_in;  // Counts message sent to child.
     std::atomic<uint64_t> cnt_sent_out; // Counts message sent by child.
@@ -3,11 +3,14 @@
 #pragma once
 
 #include <sys/time.h>
+#include <atomic>
 #include <condition_variable>
 #include <cstdint>
 #include <deque>
+#include <memory>
 #include <mutex>
 #include <queue>
+#include <thread>
 
 #include "zeek/Reporter.h"
 #include "zeek/threading/BasicThread.h"
@@ -241,4 +244,296 @@ inline void Queue<T>::WakeUp() {
     }
 }
 
+/**
+ * A lock-free bounded single-producer single-consumer ring.
+ *
+ * Put() and Get() only touch the ring's head and tail indices as long as
+ * the ring neither runs full nor empty, and each side caches the other
+ * side's index so that the shared cache lines are only read when needed.
+ * If the producer outruns the consumer and the ring fills up, further
+ * elements spill into a mutex-protected overflow queue until the consumer
+ * has caught up, so Put() never blocks and FIFO order is preserved. The
+ * consumer only takes a mutex to block for new input once the ring is
+ * empty, and the producer only signals if the consumer is actually waiting.
+ *
+ * The interface mirrors Queue<T>, so it can be used interchangeably as
+ * long as there's indeed only a single thread calling Put() and a single
+ * thread calling Get(), TryGet() and Ready().
+ */
+template<typename T>
+class SPSCQueue {
+public:
+    /**
+     * Constructor.
+     *
+     * reader, writer: The corresponding threads. This is for checking
+     * whether they have terminated so that we can abort I/O operations.
+     * Can be left null for the main thread.
+     *
+     * capacity: Number of slots in the ring, rounded up to the next power
+     * of two.
+     */
+    SPSCQueue(BasicThread* arg_reader, BasicThread* arg_writer, size_t capacity = DEFAULT_CAPACITY);
+
+    /**
+     * Retrieves one element. This may block for a little while if no
+     * input is available and eventually return with a null element if
+     * nothing shows up.
+     */
+    T Get();
+
+    /**
+     * Retrieves one element without blocking. Returns a null element if
+     * the queue is currently empty.
+     */
+    T TryGet();
+
+    /**
+     * Queues one element.
+     *
+     * @return true if the consumer found the queue empty since the last
+     * time Put() returned true. This allows to only wake up a consumer
+     * that isn't blocked in Get() on an empty to non-empty transition.
+     * The return value errs on the side of returning true.
+     */
+    bool Put(T data);
+
+    /**
+     * Returns true if the next Get() operation will succeed. If it returns
+     * false, the next Put() will return true.
+     */
+    bool Ready();
+
+    /**
+     * Same as Ready(); provided for interface compatibility with Queue<T>.
+     */
+    bool MaybeReady() { return Ready(); }
+
+    /**
+     * Wake up the reader if it's currently blocked for input. This is
+     * primarily to give it a chance to check termination quickly.
+     */
+    void WakeUp();
+
+    /**
+     * Returns the number of queued items not yet retrieved. The result is
+     * a snapshot and may be outdated by the time it's returned.
+     */
+    uint64_t Size();
+
+    /**
+     * Statistics about inter-thread communication.
+     */
+    struct Stats {
+        uint64_t num_reads;     //! Number of messages read from the queue.
+        uint64_t num_writes;    //! Number of messages written to the queue.
+        uint64_t num_overflows; //! Number of messages that didn't fit into the ring.
+    };
+
+    /**
+     * Returns statistics about the queue's usage.
+     *
+     * @param stats A pointer to a structure that will be filled with
+     * current numbers.
+     */
+    void GetStats(Stats* stats);
+
+    static constexpr size_t DEFAULT_CAPACITY = 4096;
+
+private:
+    static constexpr int SPIN_COUNT = 64;
+
+    bool Empty() const {
+        return head.load(std::memory_order_seq_cst) == tail.load(std::memory_order_seq_cst) &&
+               overflow_size.load(std::memory_order_seq_cst) == 0;
+    }
+
+    // Ring storage, immutable after construction.
+    std::unique_ptr<T[]> ring;
+    uint64_t mask;
+
+    BasicThread* reader;
+    BasicThread* writer;
+
+    // Producer side. Indices grow monotonically, the slot is determined
+    // by masking.
+    alignas(64) std::atomic<uint64_t> tail = 0;
+    uint64_t cached_head = 0;
+    std::atomic<uint64_t> num_writes = 0;
+    std::atomic<uint64_t> num_overflows = 0;
+
+    // Consumer side.
+    alignas(64) std::atomic<uint64_t> head = 0;
+    uint64_t cached_tail = 0;
+    std::atomic<uint64_t> num_reads = 0;
+
+    // Set by the consumer once it runs out of input. Both only change
+    // when the queue runs empty, so they stay cached on the producer's
+    // side while the queue is busy.
+    alignas(64) std::atomic<bool> idle = true;
+    std::atomic<bool> waiting = false;
+
+    // Overflow handling, used if the ring is full.
+    alignas(64) std::mutex overflow_mutex;
+    std::deque<T> overflow;
+    std::atomic<uint64_t> overflow_size = 0;
+
+    // Blocking support for the consumer.
+    std::mutex wait_mutex;
+    std::condition_variable has_data;
+};
+
+template<typename T>
+inline SPSCQueue<T>::SPSCQueue(BasicThread* arg_reader, BasicThread* arg_writer, size_t capacity)
+    : reader(arg_reader), writer(arg_writer) {
+    size_t n = 1;
+    while ( n < capacity )
+        n <<= 1;
+
+    ring = std::make_unique<T[]>(n);
+    mask = n - 1;
+}
+
+template<typename T>
+inline T SPSCQueue<T>::TryGet() {
+    uint64_t h = head.load(std::memory_order_relaxed);
+
+    if ( h == cached_tail )
+        cached_tail = tail.load(std::memory_order_acquire);
+
+    if ( h != cached_tail ) {
+        T data = std::move(ring[h & mask]);
+        head.store(h + 1, std::memory_order_release);
+        num_reads.store(num_reads.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        return data;
+    }
+
+    // The ring is empty, anything left must be in the overflow queue.
+    // Elements only enter the overflow while it's non-empty or the ring is
+    // full, so all of them are younger than what we've read from the ring.
+    if ( overflow_size.load(std::memory_order_acquire) == 0 )
+        return nullptr;
+
+    std::scoped_lock lock(overflow_mutex);
+
+    if ( overflow.empty() )
+        return nullptr;
+
+    T data = std::move(overflow.front());
+    overflow.pop_front();
+    overflow_size.fetch_sub(1, std::memory_order_release);
+    num_reads.store(num_reads.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    return data;
+}
+
+template<typename T>
+inline bool SPSCQueue<T>::Ready() {
+    uint64_t h = head.load(std::memory_order_relaxed);
+
+    if ( h != cached_tail )
+        return true;
+
+    cached_tail = tail.load(std::memory_order_acquire);
+
+    if ( h != cached_tail || overflow_size.load(std::memory_order_acquire) > 0 )
+        return true;
+
+    // Tell the producer that we ran dry before checking one last time.
+    // Put() checks the flag after publishing its element, so one side is
+    // guaranteed to see the other.
+    idle.store(true, std::memory_order_seq_cst);
+    return ! Empty();
+}
+
+template<typename T>
+inline T SPSCQueue<T>::Get() {
+    // Spin briefly before going to sleep, a busy producer will usually
+    // have published its next element by then.
+    for ( int i = 0; i < SPIN_COUNT; i++ ) {
+        if ( T data = TryGet() )
+            return data;
+
+        std::this_thread::yield();
+    }
+
+    if ( (reader && reader->Killed()) || (writer && writer->Killed()) )
+        return nullptr;
+
+    {
+        auto lock = acquire_lock(wait_mutex);
+
+        // Same protocol as in Ready(), but for blocking.
+        idle.store(true, std::memory_order_seq_cst);
+        waiting.store(true, std::memory_order_seq_cst);
+
+        has_data.wait_for(lock, std::chrono::seconds(5), [this]() {
+            return ! Empty() || (reader && reader->Killed()) || (writer && writer->Killed());
+        });
+
+        waiting.store(false, std::memory_order_relaxed);
+    }
+
+    return TryGet();
+}
+
+template<typename T>
+inline bool SPSCQueue<T>::Put(T data) {
+    uint64_t t = tail.load(std::memory_order_relaxed);
+    bool in_ring = false;
+
+    // Only the producer adds to the overflow queue, so seeing it empty
+    // here means it stays empty until we put something there ourselves.
+    if ( overflow_size.load(std::memory_order_acquire) == 0 ) {
+        if ( t - cached_head > mask )
+            cached_head = head.load(std::memory_order_acquire);
+
+        if ( t - cached_head <= mask ) {
+            ring[t & mask] = std::move(data);
+            tail.store(t + 1, std::memory_order_seq_cst);
+            in_ring = true;
+        }
+    }
+
+    if ( ! in_ring ) {
+        std::scoped_lock lock(overflow_mutex);
+        overflow.push_back(std::move(data));
+        overflow_size.fetch_add(1, std::memory_order_seq_cst);
+        num_overflows.store(num_overflows.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    num_writes.store(num_writes.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+    bool was_empty = idle.load(std::memory_order_seq_cst) && idle.exchange(false, std::memory_order_seq_cst);
+
+    if ( waiting.load(std::memory_order_seq_cst) ) {
+        // Taking the mutex ensures the consumer is either before its
+        // predicate check or already blocked in wait_for().
+        auto lock = acquire_lock(wait_mutex);
+        lock.unlock();
+        has_data.notify_one();
+    }
+
+    return was_empty;
+}
+
+template<typename T>
+inline uint64_t SPSCQueue<T>::Size() {
+    uint64_t h = head.load(std::memory_order_acquire);
+    uint64_t t = tail.load(std::memory_order_acquire);
+    return (t >= h ? t - h : 0) + overflow_size.load(std::memory_order_acquire);
+}
+
+template<typename T>
+inline void SPSCQueue<T>::GetStats(Stats* stats) {
+    stats->num_reads = num_reads.load(std::memory_order_relaxed);
+    stats->num_writes = num_writes.load(std::memory_order_relaxed);
+    stats->num_overflows = num_overflows.load(std::memory_order_relaxed);
+}
+
+template<typename T>
+inline void SPSCQueue<T>::WakeUp() {
+    auto lock = acquire_lock(wait_mutex);
+    has_data.notify_all();
+}
+
 } // namespace zeek::threading
@@ -8,36 +8,182 @@
 #define __STDC_LIMIT_MACROS
 #endif
 
-#define RAPIDJSON_HAS_STDSTRING 1
-
+#include <arpa/inet.h>
+#include <rapidjson/internal/dtoa.h>
 #include <rapidjson/internal/ieee754.h>
 #include <cerrno>
+#include <charconv>
+#include <chrono>
 #include <cmath>
 #include <cstdint>
-#include <sstream>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
 
+#include "zeek/3rdparty/doctest.h"
+#include "zeek/3rdparty/zeek_inet_ntop.h"
 #include "zeek/Desc.h"
 #include "zeek/threading/MsgThread.h"
-#include "zeek/threading/formatters/detail/json.h"
 
 namespace zeek::threading::formatter {
 
+namespace {
+
+// Returns the number of leading bytes that can be copied into a JSON string
+// as they are: printable ASCII other than quotes and backslashes. Anything
+// else needs escaping, or UTF-8 validation in the case of non-ASCII bytes.
+size_t plain_prefix_length(const char* data, size_t len) {
+    size_t i = 0;
+
+#if defined(__SSE2__)
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i del = _mm_set1_epi8(0x7f);
+
+    for ( ; i + 16 <= len; i += 16 ) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+
+        // As signed bytes, anything from 0x80 up is negative and compares
+        // less than a space, just like the control characters.
+        __m128i special = _mm_or_si128(_mm_or_si128(_mm_cmplt_epi8(v, space), _mm_cmpeq_epi8(v, del)),
+                                       _mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, backslash)));
+
+        if ( int mask = _mm_movemask_epi8(special) )
+            return i + __builtin_ctz(mask);
+    }
+#elif defined(__aarch64__)
+    const uint8x16_t space = vdupq_n_u8(' ');
+    const uint8x16_t quote = vdupq_n_u8('"');
+    const uint8x16_t backslash = vdupq_n_u8('\\');
+    const uint8x16_t del = vdupq_n_u8(0x7f);
+
+    for ( ; i + 16 <= len; i += 16 ) {
+        uint8x16_t v = vld1q_u8(reinterpret_cast<const uint8_t*>(data + i));
+        uint8x16_t special = vorrq_u8(vorrq_u8(vcltq_u8(v, space), vcgeq_u8(v, del)),
+                                      vorrq_u8(vceqq_u8(v, quote), vceqq_u8(v, backslash)));
+
+        // Leave locating the byte within the block to the loop below.
+        if ( vmaxvq_u8(special) )
+            break;
+    }
+#endif
+
+    for ( ; i < len; i++ ) {
+        auto c = static_cast<unsigned char>(data[i]);
+
+        if ( c < ' ' || c >= 0x7f || c == '"' || c == '\\' )
+            return i;
+    }
+
+    return len;
+}
+
+template<typename T>
+void append_integer(std::string& buffer, T v) {
+    char tmp[24];
+    auto res = std::to_chars(tmp, tmp + sizeof(tmp), v);
+    buffer.append(tmp, res.ptr - tmp);
+}
+
+void append_string(std::string& buffer, const char* data, size_t len) {
+    buffer.push_back('"');
+
+    size_t plain = plain_prefix_length(data, len);
+
+    if ( plain == len ) {
+        buffer.append(data, len);
+        buffer.push_back('"');
+        return;
+    }
+
+    // Replace invalid UTF-8 and most control characters with \x escapes
+    // first, then escape for JSON what remains.
+    std::string escaped = util::json_escape_utf8(data, len);
+    const char* s = escaped.data();
+    const char* end = s + escaped.size();
+
+    while ( s < end ) {
+        plain = plain_prefix_length(s, end - s);
+        buffer.append(s, plain);
+        s += plain;
+
+        for ( ; s < end; s++ ) {
+            auto c = static_cast<unsigned char>(*s);
+
+            if ( c >= ' ' && c != '"' && c != '\\' ) {
+                if ( c < 0x7f )
+                    break;
+
+                // Valid UTF-8 and DEL go out as they are.
+                buffer.push_back(*s);
+                continue;
+            }
+
+            buffer.push_back('\\');
+
+            switch ( c ) {
+                case '"': buffer.push_back('"'); break;
+                case '\\': buffer.push_back('\\'); break;
+                case '\b': buffer.push_back('b'); break;
+                case '\f': buffer.push_back('f'); break;
+                case '\n': buffer.push_back('n'); break;
+                case '\r': buffer.push_back('r'); break;
+                case '\t': buffer.push_back('t'); break;
+                default: {
+                    static constexpr char hex[] = "0123456789ABCDEF";
+                    buffer.append("u00");
+                    buffer.push_back(hex[c >> 4]);
+                    buffer.push_back(hex[c & 0xf]);
+                    break;
+                }
+            }
+        }
+    }
+
+    buffer.push_back('"');
+}
+
+void append_double(std::string& buffer, double d) {
+    if ( rapidjson::internal::Double(d).IsNanOrInf() ) {
+        buffer.append("null");
+        return;
+    }
+
+    char tmp[32];
+    char* end = rapidjson::internal::dtoa(d, tmp);
+    buffer.append(tmp, end - tmp);
+}
+
+} // namespace
+
 JSON::JSON(MsgThread* t, TimeFormat tf, bool arg_include_unset_fields)
     : Formatter(t), timestamps(tf), include_unset_fields(arg_include_unset_fields) {}
 
 bool JSON::Describe(ODesc* desc, int num_fields, const Field* const* fields, Value** vals) const {
-    rapidjson::StringBuffer buffer;
-    zeek::json::detail::NullDoubleWriter writer(buffer);
+    buffer.clear();
+    buffer.push_back('{');
 
-    writer.StartObject();
+    bool first = true;
 
     for ( int i = 0; i < num_fields; i++ ) {
-        if ( vals[i]->present || include_unset_fields )
-            BuildJSON(writer, vals[i], fields[i]->name);
+        if ( ! vals[i]->present && ! include_unset_fields )
+            continue;
+
+        if ( ! first )
+            buffer.push_back(',');
+
+        first = false;
+        buffer.append(Key(i, fields[i]));
+        AppendValue(vals[i]);
     }
 
-    writer.EndObject();
-    desc->Add(buffer.GetString());
+    buffer.push_back('}');
+    desc->AddN(buffer.data(), buffer.size());
 
     return true;
 }
@@ -51,15 +197,14 @@ bool JSON::Describe(ODesc* desc, Value* val, const std::string& name) const {
     if ( (! val->present && ! include_unset_fields) || name.empty() )
         return true;
 
-    rapidjson::Document doc;
-    rapidjson::StringBuffer buffer;
-    zeek::json::detail::NullDoubleWriter writer(buffer);
+    buffer.clear();
+    buffer.push_back('{');
+    append_string(buffer, name.data(), name.size());
+    buffer.push_back(':');
+    AppendValue(val);
+    buffer.push_back('}');
 
-    writer.StartObject();
-    BuildJSON(writer, val, name);
-    writer.EndObject();
-
-    desc->Add(buffer.GetString());
+    desc->AddN(buffer.data(), buffer.size());
     return true;
 }
 
@@ -68,98 +213,332 @@ Value* JSON::ParseValue(const std::string& s, const std::string& name, TypeTag t
     return nullptr;
 }
 
-void JSON::BuildJSON(zeek::json::detail::NullDoubleWriter& writer, Value* val, const std::string& name) const {
-    if ( ! name.empty() )
-        writer.Key(name);
+const std::string& JSON::Key(int i, const Field* field) const {
+    if ( static_cast<size_t>(i) >= keys.size() )
+        keys.resize(i + 1);
 
-    if ( ! val->present ) {
-        writer.Null();
-        return;
+    auto& [name, key] = keys[i];
+
+    // Callers pass the same fields with every write, so this normally only
+    // renders the key on the first one. Comparing the names themselves
+    // rather than their pointers keeps a reallocated name from matching.
+    if ( name != field->name ) {
+        key.clear();
+        append_string(key, field->name, strlen(field->name));
+        key.push_back(':');
+        name = field->name;
     }
 
-    switch ( val->type ) {
-        case TYPE_BOOL: writer.Bool(val->val.int_val != 0); break;
+    return key;
+}
 
-        case TYPE_INT: writer.Int64(val->val.int_val); break;
+void JSON::AppendTime(double t) const {
+    if ( timestamps == TS_ISO8601 ) {
+        char buffer1[40];
+        char buffer2[48];
+        time_t the_time = time_t(floor(t));
+        struct tm tm;
+
+        if ( ! gmtime_r(&the_time, &tm) || ! strftime(buffer1, sizeof(buffer1), "%Y-%m-%dT%H:%M:%S", &tm) ) {
+            GetThread()->Error(GetThread()->Fmt("json formatter: failure getting time: (%lf)", t));
+            // This was a failure, doesn't really matter what gets put here
+            // but it should probably stand out...
+            buffer.append("\"2000-01-01T00:00:00.000000\"");
+        }
+        else {
+            double integ;
+            double frac = modf(t, &integ);
 
-        case TYPE_COUNT: writer.Uint64(val->val.uint_val); break;
+            if ( frac < 0 )
+                frac += 1;
 
-        case TYPE_PORT: writer.Uint64(val->val.port_val.port); break;
+            int n = snprintf(buffer2, sizeof(buffer2), "\"%s.%06.0fZ\"", buffer1, fabs(frac) * 1000000);
+            buffer.append(buffer2, n);
+        }
+    }
 
-        case TYPE_SUBNET: writer.String(Formatter::Render(val->val.subnet_val)); break;
+    else if ( timestamps == TS_EPOCH )
+        append_double(buffer, t);
 
-        case TYPE_ADDR: writer.String(Formatter::Render(val->val.addr_val)); break;
+    else if ( timestamps == TS_MILLIS ) {
+        // ElasticSearch uses milliseconds for timestamps
+        append_integer(buffer, (uint64_t)(t * 1000));
+    }
+}
 
-        case TYPE_DOUBLE:
-        case TYPE_INTERVAL: writer.Double(val->val.double_val); break;
-
-        case TYPE_TIME: {
-            if ( timestamps == TS_ISO8601 ) {
-                char buffer[40];
-                char buffer2[48];
-                time_t the_time = time_t(floor(val->val.double_val));
-                struct tm t;
-
-                if ( ! gmtime_r(&the_time, &t) || ! strftime(buffer, sizeof(buffer), "%Y-%m-%dT%H:%M:%S", &t) ) {
-                    GetThread()->Error(
-                        GetThread()->Fmt("json formatter: failure getting time: (%lf)", val->val.double_val));
-                    // This was a failure, doesn't really matter what gets put here
-                    // but it should probably stand out...
-                    writer.String("2000-01-01T00:00:00.000000");
-                }
-                else {
-                    double integ;
-                    double frac = modf(val->val.double_val, &integ);
+void JSON::AppendValue(const Value* val) const {
+    if ( ! val->present ) {
+        buffer.append("null");
+        return;
+    }
 
-                    if ( frac < 0 )
-                        frac += 1;
+    switch ( val->type ) {
+        case TYPE_BOOL: buffer.append(val->val.int_val != 0 ? "true" : "false"); break;
 
-                    snprintf(buffer2, sizeof(buffer2), "%s.%06.0fZ", buffer, fabs(frac) * 1000000);
-                    writer.String(buffer2, strlen(buffer2));
-                }
-            }
+        case TYPE_INT: append_integer(buffer, val->val.int_val); break;
+
+        case TYPE_COUNT: append_integer(buffer, val->val.uint_val); break;
 
-            else if ( timestamps == TS_EPOCH )
-                writer.Double(val->val.double_val);
+        case TYPE_PORT: append_integer(buffer, val->val.port_val.port); break;
 
-            else if ( timestamps == TS_MILLIS ) {
-                // ElasticSearch uses milliseconds for timestamps
-                writer.Uint64((uint64_t)(val->val.double_val * 1000));
+        case TYPE_SUBNET: {
+            auto s = Formatter::Render(val->val.subnet_val);
+            append_string(buffer, s.data(), s.size());
+            break;
+        }
+
+        case TYPE_ADDR: {
+            const auto& addr = val->val.addr_val;
+            char s[INET6_ADDRSTRLEN];
+
+            if ( addr.family == IPv4 ? zeek_inet_ntop(AF_INET, &addr.in.in4, s, INET_ADDRSTRLEN) :
+                                       zeek_inet_ntop(AF_INET6, &addr.in.in6, s, INET6_ADDRSTRLEN) ) {
+                buffer.push_back('"');
+                buffer.append(s);
+                buffer.push_back('"');
+            }
+            else {
+                auto r = Formatter::Render(addr);
+                append_string(buffer, r.data(), r.size());
             }
 
             break;
         }
 
+        case TYPE_DOUBLE:
+        case TYPE_INTERVAL: append_double(buffer, val->val.double_val); break;
+
+        case TYPE_TIME: AppendTime(val->val.double_val); break;
+
         case TYPE_ENUM:
         case TYPE_STRING:
         case TYPE_FILE:
         case TYPE_FUNC: {
-            writer.String(util::json_escape_utf8(std::string(val->val.string_val.data, val->val.string_val.length)));
+            append_string(buffer, val->val.string_val.data, val->val.string_val.length);
             break;
         }
 
-        case TYPE_TABLE: {
-            writer.StartArray();
+        case TYPE_TABLE:
+        case TYPE_VECTOR: {
+            const auto& vals = val->type == TYPE_TABLE ? val->val.set_val : val->val.vector_val;
+
+            buffer.push_back('[');
 
-            for ( zeek_int_t idx = 0; idx < val->val.set_val.size; idx++ )
-                BuildJSON(writer, val->val.set_val.vals[idx]);
+            for ( zeek_int_t idx = 0; idx < vals.size; idx++ ) {
+                if ( idx > 0 )
+                    buffer.push_back(',');
 
-            writer.EndArray();
+                AppendValue(vals.vals[idx]);
+            }
+
+            buffer.push_back(']');
             break;
         }
 
-        case TYPE_VECTOR: {
-            writer.StartArray();
+        default: reporter->Warning("Unhandled type in JSON::AppendValue"); break;
+    }
+}
 
-            for ( zeek_int_t idx = 0; idx < val->val.vector_val.size; idx++ )
-                BuildJSON(writer, val->val.vector_val.vals[idx]);
+TEST_SUITE_BEGIN("threading formatter json");
 
-            writer.EndArray();
-            break;
+namespace {
+
+Value* string_value(TypeTag type, const std::string& s) {
+    auto* v = new Value(type, true);
+    v->val.string_val.data = util::copy_string(s.data(), s.size());
+    v->val.string_val.length = static_cast<int>(s.size());
+    return v;
+}
+
+std::string describe(const JSON& json, Value* v) {
+    ODesc desc;
+    json.Describe(&desc, v, "x");
+    delete v;
+    return {reinterpret_cast<const char*>(desc.Bytes()), static_cast<size_t>(desc.Len())};
+}
+
+} // namespace
+
+TEST_CASE("json formatter strings") {
+    JSON json(nullptr, JSON::TS_EPOCH);
+
+    CHECK(describe(json, string_value(TYPE_STRING, "")) == R"({"x":""})");
+    CHECK(describe(json, string_value(TYPE_STRING, "CHhAvVGS1DHFjwGM9")) == R"({"x":"CHhAvVGS1DHFjwGM9"})");
+    CHECK(describe(json, string_value(TYPE_STRING, "a \"quoted\" C:\\path")) ==
+          R"({"x":"a \"quoted\" C:\\path"})");
+    CHECK(describe(json, string_value(TYPE_STRING, "tab\there\r\n")) == R"({"x":"tab\there\r\n"})");
+    CHECK(describe(json, string_value(TYPE_STRING, std::string("\x01\x00\x7f", 3))) ==
+          R"({"x":"\\x01\\x00\\x7f"})");
+    CHECK(describe(json, string_value(TYPE_STRING, "se\xc3\xb1or")) == "{\"x\":\"se\xc3\xb1or\"}");
+    CHECK(describe(json, string_value(TYPE_STRING, "\xc3\xb1\xc0\x81")) == R"({"x":"\\xc3\\xb1\\xc0\\x81"})");
+
+    // Long enough to exercise the vectorized scan at different offsets.
+    std::string s(40, 'a');
+    for ( size_t i = 0; i < s.size(); i++ ) {
+        auto t = s;
+        t[i] = '"';
+        auto expected = "{\"x\":\"" + s.substr(0, i) + "\\\"" + s.substr(i + 1) + "\"}";
+        CHECK(describe(json, string_value(TYPE_STRING, t)) == expected);
+    }
+}
+
+TEST_CASE("json formatter values") {
+    JSON json(nullptr, JSON::TS_EPOCH);
+
+    auto* b = new Value(TYPE_BOOL);
+    b->val.int_val = 1;
+    CHECK(describe(json, b) == R"({"x":true})");
+
+    auto* i = new Value(TYPE_INT);
+    i->val.int_val = -42;
+    CHECK(describe(json, i) == R"({"x":-42})");
+
+    auto* d = new Value(TYPE_DOUBLE);
+    d->val.double_val = 3.14;
+    CHECK(describe(json, d) == R"({"x":3.14})");
+
+    auto* iv = new Value(TYPE_INTERVAL);
+    iv->val.double_val = 100.0;
+    CHECK(describe(json, iv) == R"({"x":100.0})");
+
+    auto* nan = new Value(TYPE_DOUBLE);
+    nan->val.double_val = std::nan("");
+    CHECK(describe(json, nan) == R"({"x":null})");
+
+    auto* a = new Value(TYPE_ADDR);
+    a->val.addr_val.family = IPv4;
+    a->val.addr_val.in.in4.s_addr = htonl(0x01020304);
+    CHECK(describe(json, a) == R"({"x":"1.2.3.4"})");
+
+    auto* v = new Value(TYPE_VECTOR, TYPE_COUNT);
+    v->val.vector_val.size = 3;
+    v->val.vector_val.vals = new Value*[3];
+    for ( int n = 0; n < 3; n++ ) {
+        v->val.vector_val.vals[n] = new Value(TYPE_COUNT, n != 1);
+        v->val.vector_val.vals[n]->val.uint_val = 10 * n;
+    }
+    CHECK(describe(json, v) == R"({"x":[0,null,20]})");
+
+    JSON millis(nullptr, JSON::TS_MILLIS);
+    auto* t = new Value(TYPE_TIME);
+    t->val.double_val = 1559847346.10295;
+    CHECK(describe(millis, t) == R"({"x":1559847346102})");
+}
+
+TEST_CASE("json formatter keys") {
+    JSON json(nullptr, JSON::TS_EPOCH);
+    Field field("a", nullptr, TYPE_COUNT, TYPE_ERROR, false);
+    const Field* fields[] = {&field};
+    Value val(TYPE_COUNT);
+    val.val.uint_val = 1;
+    Value* vals[] = {&val};
+
+    auto describe_record = [&]() {
+        ODesc desc;
+        json.Describe(&desc, 1, fields, vals);
+        return std::string(reinterpret_cast<const char*>(desc.Bytes()), desc.Len());
+    };
+
+    CHECK(describe_record() == R"({"a":1})");
+
+    // A different name at the same address, as after freeing and
+    // reallocating it, must not reuse the cached key.
+    const_cast<char*>(field.name)[0] = 'b';
+    CHECK(describe_record() == R"({"b":1})");
+}
+
+// Microbenchmark formatting conn.log records. Skipped by default, run with:
+// zeek --test -tc="json formatter benchmark" --no-skip
+TEST_CASE("json formatter benchmark" * doctest::skip(true)) {
+    constexpr size_t n = 1000000;
+
+    // A record from testing/btest/Baseline/opt.basic/conn.log, with "-" for
+    // unset fields.
+    struct {
+        const char* name;
+        TypeTag type;
+        const char* value;
+    } columns[] = {
+        {"ts", TYPE_TIME, "1300475167.096535"},
+        {"uid", TYPE_STRING, "CmES5u32sYpV7JYN"},
+        {"id.orig_h", TYPE_ADDR, "141.142.220.118"},
+        {"id.orig_p", TYPE_PORT, "43927"},
+        {"id.resp_h", TYPE_ADDR, "141.142.2.2"},
+        {"id.resp_p", TYPE_PORT, "53"},
+        {"proto", TYPE_ENUM, "udp"},
+        {"service", TYPE_STRING, "dns"},
+        {"duration", TYPE_INTERVAL, "0.000435"},
+        {"orig_bytes", TYPE_COUNT, "38"},
+        {"resp_bytes", TYPE_COUNT, "89"},
+        {"conn_state", TYPE_STRING, "SF"},
+        {"local_orig", TYPE_BOOL, "F"},
+        {"local_resp", TYPE_BOOL, "F"},
+        {"missed_bytes", TYPE_COUNT, "0"},
+        {"history", TYPE_STRING, "Dd"},
+        {"orig_pkts", TYPE_COUNT, "1"},
+        {"orig_ip_bytes", TYPE_COUNT, "66"},
+        {"resp_pkts", TYPE_COUNT, "1"},
+        {"resp_ip_bytes", TYPE_COUNT, "117"},
+        {"tunnel_parents", TYPE_TABLE, "-"},
+        {"ip_proto", TYPE_COUNT, "17"},
+    };
+
+    std::vector<Field*> fields;
+    std::vector<Value*> vals;
+
+    for ( const auto& c : columns ) {
+        fields.push_back(new Field(c.name, nullptr, c.type, TYPE_STRING, false));
+
+        if ( strcmp(c.value, "-") == 0 ) {
+            vals.push_back(new Value(c.type, false));
+            continue;
+        }
+
+        if ( c.type == TYPE_STRING || c.type == TYPE_ENUM ) {
+            vals.push_back(string_value(c.type, c.value));
+            continue;
         }
 
-        default: reporter->Warning("Unhandled type in JSON::BuildJSON"); break;
+        auto* v = new Value(c.type);
+
+        switch ( c.type ) {
+            case TYPE_TIME:
+            case TYPE_INTERVAL: v->val.double_val = strtod(c.value, nullptr); break;
+            case TYPE_COUNT: v->val.uint_val = strtoull(c.value, nullptr, 10); break;
+            case TYPE_PORT: v->val.port_val = {strtoull(c.value, nullptr, 10), TRANSPORT_UDP}; break;
+            case TYPE_BOOL: v->val.int_val = c.value[0] == 'T'; break;
+            case TYPE_ADDR:
+                v->val.addr_val.family = IPv4;
+                inet_pton(AF_INET, c.value, &v->val.addr_val.in.in4);
+                break;
+            default: break;
+        }
+
+        vals.push_back(v);
+    }
+
+    JSON json(nullptr, JSON::TS_EPOCH);
+    ODesc desc;
+    size_t bytes = 0;
+
+    auto start = std::chrono::steady_clock::now();
+
+    for ( size_t i = 0; i < n; i++ ) {
+        desc.Clear();
+        json.Describe(&desc, static_cast<int>(fields.size()), fields.data(), vals.data());
+        bytes += desc.Len();
     }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    MESSAGE(util::fmt("%.0f lines/s, %.1f MB/s", n / elapsed.count(), bytes / elapsed.count() / 1e6));
+
+    for ( auto* f : fields )
+        delete f;
+
+    for ( auto* v : vals )
+        delete v;
 }
 
+TEST_SUITE_END();
+
 } // namespace zeek::threading::formatter
@@ -2,19 +2,21 @@
 
 #pragma once
 
-#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
 
 #include "zeek/threading/Formatter.h"
 
-namespace zeek::json::detail {
-class NullDoubleWriter;
-}
-
 namespace zeek::threading::formatter {
 
 /**
- * A thread-safe class for converting values into a JSON representation
- * and vice versa.
+ * A class for converting values into a JSON representation and vice versa.
+ *
+ * Output is rendered directly into a buffer that's reused across calls,
+ * along with the quoted field names, which are rendered once per field.
+ * Each instance must therefore only be used by a single thread, as is the
+ * case for a writer's formatter.
  */
 class JSON : public Formatter {
 public:
@@ -34,10 +36,19 @@ public:
                       TypeTag subtype = TYPE_ERROR) const override;
 
 private:
-    void BuildJSON(zeek::json::detail::NullDoubleWriter& writer, Value* val, const std::string& name = "") const;
+    void AppendValue(const Value* val) const;
+    void AppendTime(double t) const;
+    const std::string& Key(int i, const Field* field) const;
 
     TimeFormat timestamps;
     bool include_unset_fields;
+
+    // The JSON being built by the current call.
+    mutable std::string buffer;
+
+    // Per field index, the name the key was rendered for and the rendered
+    // key, i.e., the quoted name followed by a colon.
+    mutable std::vector<std::pair<std::string, std::string>> keys;
 };
 
 } // namespace zeek::threading::formatter
@@ -23,6 +23,8 @@
 #include "zeek/3rdparty/sqlite3.h"
 #endif
 
+#include "zeek/DFA.h"
+#include "zeek/DFACache.h"
 #include "zeek/DNS_Mgr.h"
 #include "zeek/Debug.h"
 #include "zeek/Desc.h"
@@ -817,6 +819,7 @@ SetupResult setup(int argc, char** argv, Options* zopts) {
         RecordType::InitPostScript();
 
         telemetry_mgr->InitPostScript();
+        DFA_Machine::InitPostScript();
         thread_mgr->InitPostScript();
         iosource_mgr->InitPostScript();
         log_mgr->InitPostScript();
@@ -949,6 +952,9 @@ SetupResult setup(int argc, char** argv, Options* zopts) {
         file_mgr->InitMagic();
     }
 
+    if ( id::find_val("dfa_precompile")->AsBool() )
+        precompile_dfas();
+
     if ( g_policy_debug )
         // ### Add support for debug command file.
         dbg_init_debugger(nullptr);
@@ -1130,6 +1136,7 @@ int cleanup(bool did_run_loop) {
     File::CloseOpenFiles();
 
     delete rule_matcher;
+    rule_matcher = nullptr;
 
     return 0;
 }
@@ -1153,6 +1160,7 @@ void zeek_terminate_loop(const char* reason) {
     File::CloseOpenFiles();
 
     delete zeek::detail::rule_matcher;
+    zeek::detail::rule_matcher = nullptr;
 
     exit(0);
 }
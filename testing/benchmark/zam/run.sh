@@ -0,0 +1,32 @@
+#! /usr/bin/env bash
+#
+# Times the scripts in this directory under the interpreter and under ZAM,
+# or collects their ZAM instruction-sequence profiles, from which fused ZAM
+# instructions are chosen. Profiling needs a build configured with
+# --enable-ZAM-profiling; take timings with a build configured without it.
+#
+#     ./run.sh path/to/zeek           # timings
+#     ./run.sh path/to/zeek profile   # profiles, kept in <script>.zprof
+
+set -e
+
+zeek=$(realpath "${1:-$(command -v zeek)}")
+mode=${2:-time}
+
+cd "$(dirname "$0")"
+
+for script in *.zeek; do
+    name=${script%.zeek}
+
+    if [ "$mode" = profile ]; then
+        "$zeek" -b -O profile-ZAM "$script" >/dev/null
+        mv zprof.out "$name.zprof"
+        echo "== $name"
+        sed -n '/^Most frequent ZOP sequences:/,+20p' "$name.zprof"
+    else
+        for opts in "" "-O ZAM"; do
+            TIMEFORMAT="$name ${opts:-(interpreted)}: %U user, %R real"
+            time "$zeek" -b $opts "$script" >/dev/null
+        done
+    fi
+done
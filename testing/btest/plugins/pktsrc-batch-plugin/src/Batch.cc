@@ -0,0 +1,88 @@
+
+#include "Batch.h"
+
+extern "C" {
+#include <pcap.h>
+}
+
+#include <fcntl.h>
+#include <algorithm>
+#include <cstdio>
+
+using namespace btest::plugin::Demo_Foo;
+
+Batch::Batch(const std::string& path, bool is_live) {
+    // UDP packets from 10.0.0.1 to 10.0.0.2:53, with the source port
+    // counting up from 1000.
+    for ( int i = 0; i < 10; i++ ) {
+        std::string p("\x45\x00\x00\x1c\x00\x00\x40\x00\x40\x11\x00\x00\x0a\x00\x00\x01"
+                      "\x0a\x00\x00\x02\x00\x00\x00\x35\x00\x08\x00\x00",
+                      28);
+        p[20] = static_cast<char>((1000 + i) >> 8);
+        p[21] = static_cast<char>((1000 + i) & 0xff);
+        packets.push_back(std::move(p));
+    }
+
+    props.path = path;
+    props.selectable_fd = open("/bin/sh", O_RDONLY); // any fd is fine.
+    props.link_type = DLT_RAW;
+    props.netmask = 0;
+    props.is_live = 0;
+}
+
+zeek::iosource::PktSrc* Batch::Instantiate(const std::string& path, bool is_live) {
+    return new Batch(path, is_live);
+}
+
+void Batch::Open() { Opened(props); }
+
+void Batch::Close() { Closed(); }
+
+bool Batch::ExtractNextPacket(zeek::Packet* pkt) { return ExtractNextPackets(pkt, 1) == 1; }
+
+void Batch::DoneWithPacket() { DoneWithPackets(1); }
+
+size_t Batch::ExtractNextPackets(zeek::Packet* pkts, size_t max) {
+    if ( pending > 0 ) {
+        fprintf(stderr, "extracting while %zu packets are pending\n", pending);
+        return 0;
+    }
+
+    if ( next == packets.size() ) {
+        Close();
+        return 0;
+    }
+
+    size_t n = std::min(max, packets.size() - next);
+
+    for ( size_t i = 0; i < n; i++, next++ ) {
+        pkt_timeval ts = {static_cast<time_t>(1409193037 + next), 0};
+        const auto& p = packets[next];
+        pkts[i].Init(props.link_type, &ts, p.size(), p.size(), reinterpret_cast<const u_char*>(p.data()));
+    }
+
+    fprintf(stderr, "extracted %zu packets\n", n);
+    pending = n;
+    return n;
+}
+
+void Batch::DoneWithPackets(size_t n) {
+    if ( n != pending )
+        fprintf(stderr, "done with %zu packets, but %zu are pending\n", n, pending);
+
+    pending = 0;
+}
+
+bool Batch::PrecompileFilter(int index, const std::string& filter) {
+    // skip for the testing.
+    return true;
+}
+
+bool Batch::SetFilter(int index) {
+    // skip for the testing.
+    return true;
+}
+
+void Batch::Statistics(Stats* stats) {
+    // skip for the testing.
+}
@@ -0,0 +1,36 @@
+
+#pragma once
+
+#include <Val.h>
+#include <iosource/PktSrc.h>
+#include <vector>
+
+namespace btest::plugin::Demo_Foo {
+
+// Provides a fixed number of UDP packets, as many at once as Zeek asks for.
+class Batch : public zeek::iosource::PktSrc {
+public:
+    Batch(const std::string& path, bool is_live);
+
+    static zeek::iosource::PktSrc* Instantiate(const std::string& path, bool is_live);
+
+protected:
+    void Open() override;
+    void Close() override;
+    bool ExtractNextPacket(zeek::Packet* pkt) override;
+    void DoneWithPacket() override;
+    bool SupportsBatches() const override { return true; }
+    size_t ExtractNextPackets(zeek::Packet* pkts, size_t max) override;
+    void DoneWithPackets(size_t n) override;
+    bool PrecompileFilter(int index, const std::string& filter) override;
+    bool SetFilter(int index) override;
+    void Statistics(Stats* stats) override;
+
+private:
+    Properties props;
+    std::vector<std::string> packets;
+    size_t next = 0;
+    size_t pending = 0;
+};
+
+} // namespace btest::plugin::Demo_Foo
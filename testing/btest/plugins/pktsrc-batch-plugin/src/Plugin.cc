@@ -0,0 +1,24 @@
+
+#include "Plugin.h"
+
+#include "Batch.h"
+#include "iosource/Component.h"
+
+namespace btest::plugin::Demo_Foo {
+Plugin plugin;
+}
+
+using namespace btest::plugin::Demo_Foo;
+
+zeek::plugin::Configuration Plugin::Configure() {
+    AddComponent(new zeek::iosource::PktSrcComponent("BatchPktSrc", "batch", zeek::iosource::PktSrcComponent::BOTH,
+                                                     btest::plugin::Demo_Foo::Batch::Instantiate));
+
+    zeek::plugin::Configuration config;
+    config.name = "Demo::Foo";
+    config.description = "A packet source providing batches";
+    config.version.major = 1;
+    config.version.minor = 0;
+    config.version.patch = 0;
+    return config;
+}